@@ -1,136 +1,193 @@
-// C or C++ program for insertion and
-// deletion in Circular Queue
+// C++ program for insertion and
+// deletion in Circular Queue, and for passing
+// items between threads through one.
+//
+// Build: g++ -std=c++11 -O2 -pthread 01_circular_queue.cpp
 #include<stdio.h>
 #include<limits.h>
+#include<thread>
+#include<vector>
+#include "RingBuffer.h"
 using namespace std;
- 
-struct Queue
-{
-    // Initialize front and rear
-    int rear, front;
- 
-    // Circular Queue
-    int size;
-    int *arr;
- 
-    Queue(int s)
-    {
-       front = rear = -1;
-       size = s;
-       arr = new int[s];
-    }
- 
-    void enQueue(int value);
-    int deQueue();
-    void displayQueue();
-};
- 
- 
-/* Function to create Circular queue */
-void Queue::enQueue(int value)
+
+// Function displaying the elements
+// of Circular Queue, oldest first.
+// Takes them all out and puts them back.
+void displayQueue(RingBuffer<int> &q)
 {
-    if ((front == 0 && rear == size-1) ||
-            (rear == (front-1)%(size-1)))
+    if (q.empty())
     {
-        printf("\nQueue is Full");
+        printf("\nQueue is Empty");
         return;
     }
- 
-    else if (front == -1) /* Insert First Element */
-    {
-        front = rear = 0;
-        arr[rear] = value;
-    }
- 
-    else if (rear == size-1 && front != 0)
-    {
-        rear = 0;
-        arr[rear] = value;
-    }
- 
-    else
+    printf("\nElements in Circular Queue are: ");
+    size_t n = q.size();
+    for (size_t i = 0; i < n; i++)
     {
-        rear++;
-        arr[rear] = value;
+        int value = 0;
+        q.pop(value);
+        printf("%d ", value);
+        q.push(value);
     }
 }
- 
-// Function to delete element from Circular Queue
-int Queue::deQueue()
+
+void enQueue(RingBuffer<int> &q, int value)
 {
-    if (front == -1)
-    {
-        printf("\nQueue is Empty");
-        return INT_MIN;
-    }
- 
-    int data = arr[front];
-    arr[front] = -1;
-    if (front == rear)
-    {
-        front = -1;
-        rear = -1;
-    }
-    else if (front == size-1)
-        front = 0;
-    else
-        front++;
- 
-    return data;
+    if (!q.push(value))
+        printf("\nQueue is Full");
 }
- 
-// Function displaying the elements
-// of Circular Queue
-void Queue::displayQueue()
+
+// Returns INT_MIN if the queue is empty
+int deQueue(RingBuffer<int> &q)
 {
-    if (front == -1)
-    {
+    int value = INT_MIN;
+    if (!q.pop(value))
         printf("\nQueue is Empty");
-        return;
-    }
-    printf("\nElements in Circular Queue are: ");
-    if (rear >= front)
+    return value;
+}
+
+// A capture thread hands blocks of samples
+// to a processing thread, which sums them.
+// Neither ever waits on a lock: the capture
+// side drops a block if the queue is full,
+// and the processing side spins while it's empty.
+// Both work in the queue's own memory: capture
+// writes each block straight into reserved slots,
+// and processing reads the samples where they are.
+void captureToProcessing()
+{
+    // 48 doesn't divide the capacity, so some
+    // blocks wrap around the end of the queue
+    const int BLOCK = 48, NUM_BLOCKS = 20000;
+    RingBuffer<float> q(1024);
+    long long dropped = 0, wrapped = 0;
+    double sum = 0;
+
+    thread capture([&]()
     {
-        for (int i = front; i <= rear; i++)
-            printf("%d ",arr[i]);
-    }
-    else
+        for (int b = 0; b < NUM_BLOCKS; b++)
+        {
+            RingBuffer<float>::Spans s = q.reserve(BLOCK);
+            if (s.size() < BLOCK)
+                dropped++;
+            else
+            {
+                // As the device would fill them
+                for (size_t i = 0; i < s.firstSize; i++)
+                    s.first[i] = 1;
+                for (size_t i = 0; i < s.secondSize; i++)
+                    s.second[i] = 1;
+                wrapped += s.secondSize > 0;
+                q.commit(BLOCK);
+            }
+            this_thread::yield();  // Until the device has the next block
+        }
+        while (!q.push(-1))  // End of stream
+            this_thread::yield();
+    });
+
+    thread processing([&]()
     {
-        for (int i = front; i < size; i++)
-            printf("%d ", arr[i]);
- 
-        for (int i = 0; i <= rear; i++)
-            printf("%d ", arr[i]);
-    }
+        for (;;)
+        {
+            RingBuffer<float>::Spans s = q.peek(BLOCK);
+            for (size_t i = 0; i < s.size(); i++)
+            {
+                float x = i < s.firstSize ? s.first[i]
+                                          : s.second[i - s.firstSize];
+                if (x < 0)
+                    return;
+                sum += x;
+            }
+            q.release(s.size());
+            if (s.size() == 0)
+                this_thread::yield();
+        }
+    });
+
+    capture.join();
+    processing.join();
+    printf("\nProcessed %.0f samples, dropped %lld blocks of %d, %lld wrapped around",
+           sum, dropped, BLOCK, wrapped);
+}
+
+// Four producers and four consumers share
+// one queue; every item comes out exactly once.
+void manyToMany()
+{
+    const int THREADS = 4, PER_THREAD = 100000;
+    MpmcRingBuffer<int> q(256);
+    vector<long long> sums(THREADS, 0);
+    vector<thread> threads;
+
+    for (int t = 0; t < THREADS; t++)
+        threads.push_back(thread([&, t]()
+        {
+            for (int i = 1; i <= PER_THREAD; i++)
+                while (!q.push(i))
+                    this_thread::yield();
+        }));
+
+    for (int t = 0; t < THREADS; t++)
+        threads.push_back(thread([&, t]()
+        {
+            int value;
+            for (int i = 0; i < PER_THREAD; i++)
+            {
+                while (!q.pop(value))
+                    this_thread::yield();
+                sums[t] += value;
+            }
+        }));
+
+    for (size_t t = 0; t < threads.size(); t++)
+        threads[t].join();
+
+    long long total = 0;
+    for (int t = 0; t < THREADS; t++)
+        total += sums[t];
+    printf("\nSum of items taken = %lld, expected %lld", total,
+           (long long)THREADS * PER_THREAD * (PER_THREAD + 1) / 2);
 }
- 
+
 /* Driver of the program */
 int main()
 {
-    Queue q(5);
- 
+    // Capacity is rounded up to a power of two,
+    // so this queue holds 8
+    RingBuffer<int> q(5);
+
     // Inserting elements in Circular Queue
-    q.enQueue(14);
-    q.enQueue(22);
-    q.enQueue(13);
-    q.enQueue(-6);
- 
+    enQueue(q, 14);
+    enQueue(q, 22);
+    enQueue(q, 13);
+    enQueue(q, -6);
+
     // Display elements present in Circular Queue
-    q.displayQueue();
- 
+    displayQueue(q);
+
     // Deleting elements from Circular Queue
-    printf("\nDeleted value = %d", q.deQueue());
-    printf("\nDeleted value = %d", q.deQueue());
- 
-    q.displayQueue();
- 
-    q.enQueue(9);
-    q.enQueue(20);
-    q.enQueue(5);
- 
-    q.displayQueue();
- 
-    q.enQueue(20);
-    q.displayQueue();
+    printf("\nDeleted value = %d", deQueue(q));
+    printf("\nDeleted value = %d", deQueue(q));
+
+    displayQueue(q);
+
+    enQueue(q, 9);
+    enQueue(q, 20);
+    enQueue(q, 5);
+
+    displayQueue(q);
+
+    enQueue(q, 20);
+    enQueue(q, 7);
+    enQueue(q, 3);
+    displayQueue(q);
+
+    // All 8 slots are taken
+    enQueue(q, 1);
+
+    captureToProcessing();
+    manyToMany();
+    printf("\n");
     return 0;
 }
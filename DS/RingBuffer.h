@@ -0,0 +1,433 @@
+// RingBuffer.h
+//
+// Bounded circular queues for passing items between threads without locks.
+//
+//   RingBuffer<T>      one producer thread and one consumer thread; every call is
+//                      wait-free (it finishes in a bounded number of steps, whatever
+//                      the other thread is doing)
+//   MpmcRingBuffer<T>  any number of producers and consumers (Dmitry Vyukov's bounded
+//                      MPMC queue); lock-free
+//
+// Both have a power-of-two capacity, so a position becomes a slot index with a mask
+// instead of a division, and both keep the producers' and consumers' positions on
+// separate cache lines so the two sides don't keep stealing one line from each other.
+// Neither blocks: push on a full queue and pop on an empty one just return false (or a
+// short count for the bulk calls), and the caller decides whether to wait, retry or drop.
+//
+// Positions are free-running counters, never wrapped to the capacity: the number of
+// items held is always tail - head, so a full queue and an empty one can't be confused,
+// and every slot is usable.
+
+#ifndef RING_BUFFER_H
+#define RING_BUFFER_H
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace ring_buffer_detail
+{
+    const size_t CACHE_LINE = 64;
+
+    // Smallest power of two >= n, and at least 2
+    inline size_t roundUpPow2(size_t n)
+    {
+        size_t size = 2;
+        while (size < n)
+            size *= 2;
+        return size;
+    }
+
+    // Uninitialized storage for one T, constructed and destroyed as items come and go
+    template <typename T>
+    struct Slot
+    {
+        alignas(T) unsigned char bytes[sizeof(T)];
+
+        T *item() { return reinterpret_cast<T *>(bytes); }
+    };
+}
+
+// Single producer, single consumer. Besides copying items in and out, each side can work
+// on the queue's memory in place: the producer reserves free slots, fills them (e.g. by
+// reading from a socket straight into them) and commits them, and the consumer peeks at
+// items and releases them once it's done. A run of slots that crosses the end of the
+// storage comes back as two spans, the second starting at slot 0.
+template <typename T>
+class RingBuffer
+{
+public:
+    // Up to two runs of consecutive slots; second is empty unless the run wraps around
+    struct Spans
+    {
+        T *first;
+        size_t firstSize;
+        T *second;
+        size_t secondSize;
+
+        size_t size() const { return firstSize + secondSize; }
+    };
+
+    // capacity is rounded up to a power of two
+    explicit RingBuffer(size_t capacity)
+        : capacity_(ring_buffer_detail::roundUpPow2(capacity)),
+          mask_(capacity_ - 1),
+          slots_(new ring_buffer_detail::Slot<T>[capacity_]),
+          head_(0), cachedTail_(0), peeked_(0), tail_(0), cachedHead_(0), reserved_(0)
+    {
+    }
+
+    ~RingBuffer()
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        for (size_t pos = head_.load(std::memory_order_relaxed); pos != tail; pos++)
+            slots_[pos & mask_].item()->~T();
+        delete[] slots_;
+    }
+
+    RingBuffer(const RingBuffer &) = delete;
+    RingBuffer &operator=(const RingBuffer &) = delete;
+
+    size_t capacity() const { return capacity_; }
+
+    // Items held. Exact when called by either side with the other idle; otherwise a
+    // snapshot that may already be out of date.
+    size_t size() const
+    {
+        return tail_.load(std::memory_order_acquire) - head_.load(std::memory_order_acquire);
+    }
+
+    bool empty() const { return size() == 0; }
+
+    // Producer: adds an item, or returns false if the queue is full
+    bool push(const T &item) { return emplace(item); }
+    bool push(T &&item) { return emplace(std::move(item)); }
+
+    template <typename... Args>
+    bool emplace(Args &&... args)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (tail - cachedHead_ == capacity_)
+        {
+            // Looks full; see how far the consumer has got
+            cachedHead_ = head_.load(std::memory_order_acquire);
+            if (tail - cachedHead_ == capacity_)
+                return false;
+        }
+
+        new (slots_[tail & mask_].item()) T(std::forward<Args>(args)...);
+        tail_.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer: takes the oldest item, or returns false if the queue is empty
+    bool pop(T &item)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (head == cachedTail_)
+        {
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+            if (head == cachedTail_)
+                return false;
+        }
+
+        T *slot = slots_[head & mask_].item();
+        item = std::move(*slot);
+        slot->~T();
+        head_.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Producer: adds up to n items, as many as fit, and publishes them all at once.
+    // Returns how many were added.
+    size_t pushBulk(const T *items, size_t n)
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (capacity_ - (tail - cachedHead_) < n)
+            cachedHead_ = head_.load(std::memory_order_acquire);
+        size_t space = capacity_ - (tail - cachedHead_);
+        if (n > space)
+            n = space;
+
+        for (size_t i = 0; i < n; i++)
+            new (slots_[(tail + i) & mask_].item()) T(items[i]);
+        tail_.store(tail + n, std::memory_order_release);
+        return n;
+    }
+
+    // Consumer: takes up to n of the oldest items. Returns how many were taken.
+    size_t popBulk(T *items, size_t n)
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (cachedTail_ - head < n)
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+        size_t available = cachedTail_ - head;
+        if (n > available)
+            n = available;
+
+        for (size_t i = 0; i < n; i++)
+        {
+            T *slot = slots_[(head + i) & mask_].item();
+            items[i] = std::move(*slot);
+            slot->~T();
+        }
+        head_.store(head + n, std::memory_order_release);
+        return n;
+    }
+
+    // In-place access hands out slots as T without constructing or destroying anything,
+    // so it's only for types that are just bytes.
+
+    // Producer: up to n free slots, as many as there are, to be filled and then committed.
+    // Reserving again before committing hands out the same slots.
+    Spans reserve(size_t n)
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "reserve needs a trivially copyable type");
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        if (capacity_ - (tail - cachedHead_) < n)
+            cachedHead_ = head_.load(std::memory_order_acquire);
+        size_t space = capacity_ - (tail - cachedHead_);
+        if (n > space)
+            n = space;
+        reserved_ = n;
+        return spans(tail, n);
+    }
+
+    // Producer: publishes the first n of the slots last reserved
+    void commit(size_t n)
+    {
+        assert(n <= reserved_);
+        reserved_ -= n;
+        tail_.store(tail_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+    // Consumer: up to n of the oldest items, as many as there are, left in the queue until
+    // released. Peeking again before releasing hands out the same items.
+    Spans peek(size_t n)
+    {
+        static_assert(std::is_trivially_copyable<T>::value,
+                      "peek needs a trivially copyable type");
+        size_t head = head_.load(std::memory_order_relaxed);
+        if (cachedTail_ - head < n)
+            cachedTail_ = tail_.load(std::memory_order_acquire);
+        size_t available = cachedTail_ - head;
+        if (n > available)
+            n = available;
+        peeked_ = n;
+        return spans(head, n);
+    }
+
+    // Consumer: removes the first n of the items last peeked, freeing their slots
+    void release(size_t n)
+    {
+        assert(n <= peeked_);
+        peeked_ -= n;
+        head_.store(head_.load(std::memory_order_relaxed) + n, std::memory_order_release);
+    }
+
+private:
+    const size_t capacity_;
+    const size_t mask_;
+    ring_buffer_detail::Slot<T> *const slots_;
+
+    // n slots from position pos, split where they wrap around
+    Spans spans(size_t pos, size_t n)
+    {
+        size_t index = pos & mask_;
+        size_t firstSize = n < capacity_ - index ? n : capacity_ - index;
+        Spans s = {slots_[index].item(), firstSize, slots_[0].item(), n - firstSize};
+        return s;
+    }
+
+    // The consumer's line, and the producer's. Each side keeps its last sight of the
+    // other's position on its own line, and only reads the other's line again when that
+    // copy says the queue is empty (or full).
+    alignas(ring_buffer_detail::CACHE_LINE) std::atomic<size_t> head_;
+    size_t cachedTail_;
+    size_t peeked_;    // Peeked and not yet released
+    alignas(ring_buffer_detail::CACHE_LINE) std::atomic<size_t> tail_;
+    size_t cachedHead_;
+    size_t reserved_;  // Reserved and not yet committed
+};
+
+// Multiple producers, multiple consumers. Each slot has a sequence number saying which
+// lap of the ring it's ready for: pos when free for the producer of position pos, pos + 1
+// once that item is in it, and pos + capacity once it's been taken, i.e. free for the
+// next lap. A producer claims a position by advancing the shared tail with a
+// compare-and-swap, and only then writes its slot, so producers never wait on each other
+// except to retry a lost swap.
+template <typename T>
+class MpmcRingBuffer
+{
+public:
+    // capacity is rounded up to a power of two
+    explicit MpmcRingBuffer(size_t capacity)
+        : capacity_(ring_buffer_detail::roundUpPow2(capacity)),
+          mask_(capacity_ - 1),
+          cells_(new Cell[capacity_]),
+          head_(0), tail_(0)
+    {
+        for (size_t i = 0; i < capacity_; i++)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    ~MpmcRingBuffer()
+    {
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        for (size_t pos = head_.load(std::memory_order_relaxed); pos != tail; pos++)
+            cells_[pos & mask_].slot.item()->~T();
+        delete[] cells_;
+    }
+
+    MpmcRingBuffer(const MpmcRingBuffer &) = delete;
+    MpmcRingBuffer &operator=(const MpmcRingBuffer &) = delete;
+
+    size_t capacity() const { return capacity_; }
+
+    // A snapshot of the items held; may be out of date as soon as it's returned
+    size_t size() const
+    {
+        size_t head = head_.load(std::memory_order_acquire);
+        size_t tail = tail_.load(std::memory_order_acquire);
+        return tail > head ? tail - head : 0;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    // Adds an item, or returns false if the queue is full
+    bool push(const T &item) { return emplace(item); }
+    bool push(T &&item) { return emplace(std::move(item)); }
+
+    template <typename... Args>
+    bool emplace(Args &&... args)
+    {
+        size_t pos;
+        Cell *cell = claim(tail_, 0, pos);
+        if (!cell)
+            return false;
+        new (cell->slot.item()) T(std::forward<Args>(args)...);
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Takes the oldest item, or returns false if the queue is empty
+    bool pop(T &item)
+    {
+        size_t pos;
+        Cell *cell = claim(head_, 1, pos);
+        if (!cell)
+            return false;
+        T *slot = cell->slot.item();
+        item = std::move(*slot);
+        slot->~T();
+        cell->sequence.store(pos + capacity_, std::memory_order_release);
+        return true;
+    }
+
+    // Adds up to n items in consecutive positions, claimed with one compare-and-swap.
+    // Returns how many were added, fewer than n if the queue filled up.
+    size_t pushBulk(const T *items, size_t n)
+    {
+        size_t pos;
+        n = claimRun(tail_, 0, n, pos);
+        for (size_t i = 0; i < n; i++)
+        {
+            Cell &cell = cells_[(pos + i) & mask_];
+            new (cell.slot.item()) T(items[i]);
+            cell.sequence.store(pos + i + 1, std::memory_order_release);
+        }
+        return n;
+    }
+
+    // Takes up to n of the oldest items. Returns how many were taken.
+    size_t popBulk(T *items, size_t n)
+    {
+        size_t pos;
+        n = claimRun(head_, 1, n, pos);
+        for (size_t i = 0; i < n; i++)
+        {
+            Cell &cell = cells_[(pos + i) & mask_];
+            T *slot = cell.slot.item();
+            items[i] = std::move(*slot);
+            slot->~T();
+            cell.sequence.store(pos + i + capacity_, std::memory_order_release);
+        }
+        return n;
+    }
+
+private:
+    struct Cell
+    {
+        std::atomic<size_t> sequence;
+        ring_buffer_detail::Slot<T> slot;
+    };
+
+    const size_t capacity_;
+    const size_t mask_;
+    Cell *const cells_;
+
+    alignas(ring_buffer_detail::CACHE_LINE) std::atomic<size_t> head_;  // Next to pop
+    alignas(ring_buffer_detail::CACHE_LINE) std::atomic<size_t> tail_;  // Next to push
+
+    // Claims the next position of a side (tail_ with ready 0 for a producer, head_ with
+    // ready 1 for a consumer). Returns its cell, or NULL if the queue is full (or empty).
+    Cell *claim(std::atomic<size_t> &side, size_t ready, size_t &pos)
+    {
+        pos = side.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            Cell *cell = &cells_[pos & mask_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            ptrdiff_t lag = (ptrdiff_t)(sequence - (pos + ready));
+            if (lag == 0)
+            {
+                if (side.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed))
+                    return cell;
+                // Lost to another thread; pos now holds the current position
+            }
+            else if (lag < 0)
+                return NULL;  // The cell is still a lap behind: full (or empty)
+            else
+                pos = side.load(std::memory_order_relaxed);  // Someone got there first
+        }
+    }
+
+    // Claims up to n consecutive positions of a side, as many as are ready, with one
+    // compare-and-swap. A cell seen ready stays ready until its position is claimed, and
+    // only this swap can claim it, so checking them all before the swap is safe.
+    size_t claimRun(std::atomic<size_t> &side, size_t ready, size_t n, size_t &pos)
+    {
+        pos = side.load(std::memory_order_relaxed);
+        for (;;)
+        {
+            size_t run = 0;
+            while (run < n && run < capacity_)
+            {
+                size_t sequence =
+                    cells_[(pos + run) & mask_].sequence.load(std::memory_order_acquire);
+                if (sequence != pos + run + ready)
+                    break;
+                run++;
+            }
+
+            if (run == 0)
+            {
+                // Full (or empty), unless the first cell is ahead because pos is stale
+                size_t sequence = cells_[pos & mask_].sequence.load(std::memory_order_acquire);
+                if ((ptrdiff_t)(sequence - (pos + ready)) < 0)
+                    return 0;
+                pos = side.load(std::memory_order_relaxed);
+                continue;
+            }
+
+            if (side.compare_exchange_weak(pos, pos + run, std::memory_order_relaxed))
+                return run;
+        }
+    }
+};
+
+#endif
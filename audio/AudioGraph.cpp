@@ -0,0 +1,199 @@
+// =================================================================================================
+// AudioGraph.cpp
+//
+// Before the first block, the nodes are put in topological order (Kahn's algorithm: take
+// the nodes that nothing feeds, then any node whose feeders have all been taken, and so on)
+// and every output is given a block buffer. Buffers are shared: going down the order, an
+// output takes a free buffer, and a buffer is freed again once the last node that reads it
+// has run. A long chain then cycles through a few buffers that stay in cache, however many
+// nodes it has. After that, a block is just a call to each node with its precomputed
+// buffer pointers.
+// =================================================================================================
+
+#include "AudioGraph.h"
+#include <algorithm>
+#include <cassert>
+
+// Floats between the end of one buffer and the start of the next. With power-of-2 blocks,
+// buffers a multiple of 4 KB apart would make a node's loads from one look to the CPU as
+// if they depended on its stores to the other (4K aliasing), stalling every loop.
+static const int BUFFER_PADDING = 64 + 16;
+
+AudioGraph::AudioGraph (int blockSize):
+m_blockSize (blockSize), m_planned (false)
+{
+  assert (blockSize > 0);
+}
+
+int
+AudioGraph::indexOf (AudioNode & node)
+{
+  for (size_t i = 0; i < m_nodes.size (); i++)
+    if (m_nodes[i] == &node)
+      return (int) i;
+  return -1;
+}
+
+void
+AudioGraph::add (AudioNode & node)
+{
+  if (indexOf (node) < 0)
+    {
+      m_nodes.push_back (&node);
+      m_planned = false;
+    }
+}
+
+void
+AudioGraph::connect (AudioNode & from, int output, AudioNode & to, int input)
+{
+  assert (output >= 0 && output < from.numOutputs ());
+  assert (input >= 0 && input < to.numInputs ());
+
+  add (from);
+  add (to);
+  Connection c = { indexOf (from), output, indexOf (to), input };
+  for (size_t i = 0; i < m_connections.size (); i++)
+    assert (m_connections[i].to != c.to || m_connections[i].input != c.input);
+  m_connections.push_back (c);
+  m_planned = false;
+}
+
+void
+AudioGraph::connect (AudioNode & from, AudioNode & to)
+{
+  int numCh = std::min (from.numOutputs (), to.numInputs ());
+  for (int ch = 0; ch < numCh; ch++)
+    connect (from, ch, to, ch);
+}
+
+void
+AudioGraph::plan ()
+{
+  int numNodes = (int) m_nodes.size ();
+
+  // Topological order
+  vector < int >numFeeders (numNodes, 0);
+  for (size_t c = 0; c < m_connections.size (); c++)
+    numFeeders[m_connections[c].to]++;
+
+  vector < int >order;
+  for (int i = 0; i < numNodes; i++)
+    if (numFeeders[i] == 0)
+      order.push_back (i);
+  for (size_t k = 0; k < order.size (); k++)
+    for (size_t c = 0; c < m_connections.size (); c++)
+      if (m_connections[c].from == order[k] && --numFeeders[m_connections[c].to] == 0)
+	order.push_back (m_connections[c].to);
+  assert ((int) order.size () == numNodes);	// Otherwise the connections loop
+
+  // Number of inputs each output feeds
+  vector < vector < int >>numReaders (numNodes);
+  for (int i = 0; i < numNodes; i++)
+    numReaders[i].assign (m_nodes[i]->numOutputs (), 0);
+  for (size_t c = 0; c < m_connections.size (); c++)
+    numReaders[m_connections[c].from][m_connections[c].output]++;
+
+  // Walk the order, giving each output a buffer and freeing it after its last reader
+  vector < vector < int >>bufferOf (numNodes);
+  vector < int >freeBuffers;
+  int numBuffers = 0;
+  vector < int >stepOf (numNodes);
+
+  m_steps.clear ();
+  for (int k = 0; k < numNodes; k++)
+    {
+      int i = order[k];
+      AudioNode *node = m_nodes[i];
+      stepOf[i] = k;
+
+      // Outputs take buffers before the inputs' are freed, so they never share
+      bufferOf[i].resize (node->numOutputs ());
+      for (int o = 0; o < node->numOutputs (); o++)
+	{
+	  if (freeBuffers.empty ())
+	    freeBuffers.push_back (numBuffers++);
+	  bufferOf[i][o] = freeBuffers.back ();
+	  freeBuffers.pop_back ();
+	}
+
+      for (size_t c = 0; c < m_connections.size (); c++)
+	if (m_connections[c].to == i)
+	  {
+	    const Connection & conn = m_connections[c];
+	    if (--numReaders[conn.from][conn.output] == 0)
+	      freeBuffers.push_back (bufferOf[conn.from][conn.output]);
+	  }
+      for (int o = 0; o < node->numOutputs (); o++)
+	if (numReaders[i][o] == 0)
+	  freeBuffers.push_back (bufferOf[i][o]);
+
+      Step step;
+      step.node = node;
+      step.in.assign (node->numInputs (), nullptr);
+      m_steps.push_back (step);
+    }
+
+  // Now that the number of buffers is known, point the steps at them
+  m_bufferStride = m_blockSize + BUFFER_PADDING;
+  m_buffers.assign ((size_t) numBuffers * m_bufferStride, 0.0f);
+  m_silence.assign (m_blockSize, 0.0f);
+  for (int i = 0; i < numNodes; i++)
+    {
+      Step & step = m_steps[stepOf[i]];
+      step.out.resize (bufferOf[i].size ());
+      for (size_t o = 0; o < bufferOf[i].size (); o++)
+	step.out[o] = buffer (bufferOf[i][o]);
+    }
+  for (size_t c = 0; c < m_connections.size (); c++)
+    {
+      const Connection & conn = m_connections[c];
+      m_steps[stepOf[conn.to]].in[conn.input] =
+	buffer (bufferOf[conn.from][conn.output]);
+    }
+  for (size_t k = 0; k < m_steps.size (); k++)
+    for (size_t j = 0; j < m_steps[k].in.size (); j++)
+      if (m_steps[k].in[j] == nullptr)
+	m_steps[k].in[j] = m_silence.data ();
+
+  m_planned = true;
+}
+
+void
+AudioGraph::prepare ()
+{
+  if (!m_planned)
+    plan ();
+}
+
+void
+AudioGraph::process (int n)
+{
+  assert (n >= 0 && n <= m_blockSize);
+  prepare ();
+
+  for (size_t k = 0; k < m_steps.size (); k++)
+    {
+      Step & step = m_steps[k];
+      step.node->process (step.in.data (), step.out.data (), n);
+    }
+}
+
+int64_t
+AudioGraph::run ()
+{
+  int64_t total = 0;
+  while (true)
+    {
+      int64_t left = -1;
+      for (size_t i = 0; i < m_nodes.size (); i++)
+	left = std::max (left, m_nodes[i]->framesLeft ());
+      // With no source that knows when to stop, there's no end to run to
+      if (left <= 0)
+	return total;
+
+      int n = (int) std::min < int64_t > (m_blockSize, left);
+      process (n);
+      total += n;
+    }
+}
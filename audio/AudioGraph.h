@@ -0,0 +1,127 @@
+// =================================================================================================
+// AudioGraph.h
+//
+// A processing graph: audio flows a block at a time from source nodes (e.g. a file reader)
+// through processing nodes (filters, gains, mixers) to sink nodes (e.g. a file writer). A
+// chain of stages then runs as one streaming pass, with each stage's output held only for
+// one block, instead of each stage reading and writing whole files.
+//
+// =================================================================================================
+
+#ifndef __AudioGraph__
+#define __AudioGraph__
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+/// A stage of a graph, with a fixed number of input and output channels
+class AudioNode
+{
+public:
+
+	AudioNode(int numInputs, int numOutputs) : m_numInputs(numInputs), m_numOutputs(numOutputs) {}
+	virtual ~AudioNode() {}
+
+	int numInputs() const { return m_numInputs; }
+	int numOutputs() const { return m_numOutputs; }
+
+	/// Processes one block
+	///
+	///	@param	in		numInputs() channels of n samples. An unconnected input is silence.
+	///	@param	out		numOutputs() channels of n samples, to be filled. They are never the
+	///					same buffers as the inputs.
+	/// @param	n		Number of samples, up to the graph's block size
+	///
+	virtual void process(const float *const *in, float **out, int n) = 0;
+
+	/// For a source, the sample frames it still has to give, after which it gives silence.
+	/// -1 (the default) if the node doesn't know or isn't a source.
+	virtual int64_t framesLeft() const { return -1; }
+
+private:
+
+	int m_numInputs;
+	int m_numOutputs;
+};
+
+/// Runs a set of connected nodes. Each block, every node is processed once, after all the
+/// nodes that feed it. The graph doesn't own the nodes; they must outlive it.
+class AudioGraph
+{
+public:
+
+	/// @param	blockSize	Most samples per block
+	AudioGraph(int blockSize = 1024);
+
+	int blockSize() const { return m_blockSize; }
+
+	/// Adds a node; connect() also adds the nodes it's given
+	void add(AudioNode& node);
+
+	/// Feeds an output channel of one node to an input channel of another. An output can
+	/// feed any number of inputs, but an input can only be fed by one output; to sum
+	/// several, use a MixNode. The connections must not form a loop.
+	///
+	///	@param	from	Node whose output is used
+	///	@param	output	Output channel of from
+	///	@param	to		Node to feed
+	///	@param	input	Input channel of to
+	///
+	void connect(AudioNode& from, int output, AudioNode& to, int input);
+
+	/// Feeds each output channel of one node to the same input channel of another, for
+	/// as many channels as both have
+	void connect(AudioNode& from, AudioNode& to);
+
+	/// Works out the order the nodes run in and allocates their buffers, which process
+	/// otherwise does on its first call. Call it before running the graph on a realtime
+	/// thread, where allocating could cause a dropout.
+	void prepare();
+
+	/// Processes one block of n samples through every node
+	void process(int n);
+
+	/// Processes blocks until every source that knows its length has finished, i.e. for
+	/// as long as the longest source
+	///
+	/// @return		Number of sample frames processed; 0, having processed nothing, if no
+	///				node knows its length
+	///
+	int64_t run();
+
+private:
+
+	struct Connection
+	{
+		int from;
+		int output;
+		int to;
+		int input;
+	};
+
+	// A node as scheduled, with the buffers it reads and writes each block
+	struct Step
+	{
+		AudioNode *node;
+		vector<const float *> in;
+		vector<float *> out;
+	};
+
+	int m_blockSize;
+	vector<AudioNode *> m_nodes;
+	vector<Connection> m_connections;
+	bool m_planned;
+
+	vector<Step> m_steps;			// Nodes in the order they run
+	vector<float> m_buffers;		// One block per buffer, m_bufferStride apart
+	int m_bufferStride;
+	vector<float> m_silence;
+
+	int indexOf(AudioNode& node);
+	float *buffer(int b) { return m_buffers.data() + (size_t)b * m_bufferStride; }
+	void plan();
+};
+
+#endif
@@ -0,0 +1,104 @@
+// =================================================================================================
+// AudioNodes.cpp
+// =================================================================================================
+
+#include "AudioNodes.h"
+#include <algorithm>
+#include <cassert>
+
+FileSourceNode::FileSourceNode (WavReader & reader):
+AudioNode (0, reader.numChannels ()), m_reader (reader)
+{
+  assert (reader.isOpen ());
+}
+
+void
+FileSourceNode::process (const float *const *in, float **out, int n)
+{
+  int numRead = m_reader.read (out, n);
+  for (int ch = 0; ch < numOutputs (); ch++)
+    std::fill (out[ch] + numRead, out[ch] + n, 0.0f);
+}
+
+int64_t
+FileSourceNode::framesLeft () const
+{
+  return m_reader.numFrames () - m_reader.position ();
+}
+
+FileSinkNode::FileSinkNode (WavWriter & writer, int numCh):
+AudioNode (numCh, 0), m_writer (writer)
+{
+  assert (writer.isOpen ());
+}
+
+void
+FileSinkNode::process (const float *const *in, float **out, int n)
+{
+  m_writer.write (in, n);
+}
+
+FilterNode::FilterNode (double sr, int numCh):
+AudioNode (numCh, numCh), m_filters (numCh, Filter (sr))
+{
+}
+
+void
+FilterNode::process (const float *const *in, float **out, int n)
+{
+  for (int ch = 0; ch < numOutputs (); ch++)
+    m_filters[ch].process (in[ch], out[ch], n);
+}
+
+GainNode::GainNode (int numCh, float gain):
+AudioNode (numCh, numCh), m_gain (gain)
+{
+}
+
+void
+GainNode::process (const float *const *in, float **out, int n)
+{
+  // A local copy of the gain, as a store to out could otherwise change m_gain
+  float g = m_gain;
+  for (int ch = 0; ch < numOutputs (); ch++)
+    {
+      const float *x = in[ch];
+      float *y = out[ch];
+      for (int i = 0; i < n; i++)
+	y[i] = g * x[i];
+    }
+}
+
+BalanceNode::BalanceNode (float balance):
+AudioNode (2, 2), m_panner (PAN_BALANCE, balance)
+{
+}
+
+void
+BalanceNode::process (const float *const *in, float **out, int n)
+{
+  m_panner.processStereo (in, out, n);
+}
+
+MixNode::MixNode (int numSources, int numCh):
+AudioNode (numSources * numCh, numCh), m_numSources (numSources),
+m_numChannels (numCh), m_gains (numSources, 1.0f)
+{
+}
+
+void
+MixNode::process (const float *const *in, float **out, int n)
+{
+  for (int ch = 0; ch < m_numChannels; ch++)
+    {
+      float *y = out[ch];
+      std::fill (y, y + n, 0.0f);
+      for (int s = 0; s < m_numSources; s++)
+	{
+	  const float *x = in[s * m_numChannels + ch];
+	  float g = m_gains[s];
+	  for (int i = 0; i < n; i++)
+	    y[i] += g * x[i];
+	}
+    }
+}
@@ -0,0 +1,138 @@
+// =================================================================================================
+// AudioNodes.h
+//
+// Ready-made nodes for an AudioGraph: file sources and sinks, and the filter, gain,
+// balance and mix stages of the examples.
+//
+// =================================================================================================
+
+#ifndef __AudioNodes__
+#define __AudioNodes__
+
+#include "AudioGraph.h"
+#include "Biquad.h"
+#include "Panner.h"
+#include "WavUtils.h"
+#include <vector>
+
+using namespace std;
+
+/// Reads an audio file, one output per channel. Gives silence after the end of the file.
+class FileSourceNode : public AudioNode
+{
+public:
+
+	/// @param	reader	An open reader. It isn't owned.
+	FileSourceNode(WavReader& reader);
+
+	void process(const float *const *in, float **out, int n);
+	int64_t framesLeft() const;
+
+private:
+
+	WavReader& m_reader;
+};
+
+/// Writes its inputs to an audio file, one input per channel
+class FileSinkNode : public AudioNode
+{
+public:
+
+	/// @param	writer	A writer opened for numCh channels. It isn't owned, and the caller
+	///					closes it when the graph has run.
+	///	@param	numCh	Number of channels
+	///
+	FileSinkNode(WavWriter& writer, int numCh);
+
+	void process(const float *const *in, float **out, int n);
+
+private:
+
+	WavWriter& m_writer;
+};
+
+/// A biquad filter on each channel, with the same or different settings
+class FilterNode : public AudioNode
+{
+public:
+
+	/// Double precision keeps low cutoffs accurate (see main.cpp's applyFilter)
+	typedef BiquadT<double, BIQUAD_TDF2> Filter;
+
+	/// @param	sr		Sample rate (e.g. 44100)
+	///	@param	numCh	Number of channels, each with its own filter
+	///
+	FilterNode(double sr, int numCh = 1);
+
+	/// The filter for one channel, to set up with its init functions
+	Filter& filter(int ch) { return m_filters[ch]; }
+
+	void process(const float *const *in, float **out, int n);
+
+private:
+
+	vector<Filter> m_filters;
+};
+
+/// The same gain on every channel
+class GainNode : public AudioNode
+{
+public:
+
+	GainNode(int numCh = 1, float gain = 1);
+
+	void setGain(float gain) { m_gain = gain; }
+	float gain() const { return m_gain; }
+
+	void process(const float *const *in, float **out, int n);
+
+private:
+
+	float m_gain;
+};
+
+/// Stereo balance: turns one side down, leaving the other at full level
+class BalanceNode : public AudioNode
+{
+public:
+
+	/// @param	balance		-1 (full left) to +1 (full right)
+	BalanceNode(float balance = 0);
+
+	/// Changes the balance, gliding there over the ramp length so as not to click
+	void setBalance(float balance) { m_panner.setPan(balance); }
+	float balance() const { return m_panner.pan(); }
+
+	/// Samples a change of balance glides over. 0 (the default) jumps.
+	void setRampLength(int numSamples) { m_panner.setRampLength(numSamples); }
+
+	void process(const float *const *in, float **out, int n);
+
+private:
+
+	Panner m_panner;
+};
+
+/// Sums several sources with a gain each. Input s * numCh + ch is channel ch of source s.
+class MixNode : public AudioNode
+{
+public:
+
+	/// @param	numSources	Number of sources to sum
+	///	@param	numCh		Channels per source, and of the output
+	///
+	MixNode(int numSources, int numCh = 1);
+
+	void setGain(int source, float gain) { m_gains[source] = gain; }
+	float gain(int source) const { return m_gains[source]; }
+
+	void process(const float *const *in, float **out, int n);
+
+private:
+
+	int m_numSources;
+	int m_numChannels;
+	vector<float> m_gains;
+};
+
+#endif
@@ -33,6 +33,24 @@
 //
 // which can be interpreted as a two-pole filter followed by a two-zero filter.
 //
+// BiquadT also offers two other topologies with the same transfer function. Direct Form I
+// evaluates the difference equation as written:
+//
+//              y(n) = b0 x(n) + b1 x(n-1) + b2 x(n-2) - a1 y(n-1) - a2 y(n-2)
+//
+// It keeps four state variables, all at signal level, so it can't overflow internally.
+// Transposed Direct Form II runs the same graph backwards:
+//
+//              y(n)  = b0 x(n) + s1(n-1)
+//              s1(n) = b1 x(n) - a1 y(n) + s2(n-1)
+//              s2(n) = b2 x(n) - a2 y(n)
+//
+// At low cutoffs the poles are very close to z = 1, and rounding the coefficients to float
+// moves them enough to matter: a 20 Hz low-pass at 96 kHz is only about 40 dB away from
+// the exact filter, whatever the form. Double coefficients bring that down to around
+// -150 dB. Between the forms, DF2's v(n) grows far above signal level at low cutoffs while
+// TDF2's state stays near it, which helps when the coefficients change while running.
+//
 // The z-transform works out to be:
 //
 //              V(z)/X(z) = 1/(1 + a1 z^-1 + a2 ^ z-2)
@@ -85,81 +103,174 @@
 // =============================================================================================================
 
 #include "Biquad.h"
+#include <vector>
+#include <algorithm>
+
+// The designs are computed in double whatever T is, so float filters only round the
+// final coefficients, not every intermediate value.
+
+// Sine table for setFastTrig: one period, plus a guard entry so interpolation never
+// reads past the end. Linear interpolation between entries is good to about 3e-7.
+static const int TRIG_TABLE_SIZE = 4096;
+
+static const std::vector < double >&
+sineTable ()
+{
+  static const std::vector < double >table = [] ()
+  {
+    std::vector < double >t (TRIG_TABLE_SIZE + 1);
+    for (int i = 0; i <= TRIG_TABLE_SIZE; i++)
+      t[i] = sin (2 * M_PI * i / TRIG_TABLE_SIZE);
+    return t;
+  } ();
+  return table;
+}
+
+// Interpolated table lookup of sin(2 pi phase), for phase in [0, 1)
+static double
+tableSin (double phase)
+{
+  const std::vector < double >&table = sineTable ();
+  double pos = phase * TRIG_TABLE_SIZE;
+  int i = (int) pos;
+  double frac = pos - i;
+  return table[i] + frac * (table[i + 1] - table[i]);
+}
+
+template < typename T, BiquadForm FORM >
+void
+BiquadT < T, FORM >::sinCos (double w0, double &sinW0, double &cosW0) const
+{
+  if (!m_fastTrig)
+    {
+      sinW0 = sin (w0);
+      cosW0 = cos (w0);
+      return;
+    }
+
+  // Designs only use 0 <= w0 <= pi, so the phases stay within [0, 0.75]
+  double phase = std::min (std::max (w0 / (2 * M_PI), 0.0), 0.5);
+  sinW0 = tableSin (phase);
+  cosW0 = tableSin (phase + 0.25);
+}
 
 // Low-pass filter
+template < typename T, BiquadForm FORM >
 void
-Biquad::initLPF (float f0, float q)
+BiquadT < T, FORM >::initLPF (double f0, double q)
 {
-  float w0 = 2 * M_PI * f0 / m_sr;
-  float alpha = sin (w0) / (2 * q);
-  float a0;
-
-  m_b0 = (1 - cos (w0)) / 2;
-  m_b1 = 1 - cos (w0);
-  m_b2 = (1 - cos (w0)) / 2;
-  a0 = 1 + alpha;
-  m_a1 = -2 * cos (w0);
-  m_a2 = 1 - alpha;
-  normalize (a0);
+  double w0 = 2 * M_PI * f0 / m_sr;
+  double sinW0, cosW0;
+  sinCos (w0, sinW0, cosW0);
+  double alpha = sinW0 / (2 * q);
+
+  double b0 = (1 - cosW0) / 2;
+  double b1 = 1 - cosW0;
+  double b2 = (1 - cosW0) / 2;
+  double a0 = 1 + alpha;
+  double a1 = -2 * cosW0;
+  double a2 = 1 - alpha;
+  setNormalized (b0, b1, b2, a0, a1, a2);
 }
 
 
 // High-pass filter
+template < typename T, BiquadForm FORM >
 void
-Biquad::initHPF (float f0, float q)
+BiquadT < T, FORM >::initHPF (double f0, double q)
 {
-  float w0 = 2 * M_PI * f0 / m_sr;
-  float alpha = sin (w0) / (2 * q);
-  float a0;
-
-  m_b0 = (1 + cos (w0)) / 2;
-  m_b1 = -(1 + cos (w0));
-  m_b2 = (1 + cos (w0)) / 2;
-  a0 = 1 + alpha;
-  m_a1 = -2 * cos (w0);
-  m_a2 = 1 - alpha;
-  normalize (a0);
+  double w0 = 2 * M_PI * f0 / m_sr;
+  double sinW0, cosW0;
+  sinCos (w0, sinW0, cosW0);
+  double alpha = sinW0 / (2 * q);
+
+  double b0 = (1 + cosW0) / 2;
+  double b1 = -(1 + cosW0);
+  double b2 = (1 + cosW0) / 2;
+  double a0 = 1 + alpha;
+  double a1 = -2 * cosW0;
+  double a2 = 1 - alpha;
+  setNormalized (b0, b1, b2, a0, a1, a2);
 }
 
 
 // Band-pass filter. g is gain at peak. For unity gain in
 // 'skirt', make g = q.
+template < typename T, BiquadForm FORM >
 void
-Biquad::initBPF (float f0, float g, float q)
+BiquadT < T, FORM >::initBPF (double f0, double g, double q)
 {
-  float w0 = 2 * M_PI * f0 / m_sr;
-  float alpha = sin (w0) / (2 * q);
-  float a0;
-
-  m_b0 = g * alpha;
-  m_b1 = 0;
-  m_b2 = -g * alpha;
-  a0 = 1 + alpha;
-  m_a1 = -2 * cos (w0);
-  m_a2 = 1 - alpha;
-  normalize (a0);
+  double w0 = 2 * M_PI * f0 / m_sr;
+  double sinW0, cosW0;
+  sinCos (w0, sinW0, cosW0);
+  double alpha = sinW0 / (2 * q);
+
+  double b0 = g * alpha;
+  double b1 = 0;
+  double b2 = -g * alpha;
+  double a0 = 1 + alpha;
+  double a1 = -2 * cosW0;
+  double a2 = 1 - alpha;
+  setNormalized (b0, b1, b2, a0, a1, a2);
 }
 
 
 // Notch filter.
+template < typename T, BiquadForm FORM >
+void
+BiquadT < T, FORM >::initNotch (double f0, double q)
+{
+  double w0 = 2 * M_PI * f0 / m_sr;
+  double sinW0, cosW0;
+  sinCos (w0, sinW0, cosW0);
+  double alpha = sinW0 / (2 * q);
+
+  double b0 = 1;
+  double b1 = -2 * cosW0;
+  double b2 = 1;
+  double a0 = 1 + alpha;
+  double a1 = -2 * cosW0;
+  double a2 = 1 - alpha;
+
+  setNormalized (b0, b1, b2, a0, a1, a2);
+}
+
+
+// First-order low-pass filter. This is the bilinear transform of 1 / (s + 1)
+// with the same prewarping as the filters above.
+template < typename T, BiquadForm FORM >
 void
-Biquad::initNotch (float f0, float q)
+BiquadT < T, FORM >::initLPF1 (double f0)
 {
-  float w0 = 2 * M_PI * f0 / m_sr;
-  float alpha = sin (w0) / (2 * q);
-  float a0;
-
-  m_b0 = 1;
-  m_b1 = -2 * cos (w0);
-  m_b2 = 1;
-  a0 = 1 + alpha;
-  m_a1 = -2 * cos (w0);
-  m_a2 = 1 - alpha;
-
-  normalize (a0);
+  double sinW0, cosW0;
+  sinCos (2 * M_PI * f0 / m_sr, sinW0, cosW0);
+  double k = sinW0 / (1 + cosW0);	// tan (w0 / 2)
+
+  setNormalized (k, k, 0, k + 1, k - 1, 0);
 }
 
 
+// First-order high-pass filter, the bilinear transform of s / (s + 1)
+template < typename T, BiquadForm FORM >
+void
+BiquadT < T, FORM >::initHPF1 (double f0)
+{
+  double sinW0, cosW0;
+  sinCos (2 * M_PI * f0 / m_sr, sinW0, cosW0);
+  double k = sinW0 / (1 + cosW0);	// tan (w0 / 2)
+
+  setNormalized (1, -1, 0, k + 1, k - 1, 0);
+}
+
+
+template class BiquadT < float, BIQUAD_DF1 >;
+template class BiquadT < float, BIQUAD_DF2 >;
+template class BiquadT < float, BIQUAD_TDF2 >;
+template class BiquadT < double, BIQUAD_DF1 >;
+template class BiquadT < double, BIQUAD_DF2 >;
+template class BiquadT < double, BIQUAD_TDF2 >;
+
+
 
 /*
         Cookbook formulae for audio EQ biquad filter coefficients
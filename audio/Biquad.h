@@ -30,74 +30,210 @@
 #ifndef __Biquad__
 #define __Biquad__
 
+#include "DenormalGuard.h"
 #include <cmath>
 
-class Biquad
+// Filter topologies. They have the same transfer function but differ in how rounding
+// errors build up. See Biquad.cpp.
+enum BiquadForm
+{
+	BIQUAD_DF1,		// Direct Form I: 4 state variables, no internal overflow
+	BIQUAD_DF2,		// Direct Form II: 2 state variables, the cheapest
+	BIQUAD_TDF2		// Transposed Direct Form II: 2 state variables, state at signal level
+};
+
+// T is the type of the coefficients and state (float or double). Audio of any floating-point
+// type can be processed; e.g. BiquadT<double, BIQUAD_TDF2> filters float audio with double
+// precision inside.
+template <typename T, BiquadForm FORM = BIQUAD_DF2>
+class BiquadT
 {
 public:
 
-	Biquad(float sr) { m_sr = sr; clear(); }
-	~Biquad() {}
+	BiquadT(double sr) : m_sr(sr), m_rampLength(0), m_rampRemaining(0), m_fastTrig(false)
+	{
+		setNormalized(1, 0, 0, 1, 0, 0);
+		m_designed = false;
+		clear();
+	}
+	~BiquadT() {}
+
+	// Makes the init functions glide to the new coefficients over numSamples samples,
+	// interpolating linearly, instead of jumping to them. Call init every block while
+	// sweeping a parameter, with numSamples = block size, and the sweep is free of zipper
+	// noise. A filter interpolated between two stable filters is always stable too.
+	// The first init after construction still jumps. 0 (the default) switches smoothing off.
+	void setSmoothing(int numSamples) { m_rampLength = numSamples; }
+
+	// Makes the init functions use a lookup table instead of sin/cos/tan, for cheap
+	// updates at control rate. The coefficients come out within about 1e-6 of the exact
+	// design, a little further for first-order filters close to Nyquist.
+	void setFastTrig(bool fast) { m_fastTrig = fast; }
 
 	// Low-pass filter
-	void initLPF(float f0, float q = M_SQRT1_2);
+	void initLPF(double f0, double q = M_SQRT1_2);
 	
 	// High-pass filter
-	void initHPF(float f0, float q = M_SQRT1_2);
+	void initHPF(double f0, double q = M_SQRT1_2);
 	
 	// Band-pass filter. g is gain at peak.
-	void initBPF(float f0, float g = 1, float q = M_SQRT1_2);
+	void initBPF(double f0, double g = 1, double q = M_SQRT1_2);
 	
 	// Notch filter.
-	void initNotch(float f0, float q = M_SQRT1_2);
+	void initNotch(double f0, double q = M_SQRT1_2);
+
+	// First-order low-pass and high-pass filters (b2 = a2 = 0), for odd-order designs
+	void initLPF1(double f0);
+	void initHPF1(double f0);
+
+	// Normalized coefficients, e.g. to load them into a BiquadCascade. While gliding, the
+	// coefficients reached so far.
+	void getCoefficients(T &b0, T &b1, T &b2, T &a1, T &a2) const
+	{
+		b0 = m_b0;
+		b1 = m_b1;
+		b2 = m_b2;
+		a1 = m_a1;
+		a2 = m_a2;
+	}
 
 	void clear()
 	{
-		m_v1 = 0.0;
-		m_v2 = 0.0;
+		m_z1 = 0.0;
+		m_z2 = 0.0;
+		m_z3 = 0.0;
+		m_z4 = 0.0;
 	}
 	
-	void process(const float *x, float *y, int n)
+	// Filters a block, with denormals flushed to zero so that a silent tail stays cheap
+	// (see DenormalGuard.h)
+	template <typename S>
+	void process(const S *x, S *y, int n)
 	{
-		for (int i = 0; i < n; i++)
-			*y++ = tick(*x++);
+		DenormalGuard guard;
+
+		// Run a copy, so its state can stay in registers even though y might alias ours
+		BiquadT f = *this;
+		int i = 0;
+		for (; i < n && f.m_rampRemaining > 0; i++)
+			*y++ = (S)f.tick((T)*x++);
+		for (; i < n; i++)
+			*y++ = (S)f.tickFixed((T)*x++);
+		*this = f;
 	}
 	
-	inline float tick(float x)
+	// One sample. Unlike process, it leaves denormals to the caller, who should hold a
+	// DenormalGuard around a loop of ticks.
+	inline T tick(T x)
 	{
-		// Direct form 1:
-		//float y = b0*x + b1*xd1 + b2*xd2 - a0*yd1 - a2*yd2;
-		//yd2 = yd1;	yd1 = y;
-		//xd2 = xd1;	xd1 = x;
-	
-		// Direct form 2:
-		float v =      x - m_a1*m_v1 - m_a2*m_v2;
-		float y = m_b0*v + m_b1*m_v1 + m_b2*m_v2;
-		m_v2 = m_v1;
-		m_v1 = v;
-		return y;
+		if (m_rampRemaining > 0)
+			stepRamp();
+		return tickFixed(x);
 	}
 	
 private:
 
-	float m_sr;		// Sample rate
-	float m_b0;		// Coefficients of numerator; these determine the zero positions.
-	float m_b1;
-	float m_b2;
-	float m_a1;		// Coefficients of denominator; these determine the pole positions.
-	float m_a2;
-	float m_v1;		// v delayed by 1 sample
-	float m_v2;		// v delayed by 2 samples
+	double m_sr;	// Sample rate
+	T m_b0;			// Coefficients of numerator; these determine the zero positions.
+	T m_b1;
+	T m_b2;
+	T m_a1;			// Coefficients of denominator; these determine the pole positions.
+	T m_a2;
+	T m_z1;			// State; what it holds depends on the form, see tick()
+	T m_z2;
+	T m_z3;
+	T m_z4;
+	int m_rampLength;		// Samples to glide to new coefficients over; 0 to jump
+	int m_rampRemaining;	// Samples left in the current glide
+	T m_target[5];			// Coefficients being glided to: b0, b1, b2, a1, a2
+	T m_step[5];			// Change per sample while gliding
+	bool m_fastTrig;
+	bool m_designed;		// False until the first init, which never glides
+
+	// One sample with the current coefficients
+	inline T tickFixed(T x)
+	{
+		if (FORM == BIQUAD_DF1)
+		{
+			// Direct form 1: z1, z2 are x delayed; z3, z4 are y delayed
+			T y = m_b0*x + m_b1*m_z1 + m_b2*m_z2 - m_a1*m_z3 - m_a2*m_z4;
+			m_z2 = m_z1;	m_z1 = x;
+			m_z4 = m_z3;	m_z3 = y;
+			return y;
+		}
+		else if (FORM == BIQUAD_DF2)
+		{
+			// Direct form 2: z1, z2 are v delayed by 1 and 2 samples
+			T v =      x - m_a1*m_z1 - m_a2*m_z2;
+			T y = m_b0*v + m_b1*m_z1 + m_b2*m_z2;
+			m_z2 = m_z1;
+			m_z1 = v;
+			return y;
+		}
+		else
+		{
+			// Transposed direct form 2: z1, z2 are the partial sums for the next two outputs
+			T y = m_b0*x + m_z1;
+			m_z1 = m_b1*x - m_a1*y + m_z2;
+			m_z2 = m_b2*x - m_a2*y;
+			return y;
+		}
+	}
+
+	// Moves the coefficients one sample further along the glide, landing exactly on the target
+	inline void stepRamp()
+	{
+		if (--m_rampRemaining == 0)
+		{
+			m_b0 = m_target[0];
+			m_b1 = m_target[1];
+			m_b2 = m_target[2];
+			m_a1 = m_target[3];
+			m_a2 = m_target[4];
+		}
+		else
+		{
+			m_b0 += m_step[0];
+			m_b1 += m_step[1];
+			m_b2 += m_step[2];
+			m_a1 += m_step[3];
+			m_a2 += m_step[4];
+		}
+	}
 	
-	void normalize(float a0)
+	// Sets the coefficients from a design with a0 not yet normalized to 1, or starts a glide
+	// to them. The division is done in double, so T only rounds the final values.
+	void setNormalized(double b0, double b1, double b2, double a0, double a1, double a2)
 	{
-		m_b0 /= a0;
-		m_b1 /= a0;
-		m_b2 /= a0;
-		m_a1 /= a0;
-		m_a2 /= a0;
+		if (m_rampLength <= 0 || !m_designed)
+		{
+			m_designed = true;
+			m_b0 = b0 / a0;
+			m_b1 = b1 / a0;
+			m_b2 = b2 / a0;
+			m_a1 = a1 / a0;
+			m_a2 = a2 / a0;
+			m_rampRemaining = 0;
+			return;
+		}
+
+		m_target[0] = b0 / a0;
+		m_target[1] = b1 / a0;
+		m_target[2] = b2 / a0;
+		m_target[3] = a1 / a0;
+		m_target[4] = a2 / a0;
+		m_step[0] = (m_target[0] - m_b0) / m_rampLength;
+		m_step[1] = (m_target[1] - m_b1) / m_rampLength;
+		m_step[2] = (m_target[2] - m_b2) / m_rampLength;
+		m_step[3] = (m_target[3] - m_a1) / m_rampLength;
+		m_step[4] = (m_target[4] - m_a2) / m_rampLength;
+		m_rampRemaining = m_rampLength;
 	}
+
+	void sinCos(double w0, double &sinW0, double &cosW0) const;
 };
 
-#endif /* defined(__Biquad__) */
+// The original single-precision Direct Form II filter, used by most of the code
+typedef BiquadT<float, BIQUAD_DF2> Biquad;
 
+#endif /* defined(__Biquad__) */
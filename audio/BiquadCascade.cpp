@@ -0,0 +1,179 @@
+// =================================================================================================
+// BiquadCascade.cpp
+//
+// Each section is the same Direct Form II biquad as Biquad::tick, with the same operation
+// order, so a cascade gives exactly the same output as the equivalent chain of Biquads.
+//
+// The Butterworth designs factor the analog prototype into second-order sections, one per
+// conjugate pole pair, plus a first-order section for odd orders. The poles lie evenly
+// spaced on the left half of the unit circle; pole pair k has
+//
+//              Q(k) = 1 / (2 sin((2k + 1) pi / (2 order)))
+//
+// and each section is digitized with the RBJ low-pass/high-pass formulae at f0, which
+// prewarp to f0 just as the bilinear transform of the whole prototype would.
+// =================================================================================================
+
+#include "BiquadCascade.h"
+#include "DenormalGuard.h"
+#include <cassert>
+#include <algorithm>
+
+// Samples per sub-block. Small enough that the block stays in L1 cache while every
+// section runs over it, large enough to amortize loading each section's coefficients.
+static const int SUB_BLOCK = 64;
+
+BiquadCascade::BiquadCascade (float sr, int numSections):
+m_sr (sr), m_numSections (0)
+{
+  setNumSections (numSections);
+}
+
+void
+BiquadCascade::setNumSections (int numSections)
+{
+  assert (numSections >= 0);
+  m_numSections = numSections;
+
+  // Pass-through: y = x
+  m_b0.assign (numSections, 1);
+  m_b1.assign (numSections, 0);
+  m_b2.assign (numSections, 0);
+  m_a1.assign (numSections, 0);
+  m_a2.assign (numSections, 0);
+  m_v1.assign (numSections, 0);
+  m_v2.assign (numSections, 0);
+}
+
+void
+BiquadCascade::setSection (int i, const Biquad & section)
+{
+  float b0, b1, b2, a1, a2;
+  section.getCoefficients (b0, b1, b2, a1, a2);
+  setSection (i, b0, b1, b2, a1, a2);
+}
+
+void
+BiquadCascade::setSection (int i, float b0, float b1, float b2, float a1,
+			   float a2)
+{
+  assert (i >= 0 && i < m_numSections);
+  m_b0[i] = b0;
+  m_b1[i] = b1;
+  m_b2[i] = b2;
+  m_a1[i] = a1;
+  m_a2[i] = a2;
+}
+
+void
+BiquadCascade::initButterworthLPF (int order, float f0)
+{
+  initButterworth (order, f0, false, 1);
+}
+
+void
+BiquadCascade::initButterworthHPF (int order, float f0)
+{
+  initButterworth (order, f0, true, 1);
+}
+
+void
+BiquadCascade::initLinkwitzRileyLPF (int order, float f0)
+{
+  assert (order % 2 == 0);
+  initButterworth (order / 2, f0, false, 2);
+}
+
+void
+BiquadCascade::initLinkwitzRileyHPF (int order, float f0)
+{
+  assert (order % 2 == 0);
+  initButterworth (order / 2, f0, true, 2);
+}
+
+// Butterworth of the given order, with each section repeated 'copies' times
+void
+BiquadCascade::initButterworth (int order, float f0, bool highPass,
+				int copies)
+{
+  assert (order >= 1);
+  int numPairs = order / 2;
+  bool odd = order % 2 != 0;
+
+  // A squared first-order section is a single biquad with Q = 0.5
+  setNumSections (numPairs * copies + (odd ? 1 : 0));
+
+  Biquad section (m_sr);
+  int s = 0;
+
+  // The real pole goes first, then the pole pairs in order of increasing Q, so the
+  // resonant sections see audio that has already been partly filtered
+  if (odd)
+    {
+      if (copies == 1)
+	highPass ? section.initHPF1 (f0) : section.initLPF1 (f0);
+      else
+	highPass ? section.initHPF (f0, 0.5) : section.initLPF (f0, 0.5);
+      setSection (s++, section);
+    }
+
+  for (int k = numPairs - 1; k >= 0; k--)
+    {
+      float q = 1 / (2 * sin ((2 * k + 1) * M_PI / (2 * order)));
+      highPass ? section.initHPF (f0, q) : section.initLPF (f0, q);
+      for (int c = 0; c < copies; c++)
+	setSection (s++, section);
+    }
+}
+
+void
+BiquadCascade::clear ()
+{
+  m_v1.assign (m_numSections, 0);
+  m_v2.assign (m_numSections, 0);
+}
+
+void
+BiquadCascade::process (const float *x, float *y, int n)
+{
+  DenormalGuard guard;
+  float buf[SUB_BLOCK];
+
+  for (int start = 0; start < n; start += SUB_BLOCK)
+    {
+      int len = std::min (SUB_BLOCK, n - start);
+      for (int i = 0; i < len; i++)
+	buf[i] = x[start + i];
+
+      // Run the sections over the sub-block two at a time, the second one sample behind
+      // the first. The two recurrences are independent, so they overlap in the pipeline.
+      int s = 0;
+      for (; s + 1 < m_numSections; s += 2)
+	{
+	  Section first (*this, s);
+	  Section second (*this, s + 1);
+
+	  buf[0] = first.tick (buf[0]);
+	  for (int i = 1; i < len; i++)
+	    {
+	      buf[i] = first.tick (buf[i]);
+	      buf[i - 1] = second.tick (buf[i - 1]);
+	    }
+	  buf[len - 1] = second.tick (buf[len - 1]);
+
+	  first.save (*this, s);
+	  second.save (*this, s + 1);
+	}
+
+      if (s < m_numSections)
+	{
+	  Section last (*this, s);
+	  for (int i = 0; i < len; i++)
+	    buf[i] = last.tick (buf[i]);
+	  last.save (*this, s);
+	}
+
+      for (int i = 0; i < len; i++)
+	y[start + i] = buf[i];
+    }
+}
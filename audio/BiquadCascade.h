@@ -0,0 +1,109 @@
+// =================================================================================================
+// BiquadCascade.h
+//
+// A chain of biquad sections (second-order sections) run as one filter. The coefficients
+// and state of all the sections are kept in parallel arrays, and the audio is processed a
+// short sub-block at a time: every section runs over the sub-block before the next one is
+// started, so the samples stay in L1 cache however many sections there are.
+//
+// =================================================================================================
+
+#ifndef __BiquadCascade__
+#define __BiquadCascade__
+
+#include "Biquad.h"
+#include <vector>
+
+using namespace std;
+
+class BiquadCascade
+{
+public:
+
+	/// @param	sr			Sample rate (e.g. 44100)
+	/// @param	numSections	Number of sections. Each starts out passing audio unchanged.
+	///
+	BiquadCascade(float sr, int numSections = 0);
+
+	/// Changes the number of sections, resetting them all to pass audio unchanged
+	void setNumSections(int numSections);
+	int numSections() const { return m_numSections; }
+
+	/// Sets the coefficients of one section. The section's state is kept.
+	///
+	///	@param	i		Section index, 0 to numSections() - 1. Sections run in index order.
+	///	@param	section	Biquad whose coefficients to copy
+	///
+	void setSection(int i, const Biquad& section);
+	void setSection(int i, float b0, float b1, float b2, float a1, float a2);
+
+	/// Butterworth low-pass or high-pass of any order. The response is -3 dB at f0 and
+	/// maximally flat in the passband. Uses (order + 1) / 2 sections.
+	///
+	///	@param	order	Filter order; the rolloff is 6 dB/octave per order
+	///	@param	f0		Cutoff frequency in Hz
+	///
+	void initButterworthLPF(int order, float f0);
+	void initButterworthHPF(int order, float f0);
+
+	/// Linkwitz-Riley low-pass or high-pass: two Butterworth filters of half the order in
+	/// series, -6 dB at f0. The low-pass and high-pass of the same order and f0 sum to a
+	/// flat magnitude response, for crossovers. For orders 2, 6, 10... invert one of the
+	/// two outputs before summing. Uses order / 2 sections.
+	///
+	///	@param	order	Filter order; must be even
+	///	@param	f0		Crossover frequency in Hz
+	///
+	void initLinkwitzRileyLPF(int order, float f0);
+	void initLinkwitzRileyHPF(int order, float f0);
+
+	/// Resets the state of all sections
+	void clear();
+
+	/// Filters a block of audio through all the sections. x and y may be the same buffer.
+	/// Denormals are flushed to zero while it runs (see DenormalGuard.h).
+	void process(const float *x, float *y, int n);
+
+private:
+
+	float m_sr;				// Sample rate
+	int m_numSections;
+	vector<float> m_b0;		// One entry per section for each coefficient and state variable
+	vector<float> m_b1;
+	vector<float> m_b2;
+	vector<float> m_a1;
+	vector<float> m_a2;
+	vector<float> m_v1;
+	vector<float> m_v2;
+
+	void initButterworth(int order, float f0, bool highPass, int copies);
+
+	/// One section's coefficients and state, copied out of the arrays so that they can
+	/// live in registers while a sub-block is processed
+	struct Section
+	{
+		float b0, b1, b2, a1, a2, v1, v2;
+
+		Section(const BiquadCascade& c, int i) :
+			b0(c.m_b0[i]), b1(c.m_b1[i]), b2(c.m_b2[i]), a1(c.m_a1[i]), a2(c.m_a2[i]),
+			v1(c.m_v1[i]), v2(c.m_v2[i]) {}
+
+		void save(BiquadCascade& c, int i) const
+		{
+			c.m_v1[i] = v1;
+			c.m_v2[i] = v2;
+		}
+
+		// Same arithmetic as Biquad::tick
+		inline float tick(float x)
+		{
+			float v =    x - a1*v1 - a2*v2;
+			float y = b0*v + b1*v1 + b2*v2;
+			v2 = v1;
+			v1 = v;
+			return y;
+		}
+	};
+};
+
+#endif
@@ -0,0 +1,248 @@
+// =================================================================================================
+// Convolver.cpp
+//
+// Each segment is a uniformly partitioned overlap-save convolution with block size B. Every
+// B input samples, the last 2B are transformed and the spectrum goes into a ring of the last
+// P input spectra. The output spectrum is the sum over p of input spectrum p blocks ago
+// times partition p of the impulse response; its inverse transform, less the first B
+// samples (which have wrapped around), is the next B samples of output.
+//
+// The head segment covers the first 2T samples of the response in blocks of B, and the
+// tail segment the rest in blocks of T. When input block j of the tail (input samples jT to
+// jT + T) is complete, the worker starts on it. Its output is the response from 2T on, so
+// it starts at output sample jT + 2T, which the caller reaches one whole tail block later.
+// That is when the job is collected, just before the next one is handed over. Only if the
+// worker falls behind does process() wait for it.
+// =================================================================================================
+
+#include "Convolver.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+
+// acc += x * h, for n complex values
+static void
+multiplyAdd (float *accRe, float *accIm, const float *xRe, const float *xIm,
+	     const float *hRe, const float *hIm, int n)
+{
+  for (int k = 0; k < n; k++)
+    {
+      accRe[k] += xRe[k] * hRe[k] - xIm[k] * hIm[k];
+      accIm[k] += xRe[k] * hIm[k] + xIm[k] * hRe[k];
+    }
+}
+
+Convolver::Segment::Segment (const float *ir, int irLen, int blockSize):
+m_blockSize (blockSize), m_numBins (blockSize + 1),
+m_numParts ((irLen + blockSize - 1) / blockSize), m_fft (2 * blockSize)
+{
+  int B = blockSize;
+  m_irRe.resize (m_numParts * m_numBins);
+  m_irIm.resize (m_numParts * m_numBins);
+  m_historyRe.resize (m_numParts * m_numBins);
+  m_historyIm.resize (m_numParts * m_numBins);
+  m_input.resize (2 * B);
+  m_accRe.resize (m_numBins);
+  m_accIm.resize (m_numBins);
+  m_output.resize (2 * B);
+
+  // Each partition is zero-padded to 2B, so the product holds its full linear convolution
+  // with the input block
+  vector < float >padded (2 * B);
+  for (int p = 0; p < m_numParts; p++)
+    {
+      int len = std::min (B, irLen - p * B);
+      std::fill (padded.begin (), padded.end (), 0.0f);
+      std::copy (ir + p * B, ir + p * B + len, padded.begin ());
+      m_fft.forward (padded.data (), m_irRe.data () + p * m_numBins,
+		     m_irIm.data () + p * m_numBins);
+    }
+
+  reset ();
+}
+
+void
+Convolver::Segment::reset ()
+{
+  std::fill (m_historyRe.begin (), m_historyRe.end (), 0.0f);
+  std::fill (m_historyIm.begin (), m_historyIm.end (), 0.0f);
+  std::fill (m_input.begin (), m_input.end (), 0.0f);
+  m_newest = 0;
+}
+
+void
+Convolver::Segment::process (const float *x, float *y)
+{
+  const int B = m_blockSize;
+  const int K = m_numBins;
+
+  memmove (m_input.data (), m_input.data () + B, B * sizeof (float));
+  memcpy (m_input.data () + B, x, B * sizeof (float));
+
+  m_newest = m_newest == 0 ? m_numParts - 1 : m_newest - 1;
+  m_fft.forward (m_input.data (), m_historyRe.data () + m_newest * K,
+		 m_historyIm.data () + m_newest * K);
+
+  // Partition p pairs with the input from p blocks ago, which is p places on in the ring
+  std::fill (m_accRe.begin (), m_accRe.end (), 0.0f);
+  std::fill (m_accIm.begin (), m_accIm.end (), 0.0f);
+  for (int p = 0; p < m_numParts; p++)
+    {
+      int h = (m_newest + p) % m_numParts;
+      multiplyAdd (m_accRe.data (), m_accIm.data (), m_historyRe.data () + h * K,
+		   m_historyIm.data () + h * K, m_irRe.data () + p * K,
+		   m_irIm.data () + p * K, K);
+    }
+
+  m_fft.inverse (m_accRe.data (), m_accIm.data (), m_output.data ());
+  memcpy (y, m_output.data () + B, B * sizeof (float));
+}
+
+Convolver::Convolver (const float *ir, int irLen, int blockSize, int tailBlockSize):
+m_blockSize (blockSize), m_tailBlockSize (tailBlockSize), m_count (0),
+m_tailPos (0), m_jobPending (false), m_quit (false)
+{
+  assert (irLen > 0);
+  assert (FFT::isValidSize (blockSize) && FFT::isValidSize (tailBlockSize));
+  assert (tailBlockSize % blockSize == 0);
+
+  int T = tailBlockSize;
+  int headLen = irLen;
+  if (T > blockSize && irLen > 2 * T)
+    headLen = 2 * T;
+
+  m_head.reset (new Segment (ir, headLen, blockSize));
+  m_in.resize (blockSize);
+  m_ready.resize (blockSize);
+
+  if (headLen < irLen)
+    {
+      m_tail.reset (new Segment (ir + headLen, irLen - headLen, T));
+      m_tailIn.resize (T);
+      m_tailOut.resize (T);
+      m_jobIn.resize (T);
+      m_jobOut.resize (T);
+      m_worker = thread (&Convolver::workerLoop, this);
+    }
+}
+
+Convolver::~Convolver ()
+{
+  if (m_worker.joinable ())
+    {
+      {
+	lock_guard < mutex > lock (m_mutex);
+	m_quit = true;
+      }
+      m_changed.notify_all ();
+      m_worker.join ();
+    }
+}
+
+void
+Convolver::reset ()
+{
+  if (m_tail)
+    {
+      unique_lock < mutex > lock (m_mutex);
+      waitForTail (lock);
+      m_tail->reset ();
+      std::fill (m_tailIn.begin (), m_tailIn.end (), 0.0f);
+      std::fill (m_tailOut.begin (), m_tailOut.end (), 0.0f);
+      std::fill (m_jobOut.begin (), m_jobOut.end (), 0.0f);
+      m_tailPos = 0;
+    }
+
+  m_head->reset ();
+  std::fill (m_ready.begin (), m_ready.end (), 0.0f);
+  m_count = 0;
+}
+
+void
+Convolver::process (const float *x, float *y, int n)
+{
+  int done = 0;
+  while (done < n)
+    {
+      // Take input into the block, and give out the finished output in its place
+      int k = std::min (n - done, m_blockSize - m_count);
+      memcpy (m_in.data () + m_count, x + done, k * sizeof (float));
+      memcpy (y + done, m_ready.data () + m_count, k * sizeof (float));
+      m_count += k;
+      done += k;
+
+      if (m_count == m_blockSize)
+	{
+	  runBlock ();
+	  m_count = 0;
+	}
+    }
+}
+
+// Convolves the block in m_in into m_ready
+void
+Convolver::runBlock ()
+{
+  const int B = m_blockSize;
+  m_head->process (m_in.data (), m_ready.data ());
+  if (!m_tail)
+    return;
+
+  const float *tail = m_tailOut.data () + m_tailPos;
+  for (int i = 0; i < B; i++)
+    m_ready[i] += tail[i];
+
+  memcpy (m_tailIn.data () + m_tailPos, m_in.data (), B * sizeof (float));
+  m_tailPos += B;
+  if (m_tailPos == m_tailBlockSize)
+    {
+      startTail ();
+      m_tailPos = 0;
+    }
+}
+
+// Collects the worker's last job and hands it the large block just completed
+void
+Convolver::startTail ()
+{
+  {
+    unique_lock < mutex > lock (m_mutex);
+    waitForTail (lock);
+    m_tailOut.swap (m_jobOut);
+    m_tailIn.swap (m_jobIn);
+    m_jobPending = true;
+  }
+  m_changed.notify_all ();
+}
+
+void
+Convolver::waitForTail (unique_lock < mutex > &lock)
+{
+  m_changed.wait (lock, [this] ()
+    {
+      return !m_jobPending;
+    });
+}
+
+void
+Convolver::workerLoop ()
+{
+  unique_lock < mutex > lock (m_mutex);
+  while (true)
+    {
+      m_changed.wait (lock, [this] ()
+	{
+	  return m_jobPending || m_quit;
+	});
+      if (m_quit)
+	return;
+
+      // The caller doesn't touch the job buffers while a job is pending
+      lock.unlock ();
+      m_tail->process (m_jobIn.data (), m_jobOut.data ());
+      lock.lock ();
+
+      m_jobPending = false;
+      m_changed.notify_all ();
+    }
+}
@@ -0,0 +1,116 @@
+// =================================================================================================
+// Convolver.h
+//
+// Convolves a stream of audio with a long impulse response, e.g. a room's reverb or a
+// linear-phase EQ, by multiplying spectra instead of summing taps. The impulse response is
+// cut into partitions that are transformed once, up front. The start of it is convolved in
+// small blocks, which sets the latency; the rest is convolved in large blocks, which cost
+// far less per sample, on a worker thread with a whole large block's time to finish.
+//
+// =================================================================================================
+
+#ifndef __Convolver__
+#define __Convolver__
+
+#include "FFT.h"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+class Convolver
+{
+public:
+
+	/// @param	ir				Impulse response, irLen samples. It's copied.
+	/// @param	irLen			Length of the impulse response
+	///	@param	blockSize		Samples per block at the start of the impulse response, which
+	///							is the latency. Must be a valid FFT size.
+	///	@param	tailBlockSize	Samples per block for the rest, from 2 * tailBlockSize on. Must
+	///							be a valid FFT size and a multiple of blockSize. If it's the
+	///							same as blockSize, everything runs in blockSize blocks on the
+	///							calling thread.
+	///
+	Convolver(const float *ir, int irLen, int blockSize = 256, int tailBlockSize = 4096);
+	~Convolver();
+
+	/// Samples the output lags behind the input
+	int latency() const { return m_blockSize; }
+
+	/// Convolves the next block of input. To get the whole of the last input's response,
+	/// follow it with latency() + irLen - 1 samples of silence.
+	///
+	///	@param	x	Input audio, n samples
+	///	@param	y	Output audio, n samples. May be the same as x.
+	/// @param	n	Number of samples; any number
+	///
+	void process(const float *x, float *y, int n);
+
+	/// Clears the history, to start on unrelated input
+	void reset();
+
+private:
+
+	/// One uniformly partitioned overlap-save convolution. Each call takes a block of input
+	/// and gives out a block of output, computed from the spectra of the last numParts
+	/// input blocks times the spectra of the numParts partitions of the impulse response.
+	class Segment
+	{
+	public:
+
+		Segment(const float *ir, int irLen, int blockSize);
+
+		/// Takes blockSize samples from x and writes the next blockSize samples to y
+		void process(const float *x, float *y);
+
+		void reset();
+
+	private:
+
+		int m_blockSize;
+		int m_numBins;
+		int m_numParts;
+		RealFFT m_fft;					// 2 * m_blockSize points
+		vector<float> m_irRe;			// Spectrum of each partition, m_numBins apart
+		vector<float> m_irIm;
+		vector<float> m_historyRe;		// Spectrum of each of the last m_numParts input
+		vector<float> m_historyIm;		// frames, in a ring starting at m_newest
+		int m_newest;
+		vector<float> m_input;			// The last two blocks of input
+		vector<float> m_accRe;			// Sum of the products
+		vector<float> m_accIm;
+		vector<float> m_output;			// Inverse transform of the sum
+	};
+
+	int m_blockSize;
+	int m_tailBlockSize;
+	unique_ptr<Segment> m_head;			// The first 2 * tailBlockSize samples of the response
+	unique_ptr<Segment> m_tail;			// The rest, if any
+
+	vector<float> m_in;					// Input for the current block
+	vector<float> m_ready;				// Finished output for the current block
+	int m_count;						// Samples taken into the current block
+
+	// The tail collects a large block of input while it adds in the output of the block
+	// before last, and the worker convolves the last block
+	vector<float> m_tailIn;
+	vector<float> m_tailOut;
+	int m_tailPos;						// Samples into the current large block
+	vector<float> m_jobIn;
+	vector<float> m_jobOut;
+	bool m_jobPending;
+	bool m_quit;
+	mutex m_mutex;
+	condition_variable m_changed;
+	thread m_worker;
+
+	void runBlock();
+	void startTail();
+	void waitForTail(unique_lock<mutex>& lock);
+	void workerLoop();
+};
+
+#endif
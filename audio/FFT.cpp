@@ -0,0 +1,539 @@
+// =================================================================================================
+// FFT.cpp
+//
+// The complex FFT is a Stockham autosort FFT. An n-point transform is factored into stages
+// of radix 4, 2, 3 and 5. A stage of radix R with stride s (the product of the radices
+// before it) treats the data as s interleaved transforms of length n' = n / s, and does
+// one decimation-in-frequency step on each:
+//
+//              y[q + s (R p + j)] = w^(j p) * sum over k of x[q + s (p + k m)] e^(-2 pi i j k / R)
+//
+// for p < m = n' / R, q < s, j < R, with w = e^(-2 pi i / n'). Stages ping-pong between two
+// buffers and leave the output in natural order, so there is no bit-reversal pass. Within
+// a stage the s values of q are contiguous in both input and output, so once s reaches 4
+// each butterfly runs on 4 values of q at once in SSE registers. The first stage, where
+// s = 1, runs on 4 values of p instead and transposes its output. (Vectors of 8 would need
+// AVX: without it, GCC broadcasts each twiddle through memory, which is slower than scalar
+// code.)
+//
+// The real FFT packs the even samples into the real parts and the odd samples into the
+// imaginary parts of an n/2-point complex FFT, then separates the two spectra:
+//
+//              E[k] = (Z[k] + conj(Z[n/2 - k])) / 2
+//              O[k] = (Z[k] - conj(Z[n/2 - k])) / 2i
+//              X[k] = E[k] + e^(-2 pi i k / n) O[k]
+//
+// and the inverse runs the same steps backwards.
+// =================================================================================================
+
+#include "FFT.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+typedef float Vec4 __attribute__ ((vector_size (16)));
+typedef int Mask4 __attribute__ ((vector_size (16)));
+
+// cos and sin of 2 pi k / R, for the radix-3 and radix-5 butterflies
+static const float COS3[3] = { 1, -0.5f, -0.5f };
+static const float SIN3[3] = { 0, 0.866025403784438647f, -0.866025403784438647f };
+static const float COS5[5] = { 1, 0.309016994374947424f, -0.809016994374947424f,
+  -0.809016994374947424f, 0.309016994374947424f
+};
+static const float SIN5[5] = { 0, 0.951056516295153572f, 0.587785252292473129f,
+  -0.587785252292473129f, -0.951056516295153572f
+};
+
+// Loads and stores one element, or 4 consecutive elements. Vectors are passed by
+// reference, since passing them by value depends on the instruction set.
+template < typename V > static inline void
+load (V & v, const float *p)
+{
+  memcpy (&v, p, sizeof (V));
+}
+
+template < typename V > static inline void
+store (float *p, const V & v)
+{
+  memcpy (p, &v, sizeof (V));
+}
+
+// Stores w * (re + i im) at element o
+template < typename V > static inline void
+storeTwiddled (float *yr, float *yi, int o, const V & re, const V & im,
+	       float wr, float wi)
+{
+  store < V > (yr + o, re * wr - im * wi);
+  store < V > (yi + o, re * wi + im * wr);
+}
+
+// One butterfly of a stage: inputs x[q + s (p + k m)], outputs y[q + s (R p + j)]
+template < int R, typename V > static inline void
+butterfly (const float *xr, const float *xi, float *yr, float *yi, int s,
+	   int m, int p, int q, const float *twr, const float *twi)
+{
+  int in = q + s * p;
+  int out = q + s * R * p;
+
+  if (R == 2)
+    {
+      V ar, ai, br, bi;
+      load (ar, xr + in);
+      load (ai, xi + in);
+      load (br, xr + in + s * m);
+      load (bi, xi + in + s * m);
+      store (yr + out, ar + br);
+      store (yi + out, ai + bi);
+      storeTwiddled (yr, yi, out + s, ar - br, ai - bi, twr[p], twi[p]);
+    }
+  else if (R == 4)
+    {
+      V ar, ai, br, bi, cr, ci, dr, di;
+      load (ar, xr + in);
+      load (ai, xi + in);
+      load (br, xr + in + s * m);
+      load (bi, xi + in + s * m);
+      load (cr, xr + in + 2 * s * m);
+      load (ci, xi + in + 2 * s * m);
+      load (dr, xr + in + 3 * s * m);
+      load (di, xi + in + 3 * s * m);
+
+      V sumAC_r = ar + cr, sumAC_i = ai + ci;
+      V difAC_r = ar - cr, difAC_i = ai - ci;
+      V sumBD_r = br + dr, sumBD_i = bi + di;
+      V difBD_r = br - dr, difBD_i = bi - di;
+
+      // -i (b - d) is (difBD_i, -difBD_r)
+      store (yr + out, sumAC_r + sumBD_r);
+      store (yi + out, sumAC_i + sumBD_i);
+      storeTwiddled (yr, yi, out + s, difAC_r + difBD_i, difAC_i - difBD_r,
+		     twr[p], twi[p]);
+      storeTwiddled (yr, yi, out + 2 * s, sumAC_r - sumBD_r,
+		     sumAC_i - sumBD_i, twr[m + p], twi[m + p]);
+      storeTwiddled (yr, yi, out + 3 * s, difAC_r - difBD_i,
+		     difAC_i + difBD_r, twr[2 * m + p], twi[2 * m + p]);
+    }
+  else
+    {
+      // Radix 3 or 5: a direct R-point DFT
+      const float *cosTable = R == 3 ? COS3 : COS5;
+      const float *sinTable = R == 3 ? SIN3 : SIN5;
+      V ar[R], ai[R];
+      for (int k = 0; k < R; k++)
+	{
+	  load (ar[k], xr + in + k * s * m);
+	  load (ai[k], xi + in + k * s * m);
+	}
+
+      for (int j = 0; j < R; j++)
+	{
+	  V sr = ar[0], si = ai[0];
+	  for (int k = 1; k < R; k++)
+	    {
+	      // (a_r + i a_i)(c - i s)
+	      float c = cosTable[j * k % R];
+	      float sn = sinTable[j * k % R];
+	      sr += ar[k] * c + ai[k] * sn;
+	      si += ai[k] * c - ar[k] * sn;
+	    }
+	  if (j == 0)
+	    {
+	      store (yr + out, sr);
+	      store (yi + out, si);
+	    }
+	  else
+	    storeTwiddled (yr, yi, out + j * s, sr, si, twr[(j - 1) * m + p],
+			   twi[(j - 1) * m + p]);
+	}
+    }
+}
+
+// Transposes the 4 x 4 matrix whose rows are r0 to r3 and stores it at y
+static inline void
+storeTransposed (float *y, const Vec4 & r0, const Vec4 & r1, const Vec4 & r2,
+		 const Vec4 & r3)
+{
+  Mask4 lo = { 0, 4, 1, 5 }, hi = { 2, 6, 3, 7 };
+  Mask4 first = { 0, 1, 4, 5 }, second = { 2, 3, 6, 7 };
+  Vec4 t0 = __builtin_shuffle (r0, r1, lo), t1 = __builtin_shuffle (r0, r1, hi);
+  Vec4 t2 = __builtin_shuffle (r2, r3, lo), t3 = __builtin_shuffle (r2, r3, hi);
+  store (y, __builtin_shuffle (t0, t2, first));
+  store (y + 4, __builtin_shuffle (t0, t2, second));
+  store (y + 8, __builtin_shuffle (t1, t3, first));
+  store (y + 12, __builtin_shuffle (t1, t3, second));
+}
+
+// Four butterflies of the first radix-4 stage, p to p + 3. With s = 1 there is only one q,
+// so these run on 4 values of p instead: the inputs and twiddles are contiguous in p, and
+// the outputs y[4 p + j] are transposed into place.
+static inline void
+firstRadix4 (const float *xr, const float *xi, float *yr, float *yi, int m,
+	     int p, const float *twr, const float *twi)
+{
+  Vec4 re[4], im[4];
+  for (int k = 0; k < 4; k++)
+    {
+      load (re[k], xr + p + k * m);
+      load (im[k], xi + p + k * m);
+    }
+
+  Vec4 sumAC_r = re[0] + re[2], sumAC_i = im[0] + im[2];
+  Vec4 difAC_r = re[0] - re[2], difAC_i = im[0] - im[2];
+  Vec4 sumBD_r = re[1] + re[3], sumBD_i = im[1] + im[3];
+  Vec4 difBD_r = re[1] - re[3], difBD_i = im[1] - im[3];
+
+  re[0] = sumAC_r + sumBD_r;
+  im[0] = sumAC_i + sumBD_i;
+  re[1] = difAC_r + difBD_i;
+  im[1] = difAC_i - difBD_r;
+  re[2] = sumAC_r - sumBD_r;
+  im[2] = sumAC_i - sumBD_i;
+  re[3] = difAC_r - difBD_i;
+  im[3] = difAC_i + difBD_r;
+
+  for (int j = 1; j < 4; j++)
+    {
+      Vec4 wr, wi;
+      load (wr, twr + (j - 1) * m + p);
+      load (wi, twi + (j - 1) * m + p);
+      Vec4 r = re[j] * wr - im[j] * wi;
+      im[j] = re[j] * wi + im[j] * wr;
+      re[j] = r;
+    }
+
+  storeTransposed (yr + 4 * p, re[0], re[1], re[2], re[3]);
+  storeTransposed (yi + 4 * p, im[0], im[1], im[2], im[3]);
+}
+
+template < int R > static void
+runStage (int n, int s, const float *twr, const float *twi, const float *xr,
+	  const float *xi, float *yr, float *yi)
+{
+  int m = n / R;
+  int p = 0;
+  if (R == 4 && s == 1)
+    for (; p + 4 <= m; p += 4)
+      firstRadix4 (xr, xi, yr, yi, m, p, twr, twi);
+
+  for (; p < m; p++)
+    {
+      int q = 0;
+      for (; q + 4 <= s; q += 4)
+	butterfly < R, Vec4 > (xr, xi, yr, yi, s, m, p, q, twr, twi);
+      for (; q < s; q++)
+	butterfly < R, float >(xr, xi, yr, yi, s, m, p, q, twr, twi);
+    }
+}
+
+bool
+FFT::isValidSize (int n)
+{
+  if (n < 1)
+    return false;
+  int factors[] = { 2, 3, 5 };
+  for (int f = 0; f < 3; f++)
+    while (n % factors[f] == 0)
+      n /= factors[f];
+  return n == 1;
+}
+
+int
+FFT::nextValidSize (int n)
+{
+  n = std::max (n, 1);
+  while (!isValidSize (n))
+    n++;
+  return n;
+}
+
+FFT::FFT (int n):
+m_n (n)
+{
+  assert (isValidSize (n));
+
+  // Radix 4 as far as possible, since it needs the fewest multiplies
+  vector < int >radices;
+  int rest = n;
+  while (rest % 4 == 0)
+    {
+      radices.push_back (4);
+      rest /= 4;
+    }
+  int others[] = { 2, 3, 5 };
+  for (int f = 0; f < 3; f++)
+    while (rest % others[f] == 0)
+      {
+	radices.push_back (others[f]);
+	rest /= others[f];
+      }
+
+  int s = 1;
+  for (size_t i = 0; i < radices.size (); i++)
+    {
+      Stage stage;
+      stage.radix = radices[i];
+      stage.n = n / s;
+      stage.s = s;
+
+      int m = stage.n / stage.radix;
+      stage.twRe.resize ((stage.radix - 1) * m);
+      stage.twIm.resize ((stage.radix - 1) * m);
+      for (int j = 1; j < stage.radix; j++)
+	for (int p = 0; p < m; p++)
+	  {
+	    double angle = -2 * M_PI * j * p / stage.n;
+	    stage.twRe[(j - 1) * m + p] = cos (angle);
+	    stage.twIm[(j - 1) * m + p] = sin (angle);
+	  }
+
+      m_stages.push_back (stage);
+      s *= stage.radix;
+    }
+
+  m_workRe.resize (n);
+  m_workIm.resize (n);
+}
+
+void
+FFT::transform (const float *inRe, const float *inIm, float *outRe,
+		float *outIm)
+{
+  int numStages = (int) m_stages.size ();
+  if (numStages == 0)
+    {
+      memmove (outRe, inRe, m_n * sizeof (float));
+      memmove (outIm, inIm, m_n * sizeof (float));
+      return;
+    }
+
+  // Alternate the stages' outputs between the work buffers and the output, so that the
+  // last stage writes the output
+  const float *srcRe = inRe, *srcIm = inIm;
+  bool toOutput = (numStages - 1) % 2 == 0;
+  if (toOutput && inRe == outRe)
+    {
+      // The first stage can't write over its own input, so start from a copy
+      memcpy (m_workRe.data (), inRe, m_n * sizeof (float));
+      memcpy (m_workIm.data (), inIm, m_n * sizeof (float));
+      srcRe = m_workRe.data ();
+      srcIm = m_workIm.data ();
+    }
+
+  for (int i = 0; i < numStages; i++)
+    {
+      const Stage & st = m_stages[i];
+      toOutput = (numStages - 1 - i) % 2 == 0;
+      float *dstRe = toOutput ? outRe : m_workRe.data ();
+      float *dstIm = toOutput ? outIm : m_workIm.data ();
+      const float *twr = st.twRe.data ();
+      const float *twi = st.twIm.data ();
+
+      switch (st.radix)
+	{
+	case 2:
+	  runStage < 2 > (st.n, st.s, twr, twi, srcRe, srcIm, dstRe, dstIm);
+	  break;
+	case 3:
+	  runStage < 3 > (st.n, st.s, twr, twi, srcRe, srcIm, dstRe, dstIm);
+	  break;
+	case 4:
+	  runStage < 4 > (st.n, st.s, twr, twi, srcRe, srcIm, dstRe, dstIm);
+	  break;
+	case 5:
+	  runStage < 5 > (st.n, st.s, twr, twi, srcRe, srcIm, dstRe, dstIm);
+	  break;
+	}
+
+      srcRe = dstRe;
+      srcIm = dstIm;
+    }
+}
+
+void
+FFT::forward (const float *inRe, const float *inIm, float *outRe,
+	      float *outIm)
+{
+  transform (inRe, inIm, outRe, outIm);
+}
+
+void
+FFT::inverse (const float *inRe, const float *inIm, float *outRe,
+	      float *outIm)
+{
+  // Swapping the real and imaginary parts conjugates both sides of the transform
+  transform (inIm, inRe, outIm, outRe);
+
+  float scale = 1.0f / m_n;
+  for (int i = 0; i < m_n; i++)
+    {
+      outRe[i] *= scale;
+      outIm[i] *= scale;
+    }
+}
+
+RealFFT::RealFFT (int n):
+m_n (n), m_half (n / 2)
+{
+  assert (n % 2 == 0);
+
+  int h = n / 2;
+  m_twRe.resize (h + 1);
+  m_twIm.resize (h + 1);
+  for (int k = 0; k <= h; k++)
+    {
+      m_twRe[k] = cos (-2 * M_PI * k / n);
+      m_twIm[k] = sin (-2 * M_PI * k / n);
+    }
+  m_zRe.resize (h);
+  m_zIm.resize (h);
+}
+
+void
+RealFFT::forward (const float *x, float *re, float *im)
+{
+  int h = m_n / 2;
+  for (int k = 0; k < h; k++)
+    {
+      m_zRe[k] = x[2 * k];
+      m_zIm[k] = x[2 * k + 1];
+    }
+  m_half.forward (m_zRe.data (), m_zIm.data (), m_zRe.data (), m_zIm.data ());
+
+  // Bins 0 and n/2 are E[0] + O[0] and E[0] - O[0], where E[0] and O[0] are real
+  re[0] = m_zRe[0] + m_zIm[0];
+  im[0] = 0;
+  re[h] = m_zRe[0] - m_zIm[0];
+  im[h] = 0;
+
+  for (int k = 1; k < h; k++)
+    {
+      float ar = m_zRe[k], ai = m_zIm[k];
+      float br = m_zRe[h - k], bi = -m_zIm[h - k];	// conj(Z[h - k])
+
+      float er = 0.5f * (ar + br), ei = 0.5f * (ai + bi);
+      float dr = 0.5f * (ar - br), di = 0.5f * (ai - bi);
+      float orr = di, oi = -dr;	// d / i
+
+      float wr = m_twRe[k], wi = m_twIm[k];
+      re[k] = er + orr * wr - oi * wi;
+      im[k] = ei + orr * wi + oi * wr;
+    }
+}
+
+void
+RealFFT::inverse (const float *re, const float *im, float *x)
+{
+  int h = m_n / 2;
+  m_zRe[0] = 0.5f * (re[0] + re[h]);
+  m_zIm[0] = 0.5f * (re[0] - re[h]);
+
+  for (int k = 1; k < h; k++)
+    {
+      float ar = re[k], ai = im[k];
+      float br = re[h - k], bi = -im[h - k];	// conj(X[h - k])
+
+      float er = 0.5f * (ar + br), ei = 0.5f * (ai + bi);
+      float dr = 0.5f * (ar - br), di = 0.5f * (ai - bi);
+
+      // O = d / w, and w is on the unit circle, so multiply by its conjugate
+      float wr = m_twRe[k], wi = -m_twIm[k];
+      float orr = dr * wr - di * wi, oi = dr * wi + di * wr;
+
+      // Z = E + i O
+      m_zRe[k] = er - oi;
+      m_zIm[k] = ei + orr;
+    }
+  m_half.inverse (m_zRe.data (), m_zIm.data (), m_zRe.data (), m_zIm.data ());
+
+  for (int k = 0; k < h; k++)
+    {
+      x[2 * k] = m_zRe[k];
+      x[2 * k + 1] = m_zIm[k];
+    }
+}
+
+Stft::Stft (int frameSize, int hop, StftWindow window):
+m_frameSize (frameSize), m_hop (hop), m_fft (frameSize)
+{
+  assert (hop > 0 && frameSize % hop == 0);
+
+  int N = frameSize;
+  m_window.resize (N);
+  for (int i = 0; i < N; i++)
+    {
+      double hann = 0.5 - 0.5 * cos (2 * M_PI * i / N);
+      m_window[i] = window == STFT_HANN ? hann : sqrt (hann);
+    }
+
+  // The window is applied twice, so the frames overlap-add to the sum of its squares
+  // at the hop spacing. Average it over one hop, in case it isn't quite flat.
+  double sum = 0;
+  for (int i = 0; i < N; i++)
+    sum += m_window[i] * m_window[i];
+  m_scale = (float) (hop / sum);
+
+  m_frame.resize (N);
+  m_re.resize (numBins ());
+  m_im.resize (numBins ());
+  m_in.resize (N);
+  m_ola.resize (N);
+  m_ready.resize (hop);
+  reset ();
+}
+
+void
+Stft::reset ()
+{
+  std::fill (m_in.begin (), m_in.end (), 0.0f);
+  std::fill (m_ola.begin (), m_ola.end (), 0.0f);
+  std::fill (m_ready.begin (), m_ready.end (), 0.0f);
+  m_count = 0;
+}
+
+void
+Stft::analyze (const float *x, float *re, float *im)
+{
+  for (int i = 0; i < m_frameSize; i++)
+    m_frame[i] = x[i] * m_window[i];
+  m_fft.forward (m_frame.data (), re, im);
+}
+
+void
+Stft::synthesize (const float *re, const float *im, float *y)
+{
+  m_fft.inverse (re, im, m_frame.data ());
+  for (int i = 0; i < m_frameSize; i++)
+    y[i] += m_frame[i] * m_window[i] * m_scale;
+}
+
+void
+Stft::process (const float *x, float *y, int n,
+	       const function < void (float *re, float *im) > &modify)
+{
+  const int N = m_frameSize;
+  int done = 0;
+  while (done < n)
+    {
+      // Take input into the end of the frame, and give out the finished output
+      int k = std::min (n - done, m_hop - m_count);
+      memcpy (m_in.data () + N - m_hop + m_count, x + done, k * sizeof (float));
+      memcpy (y + done, m_ready.data () + m_count, k * sizeof (float));
+      m_count += k;
+      done += k;
+
+      if (m_count == m_hop)
+	{
+	  analyze (m_in.data (), m_re.data (), m_im.data ());
+	  modify (m_re.data (), m_im.data ());
+	  synthesize (m_re.data (), m_im.data (), m_ola.data ());
+
+	  // The first hop of the accumulator has had every frame that overlaps it
+	  memcpy (m_ready.data (), m_ola.data (), m_hop * sizeof (float));
+	  memmove (m_ola.data (), m_ola.data () + m_hop, (N - m_hop) * sizeof (float));
+	  std::fill (m_ola.end () - m_hop, m_ola.end (), 0.0f);
+	  memmove (m_in.data (), m_in.data () + m_hop, (N - m_hop) * sizeof (float));
+	  m_count = 0;
+	}
+    }
+}
@@ -0,0 +1,180 @@
+// =================================================================================================
+// FFT.h
+//
+// Fast Fourier transforms for spectral analysis and fast convolution: a complex FFT of any
+// size whose only prime factors are 2, 3 and 5, a real FFT built on it, and an STFT that
+// windows, transforms and overlap-adds a stream of audio. Each transform is planned once
+// for its size, precomputing the twiddle factors, and can then be run any number of times.
+//
+// Complex data is kept as separate arrays of real and imaginary parts, so that the
+// butterflies can load 4 real parts and 4 imaginary parts at once with SSE.
+//
+// =================================================================================================
+
+#ifndef __FFT__
+#define __FFT__
+
+#include <functional>
+#include <vector>
+
+using namespace std;
+
+/// A complex FFT plan. The transform isn't thread-safe, as it uses the plan's work
+/// buffers; give each thread its own plan.
+class FFT
+{
+public:
+
+	/// @param	n	Transform size. Its only prime factors must be 2, 3 and 5.
+	FFT(int n);
+
+	/// True if n is a size an FFT can be planned for
+	static bool isValidSize(int n);
+
+	/// The smallest valid size of at least n, e.g. for zero-padding
+	static int nextValidSize(int n);
+
+	int size() const { return m_n; }
+
+	/// Forward transform: X[k] = sum of x[j] e^(-2 pi i j k / n). The output may be the
+	/// same arrays as the input.
+	///
+	///	@param	inRe, inIm		Input, n samples each
+	///	@param	outRe, outIm	Spectrum, n bins each
+	///
+	void forward(const float *inRe, const float *inIm, float *outRe, float *outIm);
+
+	/// Inverse transform, scaled by 1 / n so that it undoes forward()
+	void inverse(const float *inRe, const float *inIm, float *outRe, float *outIm);
+
+private:
+
+	/// One pass of radix-R butterflies over transforms of length n at stride s
+	struct Stage
+	{
+		int radix;
+		int n;
+		int s;
+		vector<float> twRe;		// w^(j p) for j = 1..radix-1, p = 0..n/radix-1
+		vector<float> twIm;
+	};
+
+	int m_n;
+	vector<Stage> m_stages;
+	vector<float> m_workRe;
+	vector<float> m_workIm;
+
+	void transform(const float *inRe, const float *inIm, float *outRe, float *outIm);
+};
+
+/// FFT of real input, which is computed as a complex FFT of half the size. The spectrum
+/// of real input is conjugate-symmetric, so only bins 0 to n/2 are kept.
+class RealFFT
+{
+public:
+
+	/// @param	n	Transform size. Must be even, and n/2 a valid FFT size.
+	RealFFT(int n);
+
+	int size() const { return m_n; }
+	int numBins() const { return m_n / 2 + 1; }
+
+	/// Forward transform
+	///
+	///	@param	x		Input, n samples
+	///	@param	re, im	Spectrum, numBins() bins each
+	///
+	void forward(const float *x, float *re, float *im);
+
+	/// Inverse transform, scaled by 1 / n so that it undoes forward(). The imaginary
+	/// parts of bins 0 and n/2 are ignored.
+	///
+	///	@param	re, im	Spectrum, numBins() bins each
+	///	@param	x		Output, n samples
+	///
+	void inverse(const float *re, const float *im, float *x);
+
+private:
+
+	int m_n;
+	FFT m_half;
+	vector<float> m_twRe;	// e^(-2 pi i k / n) for k = 0..n/2
+	vector<float> m_twIm;
+	vector<float> m_zRe;	// The half-size complex transform
+	vector<float> m_zIm;
+};
+
+/// Window applied to each STFT frame, both before analysis and after synthesis
+enum StftWindow
+{
+	STFT_HANN,		// Low leakage; overlap-adds flat for a hop of up to a third of the frame
+	STFT_SQRT_HANN	// Overlap-adds flat for a hop of up to half the frame
+};
+
+/// Short-time Fourier transform: the audio is cut into overlapping windowed frames, each
+/// frame is transformed, and the frames can be transformed back and overlap-added into
+/// audio again. The overlap-add is scaled so that unmodified spectra give back the input.
+class Stft
+{
+public:
+
+	/// @param	frameSize	Samples per frame; must be a valid RealFFT size
+	/// @param	hop			Samples between frames; must divide frameSize
+	///	@param	window		Analysis and synthesis window
+	///
+	Stft(int frameSize, int hop, StftWindow window = STFT_HANN);
+
+	int frameSize() const { return m_frameSize; }
+	int hop() const { return m_hop; }
+	int numBins() const { return m_fft.numBins(); }
+
+	/// Samples the output of process() lags behind its input
+	int latency() const { return m_frameSize; }
+
+	/// Windows and transforms one frame
+	///
+	///	@param	x		frameSize() samples
+	///	@param	re, im	Spectrum, numBins() bins each
+	///
+	void analyze(const float *x, float *re, float *im);
+
+	/// Transforms one frame back, windows it and adds it to y
+	///
+	///	@param	re, im	Spectrum, numBins() bins each
+	///	@param	y		Overlap-add accumulator; frameSize() samples are added to
+	///
+	void synthesize(const float *re, const float *im, float *y);
+
+	/// Runs a stream of audio through analysis, a spectral modification and synthesis.
+	/// The output is latency() samples behind the input.
+	///
+	///	@param	x		Input audio, n samples
+	///	@param	y		Output audio, n samples. May be the same as x.
+	/// @param	n		Number of samples
+	///	@param	modify	Called with the spectrum of each frame, numBins() bins, to change
+	///					it in place
+	///
+	void process(const float *x, float *y, int n,
+				 const function<void(float *re, float *im)>& modify);
+
+	/// Clears the stream state of process()
+	void reset();
+
+private:
+
+	int m_frameSize;
+	int m_hop;
+	RealFFT m_fft;
+	vector<float> m_window;
+	float m_scale;				// Makes the overlap-added windows sum to 1
+
+	vector<float> m_frame;		// One windowed frame
+	vector<float> m_re;			// Spectrum of the frame
+	vector<float> m_im;
+	vector<float> m_in;			// The last frameSize input samples
+	vector<float> m_ola;		// Overlap-add accumulator, aligned with m_in
+	vector<float> m_ready;		// Finished output for the current hop
+	int m_count;				// Samples taken into the current hop
+};
+
+#endif
@@ -0,0 +1,47 @@
+// =================================================================================================
+// Kaiser.h
+//
+// Kaiser-windowed sinc filters, as used by the resampler and the loudness meter's
+// true-peak interpolator. beta sets the window's shape: larger values give a deeper
+// stopband and a wider transition band.
+//
+// =================================================================================================
+
+#ifndef __Kaiser__
+#define __Kaiser__
+
+#include <cmath>
+
+/// Zeroth-order modified Bessel function of the first kind, by its power series
+inline double besselI0(double x)
+{
+	double sum = 1, term = 1;
+	for (int k = 1; term > 1e-12 * sum; k++)
+	{
+		term *= (x / (2 * k)) * (x / (2 * k));
+		sum += term;
+	}
+	return sum;
+}
+
+/// Kaiser window at u, from -1 to 1 across the window, and 0 outside it
+inline double kaiserWindow(double u, double beta)
+{
+	return u * u < 1 ? besselI0(beta * sqrt(1 - u * u)) / besselI0(beta) : 0;
+}
+
+/// One tap of a Kaiser-windowed sinc low-pass filter. The taps sum to about 1.
+///
+///	@param	d		Distance in samples from the tap to the point it contributes to
+///	@param	half	Half the window's length, in samples
+///	@param	cutoff	Cutoff as a fraction of the Nyquist frequency
+///	@param	beta	Window shape
+///
+inline double kaiserSinc(double d, double half, double cutoff, double beta)
+{
+	double arg = M_PI * cutoff * d;
+	double sinc = arg == 0 ? 1 : sin(arg) / arg;
+	return cutoff * sinc * kaiserWindow(d / half, beta);
+}
+
+#endif
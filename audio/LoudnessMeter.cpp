@@ -0,0 +1,363 @@
+// =================================================================================================
+// LoudnessMeter.cpp
+//
+// Loudness is kept as the channel-weighted sum of K-weighted squares in each 100 ms. A
+// 400 ms block is any 4 in a row, which gives BS.1770's 75% overlap, and the momentary,
+// short-term and integrated loudness are all worked out from these sums when asked for.
+// That's 10 values a second to keep, so hours of audio take little memory, and the gating
+// of the integrated loudness is exact rather than read off a histogram.
+// =================================================================================================
+
+#include "LoudnessMeter.h"
+#include "Kaiser.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+static const int CHUNK_FRAMES = 1024;	// Most frames metered at a time
+static const int TRUE_PEAK_TAPS = 32;	// Input samples per interpolated value
+static const int TRUE_PEAK_HISTORY = TRUE_PEAK_TAPS - 1;
+static const double ABSOLUTE_GATE = -70;	// LUFS
+static const double RELATIVE_GATE = -10;	// LU
+
+// Kaiser window shape for the true-peak filter. With 32 taps, the interpolated points are
+// within 0.02 dB of exact up to 0.8 of the Nyquist frequency, and 0.04 dB up to 0.9.
+// Two other errors are not the filter's. Only 4 points per sample are looked at, so a
+// steady tone whose peaks keep falling between them reads up to 0.69 dB low near Nyquist.
+// And the audio is taken to be silent before it starts: a full-scale 12 kHz sine at
+// 48 kHz that starts at 0.707 really does overshoot, and reads +0.09 dBTP.
+static const double KAISER_BETA = 5.0;
+
+typedef float Vec4 __attribute__ ((vector_size (16)));
+
+// Highest absolute value of the audio interpolated 1/4, 1/2 and 3/4 of the way from each
+// input sample to the next. The points on the samples themselves are the sample peak. h
+// holds the weight of each tap for each of the 3 points, h[3 * t + p], in all 4 lanes, so
+// that 4 input positions are done at once, each tap's inputs loaded once for all 3 points.
+//
+// x holds TRUE_PEAK_HISTORY samples of history and then n new samples. The points after
+// input i use inputs i - TRUE_PEAK_TAPS / 2 + 1 to i + TRUE_PEAK_TAPS / 2, so they lag
+// half the filter behind; the last few wait for the next call.
+static float
+interpolatedPeak (const float *x, int n, const Vec4 * h)
+{
+  Vec4 peak = { 0, 0, 0, 0 };
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+      Vec4 a = { 0, 0, 0, 0 }, b = a, c = a;
+      for (int t = 0; t < TRUE_PEAK_TAPS; t++)
+	{
+	  Vec4 v;
+	  memcpy (&v, x + i + t, sizeof (Vec4));
+	  a += h[3 * t] * v;
+	  b += h[3 * t + 1] * v;
+	  c += h[3 * t + 2] * v;
+	}
+      Vec4 na = -a, nb = -b, nc = -c;
+      a = a > na ? a : na;
+      b = b > nb ? b : nb;
+      c = c > nc ? c : nc;
+      a = a > b ? a : b;
+      a = a > c ? a : c;
+      peak = a > peak ? a : peak;
+    }
+
+  float result =
+    std::max (std::max (peak[0], peak[1]), std::max (peak[2], peak[3]));
+  for (; i < n; i++)
+    for (int p = 0; p < 3; p++)
+      {
+	float sum = 0;
+	for (int t = 0; t < TRUE_PEAK_TAPS; t++)
+	  sum += h[3 * t + p][0] * x[i + t];
+	result = std::max (result, std::fabs (sum));
+      }
+  return result;
+}
+
+// Loudness in LUFS of a channel-weighted mean square
+static double
+toLufs (double meanSquare)
+{
+  return -0.691 + 10 * log10 (meanSquare);
+}
+
+// The mean square of a loudness in LUFS
+static double
+fromLufs (double lufs)
+{
+  return pow (10, (lufs + 0.691) / 10);
+}
+
+LoudnessMeter::LoudnessMeter (int sr, int numCh):
+m_sampleRate (sr),
+m_numChannels (numCh),
+m_weights (numCh, 1.0),
+m_kWeighting (2 * ((numCh + 3) / 4), MultiBiquad < 4 > (sr)),
+m_sumSquares (numCh), m_subBlockSum (numCh),
+m_channels (numCh * (TRUE_PEAK_HISTORY + CHUNK_FRAMES)), m_chunks (numCh)
+{
+  assert (sr > 0 && numCh > 0);
+
+  m_subBlockLength = (sr + 5) / 10;
+
+  // BS.1770's weights for 5.0 and 5.1, in wav channel order
+  if (numCh == 5 || numCh == 6)
+    {
+      m_weights[numCh - 2] = 1.41;
+      m_weights[numCh - 1] = 1.41;
+      if (numCh == 6)
+	m_weights[3] = 0;
+    }
+
+  for (int ch = 0; ch < numCh; ch++)
+    m_chunks[ch] =
+      m_channels.data () + ch * (TRUE_PEAK_HISTORY + CHUNK_FRAMES) +
+      TRUE_PEAK_HISTORY;
+  for (size_t g = 0; g < m_kWeighting.size (); g += 2)
+    initKWeighting (m_kWeighting[g], m_kWeighting[g + 1]);
+  initInterpolator ();
+
+  reset ();
+}
+
+// A Kaiser-windowed sinc for each of the 3 points between samples
+void
+LoudnessMeter::initInterpolator ()
+{
+  const int half = TRUE_PEAK_TAPS / 2;
+  m_interpolator.resize (TRUE_PEAK_TAPS * 3 * 4);
+  m_interpolatorGain = 0;
+  for (int p = 0; p < 3; p++)
+    {
+      float gain = 0;
+      for (int t = 0; t < TRUE_PEAK_TAPS; t++)
+	{
+	  double d = (p + 1) / 4.0 - (t - half + 1);	// From the input sample to the point
+	  float weight = (float) kaiserSinc (d, half, 1, KAISER_BETA);
+	  std::fill_n (m_interpolator.begin () + (t * 3 + p) * 4, 4, weight);
+	  gain += std::fabs (weight);
+	}
+      m_interpolatorGain = std::max (m_interpolatorGain, gain);
+    }
+}
+
+// BS.1770's two stages: a high shelf of +4 dB above about 1.5 kHz, for the effect of the
+// head, then a high-pass at about 38 Hz. BS.1770 gives the coefficients at 48 kHz; these
+// are the analog prototypes they come from, mapped to any rate with the bilinear
+// transform, and match them at 48 kHz.
+void
+LoudnessMeter::initKWeighting (MultiBiquad < 4 > &stage1,
+			       MultiBiquad < 4 > &stage2) const
+{
+  double f0 = 1681.974450955533;
+  double gainDb = 3.999843853973347;
+  double q = 0.7071752369554196;
+  double k = tan (M_PI * f0 / m_sampleRate);
+  double vh = pow (10, gainDb / 20);
+  double vb = pow (vh, 0.4996667741545416);
+  double a0 = 1 + k / q + k * k;
+  for (int ch = 0; ch < 4; ch++)
+    stage1.setCoefficients (ch, (vh + vb * k / q + k * k) / a0,
+			    2 * (k * k - vh) / a0,
+			    (vh - vb * k / q + k * k) / a0,
+			    2 * (k * k - 1) / a0, (1 - k / q + k * k) / a0);
+
+  // The numerator is left at 1 -2 1, as in BS.1770, rather than scaled to unity gain
+  f0 = 38.13547087602444;
+  q = 0.5003270373238773;
+  k = tan (M_PI * f0 / m_sampleRate);
+  a0 = 1 + k / q + k * k;
+  for (int ch = 0; ch < 4; ch++)
+    stage2.setCoefficients (ch, 1, -2, 1, 2 * (k * k - 1) / a0,
+			    (1 - k / q + k * k) / a0);
+}
+
+void
+LoudnessMeter::reset ()
+{
+  for (size_t g = 0; g < m_kWeighting.size (); g++)
+    m_kWeighting[g].clear ();
+  for (int ch = 0; ch < m_numChannels; ch++)
+    {
+      m_sumSquares[ch] = 0;
+      m_subBlockSum[ch] = 0;
+    }
+  std::fill (m_channels.begin (), m_channels.end (), 0.0f);
+  m_subBlocks.clear ();
+  m_subBlockPos = 0;
+  m_numFrames = 0;
+  m_samplePeak = 0;
+  m_truePeak = 0;
+}
+
+void
+LoudnessMeter::tap (const float *x, int numCh, int numFrames)
+{
+  assert (numCh == m_numChannels);
+  process (x, numFrames);
+}
+
+void
+LoudnessMeter::process (const float *x, int numFrames)
+{
+  const Vec4 *interpolator = (const Vec4 *) m_interpolator.data ();
+
+  while (numFrames > 0)
+    {
+      // Never past the end of the current 100 ms
+      int n = std::min (numFrames, m_subBlockLength - m_subBlockPos);
+      n = std::min (n, CHUNK_FRAMES);
+
+      for (int ch = 0; ch < m_numChannels; ch++)
+	{
+	  float *c = m_chunks[ch];
+	  float *h = c - TRUE_PEAK_HISTORY;
+	  float peak = 0;
+	  double sum = 0;
+	  for (int i = 0; i < n; i++)
+	    {
+	      float v = x[i * m_numChannels + ch];
+	      c[i] = v;
+	      sum += v * v;
+	      peak = std::max (peak, std::fabs (v));
+	    }
+	  m_samplePeak = std::max (m_samplePeak, peak);
+	  m_sumSquares[ch] += sum;
+
+	  // A point between samples is at most the filter's gain times the samples around
+	  // it, so most of the time, once the loudest part has set the true peak, there's no
+	  // need to interpolate at all
+	  for (int i = 0; i < TRUE_PEAK_HISTORY; i++)
+	    peak = std::max (peak, std::fabs (h[i]));
+	  if (peak * m_interpolatorGain > m_truePeak)
+	    m_truePeak =
+	      std::max (m_truePeak, interpolatedPeak (h, n, interpolator));
+
+	  // Then keep the end of the chunk as the next one's history
+	  std::copy (h + n, h + n + TRUE_PEAK_HISTORY, h);
+	}
+
+      // Each group of 4 channels runs through both stages in lockstep
+      for (int ch = 0; ch < m_numChannels; ch += 4)
+	{
+	  float *const *c = m_chunks.data () + ch;
+	  int numCh = std::min (4, m_numChannels - ch);
+	  m_kWeighting[ch / 2].process (c, c, numCh, n);
+	  m_kWeighting[ch / 2 + 1].process (c, c, numCh, n);
+	}
+
+      for (int ch = 0; ch < m_numChannels; ch++)
+	{
+	  const float *c = m_chunks[ch];
+	  double sum = 0;
+	  for (int i = 0; i < n; i++)
+	    sum += c[i] * c[i];
+	  m_subBlockSum[ch] += sum;
+	}
+
+      x += n * m_numChannels;
+      numFrames -= n;
+      m_numFrames += n;
+      m_subBlockPos += n;
+      if (m_subBlockPos == m_subBlockLength)
+	endSubBlock ();
+    }
+}
+
+void
+LoudnessMeter::endSubBlock ()
+{
+  double sum = 0;
+  for (int ch = 0; ch < m_numChannels; ch++)
+    {
+      sum += m_weights[ch] * m_subBlockSum[ch];
+      m_subBlockSum[ch] = 0;
+    }
+  m_subBlocks.push_back (sum);
+  m_subBlockPos = 0;
+}
+
+double
+LoudnessMeter::samplePeak () const
+{
+  return 20 * log10 (m_samplePeak);
+}
+
+double
+LoudnessMeter::truePeak () const
+{
+  return 20 * log10 (std::max (m_truePeak, m_samplePeak));
+}
+
+double
+LoudnessMeter::rms (int ch) const
+{
+  if (m_numFrames == 0)
+    return -INFINITY;
+  return 10 * log10 (m_sumSquares[ch] / m_numFrames);
+}
+
+// Loudness of the last numSubBlocks 100 ms, or -infinity if there aren't that many yet
+double
+LoudnessMeter::loudness (int numSubBlocks) const
+{
+  if ((int) m_subBlocks.size () < numSubBlocks)
+    return -INFINITY;
+
+  double sum = 0;
+  for (auto it = m_subBlocks.end () - numSubBlocks; it != m_subBlocks.end ();
+       ++it)
+    sum += *it;
+  return toLufs (sum / ((double) numSubBlocks * m_subBlockLength));
+}
+
+double
+LoudnessMeter::momentaryLoudness () const
+{
+  return loudness (4);
+}
+
+double
+LoudnessMeter::shortTermLoudness () const
+{
+  return loudness (30);
+}
+
+double
+LoudnessMeter::integratedLoudness () const
+{
+  int numBlocks = (int) m_subBlocks.size () - 3;
+  double scale = 1.0 / (4.0 * m_subBlockLength);
+
+  // Mean of the blocks louder than a gate, given as a mean square
+  auto gatedMean =[&](double gate, int &count)
+  {
+    double total = 0;
+    count = 0;
+    for (int b = 0; b < numBlocks; b++)
+      {
+	const double *s = m_subBlocks.data () + b;
+	double z = (s[0] + s[1] + s[2] + s[3]) * scale;
+	if (z > gate)
+	  {
+	    total += z;
+	    count++;
+	  }
+      }
+    return count > 0 ? total / count : 0;
+  };
+
+  // The relative gate is set by the blocks that pass the absolute gate, and only the
+  // blocks that pass both count
+  int count;
+  double mean = gatedMean (fromLufs (ABSOLUTE_GATE), count);
+  if (count == 0)
+    return -INFINITY;
+
+  double gate =
+    std::max (fromLufs (ABSOLUTE_GATE), fromLufs (toLufs (mean) + RELATIVE_GATE));
+  return toLufs (gatedMean (gate, count));
+}
@@ -0,0 +1,91 @@
+// =================================================================================================
+// LoudnessMeter.h
+//
+// Measures the levels a loudness checker reports, as the audio streams past: sample peak,
+// true peak (the peak between samples too, found by oversampling 4x), RMS per channel, and
+// loudness in LUFS as defined by ITU-R BS.1770 and EBU R128, i.e. the K-weighted mean
+// square in 400 ms blocks, gated to leave out silence and quiet passages. As an AudioTap,
+// it can ride along on a WavReader or WavWriter, so a file is metered as it's written
+// instead of being read a second time.
+//
+// =================================================================================================
+
+#ifndef __LoudnessMeter__
+#define __LoudnessMeter__
+
+#include "MultiBiquad.h"
+#include "WavUtils.h"
+#include <vector>
+
+using namespace std;
+
+class LoudnessMeter : public AudioTap
+{
+public:
+
+	/// @param	sr		Sample rate (e.g. 44100)
+	///	@param	numCh	Number of channels. With 5 or 6, they're taken to be in wav order,
+	///					L R C (LFE) Ls Rs, and weighted as BS.1770 says: the surrounds
+	///					count +1.5 dB and the LFE not at all.
+	///
+	LoudnessMeter(int sr, int numCh);
+
+	/// Meters a block of audio
+	///
+	///	@param	x			Interleaved audio, numCh * numFrames samples. Full scale is [-1, 1].
+	/// @param	numFrames	Number of sample frames
+	///
+	void process(const float *x, int numFrames);
+
+	/// The same, as a tap on a reader or writer
+	void tap(const float *x, int numCh, int numFrames);
+
+	/// Forgets everything metered so far
+	void reset();
+
+	/// Highest absolute sample value, in dBFS
+	double samplePeak() const;
+
+	/// Highest absolute value of the audio oversampled 4x, in dBTP; at least the sample peak
+	double truePeak() const;
+
+	/// RMS level of one channel, in dBFS; a full-scale sine is -3 dB
+	double rms(int ch) const;
+
+	/// Loudness of the last 400 ms, in LUFS
+	double momentaryLoudness() const;
+
+	/// Loudness of the last 3 s, in LUFS
+	double shortTermLoudness() const;
+
+	/// Gated loudness of everything metered so far, in LUFS. Blocks below -70 LUFS, and
+	/// then blocks more than 10 LU below the loudness of the rest, are left out. -infinity
+	/// for silence or less than 400 ms of audio.
+	double integratedLoudness() const;
+
+private:
+
+	int m_sampleRate;
+	int m_numChannels;
+	int m_subBlockLength;			// Sample frames per 100 ms; blocks are 4 of these, 75% overlapped
+	int m_subBlockPos;				// Sample frames into the current 100 ms
+	vector<double> m_weights;		// Per channel
+	vector<MultiBiquad<4> > m_kWeighting;	// Two stages per group of 4 channels
+	vector<float> m_interpolator;	// True-peak filter, 3 weights per tap, each in 4 lanes
+	float m_interpolatorGain;		// Most it can amplify a signal, i.e. its largest sum of |weights|
+	vector<double> m_sumSquares;	// Per channel, of the unweighted audio
+	vector<double> m_subBlockSum;	// Per channel, of the K-weighted audio in the current 100 ms
+	vector<double> m_subBlocks;		// Channel-weighted sum of K-weighted squares per 100 ms
+	int64_t m_numFrames;
+	float m_samplePeak;
+	float m_truePeak;
+	vector<float> m_channels;		// Per channel, the interpolator's history and then a chunk
+	vector<float *> m_chunks;		// Per channel, where its chunk starts in m_channels
+
+	void initKWeighting(MultiBiquad<4>& stage1, MultiBiquad<4>& stage2) const;
+	void initInterpolator();
+	double loudness(int numSubBlocks) const;
+	void endSubBlock();
+};
+
+#endif
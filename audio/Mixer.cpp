@@ -0,0 +1,295 @@
+// =================================================================================================
+// Mixer.cpp
+//
+// The mix is accumulated one block at a time in a buffer per output channel. Each track
+// is read (or, for a buffer track, used in place), split into channels if it is stereo,
+// scaled and added in one pass with 8-wide vectors, and the finished block is then
+// interleaved into the output. A track that is shorter than the mix simply stops
+// contributing; nothing is ever read past its end.
+//
+// renderToFile gives each thread its own range of SEGMENT frames. While the threads render
+// one pass, the main thread writes the previous pass to the file.
+// =================================================================================================
+
+#include "Mixer.h"
+#include "Panner.h"
+#include <algorithm>
+#include <cassert>
+#include <cstring>
+#include <thread>
+
+// Sample frames mixed at a time. The accumulators and a track's samples stay in L2 cache.
+static const int BLOCK = 4096;
+
+// Sample frames each thread renders per pass of renderToFile
+static const int SEGMENT = 1 << 16;
+
+typedef float Vec8 __attribute__ ((vector_size (32)));
+typedef int Mask8 __attribute__ ((vector_size (32)));
+
+// y += gain * x, for n samples
+static void
+mixAdd (float *y, const float *x, float gain, int n)
+{
+  int i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+      Vec8 a, b;
+      memcpy (&a, y + i, sizeof (Vec8));
+      memcpy (&b, x + i, sizeof (Vec8));
+      a += gain * b;
+      memcpy (y + i, &a, sizeof (Vec8));
+    }
+  for (; i < n; i++)
+    y[i] += gain * x[i];
+}
+
+// yL += gainL * left, yR += gainR * right, for n frames of interleaved stereo x
+static void
+mixAddStereo (float *yL, float *yR, const float *x, float gainL, float gainR,
+	      int n)
+{
+  const Mask8 evens = { 0, 2, 4, 6, 8, 10, 12, 14 };
+  const Mask8 odds = { 1, 3, 5, 7, 9, 11, 13, 15 };
+
+  int i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+      Vec8 lo, hi, l, r;
+      memcpy (&lo, x + 2 * i, sizeof (Vec8));
+      memcpy (&hi, x + 2 * i + 8, sizeof (Vec8));
+      memcpy (&l, yL + i, sizeof (Vec8));
+      memcpy (&r, yR + i, sizeof (Vec8));
+      l += gainL * __builtin_shuffle (lo, hi, evens);
+      r += gainR * __builtin_shuffle (lo, hi, odds);
+      memcpy (yL + i, &l, sizeof (Vec8));
+      memcpy (yR + i, &r, sizeof (Vec8));
+    }
+  for (; i < n; i++)
+    {
+      yL[i] += gainL * x[2 * i];
+      yR[i] += gainR * x[2 * i + 1];
+    }
+}
+
+// y += gain * (left + right), for n frames of interleaved stereo x
+static void
+mixAddDownmix (float *y, const float *x, float gain, int n)
+{
+  const Mask8 evens = { 0, 2, 4, 6, 8, 10, 12, 14 };
+  const Mask8 odds = { 1, 3, 5, 7, 9, 11, 13, 15 };
+
+  int i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+      Vec8 lo, hi, a;
+      memcpy (&lo, x + 2 * i, sizeof (Vec8));
+      memcpy (&hi, x + 2 * i + 8, sizeof (Vec8));
+      memcpy (&a, y + i, sizeof (Vec8));
+      a += gain * (__builtin_shuffle (lo, hi, evens) +
+		   __builtin_shuffle (lo, hi, odds));
+      memcpy (y + i, &a, sizeof (Vec8));
+    }
+  for (; i < n; i++)
+    y[i] += gain * (x[2 * i] + x[2 * i + 1]);
+}
+
+Mixer::Mixer (int sr, int numCh):
+m_sampleRate (sr), m_numChannels (numCh)
+{
+  assert (numCh == 1 || numCh == 2);
+}
+
+WavStatus
+Mixer::addTrack (const string & path)
+{
+  unique_ptr < MappedWav > file (new MappedWav);
+  WavStatus status = file->open (path);
+  if (status != WAV_OK)
+    return status;
+
+  if (file->sampleRate () != m_sampleRate || file->numChannels () > 2)
+    return WAV_ERR_UNSUPPORTED;
+
+  unique_ptr < Track > track (new Track);
+  track->buffer = NULL;
+  track->numFrames = file->numFrames ();
+  track->numChannels = file->numChannels ();
+  track->gain = 1;
+  track->pan = 0;
+  track->mute = false;
+  track->file = std::move (file);
+  m_tracks.push_back (std::move (track));
+
+  return WAV_OK;
+}
+
+void
+Mixer::addTrack (const float *x, int64_t numFrames, int numCh)
+{
+  assert (numCh == 1 || numCh == 2);
+  assert (numFrames >= 0);
+
+  unique_ptr < Track > track (new Track);
+  track->buffer = x;
+  track->numFrames = numFrames;
+  track->numChannels = numCh;
+  track->gain = 1;
+  track->pan = 0;
+  track->mute = false;
+  m_tracks.push_back (std::move (track));
+}
+
+int64_t
+Mixer::numFrames () const
+{
+  int64_t n = 0;
+  for (size_t i = 0; i < m_tracks.size (); i++)
+    n = std::max (n, m_tracks[i]->numFrames);
+  return n;
+}
+
+void
+Mixer::setGain (int i, float gain)
+{
+  assert (i >= 0 && i < numTracks ());
+  m_tracks[i]->gain = gain;
+}
+
+void
+Mixer::setPan (int i, float pan)
+{
+  assert (i >= 0 && i < numTracks ());
+  m_tracks[i]->pan = std::max (-1.0f, std::min (1.0f, pan));
+}
+
+void
+Mixer::setMute (int i, bool mute)
+{
+  assert (i >= 0 && i < numTracks ());
+  m_tracks[i]->mute = mute;
+}
+
+// Adds numFrames of one track, from startFrame on, to the per-channel mix buffers
+void
+Mixer::mixTrack (const Track & track, int64_t startFrame, float *const *mix,
+		 int numFrames, float *scratch) const
+{
+  if (track.mute || startFrame >= track.numFrames)
+    return;
+
+  // Samples of the track, interleaved
+  const float *x;
+  int n = (int) std::min < int64_t > (numFrames, track.numFrames - startFrame);
+  if (track.file)
+    {
+      n = track.file->read (startFrame, scratch, n);
+      x = scratch;
+    }
+  else
+    x = track.buffer + startFrame * track.numChannels;
+
+  float pan = track.pan;
+  if (track.numChannels == 1)
+    {
+      if (m_numChannels == 1)
+	mixAdd (mix[0], x, track.gain, n);
+      else
+	{
+	  float gainL, gainR;
+	  Panner::gains (PAN_CONSTANT_POWER, pan, gainL, gainR);
+	  mixAdd (mix[0], x, track.gain * gainL, n);
+	  mixAdd (mix[1], x, track.gain * gainR, n);
+	}
+    }
+  else
+    {
+      if (m_numChannels == 1)
+	mixAddDownmix (mix[0], x, 0.5f * track.gain, n);	// The average of the two channels
+      else
+	{
+	  float gainL, gainR;
+	  Panner::gains (PAN_BALANCE, pan, gainL, gainR);
+	  mixAddStereo (mix[0], mix[1], x, track.gain * gainL,
+			track.gain * gainR, n);
+	}
+    }
+}
+
+void
+Mixer::render (int64_t startFrame, float *y, int numFrames) const
+{
+  assert (startFrame >= 0 && numFrames >= 0);
+
+  vector < float >mixBuf (m_numChannels * BLOCK);
+  vector < float >scratch (2 * BLOCK);
+  float *mix[2] = { mixBuf.data (), mixBuf.data () + (m_numChannels - 1) * BLOCK };
+
+  for (int start = 0; start < numFrames; start += BLOCK)
+    {
+      int len = std::min (BLOCK, numFrames - start);
+      std::fill (mixBuf.begin (), mixBuf.end (), 0.0f);
+
+      for (size_t t = 0; t < m_tracks.size (); t++)
+	mixTrack (*m_tracks[t], startFrame + start, mix, len, scratch.data ());
+
+      interleave (mix, y + start * m_numChannels, m_numChannels, len);
+    }
+}
+
+WavStatus
+Mixer::renderToFile (const string & path, int numThreads,
+		     int bitsPerSample) const
+{
+  WavWriter writer;
+  WavStatus status = writer.open (path, m_sampleRate, m_numChannels,
+				  bitsPerSample);
+  if (status != WAV_OK)
+    return status;
+
+  int64_t total = numFrames ();
+  if (numThreads <= 0)
+    numThreads = std::max (1u, thread::hardware_concurrency ());
+  numThreads = (int) std::min < int64_t > (numThreads,
+					   (total + SEGMENT - 1) / SEGMENT);
+  numThreads = std::max (1, numThreads);
+
+  // Each pass renders into one buffer while the other, from the previous pass, is written
+  int64_t passFrames = (int64_t) numThreads * SEGMENT;
+  vector < float >buf[2];
+  buf[0].resize (passFrames * m_numChannels);
+  buf[1].resize (passFrames * m_numChannels);
+  int cur = 0;
+  int pending = 0;		// Frames rendered in the other buffer and not yet written
+
+  for (int64_t pos = 0; pos < total; pos += passFrames)
+    {
+      vector < thread > threads;
+      for (int t = 0; t < numThreads; t++)
+	{
+	  int64_t start = pos + (int64_t) t * SEGMENT;
+	  int len = (int) std::min < int64_t > (SEGMENT, total - start);
+	  if (len <= 0)
+	    break;
+	  float *out = buf[cur].data () + (int64_t) t * SEGMENT * m_numChannels;
+	  threads.push_back (thread ([=] ()
+	    {
+	      render (start, out, len);
+	    }));
+	}
+
+      if (pending > 0)
+	writer.write (buf[1 - cur].data (), pending);
+
+      for (size_t t = 0; t < threads.size (); t++)
+	threads[t].join ();
+
+      pending = (int) std::min < int64_t > (passFrames, total - pos);
+      cur = 1 - cur;
+    }
+
+  if (pending > 0)
+    writer.write (buf[1 - cur].data (), pending);
+
+  return writer.close ();
+}
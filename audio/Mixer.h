@@ -0,0 +1,103 @@
+// =================================================================================================
+// Mixer.h
+//
+// Mixes any number of audio files (or in-memory buffers) down to mono or stereo, with a
+// gain, pan and mute per track. Files are memory-mapped and mixed a block at a time, so
+// memory use doesn't grow with the length or number of the tracks. Long mixes are split
+// into time ranges that are rendered on several threads at once.
+//
+// =================================================================================================
+
+#ifndef __Mixer__
+#define __Mixer__
+
+#include "WavUtils.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class Mixer
+{
+public:
+
+	/// @param	sr		Sample rate of the mix. Every track must have the same rate.
+	/// @param	numCh	Number of output channels: 1 or 2
+	///
+	Mixer(int sr, int numCh = 2);
+
+	/// Adds a mono or stereo audio file as a track, at unity gain and centre pan
+	///
+	///	@param	path	Path to audio file to mix
+	/// @return			WAV_OK, or why the file couldn't be used. WAV_ERR_UNSUPPORTED if
+	///					its sample rate doesn't match the mix or it has more than 2 channels.
+	///
+	WavStatus addTrack(const string& path);
+
+	/// Adds a mono or stereo buffer as a track. The buffer isn't copied, and must stay
+	/// alive and unchanged while the mixer renders.
+	///
+	///	@param	x			Interleaved audio data, numCh * numFrames samples
+	/// @param	numFrames	Number of sample frames
+	/// @param	numCh		1 or 2
+	///
+	void addTrack(const float *x, int64_t numFrames, int numCh = 1);
+
+	int numTracks() const { return (int)m_tracks.size(); }
+	int numChannels() const { return m_numChannels; }
+	int sampleRate() const { return m_sampleRate; }
+
+	/// Length of the mix: the length of the longest track, muted or not
+	int64_t numFrames() const;
+
+	/// Sets a track's linear gain (1 is unity)
+	void setGain(int i, float gain);
+
+	/// Sets a track's position in a stereo mix, from -1 (full left) to +1 (full right).
+	/// Mono tracks are panned with a constant-power law, -3 dB each side at centre;
+	/// stereo tracks are balanced, turning one side down. Ignored for a mono mix.
+	void setPan(int i, float pan);
+
+	void setMute(int i, bool mute);
+
+	/// Mixes a region of all the tracks. Tracks that have ended contribute silence.
+	/// Safe to call from several threads at once, as long as no track is being changed.
+	///
+	/// @param	startFrame	First sample frame of the mix to render
+	///	@param	y			Interleaved mix, numChannels() * numFrames samples. Overwritten.
+	/// @param	numFrames	Number of sample frames
+	///
+	void render(int64_t startFrame, float *y, int numFrames) const;
+
+	/// Mixes the whole of every track into an audio file
+	///
+	///	@param	path			Path to audio file to write
+	///	@param	numThreads		Threads to render with; 0 for one per processor core
+	/// @param  bitsPerSample	As for WavWriter::open
+	/// @return					WAV_OK, or why the file couldn't be written
+	///
+	WavStatus renderToFile(const string& path, int numThreads = 0, int bitsPerSample = 16) const;
+
+private:
+
+	struct Track
+	{
+		unique_ptr<MappedWav> file;	// Set for a file track
+		const float *buffer;		// Otherwise the caller's interleaved audio
+		int64_t numFrames;
+		int numChannels;
+		float gain;
+		float pan;
+		bool mute;
+	};
+
+	int m_sampleRate;
+	int m_numChannels;
+	vector<unique_ptr<Track>> m_tracks;
+
+	void mixTrack(const Track& track, int64_t startFrame, float *const *mix, int numFrames,
+				  float *scratch) const;
+};
+
+#endif
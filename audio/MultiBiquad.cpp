@@ -0,0 +1,245 @@
+// =================================================================================================
+// MultiBiquad.cpp
+//
+// The loops use the compiler's vector extension, with one lane per channel. They are
+// compiled once for each instruction set, using target attributes, and the widest one the
+// processor supports is picked on first use; setSimdIsa can pick a narrower one.
+// Every version does the same IEEE float operations in the same order as Biquad::tick
+// (there's no fused multiply-add), so all of them match it exactly.
+//
+// Non-interleaved audio is interleaved a tile at a time, 4x4 blocks of samples being
+// transposed in registers, filtered, and transposed back.
+// =================================================================================================
+
+#include "MultiBiquad.h"
+#include "SimdIsa.h"
+#include <algorithm>
+#include <cstring>
+
+// AVX-512 includes fused multiply-add, which would change the rounding
+#pragma GCC optimize ("fp-contract=off")
+
+// N floats in the compiler's vector extension. vector_size can't depend on a template
+// parameter, hence a specialization per width.
+template < int N > struct LaneVec;
+template <> struct LaneVec <4 >
+{
+  typedef float Type __attribute__ ((vector_size (16)));
+};
+template <> struct LaneVec <8 >
+{
+  typedef float Type __attribute__ ((vector_size (32)));
+};
+template <> struct LaneVec <16 >
+{
+  typedef float Type __attribute__ ((vector_size (64)));
+};
+
+typedef LaneVec < 4 >::Type Vec4;
+typedef int Mask4 __attribute__ ((vector_size (16)));
+
+// Frames per tile of non-interleaved audio
+static const int TILE_FRAMES = 32;
+
+// The filter loop over interleaved audio. Vec is N floats, which the compiler maps onto as
+// many registers of the target's width as it takes.
+template < int N >
+static inline __attribute__ ((always_inline)) void
+runLanes (float *x, int n, const float (*coeffs)[N], float (*state)[N])
+{
+  typedef typename LaneVec < N >::Type Vec;
+
+  Vec b0, b1, b2, a1, a2, v1, v2;
+  memcpy (&b0, coeffs[0], sizeof (Vec));
+  memcpy (&b1, coeffs[1], sizeof (Vec));
+  memcpy (&b2, coeffs[2], sizeof (Vec));
+  memcpy (&a1, coeffs[3], sizeof (Vec));
+  memcpy (&a2, coeffs[4], sizeof (Vec));
+  memcpy (&v1, state[0], sizeof (Vec));
+  memcpy (&v2, state[1], sizeof (Vec));
+
+  for (int i = 0; i < n; i++, x += N)
+    {
+      Vec in;
+      memcpy (&in, x, sizeof (Vec));
+
+      Vec v = in - a1 * v1 - a2 * v2;
+      Vec out = b0 * v + b1 * v1 + b2 * v2;
+      v2 = v1;
+      v1 = v;
+
+      memcpy (x, &out, sizeof (Vec));
+    }
+
+  memcpy (state[0], &v1, sizeof (Vec));
+  memcpy (state[1], &v2, sizeof (Vec));
+}
+
+// Transposes a 4x4 block: r[k] element j becomes r[j] element k
+static inline __attribute__ ((always_inline)) void
+transpose4 (Vec4 & r0, Vec4 & r1, Vec4 & r2, Vec4 & r3)
+{
+  const Mask4 lo = { 0, 4, 1, 5 }, hi = { 2, 6, 3, 7 };
+  const Mask4 lo2 = { 0, 1, 4, 5 }, hi2 = { 2, 3, 6, 7 };
+
+  Vec4 t0 = __builtin_shuffle (r0, r1, lo);
+  Vec4 t1 = __builtin_shuffle (r0, r1, hi);
+  Vec4 t2 = __builtin_shuffle (r2, r3, lo);
+  Vec4 t3 = __builtin_shuffle (r2, r3, hi);
+
+  r0 = __builtin_shuffle (t0, t2, lo2);
+  r1 = __builtin_shuffle (t0, t2, hi2);
+  r2 = __builtin_shuffle (t1, t3, lo2);
+  r3 = __builtin_shuffle (t1, t3, hi2);
+}
+
+template < bool TO_TILE >
+static inline __attribute__ ((always_inline)) void
+copySample (float *split, float *tile)
+{
+  if (TO_TILE)
+    *tile = *split;
+  else
+    *split = *tile;
+}
+
+// Copies len frames of channels [0, numCh) between split buffers and an interleaved tile
+// with N lanes per frame. Whole groups of 4 channels and 4 frames go through transpose4.
+template < int N, bool TO_TILE >
+static inline __attribute__ ((always_inline)) void
+copyTile (float *const *split, int offset, float *tile, int numCh, int len)
+{
+  int ch = 0;
+  for (; ch + 4 <= numCh; ch += 4)
+    {
+      float *s0 = split[ch] + offset;
+      float *s1 = split[ch + 1] + offset;
+      float *s2 = split[ch + 2] + offset;
+      float *s3 = split[ch + 3] + offset;
+
+      int i = 0;
+      for (; i + 4 <= len; i += 4)
+	{
+	  float *t = tile + i * N + ch;
+	  Vec4 r0, r1, r2, r3;
+	  if (TO_TILE)
+	    {
+	      memcpy (&r0, s0 + i, sizeof (Vec4));
+	      memcpy (&r1, s1 + i, sizeof (Vec4));
+	      memcpy (&r2, s2 + i, sizeof (Vec4));
+	      memcpy (&r3, s3 + i, sizeof (Vec4));
+	      transpose4 (r0, r1, r2, r3);
+	      memcpy (t, &r0, sizeof (Vec4));
+	      memcpy (t + N, &r1, sizeof (Vec4));
+	      memcpy (t + 2 * N, &r2, sizeof (Vec4));
+	      memcpy (t + 3 * N, &r3, sizeof (Vec4));
+	    }
+	  else
+	    {
+	      memcpy (&r0, t, sizeof (Vec4));
+	      memcpy (&r1, t + N, sizeof (Vec4));
+	      memcpy (&r2, t + 2 * N, sizeof (Vec4));
+	      memcpy (&r3, t + 3 * N, sizeof (Vec4));
+	      transpose4 (r0, r1, r2, r3);
+	      memcpy (s0 + i, &r0, sizeof (Vec4));
+	      memcpy (s1 + i, &r1, sizeof (Vec4));
+	      memcpy (s2 + i, &r2, sizeof (Vec4));
+	      memcpy (s3 + i, &r3, sizeof (Vec4));
+	    }
+	}
+
+      for (; i < len; i++)
+	for (int k = 0; k < 4; k++)
+	  copySample < TO_TILE > (split[ch + k] + offset + i,
+				  tile + i * N + ch + k);
+    }
+
+  for (; ch < numCh; ch++)
+    for (int i = 0; i < len; i++)
+      copySample < TO_TILE > (split[ch] + offset + i, tile + i * N + ch);
+}
+
+// The filter loop over non-interleaved audio
+template < int N >
+static inline __attribute__ ((always_inline)) void
+runSplit (const float *const *x, float *const *y, int numCh, int n,
+	  const float (*coeffs)[N], float (*state)[N])
+{
+  // Spare lanes filter silence
+  float tile[TILE_FRAMES * N] = { };
+
+  for (int start = 0; start < n; start += TILE_FRAMES)
+    {
+      int len = std::min (TILE_FRAMES, n - start);
+      copyTile < N, true > ((float *const *) x, start, tile, numCh, len);
+      runLanes < N > (tile, len, coeffs, state);
+      copyTile < N, false > (y, start, tile, numCh, len);
+    }
+}
+
+#define MULTI_BIQUAD_VERSION(suffix, target) \
+template < int N > target static void \
+runLanes##suffix (float *x, int n, const float (*coeffs)[N], float (*state)[N]) \
+{ \
+  runLanes < N > (x, n, coeffs, state); \
+} \
+template < int N > target static void \
+runSplit##suffix (const float *const *x, float *const *y, int numCh, int n, \
+		  const float (*coeffs)[N], float (*state)[N]) \
+{ \
+  runSplit < N > (x, y, numCh, n, coeffs, state); \
+}
+
+MULTI_BIQUAD_VERSION (Default,)
+#ifdef SIMD_ISA_X86
+MULTI_BIQUAD_VERSION (Avx2, __attribute__ ((target ("avx2"))))
+MULTI_BIQUAD_VERSION (Avx512, __attribute__ ((target ("avx512f"))))
+#endif
+
+template < int N > struct MultiBiquadKernels
+{
+  void (*interleaved) (float *, int, const float (*)[N], float (*)[N]);
+  void (*split) (const float *const *, float *const *, int, int,
+		 const float (*)[N], float (*)[N]);
+};
+
+template < int N >
+static MultiBiquadKernels < N >
+kernels ()
+{
+  switch (simdIsa ())
+    {
+#ifdef SIMD_ISA_X86
+    case SIMD_ISA_AVX512:
+      return MultiBiquadKernels < N > { runLanesAvx512 < N >, runSplitAvx512 < N > };
+    case SIMD_ISA_AVX2:
+      return MultiBiquadKernels < N > { runLanesAvx2 < N >, runSplitAvx2 < N > };
+#endif
+    default:
+      return MultiBiquadKernels < N > { runLanesDefault < N >, runSplitDefault < N > };
+    }
+}
+
+template < int N >
+void
+multiBiquadRun (float *x, int n, const float (*coeffs)[N], float (*state)[N])
+{
+  kernels < N > ().interleaved (x, n, coeffs, state);
+}
+
+template < int N >
+void
+multiBiquadRun (const float *const *x, float *const *y, int numCh, int n,
+		const float (*coeffs)[N], float (*state)[N])
+{
+  kernels < N > ().split (x, y, numCh, n, coeffs, state);
+}
+
+#define MULTI_BIQUAD_INSTANTIATE(N) \
+template void multiBiquadRun < N > (float *, int, const float (*)[N], float (*)[N]); \
+template void multiBiquadRun < N > (const float *const *, float *const *, int, int, \
+				    const float (*)[N], float (*)[N]);
+
+MULTI_BIQUAD_INSTANTIATE (4)
+MULTI_BIQUAD_INSTANTIATE (8)
+MULTI_BIQUAD_INSTANTIATE (16)
@@ -0,0 +1,127 @@
+// =================================================================================================
+// MultiBiquad.h
+//
+// A biquad filter for N channels at once. One channel's biquad is a recurrence, so it can't
+// be vectorized along time; instead each channel gets a SIMD lane, and the N recurrences
+// advance in lockstep, one sample frame per step. N is 4, 8 or 16, i.e. one SSE, AVX or
+// AVX-512 register of floats. The class's process functions flush denormals to zero while
+// they run (see DenormalGuard.h); multiBiquadRun on its own leaves that to the caller.
+//
+// =================================================================================================
+
+#ifndef __MultiBiquad__
+#define __MultiBiquad__
+
+#include "Biquad.h"
+#include <cassert>
+#include <algorithm>
+
+/// Filters n frames of N-channel interleaved audio in place, using the instruction set
+/// simdIsa() allows (see SimdIsa.h). The result is the same as Biquad::tick on each channel.
+///
+///	@param	x		Audio data, N * n samples
+/// @param	n		Number of sample frames
+///	@param	coeffs	b0, b1, b2, a1, a2, each for N channels
+///	@param	state	v1 and v2, each for N channels. Updated.
+///
+template <int N>
+void multiBiquadRun(float *x, int n, const float (*coeffs)[N], float (*state)[N]);
+
+/// Filters n frames of non-interleaved audio, up to N channels. x and y may be the same.
+template <int N>
+void multiBiquadRun(const float *const *x, float *const *y, int numCh, int n,
+					const float (*coeffs)[N], float (*state)[N]);
+
+template <int N>
+class MultiBiquad
+{
+	static_assert(N == 4 || N == 8 || N == 16, "MultiBiquad has 4, 8 or 16 lanes");
+
+public:
+
+	/// Starts out passing audio unchanged
+	MultiBiquad(float sr) : m_sr(sr)
+	{
+		for (int ch = 0; ch < N; ch++)
+		{
+			m_coeffs[0][ch] = 1;
+			for (int c = 1; c < 5; c++)
+				m_coeffs[c][ch] = 0;
+		}
+		clear();
+	}
+
+	// The same filter on every channel; see Biquad for the parameters
+	void initLPF(float f0, float q = M_SQRT1_2)					{ Biquad b(m_sr); b.initLPF(f0, q); setCoefficients(b); }
+	void initHPF(float f0, float q = M_SQRT1_2)					{ Biquad b(m_sr); b.initHPF(f0, q); setCoefficients(b); }
+	void initBPF(float f0, float g = 1, float q = M_SQRT1_2)	{ Biquad b(m_sr); b.initBPF(f0, g, q); setCoefficients(b); }
+	void initNotch(float f0, float q = M_SQRT1_2)				{ Biquad b(m_sr); b.initNotch(f0, q); setCoefficients(b); }
+
+	/// Copies a Biquad's coefficients to every channel
+	void setCoefficients(const Biquad& filter)
+	{
+		for (int ch = 0; ch < N; ch++)
+			setCoefficients(ch, filter);
+	}
+
+	/// Copies a Biquad's coefficients to one channel, so channels can be filtered differently
+	void setCoefficients(int ch, const Biquad& filter)
+	{
+		assert(ch >= 0 && ch < N);
+		filter.getCoefficients(m_coeffs[0][ch], m_coeffs[1][ch], m_coeffs[2][ch],
+							   m_coeffs[3][ch], m_coeffs[4][ch]);
+	}
+
+	/// Sets one channel's normalized coefficients directly, for designs Biquad doesn't have
+	void setCoefficients(int ch, float b0, float b1, float b2, float a1, float a2)
+	{
+		assert(ch >= 0 && ch < N);
+		m_coeffs[0][ch] = b0;
+		m_coeffs[1][ch] = b1;
+		m_coeffs[2][ch] = b2;
+		m_coeffs[3][ch] = a1;
+		m_coeffs[4][ch] = a2;
+	}
+
+	void clear()
+	{
+		std::fill(&m_state[0][0], &m_state[0][0] + 2 * N, 0.0f);
+	}
+
+	/// Filters N-channel interleaved audio. x and y may be the same buffer.
+	///
+	///	@param	x	Audio data, N * n samples
+	///	@param	y	Filtered audio, N * n samples
+	/// @param	n	Number of sample frames
+	///
+	void processInterleaved(const float *x, float *y, int n)
+	{
+		DenormalGuard guard;
+		if (y != x)
+			std::copy(x, x + N * n, y);
+		multiBiquadRun<N>(y, n, m_coeffs, m_state);
+	}
+
+	/// Filters non-interleaved audio, e.g. from audioRead into vector<vector<float>>.
+	/// x and y may be the same buffers.
+	///
+	///	@param	x		numCh buffers of n samples
+	///	@param	y		numCh buffers of n filtered samples
+	/// @param	numCh	Number of channels, up to N. Any spare lanes filter silence.
+	/// @param	n		Number of sample frames
+	///
+	void process(const float *const *x, float *const *y, int numCh, int n)
+	{
+		assert(numCh > 0 && numCh <= N);
+		DenormalGuard guard;
+		multiBiquadRun<N>(x, y, numCh, n, m_coeffs, m_state);
+	}
+
+private:
+
+	float m_sr;
+	float m_coeffs[5][N];	// b0, b1, b2, a1, a2 for each channel
+	float m_state[2][N];	// v1, v2 for each channel
+};
+
+#endif
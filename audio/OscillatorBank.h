@@ -0,0 +1,83 @@
+// =================================================================================================
+// OscillatorBank.h
+//
+// A bank of sine partials (or wavetable oscillators) summed into one output, for additive
+// synthesis and test signals. Each partial's phase is kept as a 64-bit fixed-point fraction
+// of a cycle, so it stays exact however long the signal runs; the generators only have to
+// be accurate over one short block, after which they are re-seeded from the exact phase.
+//
+// =================================================================================================
+
+#ifndef __OscillatorBank__
+#define __OscillatorBank__
+
+#include <vector>
+#include <cstdint>
+
+using namespace std;
+
+/// How the partials are generated
+enum OscillatorMode
+{
+	OSC_PHASOR,		// Sine by a rotating complex phasor, 8 samples at a time. The most accurate:
+					// within 2e-6 of the exact sine.
+	OSC_WAVETABLE	// Any single-cycle waveform from a table, with linear interpolation
+};
+
+class OscillatorBank
+{
+public:
+
+	/// @param	sr		Sample rate (e.g. 44100)
+	///	@param	mode	How the partials are generated
+	///
+	OscillatorBank(double sr, OscillatorMode mode = OSC_PHASOR);
+
+	/// Adds a partial
+	///
+	///	@param	freq	Frequency in Hz
+	///	@param	amp		Peak amplitude
+	///	@param	phase	Starting phase in cycles; 0 starts a sine at zero
+	/// @return			Index of the partial, for setFrequency and setAmplitude
+	///
+	int addPartial(double freq, float amp, double phase = 0);
+
+	int numPartials() const { return (int)m_amp.size(); }
+
+	/// Changes a partial's frequency from the next sample on, without a phase jump
+	void setFrequency(int i, double freq);
+	void setAmplitude(int i, float amp);
+
+	/// Sets the waveform for OSC_WAVETABLE mode. The default is a sine.
+	///
+	///	@param	cycle	One cycle of the waveform; the length must be a power of 2
+	///
+	void setWavetable(const vector<float>& cycle);
+
+	/// Puts every partial back to its starting phase
+	void reset();
+
+	/// Renders the next block: the sum of all the partials
+	///
+	///	@param	x	Audio data, n samples. Overwritten.
+	/// @param	n	Number of samples
+	///
+	void render(float *x, int n);
+
+private:
+
+	double m_sr;					// Sample rate
+	OscillatorMode m_mode;
+	vector<uint64_t> m_phase;		// Phase of each partial; 2^64 is one cycle
+	vector<uint64_t> m_startPhase;
+	vector<uint64_t> m_increment;	// Phase advance per sample
+	vector<float> m_amp;
+	vector<float> m_table;			// Wavetable plus one guard sample
+	int m_tableBits;				// log2 of the wavetable length
+
+	uint64_t increment(double freq) const;
+	void renderPhasor(int p, float *x, int n);
+	void renderWavetable(int p, float *x, int n);
+};
+
+#endif
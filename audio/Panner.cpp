@@ -0,0 +1,201 @@
+// =================================================================================================
+// Panner.cpp
+//
+// An SSE register holds two frames of interleaved stereo, L R L R, so one multiply by
+// gL gR gL gR applies both gains to both frames, with no shuffling. A mono input is
+// spread to that layout with two shuffles per four samples. While a glide is running, the
+// gains of frame j of the glide are the starting gains plus (j + 1) steps, computed from
+// the frame index rather than accumulated, so no error builds up along a long ramp.
+// =================================================================================================
+
+#include "Panner.h"
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+typedef float Vec4 __attribute__ ((vector_size (16)));
+typedef int Mask4 __attribute__ ((vector_size (16)));
+
+// Interleaved stereo y = x times the gains, for n frames. With RAMP, frame i has gains
+// gL + (i + 1) dL and gR + (i + 1) dR; without, gL and gR.
+template < bool RAMP > static void
+scaleStereo (const float *x, float *y, int n, float gL, float gR, float dL,
+	     float dR)
+{
+  const Vec4 base = { gL, gR, gL, gR };
+  const Vec4 step = { dL, dR, dL, dR };
+  const Vec4 two = { 2, 2, 2, 2 };
+  const Vec4 four = { 4, 4, 4, 4 };
+  Vec4 t = { 1, 1, 2, 2 };
+
+  // Four frames at a time, so that the count t isn't waited on every vector
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+      Vec4 a, b;
+      memcpy (&a, x + 2 * i, sizeof (Vec4));
+      memcpy (&b, x + 2 * i + 4, sizeof (Vec4));
+      a *= RAMP ? base + t * step : base;
+      b *= RAMP ? base + (t + two) * step : base;
+      memcpy (y + 2 * i, &a, sizeof (Vec4));
+      memcpy (y + 2 * i + 4, &b, sizeof (Vec4));
+      t += four;
+    }
+  for (; i < n; i++)
+    {
+      y[2 * i] = (RAMP ? gL + (i + 1) * dL : gL) * x[2 * i];
+      y[2 * i + 1] = (RAMP ? gR + (i + 1) * dR : gR) * x[2 * i + 1];
+    }
+}
+
+// Interleaved stereo y = mono x times the gains, as above
+template < bool RAMP > static void
+panMono (const float *x, float *y, int n, float gL, float gR, float dL,
+	 float dR)
+{
+  const Mask4 firstPair = { 0, 0, 1, 1 };
+  const Mask4 secondPair = { 2, 2, 3, 3 };
+  const Vec4 base = { gL, gR, gL, gR };
+  const Vec4 step = { dL, dR, dL, dR };
+  const Vec4 two = { 2, 2, 2, 2 };
+  const Vec4 four = { 4, 4, 4, 4 };
+  Vec4 t = { 1, 1, 2, 2 };
+
+  int i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+      Vec4 m;
+      memcpy (&m, x + i, sizeof (Vec4));
+      Vec4 lo = __builtin_shuffle (m, firstPair);
+      Vec4 hi = __builtin_shuffle (m, secondPair);
+      lo *= RAMP ? base + t * step : base;
+      hi *= RAMP ? base + (t + two) * step : base;
+      t += four;
+      memcpy (y + 2 * i, &lo, sizeof (Vec4));
+      memcpy (y + 2 * i + 4, &hi, sizeof (Vec4));
+    }
+  for (; i < n; i++)
+    {
+      y[2 * i] = (RAMP ? gL + (i + 1) * dL : gL) * x[i];
+      y[2 * i + 1] = (RAMP ? gR + (i + 1) * dR : gR) * x[i];
+    }
+}
+
+// One channel: y = x times g, or g + (i + 1) d with RAMP
+template < bool RAMP > static void
+scaleChannel (const float *x, float *y, int n, float g, float d)
+{
+  for (int i = 0; i < n; i++)
+    y[i] = (RAMP ? g + (i + 1) * d : g) * x[i];
+}
+
+Panner::Panner (PanLaw law, float pan):
+m_law (law), m_rampLength (0), m_rampRemaining (0)
+{
+  m_pan = std::max (-1.0f, std::min (1.0f, pan));
+  gains (law, m_pan, m_gainL, m_gainR);
+  m_targetL = m_gainL;
+  m_targetR = m_gainR;
+  m_stepL = 0;
+  m_stepR = 0;
+}
+
+void
+Panner::gains (PanLaw law, float pan, float &gainL, float &gainR)
+{
+  pan = std::max (-1.0f, std::min (1.0f, pan));
+  switch (law)
+    {
+    case PAN_CONSTANT_POWER:
+      {
+	float angle = (pan + 1) * (float) M_PI_4;
+	gainL = cos (angle);
+	gainR = sin (angle);
+	break;
+      }
+    case PAN_LINEAR:
+      gainL = 0.5f * (1 - pan);
+      gainR = 0.5f * (1 + pan);
+      break;
+    case PAN_BALANCE:
+      gainL = pan < 0 ? 1 : 1 - pan;
+      gainR = pan > 0 ? 1 : 1 + pan;
+      break;
+    }
+}
+
+void
+Panner::setPan (float pan)
+{
+  m_pan = std::max (-1.0f, std::min (1.0f, pan));
+  gains (m_law, m_pan, m_targetL, m_targetR);
+
+  if (m_rampLength > 0)
+    {
+      m_stepL = (m_targetL - m_gainL) / m_rampLength;
+      m_stepR = (m_targetR - m_gainR) / m_rampLength;
+      m_rampRemaining = m_rampLength;
+    }
+  else
+    {
+      m_gainL = m_targetL;
+      m_gainR = m_targetR;
+      m_rampRemaining = 0;
+    }
+}
+
+// Frames of the next n that are still gliding
+int
+Panner::rampFrames (int n) const
+{
+  return std::min (n, m_rampRemaining);
+}
+
+void
+Panner::advanceRamp (int numFrames)
+{
+  // Measured back from the target, so the gains don't drift however the glide is split
+  // into blocks
+  m_rampRemaining -= numFrames;
+  m_gainL = m_targetL - m_rampRemaining * m_stepL;
+  m_gainR = m_targetR - m_rampRemaining * m_stepR;
+}
+
+void
+Panner::processMono (const float *x, float *y, int n)
+{
+  int r = rampFrames (n);
+  if (r > 0)
+    {
+      panMono < true > (x, y, r, m_gainL, m_gainR, m_stepL, m_stepR);
+      advanceRamp (r);
+    }
+  panMono < false > (x + r, y + 2 * r, n - r, m_gainL, m_gainR, 0, 0);
+}
+
+void
+Panner::processStereo (const float *x, float *y, int n)
+{
+  int r = rampFrames (n);
+  if (r > 0)
+    {
+      scaleStereo < true > (x, y, r, m_gainL, m_gainR, m_stepL, m_stepR);
+      advanceRamp (r);
+    }
+  scaleStereo < false > (x + 2 * r, y + 2 * r, n - r, m_gainL, m_gainR, 0,
+			 0);
+}
+
+void
+Panner::processStereo (const float *const *x, float *const *y, int n)
+{
+  int r = rampFrames (n);
+  if (r > 0)
+    {
+      scaleChannel < true > (x[0], y[0], r, m_gainL, m_stepL);
+      scaleChannel < true > (x[1], y[1], r, m_gainR, m_stepR);
+      advanceRamp (r);
+    }
+  scaleChannel < false > (x[0] + r, y[0] + r, n - r, m_gainL, 0);
+  scaleChannel < false > (x[1] + r, y[1] + r, n - r, m_gainR, 0);
+}
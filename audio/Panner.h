@@ -0,0 +1,82 @@
+// =================================================================================================
+// Panner.h
+//
+// Places audio in the stereo field: pans a mono signal into stereo, or balances a stereo
+// signal. Works directly on interleaved audio as read from and written to wav files, so
+// the channels don't have to be split apart and merged again. A change of position glides
+// to the new gains over a ramp, rather than jumping, which would click.
+//
+// =================================================================================================
+
+#ifndef __Panner__
+#define __Panner__
+
+/// How the left and right gains follow the pan position
+enum PanLaw
+{
+	PAN_CONSTANT_POWER,	// cos and sin of the position; -3 dB each side at centre, so the loudness holds
+	PAN_LINEAR,			// The gains sum to 1; -6 dB each side at centre
+	PAN_BALANCE			// Unity at centre, and the side away from the position turns down linearly
+};
+
+class Panner
+{
+public:
+
+	/// @param	law		How the gains follow the position
+	/// @param	pan		Position, from -1 (full left) to +1 (full right)
+	///
+	Panner(PanLaw law = PAN_CONSTANT_POWER, float pan = 0);
+
+	/// The left and right gains of a law at a position from -1 to +1
+	static void gains(PanLaw law, float pan, float& gainL, float& gainR);
+
+	/// Moves to a new position, gliding there over the ramp length
+	void setPan(float pan);
+	float pan() const { return m_pan; }
+
+	/// Samples a change of position glides over. 0 (the default) jumps.
+	void setRampLength(int numSamples) { m_rampLength = numSamples; }
+
+	/// Pans mono audio into stereo
+	///
+	///	@param	x	Mono input, n samples
+	///	@param	y	Interleaved stereo output, 2 * n samples
+	/// @param	n	Number of sample frames
+	///
+	void processMono(const float *x, float *y, int n);
+
+	/// Applies the gains to interleaved stereo audio
+	///
+	///	@param	x	Interleaved stereo input, 2 * n samples
+	///	@param	y	Interleaved stereo output. May be the same as x.
+	/// @param	n	Number of sample frames
+	///
+	void processStereo(const float *x, float *y, int n);
+
+	/// Applies the gains to non-interleaved stereo audio
+	///
+	///	@param	x	Left and right input, n samples each
+	///	@param	y	Left and right output. May be the same as x.
+	/// @param	n	Number of sample frames
+	///
+	void processStereo(const float *const *x, float *const *y, int n);
+
+private:
+
+	PanLaw m_law;
+	float m_pan;
+	int m_rampLength;
+	float m_gainL;			// Gains now
+	float m_gainR;
+	float m_targetL;		// Gains being glided to
+	float m_targetR;
+	float m_stepL;			// Change per sample frame while gliding
+	float m_stepR;
+	int m_rampRemaining;	// Sample frames left in the current glide
+
+	int rampFrames(int n) const;
+	void advanceRamp(int numFrames);
+};
+
+#endif
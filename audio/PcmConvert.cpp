@@ -0,0 +1,349 @@
+// =================================================================================================
+// PcmConvert.cpp
+//
+// The scalar kernels define the results: integer samples are scaled by 1/2^(bits-1), and
+// floats are clipped to [-1, 1], scaled by 32767 and truncated towards zero. The SIMD
+// kernels produce exactly the same values, just several samples at a time. Each SIMD
+// kernel handles whole vectors and leaves the remainder to the scalar kernel.
+//
+// The AVX2 kernels are compiled with a target attribute rather than -mavx2, so the rest
+// of the program still runs on processors without AVX2.
+// =================================================================================================
+
+#include "PcmConvert.h"
+#include "SimdIsa.h"
+#include <algorithm>
+#include <climits>
+
+#ifdef SIMD_ISA_X86
+#include <immintrin.h>
+#endif
+
+using namespace std;
+
+
+// -- Scalar kernels --
+
+static void
+pcm8ToFloatScalar (const uint8_t * src, float *dst, size_t n)
+{
+  const float scale = 1.0f / 128;
+  for (size_t i = 0; i < n; i++)
+    dst[i] = scale * ((int) src[i] - 128);
+}
+
+static void
+pcm16ToFloatScalar (const int16_t * src, float *dst, size_t n)
+{
+  const float scale = 1.0f / 32768;
+  for (size_t i = 0; i < n; i++)
+    dst[i] = scale * src[i];
+}
+
+static void
+pcm24ToFloatScalar (const uint8_t * src, float *dst, size_t n)
+{
+  const float scale = 1.0f / 8388608;
+  for (size_t i = 0; i < n; i++, src += 3)
+    {
+      // Assemble in the upper 3 bytes, then shift down to sign-extend
+      int32_t sample = (int32_t) ((uint32_t) src[0] << 8 |
+				  (uint32_t) src[1] << 16 |
+				  (uint32_t) src[2] << 24) >> 8;
+      dst[i] = scale * sample;
+    }
+}
+
+static void
+pcm32ToFloatScalar (const int32_t * src, float *dst, size_t n)
+{
+  const float scale = 1.0f / 2147483648.0f;
+  for (size_t i = 0; i < n; i++)
+    dst[i] = scale * src[i];
+}
+
+static void
+floatToPcm16Scalar (const float *src, int16_t * dst, size_t n)
+{
+  for (size_t i = 0; i < n; i++)
+    {
+      float flt = src[i];
+      flt = std::min < float >(flt, 1.0);
+      flt = std::max < float >(flt, -1.0);
+      dst[i] = SHRT_MAX * flt;
+    }
+}
+
+
+#ifdef SIMD_ISA_X86
+
+// -- SSE2 kernels --
+
+static void
+pcm8ToFloatSse2 (const uint8_t * src, float *dst, size_t n)
+{
+  const __m128 scale = _mm_set1_ps (1.0f / 128);
+  const __m128i bias = _mm_set1_epi32 (128);
+  const __m128i zero = _mm_setzero_si128 ();
+
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (src + i));
+      __m128i lo = _mm_unpacklo_epi8 (v, zero);
+      __m128i hi = _mm_unpackhi_epi8 (v, zero);
+      __m128i q0 = _mm_sub_epi32 (_mm_unpacklo_epi16 (lo, zero), bias);
+      __m128i q1 = _mm_sub_epi32 (_mm_unpackhi_epi16 (lo, zero), bias);
+      __m128i q2 = _mm_sub_epi32 (_mm_unpacklo_epi16 (hi, zero), bias);
+      __m128i q3 = _mm_sub_epi32 (_mm_unpackhi_epi16 (hi, zero), bias);
+      _mm_storeu_ps (dst + i, _mm_mul_ps (_mm_cvtepi32_ps (q0), scale));
+      _mm_storeu_ps (dst + i + 4, _mm_mul_ps (_mm_cvtepi32_ps (q1), scale));
+      _mm_storeu_ps (dst + i + 8, _mm_mul_ps (_mm_cvtepi32_ps (q2), scale));
+      _mm_storeu_ps (dst + i + 12, _mm_mul_ps (_mm_cvtepi32_ps (q3), scale));
+    }
+  pcm8ToFloatScalar (src + i, dst + i, n - i);
+}
+
+static void
+pcm16ToFloatSse2 (const int16_t * src, float *dst, size_t n)
+{
+  const __m128 scale = _mm_set1_ps (1.0f / 32768);
+
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (src + i));
+
+      // Put each sample in the upper half of a 32-bit lane, then shift down to sign-extend
+      __m128i lo = _mm_srai_epi32 (_mm_unpacklo_epi16 (v, v), 16);
+      __m128i hi = _mm_srai_epi32 (_mm_unpackhi_epi16 (v, v), 16);
+      _mm_storeu_ps (dst + i, _mm_mul_ps (_mm_cvtepi32_ps (lo), scale));
+      _mm_storeu_ps (dst + i + 4, _mm_mul_ps (_mm_cvtepi32_ps (hi), scale));
+    }
+  pcm16ToFloatScalar (src + i, dst + i, n - i);
+}
+
+static void
+pcm32ToFloatSse2 (const int32_t * src, float *dst, size_t n)
+{
+  const __m128 scale = _mm_set1_ps (1.0f / 2147483648.0f);
+
+  size_t i = 0;
+  for (; i + 4 <= n; i += 4)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (src + i));
+      _mm_storeu_ps (dst + i, _mm_mul_ps (_mm_cvtepi32_ps (v), scale));
+    }
+  pcm32ToFloatScalar (src + i, dst + i, n - i);
+}
+
+static void
+floatToPcm16Sse2 (const float *src, int16_t * dst, size_t n)
+{
+  const __m128 lo = _mm_set1_ps (-1.0f);
+  const __m128 hi = _mm_set1_ps (1.0f);
+  const __m128 scale = _mm_set1_ps (SHRT_MAX);
+
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+      __m128 a = _mm_loadu_ps (src + i);
+      __m128 b = _mm_loadu_ps (src + i + 4);
+      a = _mm_mul_ps (_mm_max_ps (_mm_min_ps (a, hi), lo), scale);
+      b = _mm_mul_ps (_mm_max_ps (_mm_min_ps (b, hi), lo), scale);
+
+      // Truncate like the scalar conversion does, then pack with saturation
+      __m128i packed = _mm_packs_epi32 (_mm_cvttps_epi32 (a),
+					_mm_cvttps_epi32 (b));
+      _mm_storeu_si128 ((__m128i *) (dst + i), packed);
+    }
+  floatToPcm16Scalar (src + i, dst + i, n - i);
+}
+
+
+// -- AVX2 kernels --
+
+__attribute__ ((target ("avx2")))
+static void
+pcm8ToFloatAvx2 (const uint8_t * src, float *dst, size_t n)
+{
+  const __m256 scale = _mm256_set1_ps (1.0f / 128);
+  const __m256i bias = _mm256_set1_epi32 (128);
+
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+    {
+      __m128i v = _mm_loadu_si128 ((const __m128i *) (src + i));
+      __m256i q0 = _mm256_sub_epi32 (_mm256_cvtepu8_epi32 (v), bias);
+      __m256i q1 =
+	_mm256_sub_epi32 (_mm256_cvtepu8_epi32 (_mm_srli_si128 (v, 8)), bias);
+      _mm256_storeu_ps (dst + i, _mm256_mul_ps (_mm256_cvtepi32_ps (q0), scale));
+      _mm256_storeu_ps (dst + i + 8,
+			_mm256_mul_ps (_mm256_cvtepi32_ps (q1), scale));
+    }
+  pcm8ToFloatScalar (src + i, dst + i, n - i);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+pcm16ToFloatAvx2 (const int16_t * src, float *dst, size_t n)
+{
+  const __m256 scale = _mm256_set1_ps (1.0f / 32768);
+
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+    {
+      __m128i a = _mm_loadu_si128 ((const __m128i *) (src + i));
+      __m128i b = _mm_loadu_si128 ((const __m128i *) (src + i + 8));
+      _mm256_storeu_ps (dst + i,
+			_mm256_mul_ps (_mm256_cvtepi32_ps
+				       (_mm256_cvtepi16_epi32 (a)), scale));
+      _mm256_storeu_ps (dst + i + 8,
+			_mm256_mul_ps (_mm256_cvtepi32_ps
+				       (_mm256_cvtepi16_epi32 (b)), scale));
+    }
+  pcm16ToFloatScalar (src + i, dst + i, n - i);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+pcm24ToFloatAvx2 (const uint8_t * src, float *dst, size_t n)
+{
+  const __m256 scale = _mm256_set1_ps (1.0f / 8388608);
+
+  // Bytes 0-15 go to the low lane and bytes 12-27 to the high lane, so that
+  // each lane starts with four whole 3-byte samples.
+  const __m256i spread = _mm256_setr_epi32 (0, 1, 2, 3, 3, 4, 5, 6);
+
+  // Within each lane, move sample j's bytes to the top 3 bytes of 32-bit lane j
+  const __m256i shuffle = _mm256_setr_epi8 (-1, 0, 1, 2, -1, 3, 4, 5,
+					    -1, 6, 7, 8, -1, 9, 10, 11,
+					    -1, 0, 1, 2, -1, 3, 4, 5,
+					    -1, 6, 7, 8, -1, 9, 10, 11);
+
+  // The 32-byte load reads 8 bytes past the 8 samples, so stop while that's still in range
+  size_t i = 0;
+  for (; i + 11 <= n; i += 8)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) (src + 3 * i));
+      v = _mm256_permutevar8x32_epi32 (v, spread);
+      v = _mm256_srai_epi32 (_mm256_shuffle_epi8 (v, shuffle), 8);
+      _mm256_storeu_ps (dst + i, _mm256_mul_ps (_mm256_cvtepi32_ps (v), scale));
+    }
+  pcm24ToFloatScalar (src + 3 * i, dst + i, n - i);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+pcm32ToFloatAvx2 (const int32_t * src, float *dst, size_t n)
+{
+  const __m256 scale = _mm256_set1_ps (1.0f / 2147483648.0f);
+
+  size_t i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+      __m256i v = _mm256_loadu_si256 ((const __m256i *) (src + i));
+      _mm256_storeu_ps (dst + i, _mm256_mul_ps (_mm256_cvtepi32_ps (v), scale));
+    }
+  pcm32ToFloatScalar (src + i, dst + i, n - i);
+}
+
+__attribute__ ((target ("avx2")))
+static void
+floatToPcm16Avx2 (const float *src, int16_t * dst, size_t n)
+{
+  const __m256 lo = _mm256_set1_ps (-1.0f);
+  const __m256 hi = _mm256_set1_ps (1.0f);
+  const __m256 scale = _mm256_set1_ps (SHRT_MAX);
+
+  size_t i = 0;
+  for (; i + 16 <= n; i += 16)
+    {
+      __m256 a = _mm256_loadu_ps (src + i);
+      __m256 b = _mm256_loadu_ps (src + i + 8);
+      a = _mm256_mul_ps (_mm256_max_ps (_mm256_min_ps (a, hi), lo), scale);
+      b = _mm256_mul_ps (_mm256_max_ps (_mm256_min_ps (b, hi), lo), scale);
+
+      // The pack works within 128-bit lanes, so put the 64-bit groups back in order
+      __m256i packed = _mm256_packs_epi32 (_mm256_cvttps_epi32 (a),
+					   _mm256_cvttps_epi32 (b));
+      packed = _mm256_permute4x64_epi64 (packed, 0xD8);
+      _mm256_storeu_si256 ((__m256i *) (dst + i), packed);
+    }
+  floatToPcm16Scalar (src + i, dst + i, n - i);
+}
+
+#endif // SIMD_ISA_X86
+
+
+// -- Runtime dispatch --
+
+struct PcmKernels
+{
+  void (*pcm8ToFloat) (const uint8_t *, float *, size_t);
+  void (*pcm16ToFloat) (const int16_t *, float *, size_t);
+  void (*pcm24ToFloat) (const uint8_t *, float *, size_t);
+  void (*pcm32ToFloat) (const int32_t *, float *, size_t);
+  void (*floatToPcm16) (const float *, int16_t *, size_t);
+};
+
+static const PcmKernels SCALAR_KERNELS = {
+  pcm8ToFloatScalar, pcm16ToFloatScalar, pcm24ToFloatScalar,
+  pcm32ToFloatScalar, floatToPcm16Scalar
+};
+
+#ifdef SIMD_ISA_X86
+// There's no SSE2 byte shuffle, so 24-bit stays scalar at this level
+static const PcmKernels SSE2_KERNELS = {
+  pcm8ToFloatSse2, pcm16ToFloatSse2, pcm24ToFloatScalar,
+  pcm32ToFloatSse2, floatToPcm16Sse2
+};
+
+static const PcmKernels AVX2_KERNELS = {
+  pcm8ToFloatAvx2, pcm16ToFloatAvx2, pcm24ToFloatAvx2,
+  pcm32ToFloatAvx2, floatToPcm16Avx2
+};
+#endif
+
+// The fastest kernels at or below an instruction set. There are none beyond AVX2.
+static const PcmKernels *
+kernelsFor (SimdIsa isa)
+{
+#ifdef SIMD_ISA_X86
+  if (isa >= SIMD_ISA_AVX2)
+    return &AVX2_KERNELS;
+  if (isa == SIMD_ISA_SSE2)
+    return &SSE2_KERNELS;
+#endif
+  return &SCALAR_KERNELS;
+}
+
+void
+pcm8ToFloat (const uint8_t * src, float *dst, size_t n)
+{
+  kernelsFor (simdIsa ())->pcm8ToFloat (src, dst, n);
+}
+
+void
+pcm16ToFloat (const int16_t * src, float *dst, size_t n)
+{
+  kernelsFor (simdIsa ())->pcm16ToFloat (src, dst, n);
+}
+
+void
+pcm24ToFloat (const uint8_t * src, float *dst, size_t n)
+{
+  kernelsFor (simdIsa ())->pcm24ToFloat (src, dst, n);
+}
+
+void
+pcm32ToFloat (const int32_t * src, float *dst, size_t n)
+{
+  kernelsFor (simdIsa ())->pcm32ToFloat (src, dst, n);
+}
+
+void
+floatToPcm16 (const float *src, int16_t * dst, size_t n)
+{
+  kernelsFor (simdIsa ())->floatToPcm16 (src, dst, n);
+}
@@ -0,0 +1,31 @@
+// =================================================================================================
+// PcmConvert.h
+//
+// Conversion kernels between the integer sample formats stored in wav files and
+// normalized floating point. Each kernel has a scalar version plus SSE2 and AVX2
+// versions on x86, picked at runtime by simdIsa() (see SimdIsa.h).
+//
+// =================================================================================================
+
+#ifndef __PcmConvert__
+#define __PcmConvert__
+
+#include <cstddef>
+#include <cstdint>
+
+/// Converts unsigned 8-bit samples to [-1, 1] floats (128 is silence)
+void pcm8ToFloat(const uint8_t *src, float *dst, size_t n);
+
+/// Converts signed 16-bit samples to [-1, 1] floats
+void pcm16ToFloat(const int16_t *src, float *dst, size_t n);
+
+/// Converts packed signed 24-bit samples (3 bytes each, little-endian) to [-1, 1] floats
+void pcm24ToFloat(const uint8_t *src, float *dst, size_t n);
+
+/// Converts signed 32-bit samples to [-1, 1] floats
+void pcm32ToFloat(const int32_t *src, float *dst, size_t n);
+
+/// Converts floats to signed 16-bit samples, clipping anything outside [-1, 1]
+void floatToPcm16(const float *src, int16_t *dst, size_t n);
+
+#endif
@@ -0,0 +1,244 @@
+// =================================================================================================
+// Resampler.cpp
+//
+// Each output sample at input time t = i + f (integer i, fraction f) is the sum of the inputs
+// around it weighted by a low-pass kernel centred on t:
+//
+//              y(t) = sum over k from 1 - H to H of  x(i + k) h(f - k)
+//
+//              h(d) = c sinc(c d) w(d / H)
+//
+// where c is the cutoff as a fraction of the input Nyquist frequency, sinc(x) = sin(pi x) /
+// (pi x), w is a Kaiser window and H is the half-length in input samples. When downsampling,
+// c is below 1 so that nothing above the output Nyquist frequency survives, and H grows to
+// keep the same number of zero crossings.
+//
+// The kernel is tabulated once per fraction f. For a ratio of integer rates L / M there are
+// only L distinct fractions, so each output uses one table row exactly. For any other
+// ratio the table holds TABLE_PHASES + 1 rows, evenly spaced in f, and the output is
+// interpolated between the two rows either side of the actual fraction.
+// =================================================================================================
+
+#include "Resampler.h"
+#include "Kaiser.h"
+#include <algorithm>
+#include <cassert>
+#include <climits>
+#include <cmath>
+#include <cstring>
+
+// Largest L, in lowest terms, for which a rational ratio gets its own polyphase table
+static const int MAX_PHASES = 1024;
+
+// Rows of the interpolated table for arbitrary ratios, as a power of 2
+static const int TABLE_BITS = 9;
+static const int TABLE_PHASES = 1 << TABLE_BITS;
+
+// Cutoff as a fraction of the lower Nyquist frequency. The Kaiser window's transition band
+// is centred on it, so the stopband starts at about the Nyquist frequency.
+static const double ROLLOFF = 0.92;
+
+// Kaiser window shape; 8 gives a stopband more than 80 dB down
+static const double KAISER_BETA = 8.0;
+
+// Input samples taken in at a time, which bounds the size of the input buffer
+static const int CHUNK = 1024;
+
+typedef float Vec8 __attribute__ ((vector_size (32)));
+
+static long
+gcd (long a, long b)
+{
+  while (b != 0)
+    {
+      long t = a % b;
+      a = b;
+      b = t;
+    }
+  return a;
+}
+
+// Sum of a[j] * x[j] for n samples, n a multiple of 8
+static inline float
+dot (const float *a, const float *x, int n)
+{
+  Vec8 acc = { 0, 0, 0, 0, 0, 0, 0, 0 };
+  for (int j = 0; j < n; j += 8)
+    {
+      Vec8 va, vx;
+      memcpy (&va, a + j, sizeof (Vec8));
+      memcpy (&vx, x + j, sizeof (Vec8));
+      acc += va * vx;
+    }
+  return ((acc[0] + acc[4]) + (acc[1] + acc[5])) + ((acc[2] + acc[6]) +
+						    (acc[3] + acc[7]));
+}
+
+Resampler::Resampler (int inRate, int outRate, int zeroCrossings)
+{
+  assert (inRate > 0 && outRate > 0);
+  long g = gcd (inRate, outRate);
+  long L = outRate / g;
+  long M = inRate / g;
+  m_ratio = (double) outRate / inRate;
+
+  // Too many phases to tabulate; treat it as an arbitrary ratio
+  if (L > MAX_PHASES)
+    {
+      initRatio (m_ratio, zeroCrossings);
+      return;
+    }
+
+  m_numPhases = L;
+  m_stepInt = M / L;
+  m_stepPhase = M % L;
+  m_stepFrac = 0;
+  design (ROLLOFF * std::min (1.0, m_ratio), L, zeroCrossings);
+  reset ();
+}
+
+Resampler::Resampler (double ratio, int zeroCrossings)
+{
+  initRatio (ratio, zeroCrossings);
+}
+
+void
+Resampler::initRatio (double ratio, int zeroCrossings)
+{
+  assert (ratio > 0);
+  m_ratio = ratio;
+  m_numPhases = 0;
+
+  double step = 1 / ratio;
+  m_stepInt = (int64_t) floor (step);
+  m_stepPhase = 0;
+  double frac = ldexp (step - floor (step), 64);
+  m_stepFrac = frac >= ldexp (1.0, 64) ? UINT64_MAX : (uint64_t) frac;
+
+  design (ROLLOFF * std::min (1.0, m_ratio), TABLE_PHASES, zeroCrossings);
+  reset ();
+}
+
+// Tabulates the kernel for fractions 0, 1/divisions, 2/divisions... For an arbitrary
+// ratio there's one more row, at a fraction of 1, to interpolate towards.
+void
+Resampler::design (double cutoff, int divisions, int zeroCrossings)
+{
+  assert (zeroCrossings > 0);
+  m_half = (int) ceil (zeroCrossings / cutoff);
+  m_taps = (2 * m_half + 7) / 8 * 8;
+
+  int numRows = isPolyphase ()? divisions : divisions + 1;
+  m_filter.assign ((size_t) numRows * m_taps, 0.0f);
+
+  for (int r = 0; r < numRows; r++)
+    {
+      double f = (double) r / divisions;
+      float *row = m_filter.data () + (size_t) r * m_taps;
+
+      double sum = 0;
+      vector < double >h (2 * m_half);
+      for (int j = 0; j < 2 * m_half; j++)
+	{
+	  double d = f - (j + 1 - m_half);
+	  h[j] = kaiserSinc (d, m_half, cutoff, KAISER_BETA);
+	  sum += h[j];
+	}
+
+      // Unity gain at DC for every fraction, so steady signals don't pick up a ripple
+      for (int j = 0; j < 2 * m_half; j++)
+	row[j] = h[j] / sum;
+    }
+}
+
+int
+Resampler::maxOutput (int n) const
+{
+  return (int) ceil (n * m_ratio) + 1;
+}
+
+void
+Resampler::reset ()
+{
+  m_index = 0;
+  m_phase = 0;
+  m_frac = 0;
+
+  // Silence before the first input, for the taps left of the first output
+  m_bufStart = 1 - m_half;
+  m_buf.assign (m_half - 1, 0.0f);
+  m_numInput = 0;
+}
+
+// Writes every output whose taps are all in the buffer, up to input time 'end'
+int
+Resampler::produce (float *y, int64_t end)
+{
+  const int64_t avail = m_bufStart + (int64_t) m_buf.size ();
+  const int taps = m_taps;
+  int n = 0;
+
+  while (m_index < end && m_index - m_half + taps < avail)
+    {
+      const float *x = m_buf.data () + (m_index - m_half + 1 - m_bufStart);
+
+      if (isPolyphase ())
+	{
+	  y[n++] = dot (m_filter.data () + m_phase * taps, x, taps);
+
+	  m_index += m_stepInt;
+	  m_phase += m_stepPhase;
+	  if (m_phase >= (uint64_t) m_numPhases)
+	    {
+	      m_phase -= m_numPhases;
+	      m_index++;
+	    }
+	}
+      else
+	{
+	  // Top bits of the fraction pick the row, the next 24 interpolate
+	  const float *row = m_filter.data () + (m_frac >> (64 - TABLE_BITS)) * taps;
+	  float weight = (float) ((m_frac << TABLE_BITS) >> 40) * (1.0f / (1 << 24));
+	  float a = dot (row, x, taps);
+	  float b = dot (row + taps, x, taps);
+	  y[n++] = a + weight * (b - a);
+
+	  uint64_t frac = m_frac + m_stepFrac;
+	  m_index += m_stepInt + (frac < m_frac ? 1 : 0);
+	  m_frac = frac;
+	}
+    }
+
+  // Drop the input that no later output reaches
+  int64_t drop = std::min < int64_t > (m_index - m_half + 1 - m_bufStart,
+				       (int64_t) m_buf.size ());
+  if (drop > 0)
+    {
+      m_buf.erase (m_buf.begin (), m_buf.begin () + drop);
+      m_bufStart += drop;
+    }
+
+  return n;
+}
+
+int
+Resampler::process (const float *x, int n, float *y)
+{
+  int numOut = 0;
+  for (int start = 0; start < n; start += CHUNK)
+    {
+      int len = std::min (CHUNK, n - start);
+      m_buf.insert (m_buf.end (), x + start, x + start + len);
+      m_numInput += len;
+      numOut += produce (y + numOut, INT64_MAX);
+    }
+  return numOut;
+}
+
+int
+Resampler::flush (float *y)
+{
+  // Silence after the last input, for the taps right of the last outputs
+  m_buf.insert (m_buf.end (), m_taps, 0.0f);
+  return produce (y, m_numInput);
+}
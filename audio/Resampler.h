@@ -0,0 +1,102 @@
+// =================================================================================================
+// Resampler.h
+//
+// Band-limited sample rate conversion with a Kaiser-windowed sinc filter. A conversion
+// between two integer sample rates (e.g. 44100 to 48000) uses a polyphase filter with
+// one phase per output position, and steps through the input exactly. Any other ratio
+// (e.g. a speed change) interpolates between finely spaced filter phases, with a 64-bit
+// fixed-point fractional position that doesn't drift however long the input.
+//
+// =================================================================================================
+
+#ifndef __Resampler__
+#define __Resampler__
+
+#include <cstdint>
+#include <vector>
+
+using namespace std;
+
+class Resampler
+{
+public:
+
+	/// Converts between two sample rates
+	///
+	/// @param	inRate			Sample rate of the input (e.g. 44100)
+	/// @param	outRate			Sample rate of the output (e.g. 48000)
+	///	@param	zeroCrossings	Filter half-length, in zero crossings of the sinc. More is
+	///							sharper and slower; 32 passes up to 84% of the Nyquist
+	///							frequency with the stopband more than 80 dB down.
+	///
+	Resampler(int inRate, int outRate, int zeroCrossings = 32);
+
+	/// Resamples by any ratio, e.g. 1 / speed to change speed
+	///
+	/// @param	ratio			Output samples per input sample
+	///	@param	zeroCrossings	As above
+	///
+	Resampler(double ratio, int zeroCrossings = 32);
+
+	/// Output samples per input sample
+	double ratio() const { return m_ratio; }
+
+	/// True if the ratio is rational and the exact polyphase filter is used
+	bool isPolyphase() const { return m_numPhases > 0; }
+
+	/// Input samples the output lags behind the input, i.e. what flush() has to push out
+	int latency() const { return m_taps - m_half; }
+
+	/// Most output samples that n input samples can produce; the size y needs for process()
+	int maxOutput(int n) const;
+
+	/// Resamples the next block of input. Output sample j is the input at time j / ratio,
+	/// so the first output lines up with the first input.
+	///
+	///	@param	x	Input audio, n samples. All of it is consumed.
+	/// @param	n	Number of input samples
+	///	@param	y	Output audio, up to maxOutput(n) samples
+	/// @return		Number of output samples written
+	///
+	int process(const float *x, int n, float *y);
+
+	/// Writes the output still held back by the filter at the end of the input. After
+	/// this, the total output is ceil(total input * ratio) samples.
+	///
+	///	@param	y	Output audio, up to maxOutput(latency()) samples
+	/// @return		Number of output samples written
+	///
+	int flush(float *y);
+
+	/// Clears the history, to start on unrelated input
+	void reset();
+
+private:
+
+	double m_ratio;
+	int m_half;					// Filter taps either side of the output position
+	int m_taps;					// Taps per phase, 2 * m_half rounded up to whole vectors
+	int m_numPhases;			// Polyphase: number of phases; 0 for an arbitrary ratio
+	vector<float> m_filter;		// Coefficients, one row of m_taps per phase
+
+	// Polyphase: the output position is m_index + m_phase / m_numPhases, and advances by
+	// m_stepInt + m_stepPhase / m_numPhases
+	// Arbitrary ratio: the output position is m_index + m_frac / 2^64, and advances by
+	// m_stepInt + m_stepFrac / 2^64
+	int64_t m_index;
+	uint64_t m_phase;
+	uint64_t m_frac;
+	int64_t m_stepInt;
+	uint64_t m_stepPhase;
+	uint64_t m_stepFrac;
+
+	vector<float> m_buf;		// Input history and not yet used input
+	int64_t m_bufStart;			// Input index of m_buf[0]
+	int64_t m_numInput;			// Input samples received so far
+
+	void initRatio(double ratio, int zeroCrossings);
+	void design(double cutoff, int numRows, int zeroCrossings);
+	int produce(float *y, int64_t end);
+};
+
+#endif
@@ -0,0 +1,58 @@
+// =================================================================================================
+// SimdIsa.cpp
+//
+// =================================================================================================
+
+#include "SimdIsa.h"
+#include <algorithm>
+
+SimdIsa
+supportedSimdIsa ()
+{
+#ifdef SIMD_ISA_X86
+  __builtin_cpu_init ();
+  if (__builtin_cpu_supports ("avx512f"))
+    return SIMD_ISA_AVX512;
+  if (__builtin_cpu_supports ("avx2"))
+    return SIMD_ISA_AVX2;
+  if (__builtin_cpu_supports ("sse2"))
+    return SIMD_ISA_SSE2;
+#endif
+  return SIMD_ISA_SCALAR;
+}
+
+// Instruction set in use. Chosen on first use, so it's valid even during static initialization.
+static SimdIsa &
+activeIsa ()
+{
+  static SimdIsa isa = supportedSimdIsa ();
+  return isa;
+}
+
+SimdIsa
+simdIsa ()
+{
+  return activeIsa ();
+}
+
+void
+setSimdIsa (SimdIsa isa)
+{
+  activeIsa () = std::min (isa, supportedSimdIsa ());
+}
+
+const char *
+simdIsaName (SimdIsa isa)
+{
+  switch (isa)
+    {
+    case SIMD_ISA_AVX512:
+      return "avx512";
+    case SIMD_ISA_AVX2:
+      return "avx2";
+    case SIMD_ISA_SSE2:
+      return "sse2";
+    default:
+      return "scalar";
+    }
+}
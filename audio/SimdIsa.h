@@ -0,0 +1,41 @@
+// =================================================================================================
+// SimdIsa.h
+//
+// The instruction set the SIMD kernels run with. PcmConvert and MultiBiquad compile their
+// kernels once per instruction set and dispatch on simdIsa(), which starts out as the
+// best one the processor supports. setSimdIsa restricts them all at once, e.g. to compare
+// versions in a test or benchmark. A module without kernels at some level uses its best
+// version below it.
+//
+// =================================================================================================
+
+#ifndef __SimdIsa__
+#define __SimdIsa__
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SIMD_ISA_X86 1
+#endif
+
+/// Instruction sets, each a superset of the one before
+enum SimdIsa
+{
+	SIMD_ISA_SCALAR = 0,	// Plain C++, or the compiler's baseline vectors
+	SIMD_ISA_SSE2,
+	SIMD_ISA_AVX2,
+	SIMD_ISA_AVX512
+};
+
+/// Returns the best instruction set this processor supports
+SimdIsa supportedSimdIsa();
+
+/// Returns the instruction set the kernels are currently using
+SimdIsa simdIsa();
+
+/// Restricts the kernels to at most the given instruction set. Requests beyond what the
+/// processor supports are clamped.
+void setSimdIsa(SimdIsa isa);
+
+/// Returns a printable name for an instruction set, e.g. "avx2"
+const char *simdIsaName(SimdIsa isa);
+
+#endif
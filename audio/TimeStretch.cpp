@@ -0,0 +1,406 @@
+// =================================================================================================
+// TimeStretch.cpp
+//
+// Frames of N samples are taken from the input every Ha samples and overlap-added into the
+// output every Hs samples, so the output runs Hs / Ha times as long. Hs is fixed and Ha
+// follows the stretch, which may change between frames.
+//
+// WSOLA (Verhelst & Roelands) uses Hann frames of about 20 ms with Hs = N / 2. Before a
+// frame is added, it is moved by up to the tolerance either way to where its first half
+// best matches, by cross-correlation, the input that followed the previous frame's first
+// half. That is what would have been there had the input not been stretched, so the
+// waveform carries on without a phase jump.
+//
+// The phase vocoder uses Hann frames of about 46 ms with Hs = N / 4, windowed again on
+// output. Each bin's frequency is measured from its phase advance since the last frame,
+// and its output phase is advanced at that frequency over Hs. Only the spectral peaks are
+// advanced that way; every other bin keeps its phase offset from the nearest peak, which
+// keeps each partial's bins coherent and avoids the "phasiness" of a plain vocoder
+// (Laroche & Dolson's identity phase locking).
+//
+// The first frame starts before the input, on silence, so that every frame is centred on
+// the input time corresponding to its output time. The output is dropped until the
+// windows overlap fully.
+// =================================================================================================
+
+#include "TimeStretch.h"
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+static const double MIN_STRETCH = 0.25;
+static const double MAX_STRETCH = 4;
+static const double MAX_PITCH_SEMITONES = 24;
+
+// Input samples taken in at a time. Together with the frame size, this bounds the input
+// buffer and the output of one step.
+static const int CHUNK = 1024;
+
+// Frame durations in seconds
+static const double WSOLA_FRAME_SECONDS = 0.02;
+static const double WSOLA_TOLERANCE_SECONDS = 0.008;	// Enough for a voice down to about 60 Hz
+static const double VOCODER_FRAME_SECONDS = 0.046;
+
+typedef float Vec8 __attribute__ ((vector_size (32)));
+
+// Sum of a[i] * b[i] for n samples
+static inline float
+dot (const float *a, const float *b, int n)
+{
+  Vec8 acc = { 0, 0, 0, 0, 0, 0, 0, 0 };
+  int i = 0;
+  for (; i + 8 <= n; i += 8)
+    {
+      Vec8 va, vb;
+      memcpy (&va, a + i, sizeof (Vec8));
+      memcpy (&vb, b + i, sizeof (Vec8));
+      acc += va * vb;
+    }
+  float sum = ((acc[0] + acc[4]) + (acc[1] + acc[5])) + ((acc[2] + acc[6]) +
+						       (acc[3] + acc[7]));
+  for (; i < n; i++)
+    sum += a[i] * b[i];
+  return sum;
+}
+
+static inline float
+wrapPhase (float phase)
+{
+  return phase - (float) (2 * M_PI) * floorf (phase * (float) (0.5 / M_PI) + 0.5f);
+}
+
+TimeStretch::TimeStretch (int sr, StretchMethod method, double stretch,
+			  double pitchSemitones):
+m_method (method)
+{
+  assert (pitchSemitones >= -MAX_PITCH_SEMITONES
+	  && pitchSemitones <= MAX_PITCH_SEMITONES);
+  setStretch (stretch);
+  m_pitch = pow (2, pitchSemitones / 12);
+
+  if (method == STRETCH_WSOLA)
+    {
+      m_frameSize = 2 * (int) lround (sr * WSOLA_FRAME_SECONDS / 2);
+      m_synthesisHop = m_frameSize / 2;
+      m_tolerance = (int) lround (sr * WSOLA_TOLERANCE_SECONDS);
+      m_olaScale = 1;
+    }
+  else
+    {
+      // A power of 2, for the FFT
+      m_frameSize = 1;
+      while (m_frameSize < sr * VOCODER_FRAME_SECONDS)
+	m_frameSize *= 2;
+      m_synthesisHop = m_frameSize / 4;
+      m_tolerance = 0;
+      m_olaScale = 1 / 1.5f;	// Squared Hann windows at a quarter overlap sum to 1.5
+    }
+
+  int N = m_frameSize;
+  m_window.resize (N);
+  for (int i = 0; i < N; i++)
+    m_window[i] = 0.5 - 0.5 * cos (2 * M_PI * i / N);
+
+  // A frame may need N + 2 * tolerance samples, and a chunk arrives on top of that. At the
+  // start there is also the silence before the input, which is longest at the least stretch.
+  int overlap = N - m_synthesisHop;
+  int lead = (int) ceil (overlap / (MIN_STRETCH * m_pitch) + N / 2.0) + m_tolerance;
+  m_in.resize (CHUNK + N + 2 * m_tolerance + lead);
+  m_ola.resize (N);
+  m_frame.resize (N);
+  m_continuation.resize (overlap);
+
+  // The most frames one step can complete is a full input buffer at the smallest hop
+  double minHop = m_synthesisHop / (MAX_STRETCH * m_pitch);
+  m_stretched.resize (((int) (m_in.size () / minHop) + 2) * m_synthesisHop);
+
+  if (method == STRETCH_PHASE_VOCODER)
+    {
+      m_fft.reset (new RealFFT (N));
+      m_re.resize (N / 2 + 1);
+      m_im.resize (N / 2 + 1);
+      m_mag.resize (N / 2 + 1);
+      m_phase.resize (N / 2 + 1);
+      m_prevPhase.resize (N / 2 + 1);
+      m_synthPhase.resize (N / 2 + 1);
+      m_peaks.reserve (N / 2 + 1);
+    }
+
+  if (m_pitch != 1)
+    m_resampler.reset (new Resampler (1 / m_pitch));
+
+  reset ();
+}
+
+void
+TimeStretch::setStretch (double stretch)
+{
+  assert (stretch >= MIN_STRETCH && stretch <= MAX_STRETCH);
+  m_stretch = stretch;
+}
+
+void
+TimeStretch::reset ()
+{
+  int N = m_frameSize;
+  int overlap = N - m_synthesisHop;
+
+  // Centre frame m, at output time m Hs + N / 2 - overlap, on the matching input time
+  m_pos = (N / 2.0 - overlap) / (m_stretch * m_pitch) - N / 2.0;
+  m_skip = overlap;
+
+  // Silence before the first input, back to the first frame's search range
+  m_inStart = std::min < int64_t > ((int64_t) floor (m_pos) - m_tolerance, 0);
+  m_inLen = (int) -m_inStart;
+  std::fill (m_in.begin (), m_in.begin () + m_inLen, 0.0f);
+  m_numInput = 0;
+
+  m_prevFrameStart = 0;
+  m_firstFrame = true;
+  std::fill (m_ola.begin (), m_ola.end (), 0.0f);
+  m_outTarget = 0;
+  m_numStretched = 0;
+
+  if (m_resampler)
+    m_resampler->reset ();
+}
+
+int
+TimeStretch::maxOutput (int n) const
+{
+  // Everything held back in the input buffer may come out too
+  double hop = m_synthesisHop / (m_stretch * m_pitch);
+  int numChunks = n / CHUNK + 2;
+  int frames = (int) ((n + m_in.size ()) / hop) + numChunks;
+  int stretched = frames * m_synthesisHop;
+
+  if (!m_resampler)
+    return stretched;
+  return m_resampler->maxOutput (stretched) + numChunks +
+    m_resampler->maxOutput (m_resampler->latency ());
+}
+
+// Frame m of WSOLA, at or near input index start
+void
+TimeStretch::wsolaFrame (int64_t start, float *out)
+{
+  const int N = m_frameSize;
+  const int overlap = N - m_synthesisHop;
+  const float *x = m_in.data () + (start - m_inStart);
+
+  // Find the offset whose first half best matches the natural continuation
+  int best = 0;
+  if (!m_firstFrame)
+    {
+      const float *c = m_continuation.data ();
+      float bestCorr = -INFINITY;
+      for (int d = -m_tolerance; d <= m_tolerance; d++)
+	{
+	  float corr = dot (x + d, c, overlap);
+	  if (corr > bestCorr)
+	    {
+	      bestCorr = corr;
+	      best = d;
+	    }
+	}
+    }
+
+  x += best;
+  for (int i = 0; i < N; i++)
+    out[i] = x[i] * m_window[i];
+  memcpy (m_continuation.data (), x + m_synthesisHop, overlap * sizeof (float));
+}
+
+// Frame m of the phase vocoder, at input index start
+void
+TimeStretch::vocoderFrame (int64_t start, float *out)
+{
+  const int N = m_frameSize;
+  const int numBins = N / 2 + 1;
+  const float *x = m_in.data () + (start - m_inStart);
+
+  for (int i = 0; i < N; i++)
+    out[i] = x[i] * m_window[i];
+  m_fft->forward (out, m_re.data (), m_im.data ());
+
+  for (int k = 0; k < numBins; k++)
+    {
+      m_mag[k] = hypotf (m_re[k], m_im[k]);
+      m_phase[k] = atan2f (m_im[k], m_re[k]);
+    }
+
+  if (m_firstFrame)
+    std::copy (m_phase.begin (), m_phase.end (), m_synthPhase.begin ());
+  else
+    {
+      // Peaks: bins louder than the two either side
+      m_peaks.clear ();
+      for (int k = 0; k < numBins; k++)
+	{
+	  float m = m_mag[k];
+	  if ((k < 1 || m > m_mag[k - 1]) && (k < 2 || m > m_mag[k - 2])
+	      && (k + 1 >= numBins || m >= m_mag[k + 1])
+	      && (k + 2 >= numBins || m >= m_mag[k + 2]))
+	    m_peaks.push_back (k);
+	}
+
+      // Advance each peak at its measured frequency
+      float hop = (float) (start - m_prevFrameStart);
+      for (size_t p = 0; p < m_peaks.size (); p++)
+	{
+	  int k = m_peaks[p];
+	  float omega = (float) (2 * M_PI) * k / N;
+	  float deviation = wrapPhase (m_phase[k] - m_prevPhase[k] - omega * hop);
+	  float freq = omega + deviation / hop;
+	  m_synthPhase[k] = wrapPhase (m_synthPhase[k] + freq * m_synthesisHop);
+	}
+
+      // Lock the other bins to the nearest peak, splitting the bins between peaks halfway
+      size_t p = 0;
+      for (int k = 0; k < numBins && !m_peaks.empty (); k++)
+	{
+	  while (p + 1 < m_peaks.size () && k - m_peaks[p] > m_peaks[p + 1] - k)
+	    p++;
+	  int peak = m_peaks[p];
+	  if (k != peak)
+	    m_synthPhase[k] = wrapPhase (m_synthPhase[peak] + m_phase[k] - m_phase[peak]);
+	}
+    }
+  std::copy (m_phase.begin (), m_phase.end (), m_prevPhase.begin ());
+
+  for (int k = 0; k < numBins; k++)
+    {
+      m_re[k] = m_mag[k] * cosf (m_synthPhase[k]);
+      m_im[k] = m_mag[k] * sinf (m_synthPhase[k]);
+    }
+  m_fft->inverse (m_re.data (), m_im.data (), out);
+
+  for (int i = 0; i < N; i++)
+    out[i] *= m_window[i];
+}
+
+// Runs every frame the buffered input allows, writing the finished stretched output
+int
+TimeStretch::runFrames (float *y)
+{
+  const int N = m_frameSize;
+  const int hs = m_synthesisHop;
+  int n = 0;
+
+  while ((int64_t) floor (m_pos) + m_tolerance + N <= m_inStart + m_inLen)
+    {
+      int64_t start = (int64_t) floor (m_pos);
+      if (m_method == STRETCH_WSOLA)
+	wsolaFrame (start, m_frame.data ());
+      else
+	vocoderFrame (start, m_frame.data ());
+      m_prevFrameStart = start;
+      m_firstFrame = false;
+
+      for (int i = 0; i < N; i++)
+	m_ola[i] += m_frame[i] * m_olaScale;
+
+      // The first hop of the accumulator is now complete
+      int drop = std::min (m_skip, hs);
+      m_skip -= drop;
+      memcpy (y + n, m_ola.data () + drop, (hs - drop) * sizeof (float));
+      n += hs - drop;
+
+      memmove (m_ola.data (), m_ola.data () + hs, (N - hs) * sizeof (float));
+      std::fill (m_ola.begin () + (N - hs), m_ola.end (), 0.0f);
+
+      m_pos += hs / (m_stretch * m_pitch);
+    }
+
+  // Drop the input no later frame can reach
+  int64_t keep = (int64_t) floor (m_pos) - m_tolerance;
+  int64_t drop = std::min < int64_t > (keep - m_inStart, m_inLen);
+  if (drop > 0)
+    {
+      memmove (m_in.data (), m_in.data () + drop,
+	       (m_inLen - drop) * sizeof (float));
+      m_inLen -= drop;
+      m_inStart += drop;
+    }
+
+  m_numStretched += n;
+  return n;
+}
+
+// Stretches up to CHUNK samples of input, or silence if x is NULL
+int
+TimeStretch::stretchChunk (const float *x, int n, float *y)
+{
+  assert (n <= CHUNK);
+
+  // If the frames have moved on past the buffer, skip input until they're reached. The
+  // silence flush() pushes counts as input too, or a fast stretch could skip it forever.
+  int64_t index = m_numInput;
+  m_numInput += n;
+  if (m_inLen == 0 && index < m_inStart)
+    {
+      int skip = (int) std::min < int64_t > (n, m_inStart - index);
+      if (x)
+	x += skip;
+      n -= skip;
+      index += skip;
+    }
+  if (m_inLen == 0)
+    m_inStart = index;
+
+  if (x)
+    memcpy (m_in.data () + m_inLen, x, n * sizeof (float));
+  else
+    std::fill (m_in.begin () + m_inLen, m_in.begin () + m_inLen + n, 0.0f);
+  m_inLen += n;
+
+  return runFrames (y);
+}
+
+int
+TimeStretch::process (const float *x, int n, float *y)
+{
+  int numOut = 0;
+  for (int start = 0; start < n; start += CHUNK)
+    {
+      int len = std::min (CHUNK, n - start);
+      m_outTarget += len * m_stretch * m_pitch;
+
+      int k = stretchChunk (x + start, len, m_stretched.data ());
+      if (m_resampler)
+	numOut += m_resampler->process (m_stretched.data (), k, y + numOut);
+      else
+	{
+	  memcpy (y + numOut, m_stretched.data (), k * sizeof (float));
+	  numOut += k;
+	}
+    }
+  return numOut;
+}
+
+int
+TimeStretch::flush (float *y)
+{
+  // Push silence through until the stretched output reaches its full length
+  int64_t target = llround (m_outTarget);
+  int numOut = 0;
+  while (m_numStretched < target)
+    {
+      int64_t before = m_numStretched;
+      int k = stretchChunk (NULL, CHUNK, m_stretched.data ());
+      k = (int) std::min < int64_t > (k, target - before);
+
+      if (m_resampler)
+	numOut += m_resampler->process (m_stretched.data (), k, y + numOut);
+      else
+	{
+	  memcpy (y + numOut, m_stretched.data (), k * sizeof (float));
+	  numOut += k;
+	}
+    }
+
+  if (m_resampler)
+    numOut += m_resampler->flush (y + numOut);
+  return numOut;
+}
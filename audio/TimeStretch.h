@@ -0,0 +1,117 @@
+// =================================================================================================
+// TimeStretch.h
+//
+// Changes the duration of audio without changing its pitch, or its pitch without changing
+// its duration. The audio is cut into overlapping frames, which are overlap-added back
+// together at a different spacing. Two ways of making the frames fit together are offered:
+// WSOLA, which nudges each frame to line up with the waveform of the one before (best for
+// speech and other monophonic sources), and a phase vocoder, which adjusts the phase of
+// every frequency bin (best for music). A pitch shift is a time stretch followed by
+// resampling back to the original duration.
+//
+// All working buffers are allocated by the constructor, so a file of any length is
+// processed in the same memory.
+//
+// =================================================================================================
+
+#ifndef __TimeStretch__
+#define __TimeStretch__
+
+#include "FFT.h"
+#include "Resampler.h"
+#include <memory>
+#include <vector>
+
+using namespace std;
+
+/// How the frames are fitted together
+enum StretchMethod
+{
+	STRETCH_WSOLA,			// Waveform-similarity overlap-add; for speech
+	STRETCH_PHASE_VOCODER	// Phase vocoder with phase locking; for music
+};
+
+class TimeStretch
+{
+public:
+
+	/// @param	sr				Sample rate (e.g. 44100)
+	///	@param	method			How the frames are fitted together
+	/// @param	stretch			Output duration / input duration, from 0.25 to 4
+	/// @param	pitchSemitones	Pitch shift, from -24 to +24 semitones
+	///
+	TimeStretch(int sr, StretchMethod method, double stretch = 1, double pitchSemitones = 0);
+
+	/// Changes the duration ratio from the next frame on, from 0.25 to 4
+	void setStretch(double stretch);
+	double stretch() const { return m_stretch; }
+
+	/// Most output samples that n input samples can produce; the size y needs for process()
+	int maxOutput(int n) const;
+
+	/// Processes the next block of one channel of audio
+	///
+	///	@param	x	Input audio, n samples. All of it is consumed.
+	/// @param	n	Number of input samples
+	///	@param	y	Output audio, up to maxOutput(n) samples
+	/// @return		Number of output samples written
+	///
+	int process(const float *x, int n, float *y);
+
+	/// Writes the output still held back at the end of the input. The total output is then
+	/// the input length times the stretch.
+	///
+	///	@param	y	Output audio, up to maxOutput(0) samples
+	/// @return		Number of output samples written
+	///
+	int flush(float *y);
+
+	/// Clears all state, to start on unrelated input
+	void reset();
+
+private:
+
+	StretchMethod m_method;
+	double m_stretch;
+	double m_pitch;					// Frequency ratio of the pitch shift
+	int m_frameSize;				// N: samples per frame
+	int m_synthesisHop;				// Output samples between frames
+	int m_tolerance;				// WSOLA: how far a frame may move to line up, either way
+	vector<float> m_window;			// Hann window, m_frameSize samples
+	float m_olaScale;				// Makes the overlapped windows sum to 1
+
+	vector<float> m_in;				// Input from m_inStart on, m_inLen samples
+	int64_t m_inStart;				// Input index of m_in[0]
+	int m_inLen;
+	int64_t m_numInput;				// Input samples received so far, and silence flushed
+	double m_pos;					// Input index of the next frame; may be negative at the start
+	int64_t m_prevFrameStart;		// Input index of the previous frame as used
+	vector<float> m_continuation;	// WSOLA: the input that followed the previous frame's first hop
+	bool m_firstFrame;
+
+	vector<float> m_ola;			// Overlap-add accumulator, m_frameSize samples
+	int m_skip;						// Output samples still to drop, while the windows ramp up
+	double m_outTarget;				// Stretched output the input so far should make
+	int64_t m_numStretched;			// Stretched output made so far
+
+	vector<float> m_frame;			// One frame of input, windowed
+	vector<float> m_stretched;		// Stretched output of one call, before resampling
+	unique_ptr<Resampler> m_resampler;	// Set for a pitch shift
+
+	// Phase vocoder
+	unique_ptr<RealFFT> m_fft;
+	vector<float> m_re;				// Spectrum of the frame
+	vector<float> m_im;
+	vector<float> m_phase;			// Phase of each bin in this frame and the last
+	vector<float> m_prevPhase;
+	vector<float> m_synthPhase;		// Phase of each bin in the output
+	vector<float> m_mag;
+	vector<int> m_peaks;
+
+	int stretchChunk(const float *x, int n, float *y);
+	int runFrames(float *y);
+	void wsolaFrame(int64_t start, float *out);
+	void vocoderFrame(int64_t start, float *out);
+};
+
+#endif
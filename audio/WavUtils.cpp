@@ -7,9 +7,16 @@
 // =================================================================================================
 
 #include "WavUtils.h"
+#include "PcmConvert.h"
 #include <cstring>
 #include <cassert>
 #include <fstream>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #ifndef __APPLE__
 #include <climits>
@@ -17,50 +24,200 @@
 
 using namespace std;
 
-typedef char FOURCC[4];
-
 static const int BITS_PER_SAMPLE = 16;	// 16-bits per audio sample
 
+// Payload of the "JUNK" chunk reserved for, and the same size as, an RF64 "ds64" chunk
+static const uint32_t JUNK_CHUNK_SIZE = 28;
+
+// Format codes in the fmt chunk
+static const short WAVE_FORMAT_PCM = 1;
+static const short WAVE_FORMAT_IEEE_FLOAT = 3;
+static const short WAVE_FORMAT_EXTENSIBLE = (short) 0xFFFE;
+
 static const int MIN_SAMPLE_RATE = 8000;
 static const int MAX_SAMPLE_RATE = 96000;
 
 
+// Number of sample frames converted at a time by the streaming reader/writer
+static const int BLOCK_FRAMES = 4096;
+
+
+// Wide files are (de)interleaved in tiles of this many frames by this many channels,
+// so that the interleaved rows and the per-channel runs of a tile both stay in L1
+// rather than striding through memory a whole frame at a time.
+static const int TILE_FRAMES = 64;
+static const int TILE_CHANNELS = 16;
+
+// De-interleaves n sample frames into per-channel buffers, starting at
+// the given offset in each channel buffer.
 static void
-deinterleaveAudio (const vector < float >&interleaved,
-		   vector < vector < float >>&split, int numCh)
+deinterleaveAudio (const float *interleaved, float *const *split, int numCh,
+		   int offset, int n)
 {
-  assert (numCh > 0 && numCh <= 2);
+  assert (numCh > 0);
 
-  float *srcPtr = (float *) interleaved.data ();
-  int n = (int) interleaved.size () / numCh;
+  for (int i0 = 0; i0 < n; i0 += TILE_FRAMES)
+    {
+      int i1 = std::min (n, i0 + TILE_FRAMES);
+      for (int ch0 = 0; ch0 < numCh; ch0 += TILE_CHANNELS)
+	{
+	  int ch1 = std::min (numCh, ch0 + TILE_CHANNELS);
+	  for (int ch = ch0; ch < ch1; ch++)
+	    {
+	      const float *srcPtr = interleaved + i0 * numCh + ch;
+	      float *dstPtr = split[ch] + offset;
+	      for (int i = i0; i < i1; i++, srcPtr += numCh)
+		dstPtr[i] = *srcPtr;
+	    }
+	}
+    }
+}
 
-  split.resize (numCh);
-  for (int ch = 0; ch < numCh; ch++)
-    split[ch].resize (n);
 
-  for (int i = 0; i < n; i++)
+// Interleaves n sample frames from per-channel buffers, starting at
+// the given offset in each channel buffer.
+static void
+interleaveAudio (const float *const *split, float *interleaved, int numCh,
+		 int offset, int n)
+{
+  assert (numCh > 0);
+
+  for (int i0 = 0; i0 < n; i0 += TILE_FRAMES)
     {
-      for (int ch = 0; ch < numCh; ch++)
-	split[ch][i] = *srcPtr++;
+      int i1 = std::min (n, i0 + TILE_FRAMES);
+      for (int ch0 = 0; ch0 < numCh; ch0 += TILE_CHANNELS)
+	{
+	  int ch1 = std::min (numCh, ch0 + TILE_CHANNELS);
+	  for (int ch = ch0; ch < ch1; ch++)
+	    {
+	      const float *srcPtr = split[ch] + offset;
+	      float *outP = interleaved + i0 * numCh + ch;
+	      for (int i = i0; i < i1; i++, outP += numCh)
+		*outP = srcPtr[i];
+	    }
+	}
     }
 }
 
 
+void
+deinterleave (const float *interleaved, float *const *split, int numCh,
+	      int numFrames)
+{
+  deinterleaveAudio (interleaved, split, numCh, 0, numFrames);
+}
+
+
+void
+interleave (const float *const *split, float *interleaved, int numCh,
+	    int numFrames)
+{
+  interleaveAudio (split, interleaved, numCh, 0, numFrames);
+}
+
+
+// Converts n little-endian samples to normalized [-1,1] floating point. Full scale
+// for integers is 2^(bits-1), e.g. 32768 for 16-bit audio. Floats are passed through.
 static void
-interleaveAudio (const vector < vector < float >>&split,
-		 vector < float >&interleaved)
+pcmToFloat (const uint8_t * src, float *dst, int n, int bytesPerSample,
+	    int audioFormat)
 {
-  int numCh = (int) split.size ();
-  assert (numCh > 0 && numCh <= 2);
+  if (audioFormat == WAVE_FORMAT_IEEE_FLOAT)
+    {
+      if (bytesPerSample == 4)
+	memcpy (dst, src, n * sizeof (float));
+      else
+	{
+	  const double *dblSrc = (const double *) src;
+	  for (int i = 0; i < n; i++)
+	    dst[i] = (float) dblSrc[i];
+	}
+      return;
+    }
 
-  int n = (int) split[0].size ();
+  switch (bytesPerSample)
+    {
+    case 1:
+      // By convention, 8-bit audio is *unsigned* with sample values from 0 to 255
+      pcm8ToFloat (src, dst, n);
+      break;
+    case 2:
+      pcm16ToFloat ((const int16_t *) src, dst, n);
+      break;
+    case 3:
+      pcm24ToFloat (src, dst, n);
+      break;
+    case 4:
+      pcm32ToFloat ((const int32_t *) src, dst, n);
+      break;
+    default:
+      assert (false);
+    }
+}
 
-  interleaved.resize (n * numCh);
-  float *outP = interleaved.data ();
-  for (int i = 0; i < n; i++)
+
+// Converts n normalized [-1.0, 1.0] floating-point samples to little-endian
+// 8-bit unsigned or 16/24/32-bit signed integers, or to 32/64-bit floats.
+// Integer samples are clipped; floats are written as they are.
+static void
+floatToPcm (const float *src, uint8_t * dst, int n, int bytesPerSample,
+	    int audioFormat)
+{
+  if (audioFormat == WAVE_FORMAT_IEEE_FLOAT)
     {
-      for (int ch = 0; ch < numCh; ch++)
-	*outP++ = split[ch][i];
+      if (bytesPerSample == 4)
+	memcpy (dst, src, n * sizeof (float));
+      else
+	{
+	  double *dblDst = (double *) dst;
+	  for (int i = 0; i < n; i++)
+	    dblDst[i] = src[i];
+	}
+      return;
+    }
+
+  switch (bytesPerSample)
+    {
+    case 1:
+      // 8-bit audio is unsigned, so silence is at 128
+      for (int i = 0; i < n; i++)
+	{
+	  float flt = *src++;
+	  flt = std::min < float >(flt, 1.0);
+	  flt = std::max < float >(flt, -1.0);
+	  *dst++ = (uint8_t) (128 + SCHAR_MAX * flt);
+	}
+      break;
+    case 2:
+      floatToPcm16 (src, (int16_t *) dst, n);
+      break;
+    case 3:
+      for (int i = 0; i < n; i++)
+	{
+	  float flt = *src++;
+	  flt = std::min < float >(flt, 1.0);
+	  flt = std::max < float >(flt, -1.0);
+	  int32_t sample = 8388607 * flt;
+	  *dst++ = sample;
+	  *dst++ = sample >> 8;
+	  *dst++ = sample >> 16;
+	}
+      break;
+    case 4:
+      {
+	// Scale in double, as 2^31 - 1 isn't representable as a float
+	int32_t *intDst = (int32_t *) dst;
+	for (int i = 0; i < n; i++)
+	  {
+	    float flt = *src++;
+	    flt = std::min < float >(flt, 1.0);
+	    flt = std::max < float >(flt, -1.0);
+	    intDst[i] = (int32_t) (2147483647.0 * flt);
+	  }
+	break;
+      }
+    default:
+      assert (false);
     }
 }
 
@@ -95,57 +252,69 @@ equalFourCC (const FOURCC a, const FOURCC b)
 // with the specified ID.  The file position initially must be
 // on a chunk ID (but not necessarily the specified one). If the
 // chunk is found, the file position is just after the chunk size
-// (i.e. at the beginning of the chunk's contents) and the chunk
-// size is returned. If no matching chunk is found, 0 is returned.
+// (i.e. at the beginning of the chunk's contents), the chunk
+// size is stored and true is returned. If no matching chunk is
+// found, false is returned.
+// Sizes are unsigned 32-bit; in RF64 files, 0xFFFFFFFF means the
+// real size is in the ds64 chunk.
 
-int
-findChunk (istream & fp, const FOURCC chunkIDToFind)
+bool
+findChunk (istream & fp, const FOURCC chunkIDToFind, uint32_t & chunkSize)
 {
   int count = 0;
   const int MAX_CHUNKS = 100;
 
   // While we haven't reached the end of the file
-  while (count < MAX_CHUNKS && !fp.eof ())
+  while (count < MAX_CHUNKS && fp.good ())
     {
       // Get the current position
-      long pos = fp.tellg ();
+      streamoff pos = fp.tellg ();
       count++;
 
       // Read chunk ID
       FOURCC chunkID;
       fp.read ((char *) &chunkID, sizeof (chunkID));
       if (fp.gcount () != sizeof (chunkID))
-	return 0;
+	return false;
 
       // Read chunk size
-      int chunkSize;
       fp.read ((char *) &chunkSize, sizeof (chunkSize));
       if (fp.gcount () != sizeof (chunkSize))
-	return 0;
+	return false;
 
       // If the chunk ID matches, return the chunk size
       if (equalFourCC (chunkID, chunkIDToFind))
-	return chunkSize;
+	return true;
 
-      // Otherwise, skip this chunk and move to the next
-      fp.seekg (pos + chunkSize + 8);
+      // Otherwise, skip this chunk and move to the next. Chunks are
+      // word aligned, so odd-sized ones are followed by a pad byte.
+      // The position always moves forward, so this can't loop forever.
+      fp.seekg (pos + 8 + (streamoff) chunkSize + (chunkSize & 1));
     }
 
   // Give up! Couldn't find the chunk.
-  return 0;
+  return false;
 }
 
 
-
+// Reads a header field, returning false if the file ends first
+static bool
+readField (istream & fp, void *field, size_t size)
+{
+  fp.read ((char *) field, size);
+  return fp.gcount () == (streamsize) size;
+}
 
 
 // Reads a wav file header
-// If successful, return the number of samples
+// If successful, returns WAV_OK and leaves the file position at the start of
+// the audio data. Otherwise returns the reason the file can't be read.
 
-int
+WavStatus
 readWavHeader (istream & fp,
 	       int &sampleRate,
-	       int &numSamples, short &numChannels, short &bitsPerSample)
+	       int64_t & numSamples, short &numChannels, short &bitsPerSample,
+	       short &audioFormat)
 {
   checkProcessorEndianness ();
 
@@ -157,10 +326,15 @@ readWavHeader (istream & fp,
   //
   //      0         4   ChunkID          Contains the letters "RIFF" in ASCII form
   //                                                                 (0x52494646 big-endian form).
+  //
+  //      Files over 4 GB use RF64 (or the identical BW64) instead, with the
+  //      real sizes in a "ds64" chunk.
   FOURCC chunkID;
-  fp.read (chunkID, sizeof (chunkID));
-  assert (fp.gcount () == sizeof (chunkID));
-  assert (equalFourCC (chunkID, "RIFF"));
+  if (!readField (fp, chunkID, sizeof (chunkID)))
+    return WAV_ERR_NOT_WAVE;
+  bool rf64 = equalFourCC (chunkID, "RF64") || equalFourCC (chunkID, "BW64");
+  if (!rf64 && !equalFourCC (chunkID, "RIFF"))
+    return WAV_ERR_NOT_WAVE;
 
   //      4         4   ChunkSize        36 + SubChunk2Size, or more precisely:
   //                                                                 4 + (8 + SubChunk1Size) + (8 + SubChunk2Size)
@@ -169,102 +343,175 @@ readWavHeader (istream & fp,
   //                                                                 entire file in bytes minus 8 bytes for the
   //                                                                 two fields not included in this count:
   //                                                                 ChunkID and ChunkSize.
-  int chunkSize;
-  fp.read ((char *) &chunkSize, sizeof (chunkSize));
-  assert (fp.gcount () == sizeof (chunkSize));
+  uint32_t chunkSize;
+  if (!readField (fp, &chunkSize, sizeof (chunkSize)))
+    return WAV_ERR_NOT_WAVE;
 
   //      8         4   Format           Contains the letters "WAVE"
   //                                                                 (0x57415645 big-endian form).
-  fp.read (chunkID, sizeof (chunkID));
-  assert (fp.gcount () == sizeof (chunkID));
-  assert (equalFourCC (chunkID, "WAVE"));
+  if (!readField (fp, chunkID, sizeof (chunkID))
+      || !equalFourCC (chunkID, "WAVE"))
+    return WAV_ERR_NOT_WAVE;
 
-  long wavChunkPos = fp.tellg ();
+  streamoff wavChunkPos = fp.tellg ();
+
+  // -- "ds64" subchunk (RF64 only) --
+  //
+  //      0         8   RiffSize         64-bit RIFF chunk size
+  //      8         8   DataSize         64-bit data chunk size
+  //      16        8   SampleCount      Number of sample frames
+  //      24        4   TableLength      Number of entries for other oversized chunks
+  uint64_t ds64DataSize = 0;
+  if (rf64)
+    {
+      uint32_t ds64ChunkSize;
+      if (!findChunk (fp, "ds64", ds64ChunkSize) || ds64ChunkSize < 28)
+	return WAV_ERR_BAD_FORMAT;
+
+      uint64_t riffSize64;
+      if (!readField (fp, &riffSize64, sizeof (riffSize64))
+	  || !readField (fp, &ds64DataSize, sizeof (ds64DataSize)))
+	return WAV_ERR_TRUNCATED;
+    }
 
   // -- "fmt " subchunk --
 
   fp.seekg (wavChunkPos);
 
-  int fmtChunkSize = findChunk (fp, "fmt ");
-  assert (fmtChunkSize >= 16);
+  uint32_t fmtChunkSize;
+  if (!findChunk (fp, "fmt ", fmtChunkSize) || fmtChunkSize < 16)
+    return WAV_ERR_NO_FMT;
 
   //      20        2   AudioFormat      PCM = 1 (i.e. Linear quantization)
-  //                                                                 Values other than 1 indicate some
+  //                                                                 IEEE float = 3, extensible = 0xFFFE.
+  //                                                                 Other values indicate some
   //                                                                 form of compression.
-  short audioFormat;
-  fp.read ((char *) &audioFormat, sizeof (audioFormat));
-  assert (fp.gcount () == sizeof (audioFormat));
-  assert (audioFormat == 1);
-
   //      22        2   NumChannels      Mono = 1, Stereo = 2, etc.
-  fp.read ((char *) &numChannels, sizeof (numChannels));
-  assert (fp.gcount () == sizeof (numChannels));
-  assert (numChannels == 1 || numChannels == 2);
-
   //      24        4   SampleRate       8000, 44100, etc.
-  fp.read ((char *) &sampleRate, sizeof (sampleRate));
-  assert (fp.gcount () == sizeof (sampleRate));
-  assert (sampleRate >= 8000 && sampleRate <= 96000);
-
   //      28        4   ByteRate         == SampleRate * NumChannels * BitsPerSample/8
-  //int byteRate = sampleRate * numChannels * bitsPerSample/8;
-  int byteRate;
-  fp.read ((char *) &byteRate, sizeof (byteRate));
-  assert (fp.gcount () == sizeof (byteRate));
-
   //      32        2   BlockAlign       == NumChannels * BitsPerSample/8
   //                                                                 The number of bytes for one sample including
   //                                                                 all channels. I wonder what happens when
   //                                                                 this number isn't an integer?
-  short blockAlign;
-  fp.read ((char *) &blockAlign, sizeof (blockAlign));
-  assert (fp.gcount () == sizeof (blockAlign));
-
   //      34        2   BitsPerSample    8 bits = 8, 16 bits = 16, etc.
   //                        2   ExtraParamSize   if PCM, then doesn't exist
   //                        X   ExtraParams      space for extra parameters
-  fp.read ((char *) &bitsPerSample, sizeof (bitsPerSample));
-  assert (fp.gcount () == sizeof (bitsPerSample));
-  assert (bitsPerSample % 8 == 0);
+  int byteRate;
+  short blockAlign;
+  if (!readField (fp, &audioFormat, sizeof (audioFormat))
+      || !readField (fp, &numChannels, sizeof (numChannels))
+      || !readField (fp, &sampleRate, sizeof (sampleRate))
+      || !readField (fp, &byteRate, sizeof (byteRate))
+      || !readField (fp, &blockAlign, sizeof (blockAlign))
+      || !readField (fp, &bitsPerSample, sizeof (bitsPerSample)))
+    return WAV_ERR_TRUNCATED;
+
+  if (audioFormat != WAVE_FORMAT_PCM
+      && audioFormat != WAVE_FORMAT_IEEE_FLOAT
+      && audioFormat != WAVE_FORMAT_EXTENSIBLE)
+    return WAV_ERR_UNSUPPORTED;
+
+  if (numChannels < 1 || bitsPerSample < 8 || bitsPerSample % 8 != 0)
+    return WAV_ERR_BAD_FORMAT;
+
+  if (sampleRate < MIN_SAMPLE_RATE || sampleRate > MAX_SAMPLE_RATE)
+    return WAV_ERR_UNSUPPORTED;
+
+  // Check in 64 bits, as a corrupt header could overflow an int
+  int64_t bytesPerFrame = (int64_t) numChannels * bitsPerSample / 8;
+  if (byteRate != sampleRate * bytesPerFrame || blockAlign != bytesPerFrame)
+    return WAV_ERR_BAD_FORMAT;
+
+  // WAVE_FORMAT_EXTENSIBLE appends the real format to the fmt chunk:
+  //
+  //      36        2   ExtraParamSize   22
+  //      38        2   ValidBitsPerSample
+  //      40        4   ChannelMask      Speaker position of each channel
+  //      44       16   SubFormat        GUID whose first 2 bytes are the format code
+  if (audioFormat == WAVE_FORMAT_EXTENSIBLE)
+    {
+      char extension[24];
+      if (fmtChunkSize < 40 || !readField (fp, extension, sizeof (extension)))
+	return WAV_ERR_BAD_FORMAT;
+
+      memcpy (&audioFormat, extension + 8, sizeof (audioFormat));
+      if (audioFormat != WAVE_FORMAT_PCM
+	  && audioFormat != WAVE_FORMAT_IEEE_FLOAT)
+	return WAV_ERR_UNSUPPORTED;
+    }
 
-  assert (byteRate == sampleRate * numChannels * bitsPerSample / 8);
-  assert (blockAlign == numChannels * bitsPerSample / 8);
+  if (audioFormat == WAVE_FORMAT_PCM && bitsPerSample > 32)
+    return WAV_ERR_UNSUPPORTED;
+  if (audioFormat == WAVE_FORMAT_IEEE_FLOAT
+      && bitsPerSample != 32 && bitsPerSample != 64)
+    return WAV_ERR_UNSUPPORTED;
 
   // -- "data" subchunk --
+  fp.clear ();
   fp.seekg (wavChunkPos);
-  int dataChunkSize = findChunk (fp, "data");
-  assert (dataChunkSize > 0);
+  uint32_t dataChunkSize32;
+  if (!findChunk (fp, "data", dataChunkSize32))
+    return WAV_ERR_NO_DATA;
+
+  uint64_t dataChunkSize = dataChunkSize32;
+  if (rf64 && dataChunkSize32 == 0xFFFFFFFF)
+    dataChunkSize = ds64DataSize;
 
   numSamples = dataChunkSize / blockAlign;
 
-  return numSamples;
+  return WAV_OK;
 }
 
 
 
 // Write the wav header
-// If successful, return the number of samples
-int
+// If successful, return the size of the audio data in bytes
+//
+// A 36-byte chunk always follows "WAVE": "JUNK" for RIFF files, or "ds64" for
+// RF64 files, which are used when the data is too big for 32-bit sizes. As both
+// headers are the same length, a streaming writer can start with a RIFF header
+// and overwrite it with an RF64 one if the file grows past 4 GB.
+int64_t
 writeWavHeader (ostream & fp,
 		const int sampleRate,
-		const int numSamples,
-		const short numChannels, const short bitsPerSample)
+		const int64_t numSamples,
+		const short numChannels, const short bitsPerSample,
+		const short audioFormat)
 {
   checkProcessorEndianness ();
 
   assert (sampleRate >= 8000 && sampleRate <= 96000);
   assert (numSamples >= 0);
-  assert (numChannels == 1 || numChannels == 2);
-  assert (bitsPerSample == 8 || bitsPerSample == 16);
+  assert (numChannels >= 1);
+  assert ((int64_t) numChannels * bitsPerSample / 8 <= SHRT_MAX);
+  assert (sampleRate * ((int64_t) numChannels * bitsPerSample / 8) <= INT_MAX);
+  if (audioFormat == WAVE_FORMAT_PCM)
+    assert (bitsPerSample == 8 || bitsPerSample == 16 || bitsPerSample == 24
+	    || bitsPerSample == 32);
+  else
+    assert (audioFormat == WAVE_FORMAT_IEEE_FLOAT
+	    && (bitsPerSample == 32 || bitsPerSample == 64));
   assert (sizeof (int) == 4);
   assert (sizeof (short) == 2);
 
+  // The plain PCM header can't describe floats, more than 2 channels or more
+  // than 16 bits unambiguously, so those use WAVE_FORMAT_EXTENSIBLE.
+  bool extensible = (audioFormat != WAVE_FORMAT_PCM || numChannels > 2
+		     || bitsPerSample > 16);
+
   //      The canonical WAVE format starts with the RIFF header:
   //
   //      0         4   ChunkID          Contains the letters "RIFF" in ASCII form
   //                                                                 (0x52494646 big-endian form).
+  int subChunk1Size = extensible ? 40 : 16;
+  int64_t subChunk2Size = numSamples * numChannels * bitsPerSample / 8;
+  int64_t riffSize =
+    4 + (8 + JUNK_CHUNK_SIZE) + (8 + subChunk1Size) + (8 + subChunk2Size) +
+    (subChunk2Size & 1);
+  bool rf64 = riffSize > 0xFFFFFFFF;
+
   //size_t numWritten;
-  fp.write ("RIFF", 4);
+  fp.write (rf64 ? "RF64" : "RIFF", 4);
   //assert(fp.)
 
   //      4         4   ChunkSize        36 + SubChunk2Size, or more precisely:
@@ -274,8 +521,8 @@ writeWavHeader (ostream & fp,
   //                                                                 entire file in bytes minus 8 bytes for the
   //                                                                 two fields not included in this count:
   //                                                                 ChunkID and ChunkSize.
-  int subChunk2Size = numSamples * numChannels * bitsPerSample / 8;
-  int chunkSize = 36 + subChunk2Size;
+  //                                                                 0xFFFFFFFF for RF64.
+  uint32_t chunkSize = rf64 ? 0xFFFFFFFF : (uint32_t) riffSize;
 
   fp.write ((char *) &chunkSize, sizeof (chunkSize));
 
@@ -283,6 +530,28 @@ writeWavHeader (ostream & fp,
   //                                                                 (0x57415645 big-endian form).
   fp.write ("WAVE", 4);
 
+  //      12        4   ChunkID          "JUNK", or "ds64" for RF64
+  //      16        4   ChunkSize        28
+  //      20        8   RiffSize         64-bit sizes, for RF64 only
+  //      28        8   DataSize
+  //      36        8   SampleCount
+  //      44        4   TableLength      0
+  //
+  //      The offsets in the rest of the header are shifted by these 36 bytes.
+  fp.write (rf64 ? "ds64" : "JUNK", 4);
+  fp.write ((char *) &JUNK_CHUNK_SIZE, sizeof (JUNK_CHUNK_SIZE));
+
+  uint64_t ds64[3] = { 0, 0, 0 };
+  uint32_t tableLength = 0;
+  if (rf64)
+    {
+      ds64[0] = riffSize;
+      ds64[1] = subChunk2Size;
+      ds64[2] = numSamples;
+    }
+  fp.write ((char *) ds64, sizeof (ds64));
+  fp.write ((char *) &tableLength, sizeof (tableLength));
+
   //      The "WAVE" format consists of two subchunks: "fmt " and "data":
   //      The "fmt " subchunk describes the sound data's format:
   //
@@ -290,16 +559,14 @@ writeWavHeader (ostream & fp,
   //                                                                 (0x666d7420 big-endian form).
   fp.write ("fmt ", 4);
 
-  //      16        4   Subchunk1Size    16 for PCM.  This is the size of the
+  //      16        4   Subchunk1Size    16 for PCM, 40 for extensible.  This is the size of the
   //                                                                 rest of the Subchunk which follows this number.
-  int subChunk1Size = 16;
   fp.write ((char *) &subChunk1Size, sizeof (subChunk1Size));
 
   //      20        2   AudioFormat      PCM = 1 (i.e. Linear quantization)
-  //                                                                 Values other than 1 indicate some
-  //                                                                 form of compression.
-  short audioFormat = 1;
-  fp.write ((char *) &audioFormat, sizeof (audioFormat));
+  //                                                                 or extensible = 0xFFFE.
+  short formatTag = extensible ? (short) WAVE_FORMAT_EXTENSIBLE : audioFormat;
+  fp.write ((char *) &formatTag, sizeof (formatTag));
 
   //      22        2   NumChannels      Mono = 1, Stereo = 2, etc.
   fp.write ((char *) &numChannels, sizeof (numChannels));
@@ -308,7 +575,7 @@ writeWavHeader (ostream & fp,
   fp.write ((char *) &sampleRate, sizeof (sampleRate));
 
   //      28        4   ByteRate         == SampleRate * NumChannels * BitsPerSample/8
-  int byteRate = sampleRate * numChannels * bitsPerSample / 8;
+  int byteRate = sampleRate * (numChannels * bitsPerSample / 8);
   fp.write ((char *) &byteRate, sizeof (byteRate));
 
   //      32        2   BlockAlign       == NumChannels * BitsPerSample/8
@@ -323,6 +590,27 @@ writeWavHeader (ostream & fp,
   //                        X   ExtraParams      space for extra parameters
   fp.write ((char *) &bitsPerSample, sizeof (bitsPerSample));
 
+  //      36        2   ExtraParamSize   22 for extensible
+  //      38        2   ValidBitsPerSample
+  //      40        4   ChannelMask      Speaker position of each channel
+  //      44       16   SubFormat        GUID whose first 2 bytes are the format code
+  if (extensible)
+    {
+      short extraParamSize = 22;
+      fp.write ((char *) &extraParamSize, sizeof (extraParamSize));
+      fp.write ((char *) &bitsPerSample, sizeof (bitsPerSample));
+
+      // Assign the first channels to the standard speaker positions, in order
+      int channelMask = numChannels <= 18 ? (1 << numChannels) - 1 : 0;
+      fp.write ((char *) &channelMask, sizeof (channelMask));
+
+      unsigned char subFormat[16] = { 0, 0, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
+	0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71
+      };
+      memcpy (subFormat, &audioFormat, sizeof (audioFormat));
+      fp.write ((char *) subFormat, sizeof (subFormat));
+    }
+
   //      The "data" subchunk contains the size of the data and the actual sound:
   //
   //      36        4   Subchunk2ID      Contains the letters "data"
@@ -334,7 +622,8 @@ writeWavHeader (ostream & fp,
   //                                                                 You can also think of this as the size
   //                                                                 of the read of the subchunk following this
   //                                                                 number.
-  fp.write ((char *) &subChunk2Size, sizeof (subChunk2Size));
+  uint32_t dataSize32 = rf64 ? 0xFFFFFFFF : (uint32_t) subChunk2Size;
+  fp.write ((char *) &dataSize32, sizeof (dataSize32));
 
   return subChunk2Size;
 
@@ -349,142 +638,485 @@ writeWavHeader (ostream & fp,
 
 
 // Write an audio file.
-void
+WavStatus
 audioWrite (const std::string & path, const std::vector < float >&x, int sr,
 	    int numCh)
 {
-  // Open the output wav file
-  ofstream outStream (path.c_str (), ios::out | ios::binary);
-  assert (outStream.is_open ());
-
   // Get the number of samples
-  int numSamples = (int) x.size () / numCh;
-  assert (numSamples > 0);
+  assert (numCh > 0);
+  int64_t numSamples = x.size () / numCh;
 
-  // Write the wav header
-  writeWavHeader (outStream, sr, numSamples, numCh, BITS_PER_SAMPLE);
+  // Open the output wav file and write the header
+  WavWriter writer;
+  WavStatus status = writer.open (path, sr, numCh, BITS_PER_SAMPLE);
+  if (status != WAV_OK)
+    return status;
 
-  // Convert the samples from normalized [-1.0, 1.0] floating-point to 16-bit shorts
-  vector < short >shortBuf (numSamples * numCh);
-  float *src = (float *) x.data ();
-  short *dst = shortBuf.data ();
-  for (int i = 0; i < numSamples * numCh; i++)
+  // Write the audio data. The writer converts it to 16-bit shorts a block at a time.
+  for (int64_t i = 0; i < numSamples; i += BLOCK_FRAMES)
     {
-      float flt = *src++;
-      flt = std::min < float >(flt, 1.0);
-      flt = std::max < float >(flt, -1.0);
-      *dst++ = SHRT_MAX * flt;
+      int n = (int) std::min < int64_t > (BLOCK_FRAMES, numSamples - i);
+      writer.write (x.data () + i * numCh, n);
     }
 
-  // Write the audio data
-  outStream.write ((char *) shortBuf.data (),
-		   numCh * numSamples * sizeof (shortBuf[0]));
-  outStream.flush ();
-
   // Close the file
-  outStream.close ();
+  return writer.close ();
 }
 
 // Write an audio file starting from split (non-interleaved) data
-void
+WavStatus
 audioWrite (const string & path, const vector < vector < float >>&x, int sr)
 {
-  vector < float >interleaved;
-  interleaveAudio (x, interleaved);
-  audioWrite (path, interleaved, sr, (int) x.size ());
+  int numCh = (int) x.size ();
+  assert (numCh > 0);
+
+  int64_t numSamples = x[0].size ();
+
+  WavWriter writer;
+  WavStatus status = writer.open (path, sr, numCh, BITS_PER_SAMPLE);
+  if (status != WAV_OK)
+    return status;
+
+  vector < const float *>channels (numCh);
+  for (int64_t i = 0; i < numSamples; i += BLOCK_FRAMES)
+    {
+      for (int ch = 0; ch < numCh; ch++)
+	channels[ch] = x[ch].data () + i;
+
+      int n = (int) std::min < int64_t > (BLOCK_FRAMES, numSamples - i);
+      writer.write (channels.data (), n);
+    }
+
+  return writer.close ();
 }
 
 
 // Read an audio file
-void
+WavStatus
 audioRead (const std::string & path, std::vector < float >&x, int &sr,
 	   int &numCh)
 {
-  checkProcessorEndianness ();
+  x.clear ();
+
+  // Open the input wav file and read the header
+  WavReader reader;
+  WavStatus status = reader.open (path);
+  if (status != WAV_OK)
+    return status;
+
+  sr = reader.sampleRate ();
+  numCh = reader.numChannels ();
+
+  // Adjust output vector to correct size to accomodate the samples, and read
+  // straight into it. Only one block of file bytes is held at a time.
+  x.resize (numCh * reader.numFrames ());
+  int64_t numSamples = 0;
+  int n;
+  while ((n = reader.read (x.data () + numSamples * numCh, BLOCK_FRAMES)) > 0)
+    numSamples += n;
+
+  // A file cut short yields fewer samples than the header promised
+  x.resize (numCh * numSamples);
 
-  // Open the input wav file
-  ifstream inStream (path.c_str (), ios::in | ios::binary);
-  if (!inStream.is_open ())
+  // Close the file
+  reader.close ();
+
+  return reader.truncated ()? WAV_ERR_DATA_TRUNCATED : WAV_OK;
+}
+
+// Read into split (not interleaved) buffers
+WavStatus
+audioRead (const string & path, vector < vector < float >>&x, int &sr)
+{
+  x.clear ();
+
+  WavReader reader;
+  WavStatus status = reader.open (path);
+  if (status != WAV_OK)
+    return status;
+
+  sr = reader.sampleRate ();
+  int numCh = reader.numChannels ();
+
+  x.resize (numCh);
+  for (int ch = 0; ch < numCh; ch++)
+    x[ch].resize (reader.numFrames ());
+
+  vector < float *>channels (numCh);
+  int64_t numSamples = 0;
+  while (true)
     {
-      printf ("Couldn't open %s\n", path.c_str ());
-      assert (inStream.is_open ());
+      for (int ch = 0; ch < numCh; ch++)
+	channels[ch] = x[ch].data () + numSamples;
+
+      int n = reader.read (channels.data (), BLOCK_FRAMES);
+      if (n == 0)
+	break;
+      numSamples += n;
     }
 
-  // Read the wav header
-  int numSamples;
-  short bitsPerSample;
-  short numChannels;
+  for (int ch = 0; ch < numCh; ch++)
+    x[ch].resize (numSamples);
 
-  readWavHeader (inStream, sr, numSamples, numChannels, bitsPerSample);
-  numCh = numChannels;
+  reader.close ();
 
-  assert (sr >= MIN_SAMPLE_RATE && sr <= MAX_SAMPLE_RATE);
-  assert (numCh >= 1);
-  assert (bitsPerSample % 8 == 0);
+  return reader.truncated ()? WAV_ERR_DATA_TRUNCATED : WAV_OK;
+}
 
-  int bytesPerSample = bitsPerSample / 8;
 
-  // Adjust output vector to correct size to accomodate the samples
-  x.resize (numCh * numSamples);
+const char *
+wavStatusString (WavStatus status)
+{
+  switch (status)
+    {
+    case WAV_OK:
+      return "OK";
+    case WAV_ERR_OPEN:
+      return "couldn't open file";
+    case WAV_ERR_NOT_WAVE:
+      return "not a RIFF/RF64 WAVE file";
+    case WAV_ERR_NO_FMT:
+      return "missing or short fmt chunk";
+    case WAV_ERR_BAD_FORMAT:
+      return "inconsistent format fields";
+    case WAV_ERR_UNSUPPORTED:
+      return "unsupported sample format or rate";
+    case WAV_ERR_NO_DATA:
+      return "missing data chunk";
+    case WAV_ERR_TRUNCATED:
+      return "file ends inside the header";
+    case WAV_ERR_DATA_TRUNCATED:
+      return "file ends before the end of its data";
+    case WAV_ERR_IO:
+      return "read or write failed";
+    }
+  return "unknown error";
+}
+
 
-  // Read all the audio data. Since we'll be reading in in multiple formats, we read
-  // it as unsigned bytes
-  vector < uint8_t > audioData (numChannels * numSamples * bytesPerSample);
-  inStream.read ((char *) audioData.data (),
-		 numCh * numSamples * bytesPerSample);
+// -- Streaming reader --
 
-  // Convert to normalized [-1,1] floating point
+WavReader::WavReader ():
+m_sampleRate (0),
+m_numChannels (0),
+m_bitsPerSample (0),
+m_format (WAV_FORMAT_PCM), m_numFrames (0), m_position (0), m_truncated (false),
+m_tap (NULL)
+{
+}
 
-  // Get absolute maximum sample value, e.g. for 16-bit audio abs max value is 2^15 = 32768.
-  float maxSample = 1 << (bitsPerSample - 1);
+WavStatus
+WavReader::open (const string & path)
+{
+  close ();
 
-  // Get scale factor to apply to normalize sum of samples across channels in a single sample frame.
-  float scale = 1.0 / maxSample;
+  m_stream.open (path.c_str (), ios::in | ios::binary);
+  if (!m_stream.is_open ())
+    return WAV_ERR_OPEN;
 
-  uint8_t *src = audioData.data ();
-  for (int i = 0; i < numCh * numSamples; i++)
+  // Read the wav header. This leaves the file position at the start of the audio data.
+  int64_t numSamples;
+  short numChannels;
+  short bitsPerSample;
+  short audioFormat;
+  WavStatus status = readWavHeader (m_stream, m_sampleRate, numSamples,
+				    numChannels, bitsPerSample, audioFormat);
+  if (status != WAV_OK)
     {
-      int32_t sample = 0;
-      uint8_t *sampleBytes = (uint8_t *) (&sample);	// We assume this is little-endian!
+      close ();
+      return status;
+    }
 
-      // Read in the sample value byte-by-byte. Sample is assumed to be stored in
-      // little-endian format in the file, so least-significant byte is always first.
-      for (int b = 0; b < bytesPerSample; b++)
-	{
-	  sampleBytes[b] = *src++;
-	}
+  m_numChannels = numChannels;
+  m_bitsPerSample = bitsPerSample;
+  m_format = (WavSampleFormat) audioFormat;
+  m_position = 0;
 
-      // If it's 1 byte (8 bits) per sample
-      if (bytesPerSample == 1)
-	{
-	  // By convention, 8-bit audio is *unsigned* with sample values from 0 to 255. To
-	  // make it signed, we need to translate 0 to -128.
-	  sample += CHAR_MIN;
-	}
-      // Otherwise, if the most-significant bit of most-significant byte is 1, then
-      // sample is negative, so we need to set the upper bytes to all 1s.
-      else if (sampleBytes[bytesPerSample - 1] & 0x80)
+  // Don't trust the header's size beyond the end of the file, so a corrupt
+  // size can't make callers allocate for data that isn't there
+  streamoff dataStart = m_stream.tellg ();
+  m_stream.seekg (0, ios::end);
+  int64_t available =
+    (m_stream.tellg () - dataStart) / (m_numChannels * m_bitsPerSample / 8);
+  m_stream.seekg (dataStart);
+
+  m_truncated = numSamples > available;
+  m_numFrames = std::min (numSamples, available);
+
+  return WAV_OK;
+}
+
+void
+WavReader::close ()
+{
+  if (m_stream.is_open ())
+    m_stream.close ();
+}
+
+int
+WavReader::read (float *x, int maxFrames)
+{
+  assert (isOpen ());
+
+  int bytesPerSample = m_bitsPerSample / 8;
+  int bytesPerFrame = m_numChannels * bytesPerSample;
+
+  int numRead = 0;
+  while (numRead < maxFrames && m_position < m_numFrames)
+    {
+      // Convert at most one block at a time, so the raw buffer stays small
+      int n = std::min (maxFrames - numRead, BLOCK_FRAMES);
+      n = (int) std::min < int64_t > (n, m_numFrames - m_position);
+
+      m_raw.resize (n * bytesPerFrame);
+      m_stream.read ((char *) m_raw.data (), n * bytesPerFrame);
+      int got = (int) m_stream.gcount () / bytesPerFrame;
+
+      pcmToFloat (m_raw.data (), x + numRead * m_numChannels,
+		  got * m_numChannels, bytesPerSample, m_format);
+      if (m_tap && got > 0)
+	m_tap->tap (x + numRead * m_numChannels, m_numChannels, got);
+      numRead += got;
+      m_position += got;
+
+      // If reading fails part way, stop at the last whole frame
+      if (got < n)
 	{
-	  for (size_t b = bytesPerSample; b < sizeof (sample); b++)
-	    {
-	      sampleBytes[b] = 0xFF;
-	    }
+	  m_numFrames = m_position;
+	  m_truncated = true;
+	  break;
 	}
+    }
 
-      // Apply scale to get normalized mono sample value for this sample frame
-      x[i] = scale * sample;
+  return numRead;
+}
+
+int
+WavReader::read (float *const *x, int maxFrames)
+{
+  m_scratch.resize (BLOCK_FRAMES * m_numChannels);
+
+  int numRead = 0;
+  while (numRead < maxFrames)
+    {
+      int n = read (m_scratch.data (), std::min (maxFrames - numRead,
+						 BLOCK_FRAMES));
+      if (n == 0)
+	break;
+
+      deinterleaveAudio (m_scratch.data (), x, m_numChannels, numRead, n);
+      numRead += n;
     }
 
-  // Close the file
+  return numRead;
+}
+
+
+// -- Streaming writer --
+
+WavWriter::WavWriter ():
+m_sampleRate (0),
+m_numChannels (0),
+m_bitsPerSample (0),
+m_format (WAV_FORMAT_PCM), m_numFrames (0), m_tap (NULL)
+{
+}
+
+WavStatus
+WavWriter::open (const string & path, int sr, int numCh, int bitsPerSample,
+		 WavSampleFormat format)
+{
+  close ();
+
+  // Check the format here, so writeWavHeader's asserts only catch our own mistakes
+  bool validBits = (format == WAV_FORMAT_PCM)
+    ? (bitsPerSample == 8 || bitsPerSample == 16 || bitsPerSample == 24
+       || bitsPerSample == 32)
+    : (format == WAV_FORMAT_FLOAT
+       && (bitsPerSample == 32 || bitsPerSample == 64));
+  if (!validBits || numCh < 1 || numCh > SHRT_MAX
+      || sr < MIN_SAMPLE_RATE || sr > MAX_SAMPLE_RATE)
+    return WAV_ERR_UNSUPPORTED;
+
+  // BlockAlign is a short and ByteRate an int, so the frame and the second must fit them
+  int64_t bytesPerFrame = (int64_t) numCh * bitsPerSample / 8;
+  if (bytesPerFrame > SHRT_MAX || sr * bytesPerFrame > INT_MAX)
+    return WAV_ERR_UNSUPPORTED;
+
+  m_stream.open (path.c_str (), ios::out | ios::binary | ios::trunc);
+  if (!m_stream.is_open ())
+    return WAV_ERR_OPEN;
+
+  // The sizes aren't known yet, so they're written as zero and patched on close
+  writeWavHeader (m_stream, sr, 0, numCh, bitsPerSample, format);
+
+  m_sampleRate = sr;
+  m_numChannels = numCh;
+  m_bitsPerSample = bitsPerSample;
+  m_format = format;
+  m_numFrames = 0;
+
+  return m_stream.good ()? WAV_OK : WAV_ERR_IO;
+}
+
+void
+WavWriter::write (const float *x, int numFrames)
+{
+  assert (isOpen ());
+
+  int bytesPerSample = m_bitsPerSample / 8;
+
+  for (int i = 0; i < numFrames; i += BLOCK_FRAMES)
+    {
+      int n = std::min (numFrames - i, BLOCK_FRAMES) * m_numChannels;
+      if (m_tap)
+	m_tap->tap (x + i * m_numChannels, m_numChannels, n / m_numChannels);
+      m_raw.resize (n * bytesPerSample);
+      floatToPcm (x + i * m_numChannels, m_raw.data (), n, bytesPerSample,
+		  m_format);
+      m_stream.write ((char *) m_raw.data (), n * bytesPerSample);
+    }
+
+  m_numFrames += numFrames;
+}
+
+void
+WavWriter::write (const float *const *x, int numFrames)
+{
+  m_scratch.resize (BLOCK_FRAMES * m_numChannels);
+
+  for (int i = 0; i < numFrames; i += BLOCK_FRAMES)
+    {
+      int n = std::min (numFrames - i, BLOCK_FRAMES);
+      interleaveAudio (x, m_scratch.data (), m_numChannels, i, n);
+      write (m_scratch.data (), n);
+    }
+}
+
+WavStatus
+WavWriter::close ()
+{
+  if (!m_stream.is_open ())
+    return WAV_OK;
+
+  int64_t subChunk2Size = m_numFrames * m_numChannels * m_bitsPerSample / 8;
+
+  // Chunks must be word aligned, so an odd-sized data chunk gets a pad byte
+  if (subChunk2Size % 2)
+    m_stream.put (0);
+
+  // Rewrite the header with the final sizes. It's the same length either way, but
+  // becomes an RF64 header if the data outgrew 32-bit sizes.
+  m_stream.seekp (0);
+  writeWavHeader (m_stream, m_sampleRate, m_numFrames, m_numChannels,
+		  m_bitsPerSample, m_format);
+  m_stream.flush ();
+
+  // A full disk or similar shows up as a failed stream
+  WavStatus status = m_stream.good ()? WAV_OK : WAV_ERR_IO;
+  m_stream.close ();
+
+  return status;
+}
+
+
+// -- Memory-mapped view --
+
+MappedWav::MappedWav ():
+m_map (NULL),
+m_mapSize (0),
+m_data (NULL),
+m_sampleRate (0),
+m_numChannels (0),
+m_bitsPerSample (0), m_format (WAV_FORMAT_PCM), m_numFrames (0)
+{
+}
+
+WavStatus
+MappedWav::open (const string & path)
+{
+  close ();
+
+  // Use the regular header parser to find the format and the data chunk offset
+  ifstream inStream (path.c_str (), ios::in | ios::binary);
+  if (!inStream.is_open ())
+    return WAV_ERR_OPEN;
+
+  int64_t numSamples;
+  short numChannels;
+  short bitsPerSample;
+  short audioFormat;
+  WavStatus status = readWavHeader (inStream, m_sampleRate, numSamples,
+				    numChannels, bitsPerSample, audioFormat);
+  int64_t dataOffset = inStream.tellg ();
   inStream.close ();
+
+  if (status != WAV_OK)
+    return status;
+
+  // Map the whole file read-only
+  int fd = ::open (path.c_str (), O_RDONLY);
+  if (fd < 0)
+    return WAV_ERR_OPEN;
+
+  // An empty data chunk can end the file, so it's only missing if the file ends before it
+  struct stat st;
+  if (fstat (fd, &st) != 0 || st.st_size < dataOffset)
+    {
+      ::close (fd);
+      return WAV_ERR_NO_DATA;
+    }
+
+  void *map = mmap (NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+  ::close (fd);			// The mapping stays valid after the descriptor is closed
+  if (map == MAP_FAILED)
+    return WAV_ERR_IO;
+
+  // Scans are typically front to back, so ask for aggressive read-ahead
+  madvise (map, st.st_size, MADV_SEQUENTIAL);
+
+  m_map = map;
+  m_mapSize = st.st_size;
+  m_data = (const uint8_t *) map + dataOffset;
+  m_numChannels = numChannels;
+  m_bitsPerSample = bitsPerSample;
+  m_format = (WavSampleFormat) audioFormat;
+
+  // If the file is shorter than its header says, only expose the whole frames that are there
+  int bytesPerFrame = m_numChannels * m_bitsPerSample / 8;
+  m_numFrames = std::min < int64_t > (numSamples,
+				      (m_mapSize - dataOffset) / bytesPerFrame);
+
+  return WAV_OK;
 }
 
-// Read into split (not interleaved) buffers
 void
-audioRead (const string & path, vector < vector < float >>&x, int &sr)
+MappedWav::close ()
+{
+  if (m_map != NULL)
+    {
+      munmap (m_map, m_mapSize);
+      m_map = NULL;
+      m_mapSize = 0;
+      m_data = NULL;
+      m_numFrames = 0;
+    }
+}
+
+int
+MappedWav::read (int64_t startFrame, float *x, int numFrames) const
 {
-  int numCh;
-  vector < float >interleaved;
-  audioRead (path, interleaved, sr, numCh);
-  deinterleaveAudio (interleaved, x, numCh);
+  assert (isOpen ());
+  assert (startFrame >= 0);
+
+  if (startFrame >= m_numFrames)
+    return 0;
+
+  int n = (int) std::min < int64_t > (numFrames, m_numFrames - startFrame);
+  int bytesPerSample = m_bitsPerSample / 8;
+
+  pcmToFloat (m_data + startFrame * m_numChannels * bytesPerSample, x,
+	      n * m_numChannels, bytesPerSample, m_format);
+
+  return n;
 }
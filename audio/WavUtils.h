@@ -11,25 +11,81 @@
 
 #include <vector>
 #include <string>
+#include <fstream>
+#include <cstdint>
+#include <cassert>
+#include <type_traits>
 
 using namespace std;
 
+/// How samples are encoded in an audio file. The values are the wav format codes.
+enum WavSampleFormat
+{
+	WAV_FORMAT_PCM = 1,		// Integer samples: 8-bit unsigned, or 16/24/32-bit signed
+	WAV_FORMAT_FLOAT = 3	// IEEE floating-point samples: 32 or 64-bit
+};
+
+/// Result of opening, reading or writing an audio file. Problems with the file's contents
+/// are reported this way rather than asserted, since files come from outside the program.
+enum WavStatus
+{
+	WAV_OK = 0,
+	WAV_ERR_OPEN,			// File couldn't be opened or created
+	WAV_ERR_NOT_WAVE,		// No RIFF/RF64 WAVE signature
+	WAV_ERR_NO_FMT,			// No fmt chunk, or one too short to hold the format
+	WAV_ERR_BAD_FORMAT,		// Format fields contradict each other (e.g. block align)
+	WAV_ERR_UNSUPPORTED,	// Valid, but a sample format or rate we don't handle
+	WAV_ERR_NO_DATA,		// No data chunk
+	WAV_ERR_TRUNCATED,		// File ends inside the header
+	WAV_ERR_DATA_TRUNCATED,	// File ends before the data the header gives; what is there is read
+	WAV_ERR_IO				// Read or write failed part way
+};
+
+/// Returns a printable description of a status, e.g. "missing data chunk"
+const char *wavStatusString(WavStatus status);
+
+typedef char FOURCC[4];
+
+/// Searches forward from the current position for a chunk, skipping any others
+///
+///	@param	fp			Stream positioned at a chunk header
+/// @param	fourcc		Chunk ID to look for, e.g. "data"
+/// @param	chunkSize	Size of the chunk found
+/// @return				true if found, with fp positioned at the chunk's contents
+///
+bool findChunk(istream &fp, const FOURCC fourcc, uint32_t &chunkSize);
+
+/// Parses a wav header, leaving the stream positioned at the first sample
+///
+///	@param	inStream		Stream positioned at the start of the file
+///	@param	sampleRate		Sample rate (e.g. 44100)
+///	@param	numSamples		Number of sample frames, as the header gives it
+///	@param	numChannels		Number of channels
+///	@param	bitsPerSample	Bits per sample
+///	@param	audioFormat		WAV_FORMAT_PCM or WAV_FORMAT_FLOAT
+/// @return					WAV_OK, or what is wrong with the header
+///
+WavStatus readWavHeader(istream &inStream, int &sampleRate, int64_t &numSamples,
+						short &numChannels, short &bitsPerSample, short &audioFormat);
+
 /// Writes an audio file from an interleaved buffer
 ///
 ///	@param	path	Path to audio file to write
 ///	@param	x		Audio data. Will be clipped if outside [-1, 1] range.
 /// @param	sr		Sample rate of audio data (e.g. 44100)
 /// @param  numCh   Number of channels (e.g. 2 for stereo)
+/// @return			WAV_OK, or why the file couldn't be written
 ///
-void audioWrite(const string& path, const vector<float> &x, int sr, int numCh = 1);
+WavStatus audioWrite(const string& path, const vector<float> &x, int sr, int numCh = 1);
 
 /// Writes an audio file from non-interleaved audio
 ///
 ///	@param	path	Path to audio file to write
 ///	@param	x		Audio data. Will be clipped if outside [-1, 1] range.
 /// @param	sr		Sample rate of audio data (e.g. 44100)
+/// @return			WAV_OK, or why the file couldn't be written
 ///
-void audioWrite(const string& path, const vector<vector<float>> &x, int sr);
+WavStatus audioWrite(const string& path, const vector<vector<float>> &x, int sr);
 
 /// Reads an audio file into interleaved buffer
 ///
@@ -37,16 +93,259 @@ void audioWrite(const string& path, const vector<vector<float>> &x, int sr);
 ///	@param	y		Audio data. Full scale is [-1, 1], regardless of the bit-depth.
 ///	@param	sr		Sample rate (e.g. 44100)
 /// @param  numCh   Number of channels (e.g. 2 for stereo)
+/// @return			WAV_OK, or why the file couldn't be read. x is empty if it couldn't be opened,
+///					and holds the audio that is there if the file is cut short
+///					(WAV_ERR_DATA_TRUNCATED).
 ///
-void audioRead(const string& path, vector<float> &x, int &sr, int &numCh);
+WavStatus audioRead(const string& path, vector<float> &x, int &sr, int &numCh);
 
 /// Reads an audio file into non-interleaved buffers
 ///
 ///	@param	path	Path to audio file to read
 ///	@param	y		Audio data. Full scale is [-1, 1], regardless of the bit-depth.
 ///	@param	sr		Sample rate (e.g. 44100)
+/// @return			WAV_OK, or why the file couldn't be read. x is empty if it couldn't be opened,
+///					and holds the audio that is there if the file is cut short
+///					(WAV_ERR_DATA_TRUNCATED).
+///
+WavStatus audioRead(const string& path, vector<vector<float>> &x, int &sr);
+
+/// Splits interleaved audio into one buffer per channel
+///
+///	@param	interleaved	Audio data, numCh * numFrames samples
+///	@param	split		numCh buffers of numFrames samples
+/// @param  numCh   	Number of channels, any number
+/// @param	numFrames	Number of sample frames
 ///
-void audioRead(const string& path, vector<vector<float>> &x, int &sr);
+void deinterleave(const float *interleaved, float *const *split, int numCh, int numFrames);
+
+/// Merges one buffer per channel into interleaved audio
+///
+///	@param	split		numCh buffers of numFrames samples
+///	@param	interleaved	Audio data, numCh * numFrames samples
+/// @param  numCh   	Number of channels, any number
+/// @param	numFrames	Number of sample frames
+///
+void interleave(const float *const *split, float *interleaved, int numCh, int numFrames);
+
+/// A 24-bit sample as stored in a wav file (little-endian, two's complement)
+struct Int24
+{
+	uint8_t b[3];
+
+	int32_t value() const
+	{
+		// Assemble in the upper 3 bytes, then shift down to sign-extend
+		return (int32_t)((uint32_t)b[0] << 8 | (uint32_t)b[1] << 16 | (uint32_t)b[2] << 24) >> 8;
+	}
+};
+
+/// Zero-copy view of an audio file. The file is memory-mapped and the samples in its data
+/// chunk are used in place; they are only converted to float for the regions that are read.
+class MappedWav
+{
+public:
+
+	MappedWav();
+	~MappedWav() { close(); }
+
+	// It owns the mapping, so it can't be copied
+	MappedWav(const MappedWav&) = delete;
+	MappedWav& operator=(const MappedWav&) = delete;
+
+	/// Maps an audio file into memory and locates its data chunk
+	///
+	///	@param	path	Path to audio file to map
+	/// @return			WAV_OK, or why the file couldn't be opened or mapped
+	///
+	WavStatus open(const string& path);
+	void close();
+
+	bool isOpen() const { return m_map != NULL; }
+	int sampleRate() const { return m_sampleRate; }
+	int numChannels() const { return m_numChannels; }
+	int bitsPerSample() const { return m_bitsPerSample; }
+	WavSampleFormat sampleFormat() const { return m_format; }
+	int64_t numFrames() const { return m_numFrames; }
+
+	/// Raw bytes of the data chunk
+	const uint8_t *data() const { return m_data; }
+
+	/// Interleaved samples of the data chunk in their stored type: uint8_t for 8-bit,
+	/// int16_t for 16-bit, Int24 for 24-bit and int32_t for 32-bit integer audio, and
+	/// float or double for floating-point audio.
+	template <typename T>
+	const T *samples() const
+	{
+		assert(sizeof(T) * 8 == m_bitsPerSample);
+		assert(is_floating_point<T>::value == (m_format == WAV_FORMAT_FLOAT));
+		return (const T *)m_data;
+	}
+
+	/// Converts a region of the file to an interleaved float buffer
+	///
+	/// @param	startFrame	First sample frame to convert
+	///	@param	x			Audio data, numChannels() * numFrames samples. Full scale is [-1, 1].
+	/// @param	numFrames	Maximum number of sample frames to convert
+	/// @return				Number of sample frames converted; fewer at the end of the file
+	///
+	int read(int64_t startFrame, float *x, int numFrames) const;
+
+private:
+
+	void *m_map;			// Whole file, as mapped
+	size_t m_mapSize;
+	const uint8_t *m_data;	// Start of the data chunk within the mapping
+	int m_sampleRate;
+	int m_numChannels;
+	int m_bitsPerSample;
+	WavSampleFormat m_format;
+	int64_t m_numFrames;
+};
+
+/// Sees the audio going through a WavReader or WavWriter, a block at a time, e.g. to meter
+/// it on the way without reading the file again
+class AudioTap
+{
+public:
+
+	virtual ~AudioTap() {}
+
+	/// Called with each block read or written
+	///
+	///	@param	x			Interleaved audio, numCh * numFrames samples. Full scale is [-1, 1];
+	///						a writer passes it on before it's clipped.
+	/// @param  numCh   	Number of channels
+	/// @param	numFrames	Number of sample frames
+	///
+	virtual void tap(const float *x, int numCh, int numFrames) = 0;
+};
+
+/// Reads an audio file a block of sample frames at a time, so memory use is bounded by
+/// the block size rather than by the length of the file.
+class WavReader
+{
+public:
+
+	WavReader();
+	~WavReader() { close(); }
+
+	/// Opens an audio file and reads its header
+	///
+	///	@param	path	Path to audio file to read
+	/// @return			WAV_OK, or why the file couldn't be opened
+	///
+	WavStatus open(const string& path);
+	void close();
+
+	bool isOpen() const { return m_stream.is_open(); }
+	int sampleRate() const { return m_sampleRate; }
+	int numChannels() const { return m_numChannels; }
+	int bitsPerSample() const { return m_bitsPerSample; }
+	WavSampleFormat sampleFormat() const { return m_format; }
+	int64_t numFrames() const { return m_numFrames; }	// Total number of sample frames in the file
+	int64_t position() const { return m_position; }		// Number of sample frames read so far
+
+	/// True if the header claimed more audio than the file holds, or reading stopped
+	/// short; numFrames() is then what is actually there
+	bool truncated() const { return m_truncated; }
+
+	/// Reads the next block of audio into an interleaved buffer
+	///
+	///	@param	x			Audio data, numChannels() * maxFrames samples. Full scale is [-1, 1].
+	/// @param	maxFrames	Maximum number of sample frames to read
+	/// @return				Number of sample frames read; 0 at the end of the file
+	///
+	int read(float *x, int maxFrames);
+
+	/// Reads the next block of audio into non-interleaved buffers
+	///
+	///	@param	x			One buffer of maxFrames samples per channel. Full scale is [-1, 1].
+	/// @param	maxFrames	Maximum number of sample frames to read
+	/// @return				Number of sample frames read; 0 at the end of the file
+	///
+	int read(float *const *x, int maxFrames);
+
+	/// Passes every block read from now on to a tap, or stops if tap is NULL. It isn't owned.
+	void setTap(AudioTap *tap) { m_tap = tap; }
+
+private:
+
+	ifstream m_stream;
+	int m_sampleRate;
+	int m_numChannels;
+	int m_bitsPerSample;
+	WavSampleFormat m_format;
+	int64_t m_numFrames;
+	int64_t m_position;
+	bool m_truncated;
+	AudioTap *m_tap;
+	vector<uint8_t> m_raw;		// File bytes for one block
+	vector<float> m_scratch;	// Interleaved samples for one block, used by the non-interleaved read
+};
+
+/// Writes an audio file a block of sample frames at a time. The header is written with
+/// zero sizes when the file is opened, and patched with the real sizes when it is closed.
+/// Files whose data grows past 4 GB are written as RF64, so there's no length limit.
+class WavWriter
+{
+public:
+
+	WavWriter();
+	~WavWriter() { close(); }
+
+	/// Creates an audio file and writes a provisional header
+	///
+	///	@param	path			Path to audio file to write
+	/// @param	sr				Sample rate of audio data (e.g. 44100)
+	/// @param  numCh   		Number of channels (e.g. 2 for stereo)
+	/// @param  bitsPerSample	8, 16, 24 or 32 for integer samples; 32 or 64 for floating point
+	/// @param	format			Integer or floating-point samples
+	/// @return					WAV_OK, WAV_ERR_UNSUPPORTED for a format we can't write,
+	///							including frames over 32767 bytes or seconds over INT_MAX bytes,
+	///							or WAV_ERR_OPEN if the file couldn't be created
+	///
+	WavStatus open(const string& path, int sr, int numCh = 1, int bitsPerSample = 16,
+			  WavSampleFormat format = WAV_FORMAT_PCM);
+
+	/// Patches the chunk sizes in the header and closes the file
+	///
+	/// @return		WAV_ERR_IO if any write failed (e.g. the disk is full)
+	///
+	WavStatus close();
+
+	bool isOpen() const { return m_stream.is_open(); }
+	int64_t numFrames() const { return m_numFrames; }	// Number of sample frames written so far
+
+	/// Appends a block of interleaved audio
+	///
+	///	@param	x			Audio data, numCh * numFrames samples. Integer formats clip it to [-1, 1].
+	/// @param	numFrames	Number of sample frames to write
+	///
+	void write(const float *x, int numFrames);
+
+	/// Appends a block of non-interleaved audio
+	///
+	///	@param	x			One buffer of numFrames samples per channel. Integer formats clip it to [-1, 1].
+	/// @param	numFrames	Number of sample frames to write
+	///
+	void write(const float *const *x, int numFrames);
+
+	/// Passes every block written from now on to a tap, or stops if tap is NULL. It isn't owned.
+	void setTap(AudioTap *tap) { m_tap = tap; }
+
+private:
+
+	ofstream m_stream;
+	int m_sampleRate;
+	int m_numChannels;
+	int m_bitsPerSample;
+	WavSampleFormat m_format;
+	int64_t m_numFrames;
+	AudioTap *m_tap;
+	vector<uint8_t> m_raw;		// File bytes for one block
+	vector<float> m_scratch;	// Interleaved samples for one block, used by the non-interleaved write
+};
 
 
 #endif
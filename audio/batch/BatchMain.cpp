@@ -0,0 +1,256 @@
+// =================================================================================================
+// BatchMain.cpp
+//
+// Runs an effect chain over many audio files, several files at a time.
+//
+// Usage: batch.out -c chain -o outDir [-j threads] [-l] input...
+//   Each input is a wav file, a directory (every .wav file in it), or a manifest: a text
+//   file listing one input file per line, with blank lines and lines starting with #
+//   ignored. Each output has its input's name and format, and goes in outDir.
+//   -j sets the number of files processed at once (default one per hardware thread), and
+//   -l measures each output's loudness and true peak.
+//
+// Each file streams through the chain a block at a time, so memory doesn't grow with the
+// length of the files. The biggest files are queued first, so that a long file started
+// last doesn't hold up the end of the batch.
+// =================================================================================================
+
+#include "Chain.h"
+#include "WorkStealingPool.h"
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <dirent.h>
+#include <fstream>
+#include <mutex>
+#include <set>
+#include <sys/stat.h>
+
+struct Job
+{
+  string inPath;
+  string outPath;
+  int64_t bytes;		// Size of the input file
+};
+
+static void
+usage ()
+{
+  fprintf (stderr,
+	   "Usage: batch.out -c chain -o outDir [-j threads] [-l] input...\n"
+	   "  input     A wav file, a directory of them, or a manifest listing them\n"
+	   "  -c chain  Stages separated by commas, e.g. lpf:400,gain:0.5\n"
+	   "  -o dir    Where the outputs go; created if need be\n"
+	   "  -j n      Files processed at once (default: one per hardware thread)\n"
+	   "  -l        Measure each output's loudness and true peak\n"
+	   "Stages:\n%s", chainHelp ());
+}
+
+static bool
+endsWith (const string & s, const string & suffix)
+{
+  return s.size () >= suffix.size ()
+    && s.compare (s.size () - suffix.size (), suffix.size (), suffix) == 0;
+}
+
+static string
+baseName (const string & path)
+{
+  size_t slash = path.rfind ('/');
+  return slash == string::npos ? path : path.substr (slash + 1);
+}
+
+// Adds the wav files an input names. Returns false if it can't be read.
+static bool
+collectInputs (const string & input, vector < string > &paths)
+{
+  struct stat info;
+  if (stat (input.c_str (), &info) != 0)
+    return false;
+
+  if (S_ISDIR (info.st_mode))
+    {
+      DIR *dir = opendir (input.c_str ());
+      if (!dir)
+	return false;
+
+      // Sorted, so a batch always runs in the same order
+      vector < string > names;
+      while (struct dirent * entry = readdir (dir))
+	{
+	  string name = entry->d_name;
+	  if (endsWith (name, ".wav") || endsWith (name, ".WAV"))
+	    names.push_back (name);
+	}
+      closedir (dir);
+
+      sort (names.begin (), names.end ());
+      for (size_t i = 0; i < names.size (); i++)
+	paths.push_back (input + "/" + names[i]);
+      return true;
+    }
+
+  if (endsWith (input, ".wav") || endsWith (input, ".WAV"))
+    {
+      paths.push_back (input);
+      return true;
+    }
+
+  // A manifest
+  ifstream manifest (input.c_str ());
+  if (!manifest.is_open ())
+    return false;
+  string line;
+  while (getline (manifest, line))
+    {
+      line.erase (line.find_last_not_of (" \t\r") + 1);
+      if (!line.empty () && line[0] != '#')
+	paths.push_back (line);
+    }
+  return true;
+}
+
+int
+main (int argc, const char *argv[])
+{
+  string chainSpec, outDir;
+  int numThreads = 0;
+  bool meter = false;
+  vector < string > inputs;
+
+  for (int i = 1; i < argc; i++)
+    {
+      string arg = argv[i];
+      if ((arg == "-c" || arg == "-o" || arg == "-j") && i + 1 < argc)
+	{
+	  string value = argv[++i];
+	  if (arg == "-c")
+	    chainSpec = value;
+	  else if (arg == "-o")
+	    outDir = value;
+	  else
+	    numThreads = atoi (value.c_str ());
+	}
+      else if (arg == "-l")
+	meter = true;
+      else if (!arg.empty () && arg[0] == '-')
+	{
+	  usage ();
+	  return 1;
+	}
+      else
+	inputs.push_back (arg);
+    }
+
+  if (chainSpec.empty () || outDir.empty () || inputs.empty ())
+    {
+      usage ();
+      return 1;
+    }
+
+  vector < ChainStage > stages;
+  string error;
+  if (!parseChain (chainSpec, stages, error))
+    {
+      fprintf (stderr, "Bad chain: %s\n", error.c_str ());
+      return 1;
+    }
+
+  // Every input file, each with its own output
+  vector < string > paths;
+  for (size_t i = 0; i < inputs.size (); i++)
+    if (!collectInputs (inputs[i], paths))
+      {
+	fprintf (stderr, "Couldn't read %s\n", inputs[i].c_str ());
+	return 1;
+      }
+
+  mkdir (outDir.c_str (), 0777);
+  vector < Job > jobs;
+  set < string > outPaths;
+  for (size_t i = 0; i < paths.size (); i++)
+    {
+      Job job;
+      job.inPath = paths[i];
+      job.outPath = outDir + "/" + baseName (paths[i]);
+
+      // An input that can't be found is left to fail when its job runs
+      struct stat in, out;
+      bool inFound = stat (job.inPath.c_str (), &in) == 0;
+      job.bytes = inFound ? in.st_size : 0;
+      bool overwritesInput = inFound && stat (job.outPath.c_str (), &out) == 0
+	&& in.st_dev == out.st_dev && in.st_ino == out.st_ino;
+      if (overwritesInput || !outPaths.insert (job.outPath).second)
+	{
+	  fprintf (stderr, "%s would overwrite %s\n", job.inPath.c_str (),
+		   overwritesInput ? "itself" : "another file's output");
+	  return 1;
+	}
+      jobs.push_back (job);
+    }
+
+  // Biggest first
+  stable_sort (jobs.begin (), jobs.end (), [](const Job & a, const Job & b)
+    {
+      return a.bytes > b.bytes;
+    });
+
+  mutex printMutex;
+  int numDone = 0, numFailed = 0;
+  int64_t totalBytes = 0;
+  double totalSeconds = 0;	// Of audio
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now ();
+  {
+    WorkStealingPool pool (numThreads);
+    printf ("%d files, %d at a time\n", (int) jobs.size (),
+	    pool.numThreads ());
+
+    for (size_t i = 0; i < jobs.size (); i++)
+      {
+	const Job & job = jobs[i];
+	pool.submit ([&, job] ()
+	  {
+	    chrono::steady_clock::time_point fileStart =
+	      chrono::steady_clock::now ();
+	    ChainResult result;
+	    WavStatus status =
+	      runChain (job.inPath, job.outPath, stages, meter, result);
+	    double secs = chrono::duration < double >(chrono::steady_clock::now () -
+						     fileStart).count ();
+
+	    lock_guard < mutex > lock (printMutex);
+	    numDone++;
+	    printf ("[%d/%d] %s", numDone, (int) jobs.size (),
+		    job.inPath.c_str ());
+	    if (status != WAV_OK)
+	      {
+		numFailed++;
+		printf (": %s\n", result.error.c_str ());
+		return;
+	      }
+
+	    totalBytes += job.bytes;
+	    totalSeconds += (double) result.numFrames / result.sampleRate;
+	    printf ("  %.1f MB in %.2f s", job.bytes / 1e6, secs);
+	    if (meter)
+	      printf ("  %.1f LUFS  %.1f dBTP", result.loudness,
+		      result.truePeak);
+	    printf ("\n");
+	    fflush (stdout);
+	  });
+      }
+    pool.wait ();
+  }
+  double wall =
+    chrono::duration < double >(chrono::steady_clock::now () - start).count ();
+
+  printf ("%d files, %d failed, %.1f MB in %.2f s: %.1f files/s, %.1f MB/s, "
+	  "%.0fx realtime\n", numDone, numFailed, totalBytes / 1e6, wall,
+	  (numDone - numFailed) / wall, totalBytes / 1e6 / wall,
+	  totalSeconds / wall);
+
+  return numFailed > 0 ? 1 : 0;
+}
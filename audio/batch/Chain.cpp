@@ -0,0 +1,249 @@
+// =================================================================================================
+// Chain.cpp
+// =================================================================================================
+
+#include "Chain.h"
+#include "../AudioNodes.h"
+#include "../LoudnessMeter.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+// The stages a chain can have, and how many numbers each takes
+struct StageType
+{
+  const char *name;
+  int minArgs;
+  int maxArgs;
+};
+
+static const StageType STAGE_TYPES[] = {
+  {"lpf", 1, 2},
+  {"hpf", 1, 2},
+  {"bpf", 1, 2},
+  {"notch", 1, 2},
+  {"gain", 1, 1},
+  {"balance", 1, 1},
+};
+
+const char *
+chainHelp ()
+{
+  return
+    "  lpf:f[:q]     Low-pass filter, cutoff f Hz, Q q (default 0.707)\n"
+    "  hpf:f[:q]     High-pass filter\n"
+    "  bpf:f[:q]     Band-pass filter, unity gain at f\n"
+    "  notch:f[:q]   Notch filter\n"
+    "  gain:g        Gain, as a factor (e.g. 0.5 for -6 dB)\n"
+    "  balance:b     Stereo balance, -1 (full left) to +1 (full right); stereo files only\n";
+}
+
+static bool
+isFilter (const string & name)
+{
+  return name == "lpf" || name == "hpf" || name == "bpf" || name == "notch";
+}
+
+// Splits s at every sep
+static vector < string > split (const string & s, char sep)
+{
+  vector < string > parts;
+  size_t start = 0;
+  for (;;)
+    {
+      size_t end = s.find (sep, start);
+      parts.push_back (s.substr (start, end - start));
+      if (end == string::npos)
+	return parts;
+      start = end + 1;
+    }
+}
+
+bool
+parseChain (const string & spec, vector < ChainStage > &stages,
+	    string & error)
+{
+  stages.clear ();
+
+  vector < string > stageSpecs = split (spec, ',');
+  for (size_t i = 0; i < stageSpecs.size (); i++)
+    {
+      vector < string > fields = split (stageSpecs[i], ':');
+      ChainStage stage;
+      stage.name = fields[0];
+
+      const StageType *type = NULL;
+      for (size_t t = 0; t < sizeof (STAGE_TYPES) / sizeof (STAGE_TYPES[0]);
+	   t++)
+	if (stage.name == STAGE_TYPES[t].name)
+	  type = &STAGE_TYPES[t];
+      if (!type)
+	{
+	  error = "unknown stage \"" + stageSpecs[i] + "\"";
+	  return false;
+	}
+
+      int numArgs = (int) fields.size () - 1;
+      if (numArgs < type->minArgs || numArgs > type->maxArgs)
+	{
+	  error = "wrong number of values in \"" + stageSpecs[i] + "\"";
+	  return false;
+	}
+
+      for (int a = 1; a <= numArgs; a++)
+	{
+	  const char *text = fields[a].c_str ();
+	  char *end;
+	  double value = strtod (text, &end);
+	  if (end == text || *end != '\0' || !std::isfinite (value))
+	    {
+	      error = "bad number \"" + fields[a] + "\" in \"" + stageSpecs[i] +
+		"\"";
+	      return false;
+	    }
+	  stage.args.push_back (value);
+	}
+
+      // Frequencies and Qs must be positive; the Nyquist frequency isn't known until a
+      // file is opened
+      bool valid = true;
+      if (isFilter (stage.name))
+	valid = stage.args[0] > 0 && (numArgs < 2 || stage.args[1] > 0);
+      else if (stage.name == "balance")
+	valid = stage.args[0] >= -1 && stage.args[0] <= 1;
+      if (!valid)
+	{
+	  error = "value out of range in \"" + stageSpecs[i] + "\"";
+	  return false;
+	}
+
+      stages.push_back (stage);
+    }
+
+  return true;
+}
+
+AudioNode *
+makeChainNode (const ChainStage & stage, int sr, int numCh)
+{
+  if (isFilter (stage.name))
+    {
+      double f0 = stage.args[0];
+      double q = stage.args.size () > 1 ? stage.args[1] : M_SQRT1_2;
+      if (f0 >= 0.5 * sr)
+	return NULL;
+
+      FilterNode *node = new FilterNode (sr, numCh);
+      for (int ch = 0; ch < numCh; ch++)
+	{
+	  FilterNode::Filter & f = node->filter (ch);
+	  if (stage.name == "lpf")
+	    f.initLPF (f0, q);
+	  else if (stage.name == "hpf")
+	    f.initHPF (f0, q);
+	  else if (stage.name == "bpf")
+	    f.initBPF (f0, 1, q);
+	  else
+	    f.initNotch (f0, q);
+	}
+      return node;
+    }
+
+  if (stage.name == "gain")
+    return new GainNode (numCh, stage.args[0]);
+
+  if (stage.name == "balance" && numCh == 2)
+    return new BalanceNode (stage.args[0]);
+
+  return NULL;
+}
+
+// A stage as it was written, e.g. "lpf:400"
+static string
+stageText (const ChainStage & stage)
+{
+  string text = stage.name;
+  for (size_t i = 0; i < stage.args.size (); i++)
+    {
+      char arg[32];
+      snprintf (arg, sizeof (arg), ":%g", stage.args[i]);
+      text += arg;
+    }
+  return text;
+}
+
+WavStatus
+runChain (const string & inPath, const string & outPath,
+	  const vector < ChainStage > &stages, bool meter,
+	  ChainResult & result)
+{
+  result.sampleRate = 0;
+  result.numChannels = 0;
+  result.numFrames = 0;
+  result.loudness = -INFINITY;
+  result.truePeak = -INFINITY;
+  result.error.clear ();
+
+  WavReader reader;
+  WavStatus status = reader.open (inPath);
+  if (status != WAV_OK)
+    {
+      result.error = wavStatusString (status);
+      return status;
+    }
+
+  int sr = reader.sampleRate ();
+  int numCh = reader.numChannels ();
+  result.sampleRate = sr;
+  result.numChannels = numCh;
+
+  // Build the whole chain before creating the output, so a chain that doesn't suit the
+  // file leaves nothing behind
+  vector < unique_ptr < AudioNode > >nodes;
+  nodes.push_back (unique_ptr < AudioNode > (new FileSourceNode (reader)));
+  for (size_t i = 0; i < stages.size (); i++)
+    {
+      AudioNode *node = makeChainNode (stages[i], sr, numCh);
+      if (!node)
+	{
+	  char audio[64];
+	  snprintf (audio, sizeof (audio), "%d-channel %d Hz audio", numCh, sr);
+	  result.error = stageText (stages[i]) + " can't be applied to " + audio;
+	  return WAV_ERR_UNSUPPORTED;
+	}
+      nodes.push_back (unique_ptr < AudioNode > (node));
+    }
+
+  WavWriter writer;
+  status = writer.open (outPath, sr, numCh, reader.bitsPerSample (),
+			reader.sampleFormat ());
+  if (status != WAV_OK)
+    {
+      result.error = wavStatusString (status);
+      return status;
+    }
+  nodes.push_back (unique_ptr < AudioNode > (new FileSinkNode (writer, numCh)));
+
+  AudioGraph graph;
+  for (size_t i = 0; i + 1 < nodes.size (); i++)
+    graph.connect (*nodes[i], *nodes[i + 1]);
+
+  LoudnessMeter loudnessMeter (sr, numCh);
+  if (meter)
+    writer.setTap (&loudnessMeter);
+
+  result.numFrames = graph.run ();
+
+  status = writer.close ();
+  if (status == WAV_OK && reader.truncated ())
+    status = WAV_ERR_DATA_TRUNCATED;
+  if (status != WAV_OK)
+    result.error = wavStatusString (status);
+  if (meter)
+    {
+      result.loudness = loudnessMeter.integratedLoudness ();
+      result.truePeak = loudnessMeter.truePeak ();
+    }
+  return status;
+}
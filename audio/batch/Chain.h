@@ -0,0 +1,79 @@
+// =================================================================================================
+// Chain.h
+//
+// The effect chains of the batch processor. A chain is written as a comma-separated list
+// of stages, each a name followed by its numbers, separated by colons, e.g.
+// "hpf:80,lpf:8000:0.9,gain:0.5". A file is run through a chain as one streaming pass of
+// an AudioGraph, so only a block of it is ever in memory.
+//
+// =================================================================================================
+
+#ifndef __Chain__
+#define __Chain__
+
+#include "../WavUtils.h"
+#include <string>
+#include <vector>
+
+using namespace std;
+
+class AudioNode;
+
+/// One stage of a chain, e.g. "lpf:400" is { "lpf", { 400 } }
+struct ChainStage
+{
+	string name;
+	vector<double> args;
+};
+
+/// Parses a chain spec
+///
+///	@param	spec	E.g. "lpf:400,gain:0.5"
+///	@param	stages	The stages, in the order the audio goes through them
+///	@param	error	If the spec is invalid, what's wrong with it
+/// @return			true if the spec is valid
+///
+bool parseChain(const string& spec, vector<ChainStage>& stages, string& error);
+
+/// Lines describing the stages parseChain knows, for a usage message
+const char *chainHelp();
+
+/// Makes the AudioNode for one stage of a chain
+///
+///	@param	stage	A stage from parseChain
+///	@param	sr		Sample rate of the audio it will process
+///	@param	numCh	Number of channels in and out
+/// @return			A new node, for the caller to delete; NULL if the stage can't be applied
+///					to such audio (e.g. a balance on mono, or a cutoff above the Nyquist
+///					frequency)
+///
+AudioNode *makeChainNode(const ChainStage& stage, int sr, int numCh);
+
+/// What became of one file
+struct ChainResult
+{
+	int sampleRate;
+	int numChannels;
+	int64_t numFrames;		// Sample frames processed
+	double loudness;		// Of the output in LUFS, and its true peak in dBTP, if metered
+	double truePeak;
+	string error;			// What went wrong, if anything
+};
+
+/// Streams an audio file through a chain into a new file with the same format
+///
+///	@param	inPath		File to read
+///	@param	outPath		File to write
+///	@param	stages		The chain, from parseChain
+///	@param	meter		true to measure the output's loudness and true peak
+///	@param	result		Details of the file and of the output, and if it failed, why
+/// @return				WAV_OK; WAV_ERR_UNSUPPORTED if the chain can't be applied to the
+///						file (e.g. a balance on a mono file, or a cutoff above the Nyquist
+///						frequency), with result.error naming the stage; WAV_ERR_DATA_TRUNCATED
+///						if the input ends early, with what there was of it processed; or why
+///						the file couldn't be read or written
+///
+WavStatus runChain(const string& inPath, const string& outPath,
+				   const vector<ChainStage>& stages, bool meter, ChainResult& result);
+
+#endif
@@ -0,0 +1,129 @@
+// =================================================================================================
+// WorkStealingPool.cpp
+// =================================================================================================
+
+#include "WorkStealingPool.h"
+#include <algorithm>
+
+// The pool and worker the current thread belongs to, if any
+static thread_local WorkStealingPool *t_pool = NULL;
+static thread_local int t_worker = -1;
+
+WorkStealingPool::WorkStealingPool (int numThreads):
+m_nextQueue (0), m_numQueued (0), m_numPending (0), m_quit (false)
+{
+  if (numThreads <= 0)
+    numThreads = std::max (1u, thread::hardware_concurrency ());
+
+  for (int i = 0; i < numThreads; i++)
+    m_queues.push_back (unique_ptr < Queue > (new Queue));
+  for (int i = 0; i < numThreads; i++)
+    m_threads.push_back (thread (&WorkStealingPool::workerLoop, this, i));
+}
+
+WorkStealingPool::~WorkStealingPool ()
+{
+  wait ();
+  {
+    lock_guard < mutex > lock (m_mutex);
+    m_quit = true;
+  }
+  m_queuedChanged.notify_all ();
+  for (size_t i = 0; i < m_threads.size (); i++)
+    m_threads[i].join ();
+}
+
+void
+WorkStealingPool::submit (function < void () > task)
+{
+  // Pending before it's queued, since it may be taken and finish as soon as it is
+  int q;
+  {
+    lock_guard < mutex > lock (m_mutex);
+    q = t_pool == this ? t_worker : (int) (m_nextQueue++ % m_queues.size ());
+    m_numPending++;
+  }
+
+  {
+    lock_guard < mutex > lock (m_queues[q]->lock);
+    m_queues[q]->tasks.push_back (std::move (task));
+  }
+
+  // Queued only once it's in a queue, so a worker that wakes for it will find it
+  {
+    lock_guard < mutex > lock (m_mutex);
+    m_numQueued++;
+  }
+  m_queuedChanged.notify_one ();
+}
+
+void
+WorkStealingPool::wait ()
+{
+  unique_lock < mutex > lock (m_mutex);
+  m_allDone.wait (lock, [this] ()
+    {
+      return m_numPending == 0;
+    });
+}
+
+// Takes the newest task from the worker's own queue, or else the oldest from another's
+bool
+WorkStealingPool::take (int worker, function < void () > &task)
+{
+  int n = (int) m_queues.size ();
+  for (int i = 0; i < n; i++)
+    {
+      Queue & queue = *m_queues[(worker + i) % n];
+      lock_guard < mutex > lock (queue.lock);
+      if (queue.tasks.empty ())
+	continue;
+
+      if (i == 0)
+	{
+	  task = std::move (queue.tasks.back ());
+	  queue.tasks.pop_back ();
+	}
+      else
+	{
+	  task = std::move (queue.tasks.front ());
+	  queue.tasks.pop_front ();
+	}
+
+      lock_guard < mutex > countLock (m_mutex);
+      m_numQueued--;
+      return true;
+    }
+  return false;
+}
+
+void
+WorkStealingPool::workerLoop (int worker)
+{
+  t_pool = this;
+  t_worker = worker;
+
+  for (;;)
+    {
+      function < void () > task;
+      if (take (worker, task))
+	{
+	  task ();
+	  lock_guard < mutex > lock (m_mutex);
+	  if (--m_numPending == 0)
+	    m_allDone.notify_all ();
+	  continue;
+	}
+
+      // Nothing anywhere: sleep until something is submitted. A task counted as queued
+      // may already have been taken by another worker, in which case this one just looks
+      // again and goes back to sleep.
+      unique_lock < mutex > lock (m_mutex);
+      m_queuedChanged.wait (lock, [this] ()
+	{
+	  return m_quit || m_numQueued > 0;
+	});
+      if (m_quit && m_numQueued == 0)
+	return;
+    }
+}
@@ -0,0 +1,69 @@
+// =================================================================================================
+// WorkStealingPool.h
+//
+// A fixed set of worker threads running submitted tasks. Each worker has its own queue:
+// it takes its newest task first, and when its queue is empty it steals the oldest task
+// from another worker's. Tasks are spread over the queues as they're submitted, so the
+// workers rarely contend for one lock, and a worker that finishes its share early keeps
+// busy with the others' instead of idling while one long task holds up the batch.
+//
+// =================================================================================================
+
+#ifndef __WorkStealingPool__
+#define __WorkStealingPool__
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+class WorkStealingPool
+{
+public:
+
+	/// @param	numThreads	Number of workers; 0 for one per hardware thread
+	WorkStealingPool(int numThreads = 0);
+
+	/// Waits for the tasks still to run, then stops the workers
+	~WorkStealingPool();
+
+	int numThreads() const { return (int)m_threads.size(); }
+
+	/// Queues a task. From one of the pool's own tasks, it goes on that worker's queue, so
+	/// it's likely to run next on the same thread while its data is still in cache.
+	void submit(function<void()> task);
+
+	/// Blocks until every task submitted so far has finished. Not for use from a task.
+	void wait();
+
+private:
+
+	struct Queue
+	{
+		mutex lock;
+		deque<function<void()> > tasks;
+	};
+
+	vector<unique_ptr<Queue> > m_queues;	// One per worker
+	vector<thread> m_threads;
+	unsigned m_nextQueue;		// Where the next task from outside the pool goes
+
+	mutex m_mutex;				// Guards the counts and m_quit
+	condition_variable m_queuedChanged;
+	condition_variable m_allDone;
+	int64_t m_numQueued;		// Tasks waiting in the queues (briefly -1 when a task is
+								// taken before submit has counted it)
+	int64_t m_numPending;		// Tasks submitted and not yet finished
+	bool m_quit;
+
+	bool take(int worker, function<void()>& task);
+	void workerLoop(int worker);
+};
+
+#endif
@@ -0,0 +1,137 @@
+// =================================================================================================
+// AudioGraphBench.cpp
+//
+// Ten seconds of stereo through trim, filter, mix, gain and balance stages, as one
+// streaming pass of a graph against the old way of running each stage over the whole
+// buffer in turn. The graph's blocks stay in cache between stages, while whole buffers go
+// out to memory and back at every stage; against that, the graph pays a call per node per
+// block, and the filter, which is the same either way, is most of the work. ns/item is per
+// sample frame.
+// =================================================================================================
+
+#include "Bench.h"
+#include "../AudioNodes.h"
+#include <random>
+
+// Plays stereo from memory
+class BufferSource : public AudioNode
+{
+public:
+
+  BufferSource (const vector < float >&left, const vector < float >&right):
+  AudioNode (0, 2), m_left (left), m_right (right), m_pos (0)
+  {
+  }
+
+  void process (const float *const *in, float **out, int n)
+  {
+    std::copy (m_left.begin () + m_pos, m_left.begin () + m_pos + n, out[0]);
+    std::copy (m_right.begin () + m_pos, m_right.begin () + m_pos + n, out[1]);
+    m_pos += n;
+  }
+
+  int64_t framesLeft () const
+  {
+    return (int64_t) m_left.size () - m_pos;
+  }
+
+  void rewind ()
+  {
+    m_pos = 0;
+  }
+
+private:
+
+  const vector < float >&m_left;
+  const vector < float >&m_right;
+  int64_t m_pos;
+};
+
+// Keeps the last block it's given
+class BlockSink : public AudioNode
+{
+public:
+
+  BlockSink ():AudioNode (2, 0), m_last (0)
+  {
+  }
+
+  void process (const float *const *in, float **out, int n)
+  {
+    m_last = in[0][n - 1] + in[1][n - 1];
+  }
+
+  float m_last;
+};
+
+BENCH_SUITE (audioGraph)
+{
+  const int SAMPLE_RATE = 44100;
+  const int NUM_FRAMES = 10 * SAMPLE_RATE;
+
+  mt19937 rng (1);
+  uniform_real_distribution < float >dist (-0.5f, 0.5f);
+  vector < float >left (NUM_FRAMES), right (NUM_FRAMES);
+  for (int i = 0; i < NUM_FRAMES; i++)
+    {
+      left[i] = dist (rng);
+      right[i] = dist (rng);
+    }
+
+  BufferSource source (left, right);
+  GainNode trim (2, 0.8f);
+  FilterNode filter (SAMPLE_RATE, 2);
+  filter.filter (0).initLPF (1000);
+  filter.filter (1).initLPF (1000);
+  MixNode mix (2, 2);
+  mix.setGain (1, 0.5f);
+  GainNode gain (2, 0.5f);
+  BalanceNode balance (0.3f);
+  BlockSink sink;
+
+  // Dry and low-passed copies mixed, then gain and balance
+  AudioGraph graph (1024);
+  graph.connect (source, trim);
+  graph.connect (trim, mix);
+  graph.connect (trim, filter);
+  graph.connect (filter, 0, mix, 2);
+  graph.connect (filter, 1, mix, 3);
+  graph.connect (mix, gain);
+  graph.connect (gain, balance);
+  graph.connect (balance, sink);
+
+  bench.run ("audioGraph/chain/graph", NUM_FRAMES * 2 * sizeof (float), NUM_FRAMES, [&] ()
+    {
+      source.rewind ();
+      graph.run ();
+      benchKeep (&sink.m_last);
+    });
+
+  // Each stage over the whole buffer, as main.cpp's examples used to
+  vector < float >dryL (NUM_FRAMES), dryR (NUM_FRAMES);
+  vector < float >outL (NUM_FRAMES), outR (NUM_FRAMES);
+  bench.run ("audioGraph/chain/wholeBuffer", NUM_FRAMES * 2 * sizeof (float), NUM_FRAMES, [&] ()
+    {
+      for (int i = 0; i < NUM_FRAMES; i++)
+	{
+	  dryL[i] = 0.8f * left[i];
+	  dryR[i] = 0.8f * right[i];
+	}
+      filter.filter (0).process (dryL.data (), outL.data (), NUM_FRAMES);
+      filter.filter (1).process (dryR.data (), outR.data (), NUM_FRAMES);
+      for (int i = 0; i < NUM_FRAMES; i++)
+	{
+	  outL[i] = dryL[i] + 0.5f * outL[i];
+	  outR[i] = dryR[i] + 0.5f * outR[i];
+	}
+      for (int i = 0; i < NUM_FRAMES; i++)
+	{
+	  outL[i] *= 0.5f;
+	  outR[i] *= 0.5f;
+	}
+      for (int i = 0; i < NUM_FRAMES; i++)
+	outR[i] *= 1 - 0.3f;
+      benchKeep (outL.data ());
+      benchKeep (outR.data ());
+    });
+}
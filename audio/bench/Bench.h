@@ -0,0 +1,179 @@
+// =================================================================================================
+// Bench.h
+//
+// A small self-contained benchmark harness. Each benchmark file registers a suite with
+// BENCH_SUITE, and the suite times its cases with Bench::run. A case's body is repeated
+// until it has run long enough to time reliably, and the median of several repetitions,
+// spread over a few passes through the suites, is reported as time per call and as
+// throughput. The median rather than the best, since a comparison of two runs needs a
+// figure that one lucky or unlucky repetition doesn't move; the quartiles are kept too,
+// as a measure of how much the machine's speed wandered. The results are also kept, so a
+// run can be saved as JSON and compared with an earlier one (see BenchMain.cpp).
+// =================================================================================================
+
+#ifndef __Bench__
+#define __Bench__
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <functional>
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+using namespace std;
+
+/// Keeps the compiler from optimizing away a result that is never read
+inline void benchKeep(const void *p)
+{
+	asm volatile("" : : "g"(p) : "memory");
+}
+
+/// The timing of one benchmark case
+struct BenchResult
+{
+	string suite;
+	string name;
+	double ns;				// Median time per call
+	double nsLow, nsHigh;	// Lower and upper quartiles of the time per call
+	double nsPerItem;		// 0 if the case has no items
+	double gbps;			// 0 if the case has no bytes
+};
+
+/// Identifies a case across runs, as names are only unique within a suite
+inline string benchKey(const string& suite, const string& name)
+{
+	return suite + "/" + name;
+}
+
+class Bench
+{
+public:
+
+	/// @param	filter	Only cases whose name contains this string are run
+	Bench(const string& filter) : m_filter(filter) {}
+
+	/// Runs only the given cases, by benchKey, e.g. to time suspected regressions again
+	void restrictTo(const set<string>& keys) { m_only = keys; m_restricted = true; }
+
+	/// Sets the suite the following cases belong to
+	void beginSuite(const string& suite) { m_suite = suite; }
+
+	/// Starts a pass over the suites. The repetitions of each case are spread over the
+	/// passes, and its result comes from all of them, so a spell of the machine running
+	/// slower or faster than usual only touches some of them. Cases are printed and
+	/// kept on the last pass.
+	void beginPass(int pass, int numPasses) { m_pass = pass; m_numPasses = numPasses; }
+
+	/// Every case timed so far, in the order they ran
+	const vector<BenchResult>& results() const { return m_results; }
+
+	/// Times a benchmark case and prints the result
+	///
+	///	@param	name	Case name, e.g. "pcm16ToFloat/avx2"
+	///	@param	bytes	Bytes processed by one call of body, for GB/s. 0 if not meaningful.
+	///	@param	items	Items (e.g. samples) processed by one call of body, for ns/item
+	///	@param	body	Code to time
+	///
+	void run(const string& name, double bytes, double items, const function<void()>& body)
+	{
+		string key = benchKey(m_suite, name);
+		if (name.find(m_filter) == string::npos || (m_restricted && !m_only.count(key)))
+			return;
+
+		// Find an iteration count that takes long enough to time, once for all passes
+		Timing& timing = m_timings[key];
+		body();
+		if (timing.iters == 0)
+		{
+			timing.iters = 1;
+			while (seconds(body, timing.iters) < MIN_SECONDS && timing.iters < (1L << 30))
+				timing.iters *= 2;
+		}
+
+		for (int rep = 0; rep < REPETITIONS; rep++)
+			timing.times.push_back(seconds(body, timing.iters) / timing.iters);
+		if (m_pass < m_numPasses - 1)
+			return;
+
+		vector<double>& times = timing.times;		// Seconds per call
+		sort(times.begin(), times.end());
+		size_t n = times.size();
+		double median = times[n / 2];
+
+		BenchResult result = { m_suite, name, median * 1e9,
+							   times[n / 4] * 1e9, times[n * 3 / 4] * 1e9,
+							   items > 0 ? median * 1e9 / items : 0,
+							   bytes > 0 ? bytes / median * 1e-9 : 0 };
+		m_results.push_back(result);
+
+		printf("%-40s %12.1f ns", name.c_str(), result.ns);
+		if (items > 0)
+			printf(" %10.3f ns/item", result.nsPerItem);
+		if (bytes > 0)
+			printf(" %8.3f GB/s", result.gbps);
+		printf("\n");
+		fflush(stdout);
+	}
+
+private:
+
+	/// Repetitions of one case so far
+	struct Timing
+	{
+		long iters = 0;			// Calls per repetition
+		vector<double> times;	// Seconds per call of each repetition
+	};
+
+	static constexpr double MIN_SECONDS = 0.05;
+	static const int REPETITIONS = 5;		// In each pass
+
+	string m_filter;
+	set<string> m_only;
+	bool m_restricted = false;
+	string m_suite;
+	int m_pass = 0;
+	int m_numPasses = 1;
+	map<string, Timing> m_timings;
+	vector<BenchResult> m_results;
+
+	static double seconds(const function<void()>& body, long iters)
+	{
+		chrono::steady_clock::time_point start = chrono::steady_clock::now();
+		for (long i = 0; i < iters; i++)
+			body();
+		return chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	}
+};
+
+/// A named group of benchmark cases
+struct BenchSuite
+{
+	const char *name;
+	void (*func)(Bench& bench);
+};
+
+inline vector<BenchSuite>& benchSuites()
+{
+	static vector<BenchSuite> suites;
+	return suites;
+}
+
+struct BenchRegistrar
+{
+	BenchRegistrar(const char *name, void (*func)(Bench&))
+	{
+		BenchSuite suite = { name, func };
+		benchSuites().push_back(suite);
+	}
+};
+
+/// Defines and registers a benchmark suite. The body gets a Bench named "bench".
+#define BENCH_SUITE(name) \
+	static void name(Bench& bench); \
+	static BenchRegistrar name##Registrar(#name, name); \
+	static void name(Bench& bench)
+
+#endif
@@ -0,0 +1,299 @@
+// =================================================================================================
+// BenchMain.cpp
+//
+// Runs the registered benchmark suites.
+//
+// Usage: bench.out [--json out.json] [--compare base.json] [--threshold pct] [filter]
+//   Only cases whose name contains filter are run.
+//   --json saves the results, one case per line, so runs can be diffed or kept as a baseline.
+//   --compare prints each case's change from a saved run, and exits with 2 if any case has
+//   regressed, so a build script can stop on it. A case has regressed if its median is
+//   more than pct percent slower (default 10), and also clear of the noise: the faster
+//   half of its repetitions all slower than the slower half of the baseline's. A case
+//   that looks slower is timed again, and only counts if it looks slower both times. A
+//   short case can be off by more than 10% just from what else the machine was doing, so
+//   the median alone would flag regressions that aren't there. Timings only compare
+//   fairly on the same machine, and it should be otherwise idle.
+// =================================================================================================
+
+#include "Bench.h"
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <fstream>
+#include <map>
+#include <set>
+
+// Passes through the suites, over which each case's repetitions are spread
+static const int PASSES = 3;
+
+// Writes s as a JSON string
+static string
+jsonString (const string & s)
+{
+  string out = "\"";
+  for (size_t i = 0; i < s.size (); i++)
+    {
+      if (s[i] == '"' || s[i] == '\\')
+	out += '\\';
+      out += s[i];
+    }
+  return out + "\"";
+}
+
+static bool
+writeJson (const string & path, const vector < BenchResult > &results)
+{
+  FILE *file = fopen (path.c_str (), "w");
+  if (!file)
+    return false;
+
+  char date[32];
+  time_t now = time (NULL);
+  strftime (date, sizeof (date), "%Y-%m-%dT%H:%M:%SZ", gmtime (&now));
+
+  fprintf (file, "{\n");
+  fprintf (file, "  \"date\": \"%s\",\n", date);
+  fprintf (file, "  \"compiler\": %s,\n", jsonString (__VERSION__).c_str ());
+  fprintf (file, "  \"results\": [\n");
+  for (size_t i = 0; i < results.size (); i++)
+    {
+      const BenchResult & r = results[i];
+      fprintf (file,
+	       "    {\"suite\": %s, \"name\": %s, \"ns\": %.6g, \"nsLow\": %.6g, "
+	       "\"nsHigh\": %.6g, \"nsPerItem\": %.4g, \"gbps\": %.4g}%s\n",
+	       jsonString (r.suite).c_str (), jsonString (r.name).c_str (), r.ns,
+	       r.nsLow, r.nsHigh, r.nsPerItem, r.gbps,
+	       i + 1 < results.size ()? "," : "");
+    }
+  fprintf (file, "  ]\n}\n");
+
+  return fclose (file) == 0;
+}
+
+// Finds "key": in a line and returns where its value starts, or NULL
+static const char *
+findValue (const string & line, const char *key)
+{
+  string quoted = string ("\"") + key + "\":";
+  size_t pos = line.find (quoted);
+  if (pos == string::npos)
+    return NULL;
+  const char *value = line.c_str () + pos + quoted.size ();
+  while (*value == ' ')
+    value++;
+  return value;
+}
+
+static bool
+readString (const string & line, const char *key, string & s)
+{
+  const char *p = findValue (line, key);
+  if (!p || *p++ != '"')
+    return false;
+  s.clear ();
+  for (; *p && *p != '"'; p++)
+    {
+      if (*p == '\\' && p[1])
+	p++;
+      s += *p;
+    }
+  return *p == '"';
+}
+
+// Reads the results of a file written by writeJson, by suite and name
+static bool
+readJson (const string & path, map < string, BenchResult > &results)
+{
+  ifstream file (path.c_str ());
+  if (!file.is_open ())
+    return false;
+
+  string line;
+  while (getline (file, line))
+    {
+      BenchResult r;
+      const char *ns = findValue (line, "ns");
+      if (!readString (line, "suite", r.suite)
+	  || !readString (line, "name", r.name) || !ns)
+	continue;
+      r.ns = atof (ns);
+      const char *nsLow = findValue (line, "nsLow");
+      const char *nsHigh = findValue (line, "nsHigh");
+      r.nsLow = nsLow ? atof (nsLow) : r.ns;
+      r.nsHigh = nsHigh ? atof (nsHigh) : r.ns;
+      r.nsPerItem = r.gbps = 0;
+      results[benchKey (r.suite, r.name)] = r;
+    }
+  return true;
+}
+
+// Change in percent from a case's baseline time, or 0 if the case is new
+static double
+change (const map < string, BenchResult > &baseline, const BenchResult & r)
+{
+  map < string, BenchResult >::const_iterator base =
+    baseline.find (benchKey (r.suite, r.name));
+  if (base == baseline.end () || base->second.ns <= 0)
+    return 0;
+  return 100 * (r.ns / base->second.ns - 1);
+}
+
+// Whether a case is over threshold percent slower than the baseline, beyond the noise
+static bool
+isSlower (const map < string, BenchResult > &baseline, const BenchResult & r,
+	  double threshold)
+{
+  map < string, BenchResult >::const_iterator base =
+    baseline.find (benchKey (r.suite, r.name));
+  return change (baseline, r) > threshold && base != baseline.end ()
+    && r.nsLow > base->second.nsHigh;
+}
+
+// Prints how each case has changed since the baseline, with the second timing of those
+// that were timed again. Returns the number of regressions, i.e. cases slower both times.
+static int
+compare (const map < string, BenchResult > &baseline,
+	 const vector < BenchResult > &results,
+	 const vector < BenchResult > &again, double threshold)
+{
+  map < string, const BenchResult * >againResult;
+  for (size_t i = 0; i < again.size (); i++)
+    againResult[benchKey (again[i].suite, again[i].name)] = &again[i];
+
+  printf ("\n-- compared with baseline (regression: over %.0f%% slower beyond the "
+	  "noise, twice) --\n", threshold);
+  printf ("%-48s %12s %12s %8s\n", "case", "base ns", "ns", "change");
+
+  int numRegressions = 0, numFaster = 0, numNew = 0;
+  for (size_t i = 0; i < results.size (); i++)
+    {
+      const BenchResult & r = results[i];
+      string key = benchKey (r.suite, r.name);
+      map < string, BenchResult >::const_iterator base = baseline.find (key);
+      if (base == baseline.end () || base->second.ns <= 0)
+	{
+	  printf ("%-48s %12s %12.1f %8s\n", key.c_str (), "-", r.ns, "new");
+	  numNew++;
+	  continue;
+	}
+
+      double c = change (baseline, r);
+      printf ("%-48s %12.1f %12.1f %+7.1f%%", key.c_str (), base->second.ns, r.ns, c);
+      if (isSlower (baseline, r, threshold) && againResult.count (key))
+	{
+	  const BenchResult & a = *againResult[key];
+	  bool confirmed = isSlower (baseline, a, threshold);
+	  printf ("  %s (%+.1f%% again)", confirmed ? "REGRESSION" : "noise",
+		  change (baseline, a));
+	  numRegressions += confirmed;
+	}
+      else if (c > threshold)
+	printf ("  noise");
+      else if (c < -threshold)
+	numFaster++;
+      printf ("\n");
+    }
+
+  printf ("%d regressions, %d faster, %d new, of %d cases\n", numRegressions,
+	  numFaster, numNew, (int) results.size ());
+  return numRegressions;
+}
+
+int
+main (int argc, const char *argv[])
+{
+  string filter, jsonPath, baselinePath;
+  double threshold = 10;
+
+  for (int i = 1; i < argc; i++)
+    {
+      string arg = argv[i];
+      if ((arg == "--json" || arg == "--compare" || arg == "--threshold")
+	  && i + 1 < argc)
+	{
+	  string value = argv[++i];
+	  if (arg == "--json")
+	    jsonPath = value;
+	  else if (arg == "--compare")
+	    baselinePath = value;
+	  else
+	    threshold = atof (value.c_str ());
+	}
+      else if (arg.compare (0, 2, "--") == 0)
+	{
+	  fprintf (stderr, "Usage: bench.out [--json out.json] "
+		   "[--compare base.json] [--threshold pct] [filter]\n");
+	  return 1;
+	}
+      else
+	filter = arg;
+    }
+
+  // Read the baseline first, so a bad path doesn't waste a whole run
+  map < string, BenchResult > baseline;
+  if (!baselinePath.empty () && !readJson (baselinePath, baseline))
+    {
+      fprintf (stderr, "Couldn't read %s\n", baselinePath.c_str ());
+      return 1;
+    }
+
+  Bench bench (filter);
+  for (int pass = 0; pass < PASSES; pass++)
+    {
+      if (pass < PASSES - 1)
+	{
+	  printf ("(pass %d of %d)\n", pass + 1, PASSES);
+	  fflush (stdout);
+	}
+      bench.beginPass (pass, PASSES);
+      for (size_t i = 0; i < benchSuites ().size (); i++)
+	{
+	  if (pass == PASSES - 1)
+	    printf ("-- %s --\n", benchSuites ()[i].name);
+	  bench.beginSuite (benchSuites ()[i].name);
+	  benchSuites ()[i].func (bench);
+	}
+    }
+
+  if (!jsonPath.empty () && !writeJson (jsonPath, bench.results ()))
+    {
+      fprintf (stderr, "Couldn't write %s\n", jsonPath.c_str ());
+      return 1;
+    }
+
+  if (baselinePath.empty ())
+    return 0;
+
+  // Time the cases that look slower again, running only the suites they're in
+  set < string > slower, slowerSuites;
+  for (size_t i = 0; i < bench.results ().size (); i++)
+    {
+      const BenchResult & r = bench.results ()[i];
+      if (isSlower (baseline, r, threshold))
+	{
+	  slower.insert (benchKey (r.suite, r.name));
+	  slowerSuites.insert (r.suite);
+	}
+    }
+
+  Bench again (filter);
+  again.restrictTo (slower);
+  if (!slower.empty ())
+    printf ("\n-- timing %d slower cases again --\n", (int) slower.size ());
+  for (int pass = 0; pass < PASSES && !slower.empty (); pass++)
+    {
+      again.beginPass (pass, PASSES);
+      for (size_t i = 0; i < benchSuites ().size (); i++)
+	if (slowerSuites.count (benchSuites ()[i].name))
+	  {
+	    again.beginSuite (benchSuites ()[i].name);
+	    benchSuites ()[i].func (again);
+	  }
+    }
+
+  if (compare (baseline, bench.results (), again.results (), threshold) > 0)
+    return 2;
+
+  return 0;
+}
@@ -0,0 +1,213 @@
+// =================================================================================================
+// BiquadBench.cpp
+//
+// A high-order filter run as a BiquadCascade, against the same sections as a chain of
+// Biquad objects, both sample by sample and a whole block per section. Also a filter on
+// many channels, as a Biquad per channel and as MultiBiquad lanes, the cost of each
+// BiquadT precision and form, and of sweeping the cutoff.
+// =================================================================================================
+
+#include "Bench.h"
+#include "../BiquadCascade.h"
+#include "../MultiBiquad.h"
+#include <cstdlib>
+
+static const int NUM_SAMPLES = 1 << 14;
+static const float SAMPLE_RATE = 44100;
+
+BENCH_SUITE (biquadCascade)
+{
+  vector < float >x (NUM_SAMPLES);
+  for (int i = 0; i < NUM_SAMPLES; i++)
+    x[i] = 2.0f * rand () / RAND_MAX - 1.0f;
+  vector < float >y (NUM_SAMPLES);
+
+  for (int order = 2; order <= 16; order *= 2)
+    {
+      BiquadCascade cascade (SAMPLE_RATE);
+      cascade.initButterworthLPF (order, 1000);
+
+      // The same sections as separate Biquads
+      vector < Biquad > chain;
+      for (int k = order / 2 - 1; k >= 0; k--)
+	{
+	  Biquad section (SAMPLE_RATE);
+	  section.initLPF (1000, 1 / (2 * sin ((2 * k + 1) * M_PI / (2 * order))));
+	  chain.push_back (section);
+	}
+
+      string suffix = "/" + to_string (order);
+      double bytes = NUM_SAMPLES * sizeof (float);
+
+      bench.run ("biquad/chain/tick" + suffix, bytes, NUM_SAMPLES, [&] ()
+	{
+	  for (int i = 0; i < NUM_SAMPLES; i++)
+	    {
+	      float v = x[i];
+	      for (size_t s = 0; s < chain.size (); s++)
+		v = chain[s].tick (v);
+	      y[i] = v;
+	    }
+	  benchKeep (y.data ());
+	});
+
+      bench.run ("biquad/chain/process" + suffix, bytes, NUM_SAMPLES, [&] ()
+	{
+	  chain[0].process (x.data (), y.data (), NUM_SAMPLES);
+	  for (size_t s = 1; s < chain.size (); s++)
+	    chain[s].process (y.data (), y.data (), NUM_SAMPLES);
+	  benchKeep (y.data ());
+	});
+
+      bench.run ("biquad/cascade" + suffix, bytes, NUM_SAMPLES, [&] ()
+	{
+	  cascade.process (x.data (), y.data (), NUM_SAMPLES);
+	  benchKeep (y.data ());
+	});
+    }
+}
+
+// A filter on each channel of multichannel audio: a Biquad per channel, against one
+// MultiBiquad lane per channel
+struct MultiChannelAudio
+{
+  vector < vector < float >>x;
+  vector < vector < float >>y;
+  vector < const float *>src;
+  vector < float *>dst;
+
+  MultiChannelAudio (int numCh):x (numCh, vector < float >(NUM_SAMPLES)),
+    y (numCh, vector < float >(NUM_SAMPLES)), src (numCh), dst (numCh)
+  {
+    for (int ch = 0; ch < numCh; ch++)
+      {
+	for (int i = 0; i < NUM_SAMPLES; i++)
+	  x[ch][i] = 2.0f * rand () / RAND_MAX - 1.0f;
+	src[ch] = x[ch].data ();
+	dst[ch] = y[ch].data ();
+      }
+  }
+};
+
+static void
+benchPerChannel (Bench & bench, int numCh)
+{
+  MultiChannelAudio audio (numCh);
+  vector < Biquad > filters (numCh, Biquad (SAMPLE_RATE));
+  for (int ch = 0; ch < numCh; ch++)
+    filters[ch].initLPF (1000);
+
+  double items = (double) numCh * NUM_SAMPLES;
+  bench.run ("biquad/perChannel/" + to_string (numCh) + "ch",
+	     items * sizeof (float), items, [&] ()
+    {
+      for (int ch = 0; ch < numCh; ch++)
+	filters[ch].process (audio.src[ch], audio.dst[ch], NUM_SAMPLES);
+      benchKeep (audio.dst.data ());
+    });
+}
+
+template < int N > static void
+benchMulti (Bench & bench, int numCh)
+{
+  MultiChannelAudio audio (numCh);
+  vector < MultiBiquad < N > >filters (numCh / N, MultiBiquad < N > (SAMPLE_RATE));
+  for (size_t g = 0; g < filters.size (); g++)
+    filters[g].initLPF (1000);
+
+  double items = (double) numCh * NUM_SAMPLES;
+  bench.run ("biquad/multi" + to_string (N) + "/" + to_string (numCh) + "ch",
+	     items * sizeof (float), items, [&] ()
+    {
+      for (size_t g = 0; g < filters.size (); g++)
+	filters[g].process (audio.src.data () + g * N,
+			    audio.dst.data () + g * N, N, NUM_SAMPLES);
+      benchKeep (audio.dst.data ());
+    });
+
+  // Interleaved audio needs no transposing
+  vector < float >interleaved (N * NUM_SAMPLES);
+  for (int i = 0; i < N * NUM_SAMPLES; i++)
+    interleaved[i] = 2.0f * rand () / RAND_MAX - 1.0f;
+  bench.run ("biquad/multi" + to_string (N) + "/interleaved",
+	     N * NUM_SAMPLES * sizeof (float), N * NUM_SAMPLES, [&] ()
+    {
+      filters[0].processInterleaved (interleaved.data (),
+				     interleaved.data (), NUM_SAMPLES);
+      benchKeep (interleaved.data ());
+    });
+}
+
+BENCH_SUITE (multiBiquad)
+{
+  benchPerChannel (bench, 8);
+  benchMulti < 4 > (bench, 8);
+  benchMulti < 8 > (bench, 8);
+  benchPerChannel (bench, 64);
+  benchMulti < 16 > (bench, 64);
+}
+
+// One biquad in each precision and form
+template < typename T, BiquadForm FORM > static void
+benchForm (Bench & bench, const string & name)
+{
+  vector < float >x (NUM_SAMPLES);
+  for (int i = 0; i < NUM_SAMPLES; i++)
+    x[i] = 2.0f * rand () / RAND_MAX - 1.0f;
+  vector < float >y (NUM_SAMPLES);
+
+  BiquadT < T, FORM > filter (SAMPLE_RATE);
+  filter.initLPF (400);
+
+  bench.run ("biquad/form/" + name, NUM_SAMPLES * sizeof (float),
+	     NUM_SAMPLES, [&] ()
+    {
+      filter.process (x.data (), y.data (), NUM_SAMPLES);
+      benchKeep (y.data ());
+    });
+}
+
+BENCH_SUITE (biquadForms)
+{
+  benchForm < float, BIQUAD_DF1 > (bench, "float/df1");
+  benchForm < float, BIQUAD_DF2 > (bench, "float/df2");
+  benchForm < float, BIQUAD_TDF2 > (bench, "float/tdf2");
+  benchForm < double, BIQUAD_DF1 > (bench, "double/df1");
+  benchForm < double, BIQUAD_DF2 > (bench, "double/df2");
+  benchForm < double, BIQUAD_TDF2 > (bench, "double/tdf2");
+}
+
+// A cutoff sweep with new coefficients every 64-sample block, designed with the library
+// trig functions or the lookup table, jumping or gliding to them
+static void
+benchSweep (Bench & bench, const string & name, bool fastTrig, bool smooth)
+{
+  const int BLOCK = 64;
+  vector < float >x (NUM_SAMPLES);
+  for (int i = 0; i < NUM_SAMPLES; i++)
+    x[i] = 2.0f * rand () / RAND_MAX - 1.0f;
+  vector < float >y (NUM_SAMPLES);
+
+  Biquad filter (SAMPLE_RATE);
+  filter.setFastTrig (fastTrig);
+  filter.setSmoothing (smooth ? BLOCK : 0);
+
+  bench.run ("biquad/sweep/" + name, NUM_SAMPLES * sizeof (float),
+	     NUM_SAMPLES, [&] ()
+    {
+      for (int start = 0; start < NUM_SAMPLES; start += BLOCK)
+	{
+	  filter.initLPF (200 + 5000.0f * start / NUM_SAMPLES);
+	  filter.process (x.data () + start, y.data () + start, BLOCK);
+	}
+      benchKeep (y.data ());
+    });
+}
+
+BENCH_SUITE (biquadSweep)
+{
+  benchSweep (bench, "trig", false, false);
+  benchSweep (bench, "table", true, false);
+  benchSweep (bench, "trig/smooth", false, true);
+  benchSweep (bench, "table/smooth", true, true);
+}
@@ -0,0 +1,71 @@
+// =================================================================================================
+// ConvolverBench.cpp
+//
+// Convolving one second of noise with a 2-second reverb tail, in 256-sample blocks, with
+// large tail blocks against uniform 256-sample blocks throughout; and a short 512-tap FIR
+// against summing its taps directly. ns/item is per input sample, so 1e9 / (ns/item * 48000)
+// is how many times faster than realtime.
+// =================================================================================================
+
+#include "Bench.h"
+#include "../Convolver.h"
+#include <cmath>
+#include <random>
+
+static void
+benchConvolver (Bench & bench, const string & name, Convolver & convolver,
+		const vector < float >&x)
+{
+  const int BLOCK = 256;
+  int n = (int) x.size ();
+  vector < float >y (n);
+
+  bench.run ("convolver/" + name, n * sizeof (float), n, [&] ()
+    {
+      for (int i = 0; i < n; i += BLOCK)
+	convolver.process (x.data () + i, y.data () + i, std::min (BLOCK, n - i));
+      benchKeep (y.data ());
+    });
+}
+
+BENCH_SUITE (convolver)
+{
+  const int SAMPLE_RATE = 48000;
+  mt19937 rng (1);
+  uniform_real_distribution < float >dist (-0.5f, 0.5f);
+
+  vector < float >x (SAMPLE_RATE);
+  for (size_t i = 0; i < x.size (); i++)
+    x[i] = dist (rng);
+
+  // Noise decaying by 60 dB over 2 seconds
+  vector < float >reverb (2 * SAMPLE_RATE);
+  for (size_t i = 0; i < reverb.size (); i++)
+    reverb[i] = dist (rng) * exp (-6.9 * i / reverb.size ());
+
+  Convolver twoLevel (reverb.data (), (int) reverb.size (), 256, 4096);
+  benchConvolver (bench, "reverb2s", twoLevel, x);
+  Convolver uniform (reverb.data (), (int) reverb.size (), 256, 256);
+  benchConvolver (bench, "reverb2s/uniform", uniform, x);
+
+  vector < float >fir (512);
+  for (size_t i = 0; i < fir.size (); i++)
+    fir[i] = dist (rng);
+  Convolver convolver (fir.data (), (int) fir.size (), 256, 256);
+  benchConvolver (bench, "fir512", convolver, x);
+
+  int n = (int) x.size ();
+  int taps = (int) fir.size ();
+  vector < float >y (n);
+  bench.run ("convolver/fir512/direct", n * sizeof (float), n, [&] ()
+    {
+      for (int i = 0; i < n; i++)
+	{
+	  float sum = 0;
+	  for (int j = 0; j < taps && j <= i; j++)
+	    sum += fir[j] * x[i - j];
+	  y[i] = sum;
+	}
+      benchKeep (y.data ());
+    });
+}
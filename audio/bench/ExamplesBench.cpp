@@ -0,0 +1,132 @@
+// =================================================================================================
+// ExamplesBench.cpp
+//
+// The processing of each of main.cpp's examples, as the example does it, on five seconds
+// of synthetic audio in memory rather than on its input file, so the times don't include
+// the disk and don't depend on which files are present. The files themselves are covered
+// by the wavIO suite, and applyChain's graph by audioGraph. ns/item is per sample frame,
+// so 1e9 / (ns/item * 44100) is how many times faster than realtime an example runs.
+// =================================================================================================
+
+#include "Bench.h"
+#include "../AudioNodes.h"
+#include "../Convolver.h"
+#include "../OscillatorBank.h"
+#include "../Panner.h"
+#include "../Resampler.h"
+#include "../TimeStretch.h"
+#include <cmath>
+#include <random>
+
+static const int SAMPLE_RATE = 44100;
+static const int NUM_FRAMES = 5 * SAMPLE_RATE;
+static const int BLOCK_SIZE = 1024;
+
+// Something like music: a chord, with noise for the parts of the spectrum it leaves empty
+static vector < float >
+syntheticSignal (int numCh, mt19937 & rng)
+{
+  OscillatorBank chord (SAMPLE_RATE);
+  float freqs[] = { 220, 277.2, 329.6, 440 };
+  for (int p = 0; p < 4; p++)
+    chord.addPartial (freqs[p], 0.15);
+
+  vector < float >tone (NUM_FRAMES);
+  chord.render (tone.data (), NUM_FRAMES);
+
+  uniform_real_distribution < float >noise (-0.1f, 0.1f);
+  vector < float >x (numCh * NUM_FRAMES);
+  for (int i = 0; i < NUM_FRAMES; i++)
+    for (int ch = 0; ch < numCh; ch++)
+      x[i * numCh + ch] = tone[i] + noise (rng);
+  return x;
+}
+
+BENCH_SUITE (examples)
+{
+  mt19937 rng (1);
+  vector < float >mono = syntheticSignal (1, rng);
+  vector < float >stereo = syntheticSignal (2, rng);
+  vector < float >out (2 * NUM_FRAMES);
+  double monoBytes = NUM_FRAMES * sizeof (float);
+  double stereoBytes = 2 * monoBytes;
+
+  // createTone: a fundamental and four harmonics
+  OscillatorBank tone (SAMPLE_RATE);
+  for (int h = 1; h <= 5; h++)
+    tone.addPartial (440 * h, 0.35 - 0.05 * h);
+  bench.run ("examples/createTone", monoBytes, NUM_FRAMES, [&] ()
+    {
+      tone.render (out.data (), NUM_FRAMES);
+      benchKeep (out.data ());
+    });
+
+  // applyFilter: a 400 Hz low-pass, a block at a time
+  FilterNode filter (SAMPLE_RATE);
+  filter.filter (0).initLPF (400);
+  bench.run ("examples/applyFilter", monoBytes, NUM_FRAMES, [&] ()
+    {
+      for (int i = 0; i < NUM_FRAMES; i += BLOCK_SIZE)
+	{
+	  const float *in = mono.data () + i;
+	  float *y = out.data () + i;
+	  filter.process (&in, &y, min (BLOCK_SIZE, NUM_FRAMES - i));
+	}
+      benchKeep (out.data ());
+    });
+
+  // applyReverb: a two-second noise impulse response, mixed with the dry signal
+  int irLen = 2 * SAMPLE_RATE;
+  vector < float >ir (irLen);
+  uniform_real_distribution < float >noise (-1, 1);
+  for (int i = 0; i < irLen; i++)
+    ir[i] = 0.001f * noise (rng) * exp (-6.9 * i / irLen);
+  Convolver convolver (ir.data (), irLen);
+  bench.run ("examples/applyReverb", monoBytes, NUM_FRAMES, [&] ()
+    {
+      for (int i = 0; i < NUM_FRAMES; i += BLOCK_SIZE)
+	{
+	  int n = min (BLOCK_SIZE, NUM_FRAMES - i);
+	  convolver.process (mono.data () + i, out.data () + i, n);
+	  for (int j = i; j < i + n; j++)
+	    out[j] += mono[j];
+	}
+      benchKeep (out.data ());
+    });
+
+  // changeSpeed: a resampler at unchanged speed, as the example has it, and a tone faster
+  double ratios[] = { 1.0, 1.0 / 1.122462 };
+  const char *speedNames[] = { "1", "+2semitones" };
+  for (int r = 0; r < 2; r++)
+    {
+      Resampler resampler (ratios[r]);
+      vector < float >y (resampler.maxOutput (NUM_FRAMES));
+      bench.run (string ("examples/changeSpeed/") + speedNames[r], monoBytes,
+		 NUM_FRAMES, [&] ()
+	{
+	  resampler.process (mono.data (), NUM_FRAMES, y.data ());
+	  benchKeep (y.data ());
+	});
+    }
+
+  // shiftPitch: two semitones up with the phase vocoder, streamed in 4096-frame blocks
+  TimeStretch stretch (SAMPLE_RATE, STRETCH_PHASE_VOCODER, 1.0, 2.0);
+  vector < float >shifted (stretch.maxOutput (4096));
+  bench.run ("examples/shiftPitch", monoBytes, NUM_FRAMES, [&] ()
+    {
+      for (int i = 0; i < NUM_FRAMES; i += 4096)
+	stretch.process (mono.data () + i, min (4096, NUM_FRAMES - i),
+			 shifted.data ());
+      benchKeep (shifted.data ());
+    });
+
+  // applyBalance: interleaved stereo balanced a block at a time
+  Panner panner (PAN_BALANCE, -0.2f);
+  bench.run ("examples/applyBalance", stereoBytes, NUM_FRAMES, [&] ()
+    {
+      for (int i = 0; i < NUM_FRAMES; i += BLOCK_SIZE)
+	panner.processStereo (stereo.data () + 2 * i, out.data () + 2 * i,
+			      min (BLOCK_SIZE, NUM_FRAMES - i));
+      benchKeep (out.data ());
+    });
+}
@@ -0,0 +1,116 @@
+// =================================================================================================
+// FFTBench.cpp
+//
+// Complex FFTs at power-of-2 sizes and at sizes with factors of 3 and 5 (960 and 1920 are
+// 20 and 40 ms frames at 48 kHz), against the radix-2 FFT the phase vocoder used to run;
+// and real FFTs, which should take about half the time of a complex FFT of the same size.
+// ns/item is per point.
+// =================================================================================================
+
+#include "Bench.h"
+#include "../FFT.h"
+#include <cmath>
+#include <random>
+
+// In-place radix-2 FFT, as TimeStretch had
+static void
+radix2 (float *re, float *im, int n, const float *cs, const float *sn,
+	const int *bitReverse)
+{
+  for (int i = 0; i < n; i++)
+    {
+      int j = bitReverse[i];
+      if (j > i)
+	{
+	  std::swap (re[i], re[j]);
+	  std::swap (im[i], im[j]);
+	}
+    }
+
+  for (int len = 2; len <= n; len *= 2)
+    {
+      int half = len / 2;
+      int stride = n / len;
+      for (int start = 0; start < n; start += len)
+	for (int k = 0; k < half; k++)
+	  {
+	    float wr = cs[k * stride];
+	    float wi = sn[k * stride];
+	    int a = start + k;
+	    int b = a + half;
+	    float tr = re[b] * wr - im[b] * wi;
+	    float ti = re[b] * wi + im[b] * wr;
+	    re[b] = re[a] - tr;
+	    im[b] = im[a] - ti;
+	    re[a] += tr;
+	    im[a] += ti;
+	  }
+    }
+}
+
+BENCH_SUITE (fft)
+{
+  mt19937 rng (1);
+  uniform_real_distribution < float >dist (-1, 1);
+
+  int sizes[] = { 256, 1024, 4096, 960, 1920 };
+  for (int s = 0; s < 5; s++)
+    {
+      int n = sizes[s];
+      vector < float >re (n), im (n);
+      for (int i = 0; i < n; i++)
+	{
+	  re[i] = dist (rng);
+	  im[i] = dist (rng);
+	}
+
+      FFT fft (n);
+      bench.run ("fft/complex/" + to_string (n), 2 * n * sizeof (float), n, [&] ()
+	{
+	  fft.forward (re.data (), im.data (), re.data (), im.data ());
+	  benchKeep (re.data ());
+	});
+
+      if (n & (n - 1))
+	continue;
+
+      vector < float >cs (n / 2), sn (n / 2);
+      for (int i = 0; i < n / 2; i++)
+	{
+	  cs[i] = cos (2 * M_PI * i / n);
+	  sn[i] = -sin (2 * M_PI * i / n);
+	}
+      vector < int >bitReverse (n);
+      for (int i = 0, bits = (int) log2 (n); i < n; i++)
+	{
+	  int r = 0;
+	  for (int b = 0; b < bits; b++)
+	    r |= ((i >> b) & 1) << (bits - 1 - b);
+	  bitReverse[i] = r;
+	}
+
+      bench.run ("fft/complex/" + to_string (n) + "/radix2", 2 * n * sizeof (float), n,
+		 [&] ()
+	{
+	  radix2 (re.data (), im.data (), n, cs.data (), sn.data (), bitReverse.data ());
+	  benchKeep (re.data ());
+	});
+    }
+
+  int realSizes[] = { 1024, 4096 };
+  for (int s = 0; s < 2; s++)
+    {
+      int n = realSizes[s];
+      vector < float >x (n);
+      for (int i = 0; i < n; i++)
+	x[i] = dist (rng);
+
+      RealFFT fft (n);
+      vector < float >re (fft.numBins ()), im (fft.numBins ());
+      bench.run ("fft/real/" + to_string (n), n * sizeof (float), n, [&] ()
+	{
+	  fft.forward (x.data (), re.data (), im.data ());
+	  benchKeep (re.data ());
+	});
+    }
+}
@@ -0,0 +1,55 @@
+// =================================================================================================
+// LoudnessBench.cpp
+//
+// Ten seconds of stereo metered on its own, and written to a 16-bit file with and without
+// a meter on the writer. The file is /dev/null, so the write times are for the conversion
+// rather than the disk. ns/item is per sample frame.
+// =================================================================================================
+
+#include "Bench.h"
+#include "../LoudnessMeter.h"
+#include <random>
+
+BENCH_SUITE (loudness)
+{
+  const int SAMPLE_RATE = 44100;
+  const int NUM_FRAMES = 10 * SAMPLE_RATE;
+  const int BLOCK = 4096;
+
+  mt19937 rng (1);
+  uniform_real_distribution < float >dist (-0.5f, 0.5f);
+  vector < float >x (2 * NUM_FRAMES);
+  for (float &v:x)
+    v = dist (rng);
+
+  double bytes = 2.0 * NUM_FRAMES * sizeof (float);
+  LoudnessMeter meter (SAMPLE_RATE, 2);
+  double lufs = 0;
+
+  bench.run ("loudness/meter", bytes, NUM_FRAMES, [&] ()
+    {
+      meter.reset ();
+      for (int i = 0; i < NUM_FRAMES; i += BLOCK)
+	meter.process (x.data () + 2 * i, min (BLOCK, NUM_FRAMES - i));
+      lufs = meter.integratedLoudness ();
+      benchKeep (&lufs);
+    });
+
+  for (int metered = 0; metered < 2; metered++)
+    bench.run (metered ? "loudness/write/metered" : "loudness/write/plain",
+	       bytes, NUM_FRAMES, [&] ()
+      {
+	WavWriter writer;
+	writer.open ("/dev/null", SAMPLE_RATE, 2);
+	if (metered)
+	  {
+	    meter.reset ();
+	    writer.setTap (&meter);
+	  }
+	for (int i = 0; i < NUM_FRAMES; i += BLOCK)
+	  writer.write (x.data () + 2 * i, min (BLOCK, NUM_FRAMES - i));
+	writer.close ();
+	lufs = meter.integratedLoudness ();
+	benchKeep (&lufs);
+      });
+}
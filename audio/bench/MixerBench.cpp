@@ -0,0 +1,51 @@
+// =================================================================================================
+// MixerBench.cpp
+//
+// Mixing many mono tracks to stereo: one thread rendering into memory, and renderToFile
+// with an increasing number of threads. The file is written to /dev/null, so the times
+// are for mixing and sample conversion rather than for the disk.
+// =================================================================================================
+
+#include "Bench.h"
+#include "../Mixer.h"
+#include <random>
+#include <thread>
+
+static const int NUM_TRACKS = 64;
+static const int NUM_FRAMES = 1 << 17;
+
+BENCH_SUITE (mixer)
+{
+  mt19937 rng (1);
+  uniform_real_distribution < float >dist (-0.1f, 0.1f);
+
+  vector < vector < float >>tracks (NUM_TRACKS);
+  Mixer mixer (44100);
+  for (int t = 0; t < NUM_TRACKS; t++)
+    {
+      tracks[t].resize (NUM_FRAMES);
+      for (int i = 0; i < NUM_FRAMES; i++)
+	tracks[t][i] = dist (rng);
+      mixer.addTrack (tracks[t].data (), NUM_FRAMES);
+      mixer.setPan (t, 2.0f * t / (NUM_TRACKS - 1) - 1);
+    }
+
+  double bytes = (double) NUM_TRACKS * NUM_FRAMES * sizeof (float);
+  double items = (double) NUM_TRACKS * NUM_FRAMES;
+  string suffix = "/" + to_string (NUM_TRACKS);
+
+  vector < float >y (2 * NUM_FRAMES);
+  bench.run ("mixer/render" + suffix, bytes, items, [&] ()
+    {
+      mixer.render (0, y.data (), NUM_FRAMES);
+      benchKeep (y.data ());
+    });
+
+  int maxThreads = max (1u, thread::hardware_concurrency ());
+  for (int threads = 1; threads <= maxThreads; threads *= 2)
+    bench.run ("mixer/file" + suffix + "/threads=" + to_string (threads),
+	       bytes, items, [&] ()
+      {
+	mixer.renderToFile ("/dev/null", threads);
+      });
+}
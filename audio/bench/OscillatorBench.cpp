@@ -0,0 +1,59 @@
+// =================================================================================================
+// OscillatorBench.cpp
+//
+// Rendering a sum of sine partials with OscillatorBank, in each mode, against calling sin()
+// for every partial of every sample as createTone used to.
+// =================================================================================================
+
+#include "Bench.h"
+#include "../OscillatorBank.h"
+#include <cmath>
+
+static const int NUM_SAMPLES = 1 << 14;
+static const double SAMPLE_RATE = 44100;
+
+static void
+benchPartials (Bench & bench, int numPartials)
+{
+  vector < float >x (NUM_SAMPLES);
+  string suffix = "/" + to_string (numPartials);
+  double items = (double) NUM_SAMPLES * numPartials;
+
+  // The loop createTone used, with the sample index scaled afresh for every partial
+  long start = 0;
+  bench.run ("oscillator/libm" + suffix, 0, items, [&] ()
+    {
+      for (int i = 0; i < NUM_SAMPLES; i++)
+	{
+	  long t = start + i;
+	  float v = 0.0;
+	  for (int p = 1; p <= numPartials; p++)
+	    v += 0.1 * sin (2 * M_PI * p * t * 100.0 / SAMPLE_RATE);
+	  x[i] = v;
+	}
+      start += NUM_SAMPLES;
+      benchKeep (x.data ());
+    });
+
+  OscillatorMode modes[] = { OSC_PHASOR, OSC_WAVETABLE };
+  const char *names[] = { "phasor", "wavetable" };
+  for (int m = 0; m < 2; m++)
+    {
+      OscillatorBank bank (SAMPLE_RATE, modes[m]);
+      for (int p = 1; p <= numPartials; p++)
+	bank.addPartial (100.0 * p, 0.1);
+
+      bench.run (string ("oscillator/") + names[m] + suffix,
+		 NUM_SAMPLES * sizeof (float), items, [&] ()
+	{
+	  bank.render (x.data (), NUM_SAMPLES);
+	  benchKeep (x.data ());
+	});
+    }
+}
+
+BENCH_SUITE (oscillatorBank)
+{
+  benchPartials (bench, 5);
+  benchPartials (bench, 64);
+}
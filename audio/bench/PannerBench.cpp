@@ -0,0 +1,100 @@
+// =================================================================================================
+// PannerBench.cpp
+//
+// Balancing interleaved stereo in place with the panner, against the old way of splitting
+// it into channels, scaling each and interleaving again; panning mono into stereo, against
+// a plain scalar loop; and both while the gains glide. ns/item is per sample frame.
+// =================================================================================================
+
+#include "Bench.h"
+#include "../Panner.h"
+#include <random>
+
+static const int NUM_FRAMES = 1 << 14;
+
+BENCH_SUITE (panner)
+{
+  mt19937 rng (1);
+  uniform_real_distribution < float >dist (-0.5f, 0.5f);
+  vector < float >mono (NUM_FRAMES), stereo (2 * NUM_FRAMES);
+  for (float &v:mono)
+    v = dist (rng);
+  for (float &v:stereo)
+    v = dist (rng);
+
+  double stereoBytes = 2.0 * NUM_FRAMES * sizeof (float);
+  double monoBytes = (double) NUM_FRAMES * sizeof (float);
+
+  // The gains stay close to 1 over many repetitions in place: 1 and 0.99999
+  Panner balance (PAN_BALANCE, 0.00001f);
+  bench.run ("panner/stereo/interleaved", stereoBytes, NUM_FRAMES, [&] ()
+    {
+      balance.processStereo (stereo.data (), stereo.data (), NUM_FRAMES);
+      benchKeep (stereo.data ());
+    });
+
+  // As main.cpp's applyBalance used to: deinterleave, scale, interleave
+  vector < float >left (NUM_FRAMES), right (NUM_FRAMES);
+  bench.run ("panner/stereo/deinterleaved", stereoBytes, NUM_FRAMES, [&] ()
+    {
+      float gainL = 1, gainR = 0.99999f;
+      for (int i = 0; i < NUM_FRAMES; i++)
+	{
+	  left[i] = stereo[2 * i];
+	  right[i] = stereo[2 * i + 1];
+	}
+      for (int i = 0; i < NUM_FRAMES; i++)
+	{
+	  left[i] *= gainL;
+	  right[i] *= gainR;
+	}
+      for (int i = 0; i < NUM_FRAMES; i++)
+	{
+	  stereo[2 * i] = left[i];
+	  stereo[2 * i + 1] = right[i];
+	}
+      benchKeep (stereo.data ());
+    });
+
+  // Every repetition is one long glide, back and forth
+  Panner glide (PAN_BALANCE);
+  glide.setRampLength (NUM_FRAMES);
+  float to = 0.00001f;
+  bench.run ("panner/stereo/ramp", stereoBytes, NUM_FRAMES, [&] ()
+    {
+      to = -to;
+      glide.setPan (to);
+      glide.processStereo (stereo.data (), stereo.data (), NUM_FRAMES);
+      benchKeep (stereo.data ());
+    });
+
+  vector < float >out (2 * NUM_FRAMES);
+  Panner pan (PAN_CONSTANT_POWER, 0.3f);
+  bench.run ("panner/mono/simd", monoBytes, NUM_FRAMES, [&] ()
+    {
+      pan.processMono (mono.data (), out.data (), NUM_FRAMES);
+      benchKeep (out.data ());
+    });
+
+  bench.run ("panner/mono/scalar", monoBytes, NUM_FRAMES, [&] ()
+    {
+      float gainL, gainR;
+      Panner::gains (PAN_CONSTANT_POWER, 0.3f, gainL, gainR);
+      for (int i = 0; i < NUM_FRAMES; i++)
+	{
+	  out[2 * i] = gainL * mono[i];
+	  out[2 * i + 1] = gainR * mono[i];
+	}
+      benchKeep (out.data ());
+    });
+
+  Panner monoGlide (PAN_CONSTANT_POWER);
+  monoGlide.setRampLength (NUM_FRAMES);
+  bench.run ("panner/mono/ramp", monoBytes, NUM_FRAMES, [&] ()
+    {
+      to = -to;
+      monoGlide.setPan (1000 * to);
+      monoGlide.processMono (mono.data (), out.data (), NUM_FRAMES);
+      benchKeep (out.data ());
+    });
+}
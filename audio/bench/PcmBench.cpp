@@ -0,0 +1,123 @@
+// =================================================================================================
+// PcmBench.cpp
+//
+// Throughput of the PCM conversion kernels at each instruction set level, against the
+// per-sample loops audioRead/audioWrite used before the kernels existed. GB/s counts the
+// bytes of integer PCM read or written.
+// =================================================================================================
+
+#include "Bench.h"
+#include "../PcmConvert.h"
+#include "../SimdIsa.h"
+#include <climits>
+#include <cstdlib>
+
+// 64K samples keeps the buffers in L2, so the loops rather than memory are measured
+static const int NUM_SAMPLES = 1 << 16;
+
+// The byte-by-byte loop audioRead used to convert integer samples
+static void
+legacyPcmToFloat (const uint8_t * src, float *x, int n, int bytesPerSample)
+{
+  float maxSample = 1u << (8 * bytesPerSample - 1);
+  float scale = 1.0 / maxSample;
+
+  for (int i = 0; i < n; i++)
+    {
+      int32_t sample = 0;
+      uint8_t *sampleBytes = (uint8_t *) (&sample);
+      for (int b = 0; b < bytesPerSample; b++)
+	sampleBytes[b] = *src++;
+
+      if (bytesPerSample == 1)
+	sample += CHAR_MIN;
+      else if (sampleBytes[bytesPerSample - 1] & 0x80)
+	{
+	  for (size_t b = bytesPerSample; b < sizeof (sample); b++)
+	    sampleBytes[b] = 0xFF;
+	}
+
+      x[i] = scale * sample;
+    }
+}
+
+// The clamp-and-scale loop audioWrite used to convert to 16-bit
+static void
+legacyFloatToPcm16 (const float *src, short *dst, int n)
+{
+  for (int i = 0; i < n; i++)
+    {
+      float flt = *src++;
+      flt = std::min < float >(flt, 1.0);
+      flt = std::max < float >(flt, -1.0);
+      *dst++ = SHRT_MAX * flt;
+    }
+}
+
+BENCH_SUITE (pcmConvert)
+{
+  vector < uint8_t > raw (NUM_SAMPLES * 4);
+  for (size_t i = 0; i < raw.size (); i++)
+    raw[i] = rand ();
+
+  vector < float >flt (NUM_SAMPLES);
+  for (int i = 0; i < NUM_SAMPLES; i++)
+    flt[i] = 2.2f * rand () / RAND_MAX - 1.1f;
+
+  // The integer conversions get their own output, so flt keeps its clipping input
+  vector < float >out (NUM_SAMPLES);
+  vector < int16_t > pcm16 (NUM_SAMPLES);
+  const uint8_t *src = raw.data ();
+  float *dst = out.data ();
+
+  // Reference: the loops the kernels replaced
+  for (int bytes = 1; bytes <= 4; bytes++)
+    {
+      string name = "pcmToFloat/" + to_string (8 * bytes) + "/legacy";
+      bench.run (name, NUM_SAMPLES * bytes, NUM_SAMPLES, [&] ()
+	{
+	  legacyPcmToFloat (src, dst, NUM_SAMPLES, bytes);
+	  benchKeep (dst);
+	});
+    }
+  bench.run ("floatToPcm16/legacy", NUM_SAMPLES * 2, NUM_SAMPLES, [&] ()
+    {
+      legacyFloatToPcm16 (flt.data (), pcm16.data (), NUM_SAMPLES);
+      benchKeep (pcm16.data ());
+    });
+
+  // Each instruction set the processor supports, up to AVX2, the widest with kernels here
+  SimdIsa best = simdIsa ();
+  for (int isa = SIMD_ISA_SCALAR; isa <= min (best, SIMD_ISA_AVX2); isa++)
+    {
+      setSimdIsa ((SimdIsa) isa);
+      string suffix = string ("/") + simdIsaName ((SimdIsa) isa);
+
+      bench.run ("pcmToFloat/8" + suffix, NUM_SAMPLES, NUM_SAMPLES, [&] ()
+	{
+	  pcm8ToFloat (src, dst, NUM_SAMPLES);
+	  benchKeep (dst);
+	});
+      bench.run ("pcmToFloat/16" + suffix, NUM_SAMPLES * 2, NUM_SAMPLES, [&] ()
+	{
+	  pcm16ToFloat ((const int16_t *) src, dst, NUM_SAMPLES);
+	  benchKeep (dst);
+	});
+      bench.run ("pcmToFloat/24" + suffix, NUM_SAMPLES * 3, NUM_SAMPLES, [&] ()
+	{
+	  pcm24ToFloat (src, dst, NUM_SAMPLES);
+	  benchKeep (dst);
+	});
+      bench.run ("pcmToFloat/32" + suffix, NUM_SAMPLES * 4, NUM_SAMPLES, [&] ()
+	{
+	  pcm32ToFloat ((const int32_t *) src, dst, NUM_SAMPLES);
+	  benchKeep (dst);
+	});
+      bench.run ("floatToPcm16" + suffix, NUM_SAMPLES * 2, NUM_SAMPLES, [&] ()
+	{
+	  floatToPcm16 (flt.data (), pcm16.data (), NUM_SAMPLES);
+	  benchKeep (pcm16.data ());
+	});
+    }
+  setSimdIsa (best);
+}
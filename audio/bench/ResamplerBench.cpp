@@ -0,0 +1,69 @@
+// =================================================================================================
+// ResamplerBench.cpp
+//
+// Resampling one second of mono audio, for the common sample rate conversions and for a
+// speed change, against the linear interpolation changeSpeed used to do. ns/item is per
+// input sample, so 1e9 / (ns/item * input rate) is how many times faster than realtime.
+// =================================================================================================
+
+#include "Bench.h"
+#include "../Resampler.h"
+#include <cmath>
+#include <random>
+
+static void
+benchResampler (Bench & bench, const string & name, Resampler & resampler,
+		const vector < float >&x)
+{
+  int n = (int) x.size ();
+  vector < float >y (resampler.maxOutput (n));
+
+  bench.run ("resampler/" + name, n * sizeof (float), n, [&] ()
+    {
+      resampler.process (x.data (), n, y.data ());
+      benchKeep (y.data ());
+    });
+}
+
+BENCH_SUITE (resampler)
+{
+  mt19937 rng (1);
+  uniform_real_distribution < float >dist (-0.5f, 0.5f);
+
+  int rates[][2] = { {44100, 48000}, {48000, 44100}, {96000, 44100}, {8000, 48000} };
+  for (int r = 0; r < 4; r++)
+    {
+      vector < float >x (rates[r][0]);
+      for (size_t i = 0; i < x.size (); i++)
+	x[i] = dist (rng);
+
+      Resampler resampler (rates[r][0], rates[r][1]);
+      benchResampler (bench, to_string (rates[r][0]) + "-" +
+		      to_string (rates[r][1]), resampler, x);
+    }
+
+  // Up two semitones
+  double speed = pow (2, 2.0 / 12);
+  vector < float >x (44100);
+  for (size_t i = 0; i < x.size (); i++)
+    x[i] = dist (rng);
+
+  Resampler resampler (1 / speed);
+  benchResampler (bench, "speed", resampler, x);
+
+  int n = (int) x.size ();
+  vector < float >y (n);
+  bench.run ("resampler/speed/linear", n * sizeof (float), n, [&] ()
+    {
+      int outLen = (int) (n / speed);
+      double pos = 0.0;
+      for (int i = 0; i < outLen && pos < n - 1; i++)
+	{
+	  int intPos = (int) pos;
+	  float frac = pos - intPos;
+	  y[i] = (1 - frac) * x[intPos] + frac * x[intPos + 1];
+	  pos += speed;
+	}
+      benchKeep (y.data ());
+    });
+}
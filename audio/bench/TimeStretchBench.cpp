@@ -0,0 +1,42 @@
+// =================================================================================================
+// TimeStretchBench.cpp
+//
+// Stretching and pitch shifting one second of noise with each method. ns/item is per input
+// sample, so 1e9 / (ns/item * 44100) is how many times faster than realtime.
+// =================================================================================================
+
+#include "Bench.h"
+#include "../TimeStretch.h"
+#include <random>
+
+BENCH_SUITE (timeStretch)
+{
+  const int SAMPLE_RATE = 44100;
+  mt19937 rng (1);
+  normal_distribution < float >dist (0, 0.1f);
+  vector < float >x (SAMPLE_RATE);
+  for (size_t i = 0; i < x.size (); i++)
+    x[i] = dist (rng);
+  int n = (int) x.size ();
+
+  StretchMethod methods[] = { STRETCH_WSOLA, STRETCH_PHASE_VOCODER };
+  const char *names[] = { "wsola", "vocoder" };
+  for (int m = 0; m < 2; m++)
+    {
+      TimeStretch stretch (SAMPLE_RATE, methods[m], 1.5);
+      vector < float >y (stretch.maxOutput (n));
+      bench.run (string ("timeStretch/") + names[m] + "/stretch", n * sizeof (float), n, [&] ()
+	{
+	  stretch.process (x.data (), n, y.data ());
+	  benchKeep (y.data ());
+	});
+
+      TimeStretch shift (SAMPLE_RATE, methods[m], 1.0, 2.0);
+      y.resize (shift.maxOutput (n));
+      bench.run (string ("timeStretch/") + names[m] + "/pitch", n * sizeof (float), n, [&] ()
+	{
+	  shift.process (x.data (), n, y.data ());
+	  benchKeep (y.data ());
+	});
+    }
+}
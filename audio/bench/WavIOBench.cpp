@@ -0,0 +1,133 @@
+// =================================================================================================
+// WavIOBench.cpp
+//
+// Whole-file audioRead and audioWrite, a file streamed through WavReader a block at a
+// time, and interleaving and deinterleaving in memory. The files are ten seconds of stereo
+// in the temporary directory, which the OS keeps cached, so the times are for parsing,
+// sample conversion and copying rather than for the disk. ns/item is per sample frame, and
+// GB/s counts the bytes of the file.
+// =================================================================================================
+
+#include "Bench.h"
+#include "../WavUtils.h"
+#include <cstdlib>
+#include <random>
+#include <unistd.h>
+
+static const int SAMPLE_RATE = 44100;
+static const int NUM_FRAMES = 10 * SAMPLE_RATE;
+
+// Reading and writing one sample format, in a file removed afterwards
+static void
+benchFormat (Bench & bench, const string & name, const vector < float >&x,
+	     int bitsPerSample, WavSampleFormat format)
+{
+  char path[] = "/tmp/wavIOBenchXXXXXX";
+  int fd = mkstemp (path);
+  if (fd < 0)
+    {
+      printf ("Couldn't create a temporary file\n");
+      return;
+    }
+  close (fd);
+
+  double bytes = (double) x.size () * bitsPerSample / 8;
+  int numCh = 2;
+
+  // audioWrite only writes 16-bit; other formats go through a WavWriter in one block
+  auto write =[&]()
+  {
+    if (bitsPerSample == 16 && format == WAV_FORMAT_PCM)
+      audioWrite (path, x, SAMPLE_RATE, numCh);
+    else
+      {
+	WavWriter writer;
+	writer.open (path, SAMPLE_RATE, numCh, bitsPerSample, format);
+	writer.write (x.data (), NUM_FRAMES);
+	writer.close ();
+      }
+  };
+
+  // The reading cases need the file even if the filter leaves out the writing one
+  write ();
+  bench.run ("audioWrite/" + name, bytes, NUM_FRAMES, write);
+
+  vector < float >y;
+  int sr;
+  bench.run ("audioRead/" + name, bytes, NUM_FRAMES, [&] ()
+    {
+      audioRead (path, y, sr, numCh);
+      benchKeep (y.data ());
+    });
+
+  vector < vector < float >>split;
+  bench.run ("audioRead/" + name + "/split", bytes, NUM_FRAMES, [&] ()
+    {
+      audioRead (path, split, sr);
+      benchKeep (split[0].data ());
+    });
+
+  // As main.cpp's examples read: a block at a time, never holding the whole file
+  const int BLOCK_SIZE = 4096;
+  vector < float >block (numCh * BLOCK_SIZE);
+  bench.run ("wavReader/" + name + "/block=" + to_string (BLOCK_SIZE), bytes,
+	     NUM_FRAMES, [&] ()
+    {
+      WavReader reader;
+      reader.open (path);
+      while (reader.read (block.data (), BLOCK_SIZE) > 0)
+	benchKeep (block.data ());
+    });
+
+  remove (path);
+}
+
+BENCH_SUITE (wavIO)
+{
+  mt19937 rng (1);
+  uniform_real_distribution < float >dist (-0.9f, 0.9f);
+
+  vector < float >x (2 * NUM_FRAMES);
+  for (size_t i = 0; i < x.size (); i++)
+    x[i] = dist (rng);
+
+  benchFormat (bench, "16/stereo", x, 16, WAV_FORMAT_PCM);
+  benchFormat (bench, "24/stereo", x, 24, WAV_FORMAT_PCM);
+  benchFormat (bench, "float/stereo", x, 32, WAV_FORMAT_FLOAT);
+}
+
+BENCH_SUITE (interleave)
+{
+  mt19937 rng (1);
+  uniform_real_distribution < float >dist (-1, 1);
+
+  // 4096 frames keeps a six-channel block in L2, as a block-based caller would have it
+  const int N = 4096;
+  int channelCounts[] = { 2, 6 };
+  for (int c = 0; c < 2; c++)
+    {
+      int numCh = channelCounts[c];
+      vector < float >interleaved (numCh * N);
+      for (size_t i = 0; i < interleaved.size (); i++)
+	interleaved[i] = dist (rng);
+
+      vector < vector < float >>split (numCh, vector < float >(N));
+      vector < float *>ptrs (numCh);
+      for (int ch = 0; ch < numCh; ch++)
+	ptrs[ch] = split[ch].data ();
+
+      double bytes = (double) numCh * N * sizeof (float);
+      string suffix = "/" + to_string (numCh);
+
+      bench.run ("deinterleave" + suffix, bytes, N, [&] ()
+	{
+	  deinterleave (interleaved.data (), ptrs.data (), numCh, N);
+	  benchKeep (ptrs[0]);
+	});
+      bench.run ("interleave" + suffix, bytes, N, [&] ()
+	{
+	  interleave (ptrs.data (), interleaved.data (), numCh, N);
+	  benchKeep (interleaved.data ());
+	});
+    }
+}
@@ -0,0 +1,64 @@
+// =================================================================================================
+// FindChunkFuzzer.cpp
+//
+// libFuzzer harness for the wav header parser. Every input is parsed as a complete file
+// and as a bare chunk list; neither may crash, assert or read out of bounds, whatever
+// the bytes are.
+//
+// Build and run with "make fuzz" (needs clang). "make fuzz-replay" builds a g++ version
+// that just parses the files given on its command line, e.g. to re-run a crash input.
+// =================================================================================================
+
+#include "../WavUtils.h"
+#include <sstream>
+#include <cstdio>
+
+extern "C" int
+LLVMFuzzerTestOneInput (const uint8_t * data, size_t size)
+{
+  string bytes ((const char *) data, size);
+
+  // As a whole file
+  {
+    istringstream in (bytes);
+    int sampleRate;
+    int64_t numSamples;
+    short numChannels;
+    short bitsPerSample;
+    short audioFormat;
+    readWavHeader (in, sampleRate, numSamples, numChannels, bitsPerSample,
+		   audioFormat);
+  }
+
+  // As a list of chunks, looking for one that is never there
+  {
+    istringstream in (bytes);
+    uint32_t chunkSize;
+    findChunk (in, "zzzz", chunkSize);
+  }
+
+  return 0;
+}
+
+#ifdef FUZZ_STANDALONE
+int
+main (int argc, const char *argv[])
+{
+  for (int i = 1; i < argc; i++)
+    {
+      ifstream in (argv[i], ios::in | ios::binary);
+      if (!in.is_open ())
+	{
+	  printf ("Couldn't open %s\n", argv[i]);
+	  continue;
+	}
+
+      string bytes ((istreambuf_iterator < char >(in)),
+		    istreambuf_iterator < char >());
+      LLVMFuzzerTestOneInput ((const uint8_t *) bytes.data (), bytes.size ());
+      printf ("%s: OK\n", argv[i]);
+    }
+
+  return 0;
+}
+#endif
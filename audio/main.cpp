@@ -10,13 +10,24 @@
 //
 
 #include <cstdio>
+#include <cstdlib>
 #include <cmath>
 #include <ctgmath>
 #include <vector>
 #include <string>
 #include <cassert>
+#include <algorithm>
 #include "WavUtils.h"
+#include "AudioGraph.h"
+#include "AudioNodes.h"
 #include "Biquad.h"
+#include "Convolver.h"
+#include "LoudnessMeter.h"
+#include "OscillatorBank.h"
+#include "Mixer.h"
+#include "Panner.h"
+#include "Resampler.h"
+#include "TimeStretch.h"
 
 using namespace std;
 
@@ -24,42 +35,43 @@ const int SAMPLE_RATE = 44100;
 const string IN_DIR = "InputFiles/";
 const string OUT_DIR = "OutputFiles/";
 
+// Reports a failed read or write. Returns true if the status is OK.
+static bool
+checkStatus (WavStatus status, const char *action, const string & path)
+{
+  if (status != WAV_OK)
+    printf ("Couldn't %s %s: %s\n", action, path.c_str (),
+	    wavStatusString (status));
+  return status == WAV_OK;
+}
+
 // Create a tone and write it to file
 void
 createTone ()
 {
   printf ("createTone\n");
 
-  // Set up a buffer for the output. Note that the buffer is two-dimensional,
-  // as we'll be creating a stereo output file.
+  // Set up a buffer for the output
   float durSecs = 5.0;
   int numFrames = SAMPLE_RATE * durSecs;
   vector < float >outBuf (numFrames);
 
-  // For each output frame
-  for (int i = 0; i < numFrames; i++)
-    {
-      // Generate a sample value
-      float freq = 440.0;
-      float x = 0.0;
-
-      // Fundamental
-      x += 0.30 * sin (2 * M_PI * i * freq / SAMPLE_RATE);
-
-      // Adding harmonics doesn't change the pitch, but
-      // changes the timbre.
-      x += 0.25 * sin (2 * M_PI * 2 * i * freq / SAMPLE_RATE);
-      x += 0.20 * sin (2 * M_PI * 3 * i * freq / SAMPLE_RATE);
-      x += 0.15 * sin (2 * M_PI * 4 * i * freq / SAMPLE_RATE);
-      x += 0.10 * sin (2 * M_PI * 5 * i * freq / SAMPLE_RATE);
-
-      // Write it to the left and right channels
-      outBuf[i] = x;		// Left
-    }
+  // A fundamental plus harmonics. Adding harmonics doesn't change the pitch, but
+  // changes the timbre.
+  float freq = 440.0;
+  OscillatorBank tone (SAMPLE_RATE);
+  tone.addPartial (freq, 0.30);	// Fundamental
+  tone.addPartial (2 * freq, 0.25);
+  tone.addPartial (3 * freq, 0.20);
+  tone.addPartial (4 * freq, 0.15);
+  tone.addPartial (5 * freq, 0.10);
+
+  // Generate the samples
+  tone.render (outBuf.data (), numFrames);
 
   // Write the audio to file
   string outPath = OUT_DIR + "ToneOut.wav";
-  audioWrite (outPath, outBuf, SAMPLE_RATE);
+  checkStatus (audioWrite (outPath, outBuf, SAMPLE_RATE), "write", outPath);
 }
 
 // Read a mono audio file, write to an output file.
@@ -68,79 +80,61 @@ readWriteAudio ()
 {
   printf ("readWriteAudio\n");
 
-  // Read the input file
-  vector < float >sourceBuf;
-  int sr;
-  int numCh;
+  // Open the input file
+  WavReader reader;
   string sourcePath = IN_DIR + "RickAstleyMono.wav";
-  audioRead (sourcePath, sourceBuf, sr, numCh);
-  auto numFrames = sourceBuf.size ();
+  if (!checkStatus (reader.open (sourcePath), "read", sourcePath))
+    return;
+  int numCh = reader.numChannels ();
 
-  // Set up an output buffer
-  vector < float >outBuf (numFrames);
+  // Open the output file
+  WavWriter writer;
+  string outPath = OUT_DIR + "RickAstleyMonoCopy.wav";
+  if (!checkStatus (writer.open (outPath, SAMPLE_RATE, numCh), "write",
+		    outPath))
+    return;
 
-  // For each output frame
-  for (int i = 0; i < numFrames; i++)
-    {
-      // Get input sample
-      float x = sourceBuf[i];
+  // Copy the audio across at half gain, a block at a time
+  FileSourceNode source (reader);
+  GainNode gain (numCh, 0.5);
+  FileSinkNode sink (writer, numCh);
 
-      // Copy it to the output buffer
-      float gain = 0.5;
-      outBuf[i] = gain * x;
-    }
+  AudioGraph graph;
+  graph.connect (source, gain);
+  graph.connect (gain, sink);
+  graph.run ();
 
-  // Write the audio to file
-  string outPath = OUT_DIR + "RickAstleyMonoCopy.wav";
-  audioWrite (outPath, outBuf, SAMPLE_RATE);
+  checkStatus (writer.close (), "write", outPath);
 }
 
-// Read an audio file, and copy it to another file
+// Mix several audio files down to one stereo file
 void
 mixAudioFiles ()
 {
   printf ("mixAudioFiles\n");
 
-  // Set up buffers for all the audio.
-  vector < float >bass;
-  vector < float >guitar;
-  vector < float >keys;
-  vector < float >kit;
-
-  // Read in all the audio sources
-  int sr;
-  int numCh;
-  audioRead (IN_DIR + "AcesHigh/Bass.wav", bass, sr, numCh);
-  audioRead (IN_DIR + "AcesHigh/Guitar.wav", guitar, sr, numCh);
-  audioRead (IN_DIR + "AcesHigh/Keys.wav", keys, sr, numCh);
-  audioRead (IN_DIR + "AcesHigh/Kit.wav", kit, sr, numCh);
-
-  // Set up an output buffer
-  float durSecs = 30.0;
-  int numFrames = SAMPLE_RATE * durSecs;
-  vector < float >outBuf (numFrames);
-
-  // For each output frame
-  for (int i = 0; i < numFrames; i++)
-    {
-      // Add in contribution of each source
-      float x = 0.0;
-      x += bass[i];
-      x += guitar[i];
-      x += keys[i];
-      x += kit[i];
-
-      // Write mix to L/R output channels
-      outBuf[i] = x;
-    }
-
-  // Write the audio to file
+  // Each source is a track of the mix. Sources of different lengths are fine;
+  // the mix is as long as the longest one.
+  Mixer mixer (SAMPLE_RATE);
+  string paths[] = { IN_DIR + "AcesHigh/Bass.wav", IN_DIR + "AcesHigh/Guitar.wav",
+    IN_DIR + "AcesHigh/Keys.wav", IN_DIR + "AcesHigh/Kit.wav"
+  };
+  for (int s = 0; s < 4; s++)
+    if (!checkStatus (mixer.addTrack (paths[s]), "read", paths[s]))
+      return;
+
+  // Spread the instruments across the stereo field
+  float pans[] = { 0.0, -0.5, 0.5, 0.0 };
+  for (int s = 0; s < 4; s++)
+    mixer.setPan (s, pans[s]);
+
+  // Write the mix to file
   string outPath = OUT_DIR + "AcesHigh_Mix.wav";
-  audioWrite (outPath, outBuf, SAMPLE_RATE);
+  checkStatus (mixer.renderToFile (outPath), "write", outPath);
 }
 
-// Play audio at different speed using linear interpolation. Changing the speed
-// also changes the pitch.
+// Play audio at different speed by resampling it. Changing the speed also
+// changes the pitch.
 void
 changeSpeed ()
 {
@@ -157,78 +151,187 @@ changeSpeed ()
   int sr;
   int numCh;
   string sourcePath = IN_DIR + "RickAstleyMono.wav";
-  audioRead (sourcePath, sourceBuf, sr, numCh);
-  auto sourceLen = sourceBuf.size ();
+  if (!checkStatus (audioRead (sourcePath, sourceBuf, sr, numCh), "read",
+		    sourcePath))
+    return;
+  int sourceLen = (int) sourceBuf.size ();
+
+  // Resample to 1 / speed as many samples. The resampler's low-pass filter
+  // removes anything that would alias when speeding up.
+  Resampler resampler (1.0 / speed);
+  vector < float >outBuf (resampler.maxOutput (sourceLen) +
+			  resampler.maxOutput (resampler.latency ()));
+  int outLen = resampler.process (sourceBuf.data (), sourceLen, outBuf.data ());
+  outLen += resampler.flush (outBuf.data () + outLen);
+  outBuf.resize (outLen);
 
-  // Set up an output buffer
-  int outLen = sourceLen / speed;
-  vector < float >outBuf (outLen);
+  // Write the audio to file
+  string outPath = OUT_DIR + "ChangeSpeedOut.wav";
+  checkStatus (audioWrite (outPath, outBuf, SAMPLE_RATE, 1), "write", outPath);
+}
 
-  // For each output frame
-  float pos = 0.0;
-  for (int i = 0; i < outLen && pos < sourceLen - 1; i++)
-    {
-      // Break the current position into integer and fraction parts
-      int intPos = floor (pos);
-      float frac = pos - intPos;
+// Shift the pitch without changing the speed, streaming the audio through a
+// time stretcher one block at a time
+void
+shiftPitch ()
+{
+  printf ("shiftPitch\n");
 
-      // Get samples at integer positions just before and after current position
-      float prev = sourceBuf[intPos];
-      float next = sourceBuf[intPos + 1];
+  const int BLOCK_SIZE = 4096;
+  float pitchChangeSemitones = 2.0;
 
-      // Linearly interpolate between the samples
-      outBuf[i] = (1 - frac) * prev + frac * next;
+  // Open the input file
+  WavReader reader;
+  string sourcePath = IN_DIR + "RickAstleyMono.wav";
+  if (!checkStatus (reader.open (sourcePath), "read", sourcePath))
+    return;
+  int numCh = reader.numChannels ();
+
+  // Open the output file
+  WavWriter writer;
+  string outPath = OUT_DIR + "ShiftPitchOut.wav";
+  if (!checkStatus (writer.open (outPath, reader.sampleRate (), numCh), "write",
+		    outPath))
+    return;
+
+  // One stretcher per channel. They all produce the same number of samples.
+  vector < TimeStretch > stretchers;
+  for (int ch = 0; ch < numCh; ch++)
+    stretchers.push_back (TimeStretch (reader.sampleRate (),
+				       STRETCH_PHASE_VOCODER, 1.0,
+				       pitchChangeSemitones));
+
+  int maxOut = stretchers[0].maxOutput (BLOCK_SIZE);
+  vector < vector < float >>inBuf (numCh, vector < float >(BLOCK_SIZE));
+  vector < vector < float >>outBuf (numCh, vector < float >(maxOut));
+  vector < float *>inPtrs (numCh), outPtrs (numCh);
+  for (int ch = 0; ch < numCh; ch++)
+    {
+      inPtrs[ch] = inBuf[ch].data ();
+      outPtrs[ch] = outBuf[ch].data ();
+    }
 
-      // Increment the position based on the current speed
-      pos += speed;
+  // For each block of input, shift it and write out whatever is ready
+  int n;
+  while ((n = reader.read (inPtrs.data (), BLOCK_SIZE)) > 0)
+    {
+      int numOut = 0;
+      for (int ch = 0; ch < numCh; ch++)
+	numOut = stretchers[ch].process (inPtrs[ch], n, outPtrs[ch]);
+      writer.write (outPtrs.data (), numOut);
     }
 
-  // Write the audio to file
-  string outPath = OUT_DIR + "ChangeSpeedOut.wav";
-  audioWrite (outPath, outBuf, SAMPLE_RATE, 1);
+  // Then the output still held back at the end
+  int numOut = 0;
+  for (int ch = 0; ch < numCh; ch++)
+    numOut = stretchers[ch].flush (outPtrs[ch]);
+  writer.write (outPtrs.data (), numOut);
+
+  checkStatus (writer.close (), "write", outPath);
 }
 
-// Apply a filter
+// Apply a filter, streaming the audio through it a block at a time
 void
 applyFilter ()
 {
   printf ("applyFilter\n");
 
-  // Read the input file
-  vector < float >sourceBuf;
-  int sr;
-  int numCh;
+  // Open the input file
+  WavReader reader;
   string sourcePath = IN_DIR + "RickAstleyMono.wav";
-  audioRead (sourcePath, sourceBuf, sr, numCh);
-  auto sourceLen = sourceBuf.size ();
+  if (!checkStatus (reader.open (sourcePath), "read", sourcePath))
+    return;
+  assert (reader.numChannels () == 1);	// Expecting mono
 
-  // Set up an output buffer
-  vector < float >outBuf (sourceLen);
+  // Open the output file
+  WavWriter writer;
+  string outPath = OUT_DIR + "FilterOut.wav";
+  if (!checkStatus (writer.open (outPath, SAMPLE_RATE, 1), "write", outPath))
+    return;
 
-  // Set up a filter
-  Biquad filter (SAMPLE_RATE);
+  // Set up a filter. A low cutoff puts the poles close to the unit circle, where
+  // float coefficients would noticeably change the response, so FilterNode uses double.
+  FilterNode filter (SAMPLE_RATE);
 
   //float cutoffFreqHz = 1000;
-  //filter.initHPF(cutoffFreqHz);
+  //filter.filter(0).initHPF(cutoffFreqHz);
   float cutoffFreqHz = 400;
-  filter.initLPF (cutoffFreqHz);
+  filter.filter (0).initLPF (cutoffFreqHz);
 
-  // For each output frame
-  for (int i = 0; i < sourceLen; i++)
-    {
-      // Get the input sample
-      float x = sourceBuf[i];
+  // Stream the file through the filter
+  FileSourceNode source (reader);
+  FileSinkNode sink (writer, 1);
 
-      // Pass it to the filer
-      float y = filter.tick (x);
+  AudioGraph graph;
+  graph.connect (source, filter);
+  graph.connect (filter, sink);
+  graph.run ();
+
+  // Patches the header with the final length
+  checkStatus (writer.close (), "write", outPath);
+}
 
-      // And put it in the output buffer
-      outBuf[i] = y;
+// Add reverb by convolving with an impulse response, streaming the audio
+// through the convolver a block at a time
+void
+applyReverb ()
+{
+  printf ("applyReverb\n");
+
+  const int BLOCK_SIZE = 1024;
+  float reverbSeconds = 2.0;	// Time for the reverb to die away by 60 dB
+  float wetGain = 0.3;		// RMS gain of the reverb
+
+  // Open the input file
+  WavReader reader;
+  string sourcePath = IN_DIR + "RickAstleyMono.wav";
+  if (!checkStatus (reader.open (sourcePath), "read", sourcePath))
+    return;
+  assert (reader.numChannels () == 1);	// Expecting mono
+
+  // Open the output file
+  WavWriter writer;
+  string outPath = OUT_DIR + "ReverbOut.wav";
+  if (!checkStatus (writer.open (outPath, SAMPLE_RATE, 1), "write", outPath))
+    return;
+
+  // A simple synthetic room: noise decaying exponentially, scaled to the wet gain
+  int irLen = (int) (reverbSeconds * SAMPLE_RATE);
+  vector < float >ir (irLen);
+  srand (1);
+  double energy = 0;
+  for (int i = 0; i < irLen; i++)
+    {
+      float noise = 2.0f * rand () / RAND_MAX - 1.0f;
+      ir[i] = noise * exp (-6.9 * i / irLen);
+      energy += ir[i] * ir[i];
+    }
+  for (int i = 0; i < irLen; i++)
+    ir[i] *= wetGain / sqrt (energy);
+  Convolver convolver (ir.data (), irLen);
+
+  // For each block of input, mix the dry signal with the reverb and write it out.
+  // The reverb lags by the convolver's latency, which is a few milliseconds.
+  vector < float >block (BLOCK_SIZE), wet (BLOCK_SIZE);
+  int n;
+  while ((n = reader.read (block.data (), BLOCK_SIZE)) > 0)
+    {
+      convolver.process (block.data (), wet.data (), n);
+      for (int i = 0; i < n; i++)
+	block[i] += wet[i];
+      writer.write (block.data (), n);
     }
 
-  // Write the audio to file
-  string outPath = OUT_DIR + "FilterOut.wav";
-  audioWrite (outPath, outBuf, SAMPLE_RATE, 1);
+  // Then let the reverb ring out
+  std::fill (block.begin (), block.end (), 0.0f);
+  for (int left = irLen + convolver.latency (); left > 0; left -= BLOCK_SIZE)
+    {
+      n = std::min (left, BLOCK_SIZE);
+      convolver.process (block.data (), wet.data (), n);
+      writer.write (wet.data (), n);
+    }
+
+  checkStatus (writer.close (), "write", outPath);
 }
 
 // Reads audio from one file, writes it to another file
@@ -236,45 +339,92 @@ applyFilter ()
 void
 applyBalance ()
 {
-  const int NUM_CHANNELS = 2;
-
-  const int L = 0;		// Left channel
-  const int R = 1;		// Right channel
-
   printf ("applyBalance\n");
 
-  // Read the input file
-  int sr;
-  vector < vector < float >>sourceBuf;
+  // Open the input file
+  WavReader reader;
   string sourcePath = IN_DIR + "StairwayExcerpt.wav";
-  audioRead (sourcePath, sourceBuf, sr);
-  assert (sourceBuf.size () == NUM_CHANNELS);	// Expecting stereo
-  auto numFrames = sourceBuf[L].size ();
-
-  // Set up an output buffer
-  vector < vector < float >>outBuf (NUM_CHANNELS);
-  outBuf[L].resize (numFrames);
-  outBuf[R].resize (numFrames);
+  if (!checkStatus (reader.open (sourcePath), "read", sourcePath))
+    return;
+  assert (reader.numChannels () == 2);	// Expecting stereo
 
-  // For each output frame
-  for (int i = 0; i < numFrames; i++)
+  // Open the output file
+  WavWriter writer;
+  string outPath = OUT_DIR + "BalanceOut.wav";
+  if (!checkStatus (writer.open (outPath, SAMPLE_RATE, 2), "write", outPath))
+    return;
+
+  // The file's samples are interleaved, and so is the panner's input and output, so each
+  // block goes straight from the reader to the writer, balanced in place
+  float balance = 0.0;		// Range -1 (full left) to +1 (full right)
+  Panner panner (PAN_BALANCE, balance);
+
+  const int BLOCK_SIZE = 1024;
+  vector < float >buf (2 * BLOCK_SIZE);
+  int n;
+  while ((n = reader.read (buf.data (), BLOCK_SIZE)) > 0)
     {
-      // Get left and right input samples
-      float xL = sourceBuf[L][i];
-      float xR = sourceBuf[R][i];
+      panner.processStereo (buf.data (), buf.data (), n);
+      writer.write (buf.data (), n);
+    }
 
-      // Copy them to the output buffer
-      float balance = 0.0;	// Range -1 (full left) to +1 (full right)
-      float gainL = balance < 0.0 ? 1.0 : 1.0 - balance;
-      float gainR = balance > 0.0 ? 1.0 : 1.0 + balance;
+  checkStatus (writer.close (), "write", outPath);
+}
 
-      outBuf[L][i] = gainL * xL;
-      outBuf[R][i] = gainR * xR;
-    }
+// Several stages in one streaming pass: the audio is split into a dry path and a
+// filtered path, the two are mixed, and the mix is turned down and balanced. Each
+// stage only ever holds one block.
+void
+applyChain ()
+{
+  printf ("applyChain\n");
 
-  // Write the audio to file
-  string outPath = OUT_DIR + "BalanceOut.wav";
-  audioWrite (outPath, outBuf, SAMPLE_RATE);
+  // Open the input file
+  WavReader reader;
+  string sourcePath = IN_DIR + "StairwayExcerpt.wav";
+  if (!checkStatus (reader.open (sourcePath), "read", sourcePath))
+    return;
+  assert (reader.numChannels () == 2);	// Expecting stereo
+
+  // Open the output file
+  WavWriter writer;
+  string outPath = OUT_DIR + "ChainOut.wav";
+  if (!checkStatus (writer.open (outPath, SAMPLE_RATE, 2), "write", outPath))
+    return;
+
+  FileSourceNode source (reader);
+
+  // Bring up the low end by mixing in a low-passed copy
+  FilterNode lowPass (SAMPLE_RATE, 2);
+  lowPass.filter (0).initLPF (200);
+  lowPass.filter (1).initLPF (200);
+
+  MixNode mix (2, 2);
+  mix.setGain (0, 1.0);		// Dry
+  mix.setGain (1, 0.5);		// Low-passed
+
+  GainNode gain (2, 0.7);
+  BalanceNode balancer (-0.2);
+  FileSinkNode sink (writer, 2);
+
+  AudioGraph graph;
+  graph.connect (source, mix);	// Source 0 of the mix: inputs 0 and 1
+  graph.connect (source, lowPass);
+  graph.connect (lowPass, 0, mix, 2);	// Source 1 of the mix: inputs 2 and 3
+  graph.connect (lowPass, 1, mix, 3);
+  graph.connect (mix, gain);
+  graph.connect (gain, balancer);
+  graph.connect (balancer, sink);
+
+  // Meter the result as it's written, rather than reading the file again afterwards
+  LoudnessMeter meter (SAMPLE_RATE, 2);
+  writer.setTap (&meter);
+  graph.run ();
+
+  if (checkStatus (writer.close (), "write", outPath))
+    printf ("%.1f LUFS, true peak %.1f dBTP, RMS %.1f / %.1f dBFS\n",
+	    meter.integratedLoudness (), meter.truePeak (), meter.rms (0),
+	    meter.rms (1));
 }
 
 int
@@ -286,8 +436,11 @@ main (int argc, const char *argv[])
   //readWriteAudio();
   //mixAudioFiles();
   //changeSpeed();
+  //shiftPitch();
   //applyFilter();
+  //applyReverb();
   //applyBalance();
+  //applyChain();
 
   return 0;
 }
@@ -0,0 +1,343 @@
+// =================================================================================================
+// AlsaEngine.cpp
+// =================================================================================================
+
+#include "AlsaEngine.h"
+#include "../DenormalGuard.h"
+#include "../PcmConvert.h"
+#include <alsa/asoundlib.h>
+#include <cerrno>
+#include <cstring>
+#include <pthread.h>
+
+// Adds a whole period to a ring, or nothing if it hasn't room for all of it. Only the
+// producer adds, so the room seen can only grow before the items go in.
+static bool
+pushPeriod (RingBuffer < float >&ring, const float *x, int n)
+{
+  if (ring.capacity () - ring.size () < (size_t) n)
+    return false;
+  ring.pushBulk (x, n);
+  return true;
+}
+
+// Takes a whole period from a ring, or nothing if it doesn't hold all of it yet
+static bool
+popPeriod (RingBuffer < float >&ring, float *x, int n)
+{
+  if (ring.size () < (size_t) n)
+    return false;
+  ring.popBulk (x, n);
+  return true;
+}
+
+AlsaEngine::AlsaEngine ():m_capture (NULL), m_playback (NULL), m_linked (false),
+m_isFloat (true), m_numCh (0), m_periodFrames (0), m_numPeriods (0),
+m_realtime (false), m_processor (NULL), m_running (false), m_failed (false),
+m_framesProcessed (0), m_captureXruns (0), m_playbackXruns (0),
+m_lateBlocks (0), m_droppedBlocks (0)
+{
+  sem_init (&m_captured, 0, 0);
+}
+
+AlsaEngine::~AlsaEngine ()
+{
+  stop ();
+  sem_destroy (&m_captured);
+}
+
+// Sets up one device for interleaved samples at the config's rate and channels, as floats
+// if it has them and otherwise as 16-bit. The playback device must agree with the capture
+// device, which is opened first, on the sample format and period size.
+bool
+AlsaEngine::openDevice (snd_pcm_t * &pcm, const string & name, bool capture,
+			const AlsaConfig & config, string & error)
+{
+  const char *what = capture ? "capture" : "playback";
+  int err = snd_pcm_open (&pcm, name.c_str (),
+			  capture ? SND_PCM_STREAM_CAPTURE :
+			  SND_PCM_STREAM_PLAYBACK, 0);
+  if (err < 0)
+    {
+      pcm = NULL;
+      error = "can't open " + name + " for " + what + ": " + snd_strerror (err);
+      return false;
+    }
+
+  snd_pcm_hw_params_t *hw;
+  snd_pcm_hw_params_alloca (&hw);
+  snd_pcm_hw_params_any (pcm, hw);
+  if (capture)
+    m_isFloat = snd_pcm_hw_params_test_format (pcm, hw,
+					       SND_PCM_FORMAT_FLOAT_LE) == 0;
+
+  unsigned rate = config.sampleRate;
+  snd_pcm_uframes_t period =
+    capture ? config.periodFrames : (snd_pcm_uframes_t) m_periodFrames;
+  unsigned periods = config.numPeriods;
+  if ((err = snd_pcm_hw_params_set_access (pcm, hw,
+					   SND_PCM_ACCESS_RW_INTERLEAVED)) < 0
+      || (err = snd_pcm_hw_params_set_format (pcm, hw,
+					      m_isFloat ? SND_PCM_FORMAT_FLOAT_LE :
+					      SND_PCM_FORMAT_S16_LE)) < 0
+      || (err = snd_pcm_hw_params_set_channels (pcm, hw,
+						config.numChannels)) < 0
+      || (err = snd_pcm_hw_params_set_rate_near (pcm, hw, &rate, NULL)) < 0
+      || (err = snd_pcm_hw_params_set_period_size_near (pcm, hw, &period,
+							NULL)) < 0
+      || (err = snd_pcm_hw_params_set_periods_near (pcm, hw, &periods,
+						    NULL)) < 0
+      || (err = snd_pcm_hw_params (pcm, hw)) < 0)
+    {
+      error = name + " can't do " + what + " of " +
+	to_string (config.numChannels) + " channels at " +
+	to_string (config.sampleRate) + " Hz: " + snd_strerror (err);
+      return false;
+    }
+
+  if ((int) rate != config.sampleRate
+      || (!capture && (int) period != m_periodFrames))
+    {
+      error = name + " doesn't support the sample rate or period size of " +
+	(capture ? "the config" : "the capture device");
+      return false;
+    }
+  m_periodFrames = (int) period;
+  m_numPeriods = (int) periods;
+
+  // Wake a period at a time. Playback is started explicitly once it has been given a lead
+  // over capture, so it mustn't start itself as soon as it has data.
+  snd_pcm_sw_params_t *sw;
+  snd_pcm_sw_params_alloca (&sw);
+  snd_pcm_uframes_t boundary;
+  if ((err = snd_pcm_sw_params_current (pcm, sw)) < 0
+      || (err = snd_pcm_sw_params_set_avail_min (pcm, sw, period)) < 0
+      || (err = snd_pcm_sw_params_get_boundary (sw, &boundary)) < 0
+      || (!capture
+	  && (err = snd_pcm_sw_params_set_start_threshold (pcm, sw,
+							   boundary)) < 0)
+      || (err = snd_pcm_sw_params (pcm, sw)) < 0)
+    {
+      error = "can't set up " + name + ": " + snd_strerror (err);
+      return false;
+    }
+
+  return true;
+}
+
+bool
+AlsaEngine::start (const AlsaConfig & config, AudioProcessor & processor,
+		   string & error)
+{
+  stop ();
+
+  if (!openDevice (m_capture, config.captureDevice, true, config, error)
+      || !openDevice (m_playback, config.playbackDevice, false, config,
+		      error))
+    {
+      stop ();
+      return false;
+    }
+  m_linked = snd_pcm_link (m_capture, m_playback) == 0;
+
+  // Every buffer the threads will use. The rings hold a few periods, so the processing can
+  // fall briefly behind without losing anything.
+  m_numCh = config.numChannels;
+  int periodSamples = m_periodFrames * m_numCh;
+  m_deviceBuf.assign (periodSamples * (m_isFloat ? sizeof (float) :
+				       sizeof (int16_t)), 0);
+  m_deviceFloat.assign (periodSamples, 0);
+  m_processIn.assign (periodSamples, 0);
+  m_processOut.assign (periodSamples, 0);
+  m_inRing.reset (new RingBuffer < float >(4 * periodSamples));
+  m_outRing.reset (new RingBuffer < float >(4 * periodSamples));
+
+  // A period of silence in the output ring covers the period the first block takes
+  m_outRing->pushBulk (m_processOut.data (), periodSamples);
+
+  m_processor = &processor;
+  m_processor->prepare (config.sampleRate, m_numCh, m_periodFrames);
+
+  m_framesProcessed = 0;
+  m_captureXruns = 0;
+  m_playbackXruns = 0;
+  m_lateBlocks = 0;
+  m_droppedBlocks = 0;
+  m_failed = false;
+
+  if (!startDevices ())
+    {
+      error = "can't start the devices";
+      stop ();
+      return false;
+    }
+
+  m_running = true;
+  m_deviceThread = thread (&AlsaEngine::deviceLoop, this);
+  m_processThread = thread (&AlsaEngine::processLoop, this);
+
+  // Realtime scheduling if we're allowed it, the device thread above the processing
+  sched_param param;
+  param.sched_priority = config.priority;
+  m_realtime = pthread_setschedparam (m_deviceThread.native_handle (),
+				      SCHED_FIFO, &param) == 0;
+  param.sched_priority = config.priority - 1;
+  m_realtime = pthread_setschedparam (m_processThread.native_handle (),
+				      SCHED_FIFO, &param) == 0 && m_realtime;
+
+  return true;
+}
+
+void
+AlsaEngine::stop ()
+{
+  if (m_running.exchange (false))
+    {
+      sem_post (&m_captured);
+      m_deviceThread.join ();
+      m_processThread.join ();
+    }
+
+  // Drain any posts left from the last run
+  while (sem_trywait (&m_captured) == 0)
+    ;
+
+  if (m_capture)
+    {
+      if (m_linked)
+	snd_pcm_unlink (m_capture);
+      snd_pcm_drop (m_capture);
+      snd_pcm_close (m_capture);
+      m_capture = NULL;
+    }
+  if (m_playback)
+    {
+      snd_pcm_drop (m_playback);
+      snd_pcm_close (m_playback);
+      m_playback = NULL;
+    }
+  m_linked = false;
+}
+
+// Prepares both devices, gives playback its lead of all but one period of silence, and
+// starts them. Also how the device thread recovers from an xrun.
+bool
+AlsaEngine::startDevices ()
+{
+  snd_pcm_drop (m_capture);
+  if (!m_linked)
+    snd_pcm_drop (m_playback);
+  if (snd_pcm_prepare (m_capture) < 0
+      || (!m_linked && snd_pcm_prepare (m_playback) < 0))
+    return false;
+
+  std::fill (m_deviceBuf.begin (), m_deviceBuf.end (), 0);
+  for (int p = 0; p < m_numPeriods - 1; p++)
+    if (snd_pcm_writei (m_playback, m_deviceBuf.data (), m_periodFrames) < 0)
+      return false;
+
+  // Linked, starting capture starts playback at the same moment
+  if (!m_linked && snd_pcm_start (m_playback) < 0)
+    return false;
+  return snd_pcm_start (m_capture) == 0;
+}
+
+void
+AlsaEngine::deviceLoop ()
+{
+  int periodSamples = m_periodFrames * m_numCh;
+  float *samples = m_deviceFloat.data ();
+  int numLate = 0;		// Periods played as silence whose audio hasn't been skipped yet
+
+  while (m_running.load (memory_order_relaxed))
+    {
+      // Capture a period. It's only short when the device stops or fails.
+      snd_pcm_sframes_t n =
+	snd_pcm_readi (m_capture, m_deviceBuf.data (), m_periodFrames);
+      if (n == -EPIPE || n == -ESTRPIPE)
+	{
+	  m_captureXruns++;
+	  if (!startDevices ())
+	    break;
+	  continue;
+	}
+      if (n < 0 && snd_pcm_recover (m_capture, (int) n, 1) < 0)
+	break;
+      if (n != m_periodFrames)
+	continue;
+
+      if (m_isFloat)
+	memcpy (samples, m_deviceBuf.data (), periodSamples * sizeof (float));
+      else
+	pcm16ToFloat ((const int16_t *) m_deviceBuf.data (), samples,
+		      periodSamples);
+
+      // Hand it to the processing, whole periods only
+      if (!pushPeriod (*m_inRing, samples, periodSamples))
+	m_droppedBlocks++;
+      sem_post (&m_captured);
+
+      // Play the oldest processed period, or silence if there isn't one yet. A period
+      // played as silence is skipped when it turns up, once the one after it is there
+      // too, so the delay doesn't grow by a period every time the processing is late.
+      // Skipping reads into samples, which the period played then overwrites.
+      while (numLate > 0 && m_outRing->size () >= 2 * (size_t) periodSamples)
+	{
+	  m_outRing->popBulk (samples, periodSamples);
+	  numLate--;
+	}
+      if (!popPeriod (*m_outRing, samples, periodSamples))
+	{
+	  std::fill (samples, samples + periodSamples, 0.0f);
+	  numLate++;
+	  m_lateBlocks++;
+	}
+
+      if (m_isFloat)
+	memcpy (m_deviceBuf.data (), samples, periodSamples * sizeof (float));
+      else
+	floatToPcm16 (samples, (int16_t *) m_deviceBuf.data (), periodSamples);
+
+      n = snd_pcm_writei (m_playback, m_deviceBuf.data (), m_periodFrames);
+      if (n == -EPIPE || n == -ESTRPIPE)
+	{
+	  m_playbackXruns++;
+	  if (!startDevices ())
+	    break;
+	}
+      else if (n < 0 && snd_pcm_recover (m_playback, (int) n, 1) < 0)
+	break;
+    }
+
+  // The devices failed for good. Wake the processing thread so it can see.
+  if (m_running.load ())
+    {
+      m_failed = true;
+      sem_post (&m_captured);
+    }
+}
+
+void
+AlsaEngine::processLoop ()
+{
+  int periodSamples = m_periodFrames * m_numCh;
+
+  // For the whole thread, so that no processor's silent tail can cost a dropout
+  DenormalGuard guard;
+
+  for (;;)
+    {
+      sem_wait (&m_captured);
+      if (!m_running.load (memory_order_relaxed) || m_failed.load ())
+	return;
+
+      while (popPeriod (*m_inRing, m_processIn.data (), periodSamples))
+	{
+	  m_processor->process (m_processIn.data (), m_processOut.data (),
+				m_periodFrames);
+	  if (!pushPeriod (*m_outRing, m_processOut.data (), periodSamples))
+	    m_droppedBlocks++;
+	  m_framesProcessed.fetch_add (m_periodFrames, memory_order_relaxed);
+	}
+    }
+}
@@ -0,0 +1,163 @@
+// =================================================================================================
+// AlsaEngine.h
+//
+// Live duplex audio through ALSA: audio captured from one device is processed and played
+// on another (or the same) as it arrives.
+//
+// Two threads share the work. The device thread blocks on the capture device a period at
+// a time, passes each period to the processing thread through a lock-free ring, and plays
+// whatever the processing thread has put in the other ring. It never waits for the
+// processing, so a slow block costs a period of silence rather than a device xrun. The
+// processing thread runs an AudioProcessor, e.g. a GraphProcessor running an AudioGraph.
+// Neither thread allocates or takes a lock once running; all the buffers are made by start.
+//
+// The ALSA "null" device tests the whole path without audio hardware, and the snd-aloop
+// module's loopback devices test it with a real device's timing (see LiveMain.cpp).
+//
+// The MATLAB support package in this tree has ALSA code of its own
+// (toolbox/realtime/targets/linux/src/MW_alsa_audio.c), but it isn't used here: it is
+// MathWorks code, written for Simulink's generated code, with integer samples only and
+// blocking reads and writes on the caller's thread.
+//
+// =================================================================================================
+
+#ifndef __AlsaEngine__
+#define __AlsaEngine__
+
+#include "../../DS/RingBuffer.h"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <semaphore.h>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+typedef struct _snd_pcm snd_pcm_t;
+
+/// What the engine runs on the live audio
+class AudioProcessor
+{
+public:
+
+	virtual ~AudioProcessor() {}
+
+	/// Called by AlsaEngine::start before the audio starts, to allocate whatever process
+	/// will need
+	///
+	///	@param	sampleRate	Sample rate of the devices
+	///	@param	numCh		Number of channels in and out
+	///	@param	maxFrames	Most sample frames process will be given
+	///
+	virtual void prepare(int sampleRate, int numCh, int maxFrames) {}
+
+	/// Processes one block on the processing thread. It must not block, allocate or take a
+	/// lock that another thread could hold for long.
+	///
+	///	@param	in			Captured audio, interleaved
+	///	@param	out			Audio to play, interleaved, to be filled
+	///	@param	numFrames	Number of sample frames
+	///
+	virtual void process(const float *in, float *out, int numFrames) = 0;
+};
+
+/// Devices and buffering for AlsaEngine
+struct AlsaConfig
+{
+	string captureDevice = "default";	// ALSA device names, e.g. "hw:0", "null"
+	string playbackDevice = "default";
+	int sampleRate = 48000;
+	int numChannels = 2;
+	int periodFrames = 256;				// Sample frames per period, asked of the devices
+	int numPeriods = 3;					// Periods in each device's buffer
+	int priority = 70;					// SCHED_FIFO priority of the device thread, if
+										// allowed; the processing thread's is one lower
+};
+
+class AlsaEngine
+{
+public:
+
+	AlsaEngine();
+	~AlsaEngine();
+
+	/// Opens the devices and starts the audio
+	///
+	///	@param	config		Devices and buffering
+	///	@param	processor	Run on every period. It must outlive the engine's running.
+	///	@param	error		If the devices couldn't be opened or set up, why
+	/// @return				true if the audio is running
+	///
+	bool start(const AlsaConfig& config, AudioProcessor& processor, string& error);
+
+	/// Stops the audio and closes the devices
+	void stop();
+
+	/// false once stopped, or if the devices failed in a way they couldn't recover from
+	bool isRunning() const { return m_running.load() && !m_failed.load(); }
+
+	/// Sample frames per period, as the devices agreed it, once started
+	int periodFrames() const { return m_periodFrames; }
+
+	/// Latency from capture to playback in sample frames: the playback buffer's lead over
+	/// capture, plus the period the processing thread has to process each block
+	int latencyFrames() const { return m_numPeriods * m_periodFrames; }
+
+	/// true if the threads got realtime scheduling. Without it (e.g. without permission
+	/// for SCHED_FIFO) they still run, but other work can delay them into dropouts.
+	bool isRealtime() const { return m_realtime; }
+
+	/// Counters, readable from any thread while running
+	int64_t framesProcessed() const { return m_framesProcessed.load(memory_order_relaxed); }
+	int64_t captureXruns() const { return m_captureXruns.load(memory_order_relaxed); }
+	int64_t playbackXruns() const { return m_playbackXruns.load(memory_order_relaxed); }
+
+	/// Periods played as silence because processing hadn't finished them in time
+	int64_t lateBlocks() const { return m_lateBlocks.load(memory_order_relaxed); }
+
+	/// Periods dropped because the processing thread had fallen too far behind the device
+	/// thread, or run too far ahead of it
+	int64_t droppedBlocks() const { return m_droppedBlocks.load(memory_order_relaxed); }
+
+private:
+
+	snd_pcm_t *m_capture;
+	snd_pcm_t *m_playback;
+	bool m_linked;						// The devices start and stop together
+	bool m_isFloat;						// Float samples, else 16-bit
+	int m_numCh;
+	int m_periodFrames;
+	int m_numPeriods;
+	bool m_realtime;
+	AudioProcessor *m_processor;
+
+	thread m_deviceThread;
+	thread m_processThread;
+	atomic<bool> m_running;
+	atomic<bool> m_failed;
+	sem_t m_captured;					// Posted by the device thread for each period
+
+	unique_ptr<RingBuffer<float>> m_inRing;		// Captured audio, device thread to processing
+	unique_ptr<RingBuffer<float>> m_outRing;	// Processed audio, processing to device thread
+
+	vector<uint8_t> m_deviceBuf;		// One period as the devices have it
+	vector<float> m_deviceFloat;		// The same as floats
+	vector<float> m_processIn;			// One period for the processor
+	vector<float> m_processOut;
+
+	atomic<int64_t> m_framesProcessed;
+	atomic<int64_t> m_captureXruns;
+	atomic<int64_t> m_playbackXruns;
+	atomic<int64_t> m_lateBlocks;
+	atomic<int64_t> m_droppedBlocks;
+
+	bool openDevice(snd_pcm_t *&pcm, const string& name, bool capture,
+					const AlsaConfig& config, string& error);
+	bool startDevices();
+	void deviceLoop();
+	void processLoop();
+};
+
+#endif
@@ -0,0 +1,47 @@
+// =================================================================================================
+// GraphProcessor.cpp
+// =================================================================================================
+
+#include "GraphProcessor.h"
+#include "../WavUtils.h"
+#include <algorithm>
+#include <cassert>
+
+GraphProcessor::GraphProcessor (int numCh, int blockSize):
+m_numCh (numCh), m_input (numCh), m_output (numCh), m_graph (blockSize)
+{
+  m_graph.add (m_input);
+  m_graph.add (m_output);
+}
+
+void
+GraphProcessor::InputNode::process (const float *const *in, float **out, int n)
+{
+  deinterleave (m_in, out, numOutputs (), n);
+}
+
+void
+GraphProcessor::OutputNode::process (const float *const *in, float **out,
+				     int n)
+{
+  interleave (in, m_out, numInputs (), n);
+}
+
+void
+GraphProcessor::prepare (int sampleRate, int numCh, int maxFrames)
+{
+  assert (numCh == m_numCh);
+  m_graph.prepare ();
+}
+
+void
+GraphProcessor::process (const float *in, float *out, int numFrames)
+{
+  int blockSize = m_graph.blockSize ();
+  for (int i = 0; i < numFrames; i += blockSize)
+    {
+      m_input.m_in = in + (size_t) i * m_numCh;
+      m_output.m_out = out + (size_t) i * m_numCh;
+      m_graph.process (std::min (blockSize, numFrames - i));
+    }
+}
@@ -0,0 +1,67 @@
+// =================================================================================================
+// GraphProcessor.h
+//
+// Runs an AudioGraph live on an AlsaEngine. The captured audio comes into the graph from
+// input(), one output per channel, and what reaches output() is played. The nodes in
+// between are the same ones the offline examples use, e.g. a FilterNode's biquads.
+//
+// =================================================================================================
+
+#ifndef __GraphProcessor__
+#define __GraphProcessor__
+
+#include "AlsaEngine.h"
+#include "../AudioGraph.h"
+
+class GraphProcessor : public AudioProcessor
+{
+public:
+
+	/// @param	numCh		Number of channels in and out, as the engine is configured
+	///	@param	blockSize	Most samples the graph processes at once; a longer period is
+	///						processed in several blocks
+	///
+	GraphProcessor(int numCh, int blockSize = 256);
+
+	/// The captured audio, to connect to the first stage
+	AudioNode& input() { return m_input; }
+
+	/// Where the last stage goes, to be played
+	AudioNode& output() { return m_output; }
+
+	/// The graph, to add stages to and connect them with
+	AudioGraph& graph() { return m_graph; }
+
+	/// Called by the engine: plans the graph, so that process doesn't allocate
+	void prepare(int sampleRate, int numCh, int maxFrames);
+
+	/// Called by the engine for each block
+	void process(const float *in, float *out, int numFrames);
+
+private:
+
+	// Deinterleaves the captured block into the graph
+	class InputNode : public AudioNode
+	{
+	public:
+		InputNode(int numCh) : AudioNode(0, numCh), m_in(NULL) {}
+		void process(const float *const *in, float **out, int n);
+		const float *m_in;
+	};
+
+	// Interleaves the graph's output into the block to play
+	class OutputNode : public AudioNode
+	{
+	public:
+		OutputNode(int numCh) : AudioNode(numCh, 0), m_out(NULL) {}
+		void process(const float *const *in, float **out, int n);
+		float *m_out;
+	};
+
+	int m_numCh;
+	InputNode m_input;
+	OutputNode m_output;
+	AudioGraph m_graph;
+};
+
+#endif
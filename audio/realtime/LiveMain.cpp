@@ -0,0 +1,188 @@
+// =================================================================================================
+// LiveMain.cpp
+//
+// Runs an effect chain live: captures from one ALSA device, processes, plays on another.
+//
+// Usage: live.out [-i capture] [-o playback] [-r rate] [-n channels] [-p period] [-t seconds]
+//                 [-c chain]
+//   The chain is written as for batch.out, e.g. -c hpf:80,lpf:8000,gain:0.5; without one the
+//   audio passes through unchanged. It runs for -t seconds, or until interrupted, printing
+//   the engine's counters every second.
+//
+// Testing without audio hardware:
+//   live.out -i null -o null -t 10
+//     runs the whole path on ALSA's null device, which captures silence and discards what
+//     it's given.
+//   sudo modprobe snd-aloop
+//   live.out -i hw:Loopback,1,0 -o hw:Loopback,0,1 -c lpf:400
+//     runs it with a real device's timing: audio played to hw:Loopback,0,0 (e.g. with
+//     aplay -D hw:Loopback,0,0 file.wav) is captured, filtered, and can be heard back on
+//     hw:Loopback,1,1 (e.g. with arecord -D hw:Loopback,1,1 out.wav).
+// =================================================================================================
+
+#include "GraphProcessor.h"
+#include "../batch/Chain.h"
+#include <chrono>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+
+static volatile sig_atomic_t s_interrupted = 0;
+
+static void
+onInterrupt (int)
+{
+  s_interrupted = 1;
+}
+
+static void
+usage ()
+{
+  fprintf (stderr,
+	   "Usage: live.out [-i capture] [-o playback] [-r rate] [-n channels] "
+	   "[-p period] [-t seconds] [-c chain]\n"
+	   "  -i, -o    ALSA devices (default: default), e.g. hw:0, null\n"
+	   "  -r        Sample rate (default 48000)\n"
+	   "  -n        Channels (default 2)\n"
+	   "  -p        Sample frames per period (default 256)\n"
+	   "  -t        Seconds to run (default: until interrupted)\n"
+	   "  -c chain  Stages separated by commas, e.g. lpf:400,gain:0.5\n"
+	   "Stages:\n%s", chainHelp ());
+}
+
+int
+main (int argc, const char *argv[])
+{
+  AlsaConfig config;
+  string chainSpec;
+  double seconds = 0;
+
+  for (int i = 1; i < argc; i++)
+    {
+      string arg = argv[i];
+      if (arg.size () != 2 || arg[0] != '-' || i + 1 >= argc)
+	{
+	  usage ();
+	  return 1;
+	}
+
+      string value = argv[++i];
+      switch (arg[1])
+	{
+	case 'i':
+	  config.captureDevice = value;
+	  break;
+	case 'o':
+	  config.playbackDevice = value;
+	  break;
+	case 'r':
+	  config.sampleRate = atoi (value.c_str ());
+	  break;
+	case 'n':
+	  config.numChannels = atoi (value.c_str ());
+	  break;
+	case 'p':
+	  config.periodFrames = atoi (value.c_str ());
+	  break;
+	case 't':
+	  seconds = atof (value.c_str ());
+	  break;
+	case 'c':
+	  chainSpec = value;
+	  break;
+	default:
+	  usage ();
+	  return 1;
+	}
+    }
+
+  if (config.sampleRate <= 0 || config.numChannels <= 0
+      || config.periodFrames <= 0)
+    {
+      usage ();
+      return 1;
+    }
+
+  // The chain's stages, from the captured audio to the played
+  GraphProcessor processor (config.numChannels);
+  vector < unique_ptr < AudioNode > >stages;
+  if (!chainSpec.empty ())
+    {
+      vector < ChainStage > chain;
+      string error;
+      if (!parseChain (chainSpec, chain, error))
+	{
+	  fprintf (stderr, "Bad chain: %s\n", error.c_str ());
+	  return 1;
+	}
+      for (size_t i = 0; i < chain.size (); i++)
+	{
+	  AudioNode *node =
+	    makeChainNode (chain[i], config.sampleRate, config.numChannels);
+	  if (!node)
+	    {
+	      fprintf (stderr, "Stage %s can't be applied to %d channels at %d Hz\n",
+		       chain[i].name.c_str (), config.numChannels,
+		       config.sampleRate);
+	      return 1;
+	    }
+	  stages.push_back (unique_ptr < AudioNode > (node));
+	}
+    }
+
+  AudioNode *prev = &processor.input ();
+  for (size_t i = 0; i < stages.size (); i++)
+    {
+      processor.graph ().connect (*prev, *stages[i]);
+      prev = stages[i].get ();
+    }
+  processor.graph ().connect (*prev, processor.output ());
+
+  AlsaEngine engine;
+  string error;
+  if (!engine.start (config, processor, error))
+    {
+      fprintf (stderr, "Couldn't start: %s\n", error.c_str ());
+      return 1;
+    }
+  printf ("%s -> %s, %d channels at %d Hz, %d-frame periods, latency %.1f ms%s\n",
+	  config.captureDevice.c_str (), config.playbackDevice.c_str (),
+	  config.numChannels, config.sampleRate, engine.periodFrames (),
+	  1000.0 * engine.latencyFrames () / config.sampleRate,
+	  engine.isRealtime ()? "" : " (no realtime scheduling)");
+
+  signal (SIGINT, onInterrupt);
+  signal (SIGTERM, onInterrupt);
+
+  chrono::steady_clock::time_point start = chrono::steady_clock::now ();
+  for (int tick = 1; !s_interrupted && engine.isRunning (); tick++)
+    {
+      // A second at a time, but quick to notice an interruption
+      chrono::steady_clock::time_point next = start + chrono::seconds (tick);
+      while (!s_interrupted && engine.isRunning ()
+	     && chrono::steady_clock::now () < next)
+	this_thread::sleep_for (chrono::milliseconds (20));
+
+      printf ("%4d s  %10lld frames  xruns %lld in, %lld out  "
+	      "late %lld  dropped %lld\n", tick,
+	      (long long) engine.framesProcessed (),
+	      (long long) engine.captureXruns (),
+	      (long long) engine.playbackXruns (),
+	      (long long) engine.lateBlocks (),
+	      (long long) engine.droppedBlocks ());
+      fflush (stdout);
+
+      if (seconds > 0 && tick >= seconds)
+	break;
+    }
+
+  bool failed = !engine.isRunning ();
+  engine.stop ();
+  if (failed && !s_interrupted)
+    {
+      fprintf (stderr, "The devices stopped working\n");
+      return 1;
+    }
+  return 0;
+}
@@ -0,0 +1,218 @@
+// =================================================================================================
+// AudioGraphTest.cpp
+//
+// AudioGraph's scheduling and buffers, against the same stages run by hand.
+// =================================================================================================
+
+#include "gtest/gtest.h"
+#include "TestUtils.h"
+#include "../AudioGraph.h"
+#include "../AudioNodes.h"
+
+static const int SAMPLE_RATE = 44100;
+
+// A mono source playing a buffer, then silence
+class BufferSourceNode : public AudioNode
+{
+public:
+  BufferSourceNode (const vector < float >&x):AudioNode (0, 1), m_x (x), m_pos (0)
+  {
+  }
+
+  void process (const float *const *, float **out, int n)
+  {
+    for (int i = 0; i < n; i++, m_pos++)
+      out[0][i] = m_pos < (int64_t) m_x.size ()? m_x[m_pos] : 0;
+  }
+
+  int64_t framesLeft () const
+  {
+    return max < int64_t > (m_x.size () - m_pos, 0);
+  }
+
+private:
+  vector < float >m_x;
+  int64_t m_pos;
+};
+
+// A mono sink keeping everything it's given
+class CaptureNode : public AudioNode
+{
+public:
+  CaptureNode ():AudioNode (1, 0)
+  {
+  }
+
+  void process (const float *const *in, float **, int n)
+  {
+    y.insert (y.end (), in[0], in[0] + n);
+  }
+
+  vector < float >y;
+};
+
+// source -> gain -> filter -> sink, in blocks that don't divide the length
+TEST (AudioGraph, ChainMatchesStages)
+{
+  vector < float >x = testNoise (10000, 1, 0.5f);
+  BufferSourceNode source (x);
+  GainNode gain (1, 0.7f);
+  FilterNode filter (SAMPLE_RATE);
+  filter.filter (0).initLPF (1000);
+  CaptureNode sink;
+
+  // Added sink first: the graph works out the order
+  AudioGraph graph (300);
+  graph.add (sink);
+  graph.connect (filter, sink);
+  graph.connect (gain, filter);
+  graph.connect (source, gain);
+  EXPECT_EQ (graph.run (), 10000);
+
+  FilterNode::Filter expected (SAMPLE_RATE);
+  expected.initLPF (1000);
+  ASSERT_EQ (sink.y.size (), 10000u);
+  for (int i = 0; i < 10000; i++)
+    ASSERT_EQ (sink.y[i], (float) expected.tick (0.7f * x[i])) << i;
+}
+
+// One source fanning out to a dry and a filtered path, mixed back together
+TEST (AudioGraph, DryAndWetMix)
+{
+  vector < float >x = testNoise (5000);
+  BufferSourceNode source (x);
+  GainNode dry (1, 0.25f);
+  FilterNode wet (SAMPLE_RATE);
+  wet.filter (0).initHPF (3000);
+  MixNode mix (2);
+  mix.setGain (0, 0.5f);
+  mix.setGain (1, 2);
+  CaptureNode sink;
+
+  AudioGraph graph (256);
+  graph.connect (source, dry);
+  graph.connect (source, wet);
+  graph.connect (dry, 0, mix, 0);
+  graph.connect (wet, 0, mix, 1);
+  graph.connect (mix, sink);
+  graph.run ();
+
+  FilterNode::Filter hpf (SAMPLE_RATE);
+  hpf.initHPF (3000);
+  for (int i = 0; i < 5000; i++)
+    {
+      float expected = 0.5f * (0.25f * x[i]) + 2 * (float) hpf.tick (x[i]);
+      ASSERT_NEAR (sink.y[i], expected, 1e-6) << i;
+    }
+}
+
+// A long chain with branches off it: every node's output survives until its last reader,
+// however the buffers are shared
+TEST (AudioGraph, BufferReuse)
+{
+  const int DEPTH = 20;
+  vector < float >x = testNoise (3000);
+  BufferSourceNode source (x);
+  vector < unique_ptr < GainNode > >gains;
+  vector < unique_ptr < MixNode > >mixes;
+  CaptureNode sink;
+  AudioGraph graph (512);
+
+  // Stage i doubles, and every fourth one adds back the output of three stages before
+  AudioNode *prev = &source;
+  vector < AudioNode * >chain;
+  for (int i = 0; i < DEPTH; i++)
+    {
+      gains.push_back (unique_ptr < GainNode > (new GainNode (1, 2)));
+      graph.connect (*prev, *gains.back ());
+      prev = gains.back ().get ();
+      if (i % 4 == 3)
+	{
+	  mixes.push_back (unique_ptr < MixNode > (new MixNode (2)));
+	  graph.connect (*prev, 0, *mixes.back (), 0);
+	  graph.connect (*chain[i - 3], 0, *mixes.back (), 1);
+	  prev = mixes.back ().get ();
+	}
+      chain.push_back (prev);
+    }
+  graph.connect (*prev, sink);
+  graph.run ();
+
+  // Each group of four stages gives 16 times its input plus the first stage's 2 times
+  double scale = 1;
+  for (int i = 0; i < DEPTH / 4; i++)
+    scale *= 18;
+  for (int i = 0; i < 3000; i++)
+    ASSERT_NEAR (sink.y[i], scale * x[i], 1e-5 * scale) << i;
+}
+
+// The run lasts as long as the longest source; an unconnected input is silence
+TEST (AudioGraph, RunsForLongestSource)
+{
+  vector < float >a (1000, 0.25f), b (2500, 0.5f);
+  BufferSourceNode sourceA (a), sourceB (b);
+  MixNode mix (3);
+  CaptureNode sink;
+  AudioGraph graph (256);
+  graph.connect (sourceA, 0, mix, 0);
+  graph.connect (sourceB, 0, mix, 1);
+  graph.connect (mix, sink);
+  EXPECT_EQ (graph.run (), 2500);
+  ASSERT_EQ (sink.y.size (), 2500u);
+  for (int i = 0; i < 2500; i++)
+    ASSERT_EQ (sink.y[i], (i < 1000 ? 0.25f : 0) + 0.5f) << i;
+}
+
+// A source that never ends
+class EndlessNode : public AudioNode
+{
+public:
+  EndlessNode ():AudioNode (0, 1)
+  {
+  }
+
+  void process (const float *const *, float **out, int n)
+  {
+    std::fill (out[0], out[0] + n, 1.0f);
+  }
+};
+
+// With no source that knows its length, run has nothing to run to, and returns at once
+TEST (AudioGraph, RunWithoutLengthReturns)
+{
+  EndlessNode source;
+  CaptureNode sink;
+  AudioGraph graph (256);
+  graph.connect (source, sink);
+  EXPECT_EQ (graph.run (), 0);
+  EXPECT_TRUE (sink.y.empty ());
+}
+
+// A file through the graph comes out sample for sample
+TEST (AudioGraph, FileToFile)
+{
+  TempFile in, out;
+  vector < float >x = testSines (2, 5000, SAMPLE_RATE);
+  {
+    WavWriter writer;
+    ASSERT_EQ (writer.open (in.path (), SAMPLE_RATE, 2, 32, WAV_FORMAT_FLOAT), WAV_OK);
+    writer.write (x.data (), 5000);
+    ASSERT_EQ (writer.close (), WAV_OK);
+  }
+
+  WavReader reader;
+  ASSERT_EQ (reader.open (in.path ()), WAV_OK);
+  WavWriter writer;
+  ASSERT_EQ (writer.open (out.path (), SAMPLE_RATE, 2, 32, WAV_FORMAT_FLOAT), WAV_OK);
+  FileSourceNode source (reader);
+  FileSinkNode sink (writer, 2);
+  AudioGraph graph (1000);
+  graph.connect (source, sink);
+  EXPECT_EQ (graph.run (), 5000);
+  ASSERT_EQ (writer.close (), WAV_OK);
+
+  vector < float >y;
+  int sr, numCh;
+  ASSERT_EQ (audioRead (out.path (), y, sr, numCh), WAV_OK);
+  EXPECT_EQ (y, x);
+}
@@ -0,0 +1,149 @@
+// =================================================================================================
+// BiquadCascadeTest.cpp
+//
+// BiquadCascade gives exactly the output of the same sections chained as Biquads, and its
+// Butterworth and Linkwitz-Riley designs have the responses they're named for.
+// =================================================================================================
+
+#include "gtest/gtest.h"
+#include "TestUtils.h"
+#include "../BiquadCascade.h"
+
+static const float SAMPLE_RATE = 48000;
+
+// Sections of different kinds, so each pairing in the staggered loop is exercised
+static vector < Biquad > testSections (int numSections)
+{
+  vector < Biquad > sections;
+  for (int i = 0; i < numSections; i++)
+    {
+      Biquad b (SAMPLE_RATE);
+      switch (i % 4)
+	{
+	case 0:
+	  b.initLPF (2000 + 500 * i, 0.9);
+	  break;
+	case 1:
+	  b.initHPF (100 + 10 * i);
+	  break;
+	case 2:
+	  b.initBPF (1000 + 100 * i, 2, 1.5);
+	  break;
+	default:
+	  b.initNotch (3000 + 100 * i);
+	}
+      sections.push_back (b);
+    }
+  return sections;
+}
+
+TEST (BiquadCascade, MatchesChainedTicks)
+{
+  vector < float >x = testNoise (10000);
+
+  // Odd and even section counts, and block sizes that split the sub-blocks
+  for (int numSections : {1, 2, 3, 8})
+    for (int blockSize : {1, 63, 64, 1000})
+      {
+	SCOPED_TRACE (to_string (numSections) + " sections, blocks of " +
+		      to_string (blockSize));
+	vector < Biquad > chain = testSections (numSections);
+	BiquadCascade cascade (SAMPLE_RATE, numSections);
+	for (int s = 0; s < numSections; s++)
+	  cascade.setSection (s, chain[s]);
+
+	vector < float >expected (x.size ());
+	for (size_t i = 0; i < x.size (); i++)
+	  {
+	    float v = x[i];
+	    for (int s = 0; s < numSections; s++)
+	      v = chain[s].tick (v);
+	    expected[i] = v;
+	  }
+
+	// In place
+	vector < float >y = x;
+	for (size_t i = 0; i < y.size (); i += blockSize)
+	  cascade.process (y.data () + i, y.data () + i,
+			   std::min < int >(blockSize, y.size () - i));
+	ASSERT_EQ (y, expected);
+      }
+}
+
+// To within 0.05 dB, or below -80 dB where float rounding takes over
+static void
+expectGainDb (double measured, double expected, double f)
+{
+  if (expected > -80)
+    EXPECT_NEAR (measured, expected, 0.05) << f << " Hz";
+  else
+    EXPECT_LT (measured, -79) << f << " Hz";
+}
+
+TEST (BiquadCascade, ButterworthResponse)
+{
+  for (int order : {1, 2, 5, 8})
+    {
+      SCOPED_TRACE ("order " + to_string (order));
+      BiquadCascade lpf (SAMPLE_RATE), hpf (SAMPLE_RATE);
+      lpf.initButterworthLPF (order, 1000);
+      hpf.initButterworthHPF (order, 1000);
+      EXPECT_EQ (lpf.numSections (), (order + 1) / 2);
+
+      auto runLpf =[&](const float *x, float *y, int n)
+      {
+	lpf.clear ();
+	lpf.process (x, y, n);
+      };
+      auto runHpf =[&](const float *x, float *y, int n)
+      {
+	hpf.clear ();
+	hpf.process (x, y, n);
+      };
+
+      // The bilinear transform of the analog Butterworth response,
+      // 1 / (1 + (f / f0)^(2 order)), with the frequencies prewarped
+      for (double f : {100.0, 500.0, 1000.0, 2000.0, 4000.0})
+	{
+	  double ratio = tan (M_PI * f / SAMPLE_RATE) / tan (M_PI * 1000 / SAMPLE_RATE);
+	  double lowDb = -10 * log10 (1 + pow (ratio, 2 * order));
+	  double highDb = -10 * log10 (1 + pow (ratio, -2 * order));
+	  expectGainDb (sineGainDb (runLpf, f, SAMPLE_RATE), lowDb, f);
+	  expectGainDb (sineGainDb (runHpf, f, SAMPLE_RATE), highDb, f);
+	}
+    }
+}
+
+// A Linkwitz-Riley low-pass and high-pass sum to a flat response, and are each -6 dB at
+// the crossover
+TEST (BiquadCascade, LinkwitzRileyCrossover)
+{
+  for (int order : {4, 8})
+    {
+      SCOPED_TRACE ("order " + to_string (order));
+      BiquadCascade lpf (SAMPLE_RATE), hpf (SAMPLE_RATE);
+      lpf.initLinkwitzRileyLPF (order, 2000);
+      hpf.initLinkwitzRileyHPF (order, 2000);
+      EXPECT_EQ (lpf.numSections (), order / 2);
+
+      auto runLpf =[&](const float *x, float *y, int n)
+      {
+	lpf.clear ();
+	lpf.process (x, y, n);
+      };
+      EXPECT_NEAR (sineGainDb (runLpf, 2000, SAMPLE_RATE), -6.02, 0.02);
+
+      auto runSum =[&](const float *x, float *y, int n)
+      {
+	vector < float >high (n);
+	lpf.clear ();
+	hpf.clear ();
+	lpf.process (x, y, n);
+	hpf.process (x, high.data (), n);
+	for (int i = 0; i < n; i++)
+	  y[i] += high[i];
+      };
+      for (double f : {200.0, 1000.0, 2000.0, 4000.0, 12000.0})
+	EXPECT_NEAR (sineGainDb (runSum, f, SAMPLE_RATE), 0, 0.01) << f << " Hz";
+    }
+}
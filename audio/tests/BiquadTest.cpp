@@ -0,0 +1,196 @@
+// =================================================================================================
+// BiquadTest.cpp
+//
+// BiquadT's forms and precisions against a long double reference.
+// =================================================================================================
+
+#include "gtest/gtest.h"
+#include "TestUtils.h"
+#include "../Biquad.h"
+#include <type_traits>
+
+static const double SAMPLE_RATE = 96000;
+
+// The RBJ low-pass, in long double, as Direct Form I
+class ReferenceLPF
+{
+public:
+  ReferenceLPF (long double f0, long double q)
+  {
+    long double w0 = 2 * M_PIl * f0 / SAMPLE_RATE;
+    long double alpha = sinl (w0) / (2 * q);
+    long double a0 = 1 + alpha;
+    b0 = (1 - cosl (w0)) / 2 / a0;
+    b1 = (1 - cosl (w0)) / a0;
+    b2 = b0;
+    a1 = -2 * cosl (w0) / a0;
+    a2 = (1 - alpha) / a0;
+    x1 = x2 = y1 = y2 = 0;
+  }
+
+  long double tick (long double x)
+  {
+    long double y = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+    x2 = x1;
+    x1 = x;
+    y2 = y1;
+    y1 = y;
+    return y;
+  }
+
+private:
+  long double b0, b1, b2, a1, a2, x1, x2, y1, y2;
+};
+
+// Error of a filter's output on noise, relative to the reference, in dB
+template < class Filter > static double
+errorDb (double f0)
+{
+  vector < float >x = testNoise (200000);
+  Filter filter (SAMPLE_RATE);
+  filter.initLPF (f0);
+  ReferenceLPF ref (f0, M_SQRT1_2);
+
+  long double error = 0, signal = 0;
+  for (size_t i = 0; i < x.size (); i++)
+    {
+      long double expected = ref.tick (x[i]);
+      long double y = filter.tick (x[i]);
+      error += (y - expected) * (y - expected);
+      signal += expected * expected;
+    }
+  return 10 * log10 ((double) (error / signal));
+}
+
+TEST (Biquad, FloatIsTheOriginalFilter)
+{
+  EXPECT_TRUE ((is_same < Biquad, BiquadT < float, BIQUAD_DF2 > >::value));
+}
+
+// At 20 Hz and 96 kHz the poles are close to z = 1: float coefficients leave every form
+// about 40 dB from the exact filter, and double ones about 150 dB
+TEST (Biquad, PrecisionAtLowCutoff)
+{
+  EXPECT_LT ((errorDb < BiquadT < float, BIQUAD_DF1 > >(20)), -38);
+  EXPECT_LT ((errorDb < BiquadT < float, BIQUAD_DF2 > >(20)), -38);
+  EXPECT_LT ((errorDb < BiquadT < float, BIQUAD_TDF2 > >(20)), -38);
+  EXPECT_LT ((errorDb < BiquadT < double, BIQUAD_DF1 > >(20)), -145);
+  EXPECT_LT ((errorDb < BiquadT < double, BIQUAD_DF2 > >(20)), -145);
+  EXPECT_LT ((errorDb < BiquadT < double, BIQUAD_TDF2 > >(20)), -145);
+
+  // Far from the poles' trouble spot, float is close to its own precision
+  EXPECT_LT ((errorDb < BiquadT < float, BIQUAD_TDF2 > >(5000)), -120);
+}
+
+// A double filter runs on float buffers, rounding only the output
+TEST (Biquad, DoubleFilterOnFloatAudio)
+{
+  vector < float >x = testNoise (5000);
+  vector < float >y (x.size ());
+  BiquadT < double, BIQUAD_TDF2 > filter (SAMPLE_RATE), ticked (SAMPLE_RATE);
+  filter.initHPF (200);
+  ticked.initHPF (200);
+  filter.process (x.data (), y.data (), 1234);
+  filter.process (x.data () + 1234, y.data () + 1234, x.size () - 1234);
+  for (size_t i = 0; i < x.size (); i++)
+    ASSERT_EQ (y[i], (float) ticked.tick (x[i]));
+}
+
+// process gives the same output as tick, in place too
+TEST (Biquad, ProcessMatchesTick)
+{
+  vector < float >x = testNoise (5000);
+  vector < float >y = x;
+  Biquad filter (SAMPLE_RATE), ticked (SAMPLE_RATE);
+  filter.initBPF (3000, 2, 4);
+  ticked.initBPF (3000, 2, 4);
+  filter.process (y.data (), y.data (), y.size ());
+  for (size_t i = 0; i < x.size (); i++)
+    ASSERT_EQ (y[i], ticked.tick (x[i]));
+}
+
+// Error of a low-pass swept from 200 Hz to 5.2 kHz, redesigned every 64 samples, against
+// one redesigned every sample, in dB
+static double
+sweepErrorDb (bool smooth)
+{
+  const int N = 96000, BLOCK = 64;
+  vector < float >x = testNoise (N);
+  BiquadT < double, BIQUAD_TDF2 > filter (SAMPLE_RATE), exact (SAMPLE_RATE);
+  filter.setSmoothing (smooth ? BLOCK : 0);
+
+  double error = 0, signal = 0;
+  for (int start = 0; start < N; start += BLOCK)
+    {
+      filter.initLPF (200 + 5000.0 * start / N);
+      for (int i = start; i < start + BLOCK; i++)
+	{
+	  // Where the glide is at this sample
+	  exact.initLPF (200 + 5000.0 * (i - BLOCK + 1) / N);
+	  double expected = exact.tick (x[i]);
+	  double y = filter.tick (x[i]);
+	  if (start >= BLOCK)
+	    {
+	      error += (y - expected) * (y - expected);
+	      signal += expected * expected;
+	    }
+	}
+    }
+  return 10 * log10 (error / signal);
+}
+
+TEST (Biquad, SmoothingFollowsSweep)
+{
+  double jumps = sweepErrorDb (false), glide = sweepErrorDb (true);
+  EXPECT_LT (glide, -70);
+  EXPECT_LT (glide, jumps - 25);
+}
+
+// Gliding between two stable designs never leaves the stability triangle
+TEST (Biquad, GlideStaysStable)
+{
+  Biquad filter (SAMPLE_RATE);
+  filter.setSmoothing (100);
+  filter.initLPF (30, 10);
+  filter.initHPF (20000, 0.3);
+  for (int i = 0; i < 100; i++)
+    {
+      filter.tick (0);
+      float b0, b1, b2, a1, a2;
+      filter.getCoefficients (b0, b1, b2, a1, a2);
+      ASSERT_LT (fabs (a2), 1);
+      ASSERT_LT (fabs (a1), 1 + a2);
+    }
+}
+
+// The table designs match the library's sin/cos ones
+TEST (Biquad, FastTrigCoefficients)
+{
+  for (double f0 = 10; f0 < SAMPLE_RATE / 2; f0 *= 1.37)
+    for (int design = 0; design < 6; design++)
+      {
+	SCOPED_TRACE (testing::Message () << f0 << " Hz, design " << design);
+	BiquadT < double > exact (SAMPLE_RATE), fast (SAMPLE_RATE);
+	fast.setFastTrig (true);
+	for (int k = 0; k < 2; k++)
+	  {
+	    BiquadT < double > &f = k ? fast : exact;
+	    switch (design)
+	      {
+	      case 0: f.initLPF (f0); break;
+	      case 1: f.initHPF (f0); break;
+	      case 2: f.initBPF (f0, 2, 3); break;
+	      case 3: f.initNotch (f0, 5); break;
+	      case 4: f.initLPF1 (f0); break;
+	      case 5: f.initHPF1 (f0); break;
+	      }
+	  }
+	double e[5], a[5];
+	exact.getCoefficients (e[0], e[1], e[2], e[3], e[4]);
+	fast.getCoefficients (a[0], a[1], a[2], a[3], a[4]);
+	// First-order designs divide by cos(w0/2), which is small close to Nyquist
+	double tolerance = design >= 4 && f0 > 0.4 * SAMPLE_RATE ? 1e-4 : 2e-6;
+	for (int c = 0; c < 5; c++)
+	  EXPECT_NEAR (a[c], e[c], tolerance) << "coefficient " << c;
+      }
+}
@@ -0,0 +1,121 @@
+// =================================================================================================
+// ChainTest.cpp
+//
+// The batch processor's chain parser, and runChain on good, mismatched and truncated files.
+// =================================================================================================
+
+#include "gtest/gtest.h"
+#include "TestUtils.h"
+#include "../batch/Chain.h"
+#include <fstream>
+#include <sys/stat.h>
+
+static bool
+exists (const string & path)
+{
+  struct stat info;
+  return stat (path.c_str (), &info) == 0;
+}
+
+TEST (Chain, Parse)
+{
+  vector < ChainStage > stages;
+  string error;
+  ASSERT_TRUE (parseChain ("hpf:80,lpf:8000:0.9,gain:0.5", stages, error));
+  ASSERT_EQ (stages.size (), 3u);
+  EXPECT_EQ (stages[1].name, "lpf");
+  EXPECT_EQ (stages[1].args, vector < double >({8000, 0.9}));
+
+  EXPECT_FALSE (parseChain ("lpf:400,wah:3", stages, error));
+  EXPECT_NE (error.find ("wah"), string::npos);
+  EXPECT_FALSE (parseChain ("gain", stages, error));
+  EXPECT_FALSE (parseChain ("gain:loud", stages, error));
+}
+
+TEST (Chain, RunsFile)
+{
+  TempFile in, out;
+  vector < float >x = testSines (2, 30000, 44100);
+  {
+    WavWriter writer;
+    ASSERT_EQ (writer.open (in.path (), 44100, 2, 32, WAV_FORMAT_FLOAT), WAV_OK);
+    writer.write (x.data (), 30000);
+    ASSERT_EQ (writer.close (), WAV_OK);
+  }
+
+  vector < ChainStage > stages;
+  string error;
+  ASSERT_TRUE (parseChain ("gain:0.5,balance:1", stages, error));
+  ChainResult result;
+  ASSERT_EQ (runChain (in.path (), out.path (), stages, true, result), WAV_OK);
+  EXPECT_EQ (result.error, "");
+  EXPECT_EQ (result.numFrames, 30000);
+  EXPECT_EQ (result.numChannels, 2);
+  EXPECT_NEAR (result.truePeak, 20 * log10 (0.5 * 0.5), 0.05);
+
+  // Halved, then the left channel silenced
+  vector < float >y;
+  int sr, numCh;
+  ASSERT_EQ (audioRead (out.path (), y, sr, numCh), WAV_OK);
+  ASSERT_EQ (y.size (), x.size ());
+  for (int i = 0; i < 30000; i++)
+    {
+      ASSERT_EQ (y[2 * i], 0);
+      ASSERT_EQ (y[2 * i + 1], 0.5f * x[2 * i + 1]);
+    }
+}
+
+// A chain that doesn't suit the file says which stage, and writes nothing
+TEST (Chain, Mismatch)
+{
+  TempFile in;
+  ASSERT_EQ (audioWrite (in.path (), testSines (1, 1000, 44100), 44100), WAV_OK);
+  string outPath = in.path () + ".out";
+
+  vector < ChainStage > stages;
+  string error;
+  ChainResult result;
+  ASSERT_TRUE (parseChain ("gain:2,balance:-0.5", stages, error));
+  EXPECT_EQ (runChain (in.path (), outPath, stages, false, result), WAV_ERR_UNSUPPORTED);
+  EXPECT_EQ (result.error, "balance:-0.5 can't be applied to 1-channel 44100 Hz audio");
+  EXPECT_FALSE (exists (outPath));
+
+  ASSERT_TRUE (parseChain ("lpf:30000", stages, error));
+  EXPECT_EQ (runChain (in.path (), outPath, stages, false, result), WAV_ERR_UNSUPPORTED);
+  EXPECT_EQ (result.error, "lpf:30000 can't be applied to 1-channel 44100 Hz audio");
+  EXPECT_FALSE (exists (outPath));
+}
+
+// A file cut short is processed as far as it goes, and reported
+TEST (Chain, TruncatedInput)
+{
+  TempFile in, out;
+  ASSERT_EQ (audioWrite (in.path (), testSines (1, 10000, 44100), 44100), WAV_OK);
+  ASSERT_EQ (truncate (in.path ().c_str (), 1000), 0);
+
+  vector < ChainStage > stages;
+  string error;
+  ChainResult result;
+  ASSERT_TRUE (parseChain ("gain:1", stages, error));
+  EXPECT_EQ (runChain (in.path (), out.path (), stages, false, result),
+	     WAV_ERR_DATA_TRUNCATED);
+  EXPECT_EQ (result.error, wavStatusString (WAV_ERR_DATA_TRUNCATED));
+  EXPECT_GT (result.numFrames, 0);
+  EXPECT_LT (result.numFrames, 10000);
+
+  vector < float >y;
+  int sr, numCh;
+  EXPECT_EQ (audioRead (out.path (), y, sr, numCh), WAV_OK);
+  EXPECT_EQ ((int64_t) y.size (), result.numFrames);
+}
+
+TEST (Chain, MissingFile)
+{
+  vector < ChainStage > stages;
+  string error;
+  ChainResult result;
+  ASSERT_TRUE (parseChain ("gain:1", stages, error));
+  EXPECT_EQ (runChain ("/nonexistent/in.wav", "/nonexistent/out.wav", stages, false,
+		       result), WAV_ERR_OPEN);
+  EXPECT_EQ (result.error, wavStatusString (WAV_ERR_OPEN));
+}
@@ -0,0 +1,86 @@
+// =================================================================================================
+// ConvolverTest.cpp
+//
+// Convolver against direct convolution, for impulse responses that end in each segment.
+// =================================================================================================
+
+#include "gtest/gtest.h"
+#include "TestUtils.h"
+#include "../Convolver.h"
+
+// Decaying noise, like a room
+static vector < float >
+testImpulseResponse (int n)
+{
+  vector < float >ir = testNoise (n, 7);
+  for (int i = 0; i < n; i++)
+    ir[i] *= (float) exp (-3.0 * i / n);
+  return ir;
+}
+
+// RMS error of the convolver's output against direct convolution in double, relative to
+// the output's RMS
+static double
+convolutionError (int irLen, int blockSize, int tailBlockSize)
+{
+  const int N = 12000;
+  vector < float >ir = testImpulseResponse (irLen);
+  Convolver convolver (ir.data (), irLen, blockSize, tailBlockSize);
+  int d = convolver.latency ();
+
+  // The input, then silence for the whole of its response, in uneven blocks
+  vector < float >x = testNoise (N, 1, 0.5f);
+  vector < float >y = x;
+  y.resize (N + d + irLen - 1, 0.0f);
+  for (size_t i = 0, len = 1; i < y.size (); i += len, len = len * 3 % 1009)
+    {
+      len = min (len, y.size () - i);
+      convolver.process (y.data () + i, y.data () + i, len);
+    }
+
+  double error = 0, signal = 0;
+  for (int i = 0; i < N + irLen - 1; i++)
+    {
+      double expected = 0;
+      for (int j = max (0, i - N + 1); j < irLen && j <= i; j++)
+	expected += (double) ir[j] * x[i - j];
+      error += (y[i + d] - expected) * (y[i + d] - expected);
+      signal += expected * expected;
+    }
+  for (int i = 0; i < d; i++)
+    EXPECT_EQ (y[i], 0);
+  return sqrt (error / signal);
+}
+
+TEST (Convolver, MatchesDirectConvolution)
+{
+  struct Setup
+  {
+    int blockSize, tailBlockSize;
+  };
+  const Setup setups[] = { {256, 4096}, {64, 64}, {128, 1024}, {60, 960} };
+  for (int s = 0; s < 4; s++)
+    {
+      int b = setups[s].blockSize, t = setups[s].tailBlockSize;
+      // Ending in the first block, at the edges of the head and the tail, and in the tail
+      const int lengths[] = { 1, b - 1, b, b + 1, 2 * t - 1, 2 * t, 2 * t + 1, 3 * t + 17 };
+      for (int i = 0; i < 8; i++)
+	{
+	  SCOPED_TRACE (testing::Message () << "blocks " << b << "/" << t << ", length "
+			<< lengths[i]);
+	  EXPECT_LT (convolutionError (lengths[i], b, t), 1e-6);
+	}
+    }
+}
+
+// After reset, the same input gives the same output
+TEST (Convolver, Reset)
+{
+  vector < float >ir = testImpulseResponse (9000);
+  Convolver convolver (ir.data (), ir.size (), 128, 1024);
+  vector < float >x = testNoise (20000), first (x.size ()), second (x.size ());
+  convolver.process (x.data (), first.data (), x.size ());
+  convolver.reset ();
+  convolver.process (x.data (), second.data (), x.size ());
+  EXPECT_EQ (first, second);
+}
@@ -0,0 +1,135 @@
+// =================================================================================================
+// FFTTest.cpp
+//
+// FFT and RealFFT against a long double DFT, and Stft's reconstruction.
+// =================================================================================================
+
+#include "gtest/gtest.h"
+#include "TestUtils.h"
+#include "../FFT.h"
+
+// RMS error of a spectrum against the long double DFT of the input, relative to the
+// spectrum's RMS
+static double
+dftError (const vector < float >&inRe, const vector < float >&inIm,
+	  const vector < float >&outRe, const vector < float >&outIm, int numBins)
+{
+  int n = (int) inRe.size ();
+  vector < long double >c (n), s (n);
+  for (int m = 0; m < n; m++)
+    {
+      c[m] = cosl (2 * M_PIl * m / n);
+      s[m] = -sinl (2 * M_PIl * m / n);
+    }
+
+  long double error = 0, signal = 0;
+  for (int k = 0; k < numBins; k++)
+    {
+      long double re = 0, im = 0;
+      for (int j = 0, m = 0; j < n; j++, m = (m + k) % n)	// m = j k mod n
+	{
+	  re += inRe[j] * c[m] - inIm[j] * s[m];
+	  im += inRe[j] * s[m] + inIm[j] * c[m];
+	}
+      error += (outRe[k] - re) * (outRe[k] - re) + (outIm[k] - im) * (outIm[k] - im);
+      signal += re * re + im * im;
+    }
+  return sqrt ((double) (error / signal));
+}
+
+// Every valid size up to 1000 and a few bigger ones
+static vector < int >
+testSizes ()
+{
+  vector < int >sizes;
+  for (int n = 1; n <= 1000; n++)
+    if (FFT::isValidSize (n))
+      sizes.push_back (n);
+  sizes.push_back (1024 * 3);
+  sizes.push_back (4096);
+  sizes.push_back (3125);
+  return sizes;
+}
+
+TEST (FFT, ValidSizes)
+{
+  EXPECT_TRUE (FFT::isValidSize (1));
+  EXPECT_TRUE (FFT::isValidSize (2 * 2 * 3 * 5 * 5));
+  EXPECT_FALSE (FFT::isValidSize (7));
+  EXPECT_FALSE (FFT::isValidSize (0));
+  EXPECT_EQ (FFT::nextValidSize (7), 8);
+  EXPECT_EQ (FFT::nextValidSize (1001), 1024);
+  EXPECT_EQ (FFT::nextValidSize (1000), 1000);
+}
+
+// Float rounding grows with the number of stages, so the bound is per factor of 2
+TEST (FFT, MatchesDft)
+{
+  vector < int >sizes = testSizes ();
+  for (size_t i = 0; i < sizes.size (); i++)
+    {
+      int n = sizes[i];
+      SCOPED_TRACE (n);
+      vector < float >re = testNoise (n, 1), im = testNoise (n, 2);
+      vector < float >outRe (n), outIm (n);
+      FFT fft (n);
+      fft.forward (re.data (), im.data (), outRe.data (), outIm.data ());
+      EXPECT_LT (dftError (re, im, outRe, outIm, n), 3e-8 * (log2 (n) + 1));
+
+      // Inverse, in place
+      fft.inverse (outRe.data (), outIm.data (), outRe.data (), outIm.data ());
+      EXPECT_LT (maxAbsDiff (outRe, re), 1e-6);
+      EXPECT_LT (maxAbsDiff (outIm, im), 1e-6);
+    }
+}
+
+TEST (RealFFT, MatchesDft)
+{
+  vector < int >sizes = testSizes ();
+  for (size_t i = 0; i < sizes.size (); i++)
+    {
+      int n = 2 * sizes[i];
+      SCOPED_TRACE (n);
+      RealFFT fft (n);
+      vector < float >x = testNoise (n), zero (n, 0.0f), y (n);
+      vector < float >re (fft.numBins ()), im (fft.numBins ());
+      fft.forward (x.data (), re.data (), im.data ());
+      EXPECT_LT (dftError (x, zero, re, im, fft.numBins ()), 3e-8 * (log2 (n) + 1));
+
+      fft.inverse (re.data (), im.data (), y.data ());
+      EXPECT_LT (maxAbsDiff (y, x), 1e-6);
+    }
+}
+
+// Unmodified spectra give back the input, latency() samples later
+TEST (Stft, Reconstructs)
+{
+  struct Setup
+  {
+    int frameSize, hop;
+    StftWindow window;
+  };
+  const Setup setups[] = {
+    {1024, 256, STFT_HANN}, {1024, 512, STFT_SQRT_HANN}, {960, 240, STFT_HANN},
+    {512, 128, STFT_SQRT_HANN}
+  };
+  vector < float >x = testNoise (20000, 3, 0.5f);
+  for (int s = 0; s < 4; s++)
+    {
+      SCOPED_TRACE (s);
+      Stft stft (setups[s].frameSize, setups[s].hop, setups[s].window);
+      vector < float >y (x.size ());
+      // In place, in uneven blocks
+      y = x;
+      for (size_t i = 0, len = 1; i < y.size (); i += len, len = len * 5 % 1999)
+	{
+	  len = min (len, y.size () - i);
+	  stft.process (y.data () + i, y.data () + i, len, [] (float *, float *) {});
+	}
+      int d = stft.latency ();
+      double worst = 0;
+      for (size_t i = d; i < x.size (); i++)
+	worst = max (worst, fabs ((double) y[i] - x[i - d]));
+      EXPECT_LT (worst, 1e-6);
+    }
+}
@@ -0,0 +1,138 @@
+// =================================================================================================
+// LoudnessMeterTest.cpp
+//
+// LoudnessMeter against EBU Tech 3341 style test signals, and its true peak against known
+// sines.
+// =================================================================================================
+
+#include "gtest/gtest.h"
+#include "TestUtils.h"
+#include "../LoudnessMeter.h"
+
+// Appends seconds of a stereo 1 kHz sine at a level in dBFS, both channels in phase
+static void
+appendTone (vector < float >&x, int sr, double seconds, double levelDb)
+{
+  double amp = pow (10, levelDb / 20);
+  size_t start = x.size () / 2;
+  int n = (int) (seconds * sr);
+  for (int i = 0; i < n; i++)
+    {
+      float v = (float) (amp * sin (2 * M_PI * 1000 * (start + i) / sr));
+      x.push_back (v);
+      x.push_back (v);
+    }
+}
+
+static LoudnessMeter
+meter (int sr, const vector < float >&x, int block)
+{
+  LoudnessMeter m (sr, 2);
+  int numFrames = x.size () / 2;
+  for (int i = 0; i < numFrames; i += block)
+    m.process (x.data () + 2 * i, min (block, numFrames - i));
+  return m;
+}
+
+static const int RATES[] = { 44100, 48000, 96000 };
+
+// A stereo 1 kHz sine peaking at -23 dBFS is -23 LUFS
+TEST (LoudnessMeter, SteadyTone)
+{
+  for (int r = 0; r < 3; r++)
+    {
+      SCOPED_TRACE (RATES[r]);
+      vector < float >x;
+      appendTone (x, RATES[r], 20, -23);
+      LoudnessMeter m = meter (RATES[r], x, 1024);
+      EXPECT_NEAR (m.integratedLoudness (), -23, 0.03);
+      EXPECT_NEAR (m.momentaryLoudness (), -23, 0.03);
+      EXPECT_NEAR (m.shortTermLoudness (), -23, 0.03);
+      EXPECT_NEAR (m.rms (0), -23 - 3.01, 0.01);
+      EXPECT_NEAR (m.samplePeak (), -23, 0.01);
+    }
+}
+
+// The quiet parts fall below the relative gate, and the silent ones below the absolute
+// gate, leaving the -23 dB part. The blocks that straddle a change of level count too,
+// so this is held to Tech 3341's 0.1 LU.
+TEST (LoudnessMeter, Gating)
+{
+  for (int r = 0; r < 3; r++)
+    {
+      SCOPED_TRACE (RATES[r]);
+      vector < float >x;
+      appendTone (x, RATES[r], 10, -36);
+      appendTone (x, RATES[r], 60, -23);
+      appendTone (x, RATES[r], 10, -36);
+      EXPECT_NEAR (meter (RATES[r], x, 1024).integratedLoudness (), -23, 0.1);
+
+      x.clear ();
+      appendTone (x, RATES[r], 10, -72);
+      appendTone (x, RATES[r], 10, -36);
+      appendTone (x, RATES[r], 60, -23);
+      appendTone (x, RATES[r], 10, -36);
+      appendTone (x, RATES[r], 10, -72);
+      EXPECT_NEAR (meter (RATES[r], x, 1024).integratedLoudness (), -23, 0.1);
+    }
+}
+
+TEST (LoudnessMeter, SilenceAndShortInput)
+{
+  vector < float >silence (2 * 48000, 0.0f), tone;
+  EXPECT_TRUE (std::isinf (meter (48000, silence, 1024).integratedLoudness ()));
+  appendTone (tone, 48000, 0.3, -10);
+  EXPECT_TRUE (std::isinf (meter (48000, tone, 1024).integratedLoudness ()));
+}
+
+// Every level comes out the same however the audio is split into blocks
+TEST (LoudnessMeter, BlockInvariant)
+{
+  vector < float >x;
+  appendTone (x, 44100, 3, -30);
+  appendTone (x, 44100, 4, -18);
+  vector < float >noise = testNoise (2 * 44100, 1, 0.3f);
+  x.insert (x.end (), noise.begin (), noise.end ());
+
+  LoudnessMeter whole = meter (44100, x, x.size () / 2);
+  const int blocks[] = { 1, 441, 1000, 4410 };
+  for (int b = 0; b < 4; b++)
+    {
+      SCOPED_TRACE (blocks[b]);
+      LoudnessMeter m = meter (44100, x, blocks[b]);
+      EXPECT_NEAR (m.integratedLoudness (), whole.integratedLoudness (), 1e-9);
+      EXPECT_NEAR (m.shortTermLoudness (), whole.shortTermLoudness (), 1e-9);
+      EXPECT_NEAR (m.momentaryLoudness (), whole.momentaryLoudness (), 1e-9);
+      EXPECT_EQ (m.samplePeak (), whole.samplePeak ());
+      EXPECT_EQ (m.truePeak (), whole.truePeak ());
+    }
+}
+
+// The true peak of a full-scale sine faded in, so it doesn't start with a step, at
+// frequencies whose peaks land at every position between samples
+TEST (LoudnessMeter, TruePeak)
+{
+  for (int r = 0; r < 2; r++)
+    for (double f = 997; f < 0.9 * RATES[r] / 2; f *= 1.3)
+      {
+	SCOPED_TRACE (testing::Message () << RATES[r] << " Hz, sine at " << f);
+	int sr = RATES[r];
+	vector < float >x (2 * sr);
+	for (int i = 0; i < sr; i++)
+	  x[2 * i] = x[2 * i + 1] =
+	    (float) (sin (2 * M_PI * f * i / sr + 0.3) * min (1.0, i / 2000.0));
+	LoudnessMeter m = meter (sr, x, 1024);
+	EXPECT_NEAR (m.truePeak (), 0, 0.04);
+	EXPECT_GE (m.truePeak (), m.samplePeak ());
+      }
+
+  // A sine at a quarter of the sample rate, starting between its peaks: the samples are
+  // 3 dB below the peak, and the interpolated points find it
+  vector < float >x (2 * 48000);
+  for (int i = 0; i < 48000; i++)
+    x[2 * i] = x[2 * i + 1] =
+      (float) (sin (M_PI / 2 * i + M_PI / 4) * min (1.0, i / 2000.0));
+  LoudnessMeter m = meter (48000, x, 1024);
+  EXPECT_NEAR (m.samplePeak (), -3.01, 0.01);
+  EXPECT_NEAR (m.truePeak (), 0, 0.02);
+}
@@ -0,0 +1,66 @@
+// =================================================================================================
+// MappedWavTest.cpp
+//
+// MappedWav, the memory-mapped view of a wav file.
+// =================================================================================================
+
+#include "gtest/gtest.h"
+#include "TestUtils.h"
+#include "../WavUtils.h"
+#include <type_traits>
+
+static const int SAMPLE_RATE = 48000;
+
+// Regions read from the mapping match audioRead, and the samples are there in place
+TEST (MappedWav, ReadMatchesAudioRead)
+{
+  TempFile file;
+  int numFrames = 12345;
+  vector < float >x = testSines (2, numFrames, SAMPLE_RATE);
+  ASSERT_EQ (audioWrite (file.path (), x, SAMPLE_RATE, 2), WAV_OK);
+
+  vector < float >expected;
+  int sr, numCh;
+  ASSERT_EQ (audioRead (file.path (), expected, sr, numCh), WAV_OK);
+
+  MappedWav wav;
+  ASSERT_EQ (wav.open (file.path ()), WAV_OK);
+  EXPECT_EQ (wav.sampleRate (), SAMPLE_RATE);
+  EXPECT_EQ (wav.numChannels (), 2);
+  EXPECT_EQ (wav.bitsPerSample (), 16);
+  ASSERT_EQ (wav.numFrames (), numFrames);
+
+  vector < float >region (2 * 1000);
+  EXPECT_EQ (wav.read (5000, region.data (), 1000), 1000);
+  for (int i = 0; i < 2 * 1000; i++)
+    ASSERT_EQ (region[i], expected[2 * 5000 + i]);
+
+  // Short at the end of the file
+  EXPECT_EQ (wav.read (numFrames - 10, region.data (), 1000), 10);
+  EXPECT_EQ (wav.read (numFrames, region.data (), 1000), 0);
+
+  const int16_t *samples = wav.samples < int16_t > ();
+  EXPECT_EQ (samples[2 * 100 + 1] / 32768.0f, expected[2 * 100 + 1]);
+}
+
+// A file whose data chunk is empty, and ends the file, is valid
+TEST (MappedWav, EmptyDataChunk)
+{
+  TempFile file;
+  WavWriter writer;
+  ASSERT_EQ (writer.open (file.path (), SAMPLE_RATE, 2), WAV_OK);
+  ASSERT_EQ (writer.close (), WAV_OK);
+
+  MappedWav wav;
+  ASSERT_EQ (wav.open (file.path ()), WAV_OK);
+  EXPECT_TRUE (wav.isOpen ());
+  EXPECT_EQ (wav.numFrames (), 0);
+  float x[2];
+  EXPECT_EQ (wav.read (0, x, 1), 0);
+}
+
+TEST (MappedWav, NotCopyable)
+{
+  EXPECT_FALSE (is_copy_constructible < MappedWav >::value);
+  EXPECT_FALSE (is_copy_assignable < MappedWav >::value);
+}
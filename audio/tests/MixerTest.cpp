@@ -0,0 +1,174 @@
+// =================================================================================================
+// MixerTest.cpp
+//
+// Mixer against a double-precision mix of the same tracks.
+// =================================================================================================
+
+#include "gtest/gtest.h"
+#include "TestUtils.h"
+#include "../Mixer.h"
+
+static const int SAMPLE_RATE = 48000;
+
+struct TestTrack
+{
+  vector < float >x;		// Interleaved
+  int numCh;
+  float gain, pan;
+  bool mute;
+};
+
+// Mono and stereo tracks of different lengths, one of them muted
+static vector < TestTrack > testTracks ()
+{
+  vector < TestTrack > tracks;
+  const int lengths[] = { 30000, 9001, 4096, 12345, 1, 20000, 8191 };
+  for (int i = 0; i < 7; i++)
+    {
+      TestTrack t;
+      t.numCh = i % 3 == 1 ? 2 : 1;
+      t.x = testNoise (lengths[i] * t.numCh, i + 1, 0.3f);
+      t.gain = 0.25f + 0.2f * i;
+      t.pan = -1 + i / 3.0f;
+      t.mute = i == 5;
+      tracks.push_back (t);
+    }
+  return tracks;
+}
+
+static void
+addTracks (Mixer & mixer, const vector < TestTrack > &tracks)
+{
+  for (size_t i = 0; i < tracks.size (); i++)
+    {
+      const TestTrack & t = tracks[i];
+      mixer.addTrack (t.x.data (), t.x.size () / t.numCh, t.numCh);
+      mixer.setGain (i, t.gain);
+      mixer.setPan (i, t.pan);
+      mixer.setMute (i, t.mute);
+    }
+}
+
+// The mix, interleaved, worked out in double
+static vector < double >
+referenceMix (const vector < TestTrack > &tracks, int numCh, int64_t numFrames)
+{
+  vector < double >y (numFrames * numCh, 0.0);
+  for (size_t i = 0; i < tracks.size (); i++)
+    {
+      const TestTrack & t = tracks[i];
+      if (t.mute)
+	continue;
+      double gainL = 1, gainR = 1;
+      if (numCh == 2 && t.numCh == 1)
+	{
+	  // Constant power
+	  gainL = cos ((t.pan + 1) * M_PI / 4);
+	  gainR = sin ((t.pan + 1) * M_PI / 4);
+	}
+      else if (numCh == 2)
+	{
+	  // Balance
+	  gainL = t.pan < 0 ? 1 : 1 - t.pan;
+	  gainR = t.pan > 0 ? 1 : 1 + t.pan;
+	}
+      for (size_t f = 0; f < t.x.size () / t.numCh; f++)
+	{
+	  double l = t.x[f * t.numCh], r = t.x[f * t.numCh + t.numCh - 1];
+	  if (numCh == 1)
+	    y[f] += t.gain * (l + r) / 2;
+	  else
+	    {
+	      y[2 * f] += t.gain * gainL * l;
+	      y[2 * f + 1] += t.gain * gainR * r;
+	    }
+	}
+    }
+  return y;
+}
+
+TEST (Mixer, MatchesReference)
+{
+  vector < TestTrack > tracks = testTracks ();
+  for (int numCh = 1; numCh <= 2; numCh++)
+    {
+      SCOPED_TRACE (numCh);
+      Mixer mixer (SAMPLE_RATE, numCh);
+      addTracks (mixer, tracks);
+      ASSERT_EQ (mixer.numFrames (), 30000);
+
+      vector < double >expected = referenceMix (tracks, numCh, 30000);
+      vector < float >y (expected.size ());
+      mixer.render (0, y.data (), 30000);
+      double worst = 0;
+      for (size_t i = 0; i < y.size (); i++)
+	worst = max (worst, fabs (y[i] - expected[i]));
+      EXPECT_LT (worst, 2e-7);
+    }
+}
+
+// Rendering in chunks of any size, or past the end, gives the same samples
+TEST (Mixer, ChunkInvariant)
+{
+  vector < TestTrack > tracks = testTracks ();
+  Mixer mixer (SAMPLE_RATE, 2);
+  addTracks (mixer, tracks);
+
+  const int N = 31000;
+  vector < float >whole (2 * N), chunked (2 * N, -1.0f);
+  mixer.render (0, whole.data (), N);
+  for (int start = 0, len = 1; start < N; start += len, len = len * 7 % 5003)
+    {
+      len = min (len, N - start);
+      mixer.render (start, chunked.data () + 2 * start, len);
+    }
+  EXPECT_EQ (chunked, whole);
+  for (int i = 2 * 30000; i < 2 * N; i++)
+    ASSERT_EQ (whole[i], 0);
+}
+
+// File tracks, and the threaded file output, give the same mix as buffers
+TEST (Mixer, FileTracksAndThreadedOutput)
+{
+  vector < TestTrack > tracks = testTracks ();
+  vector < TempFile > files (tracks.size ());
+  Mixer buffers (SAMPLE_RATE, 2), mapped (SAMPLE_RATE, 2);
+  addTracks (buffers, tracks);
+  for (size_t i = 0; i < tracks.size (); i++)
+    {
+      const TestTrack & t = tracks[i];
+      WavWriter writer;
+      ASSERT_EQ (writer.open (files[i].path (), SAMPLE_RATE, t.numCh, 32,
+			      WAV_FORMAT_FLOAT), WAV_OK);
+      writer.write (t.x.data (), t.x.size () / t.numCh);
+      ASSERT_EQ (writer.close (), WAV_OK);
+      ASSERT_EQ (mapped.addTrack (files[i].path ()), WAV_OK);
+      mapped.setGain (i, t.gain);
+      mapped.setPan (i, t.pan);
+      mapped.setMute (i, t.mute);
+    }
+
+  vector < float >expected (2 * 30000), y (2 * 30000);
+  buffers.render (0, expected.data (), 30000);
+  mapped.render (0, y.data (), 30000);
+  EXPECT_EQ (y, expected);
+
+  TempFile out;
+  ASSERT_EQ (mapped.renderToFile (out.path (), 3, 32), WAV_OK);
+  vector < float >read;
+  int sr, numCh;
+  ASSERT_EQ (audioRead (out.path (), read, sr, numCh), WAV_OK);
+  ASSERT_EQ (numCh, 2);
+  ASSERT_EQ (read.size (), expected.size ());
+  EXPECT_LT (maxAbsDiff (read, expected), 1e-8);	// 32-bit integer samples
+}
+
+TEST (Mixer, RejectsMismatchedFile)
+{
+  TempFile file;
+  ASSERT_EQ (audioWrite (file.path (), testSines (3, 100, 44100), 44100, 3), WAV_OK);
+  Mixer wrongRate (SAMPLE_RATE), wrongChannels (44100);
+  EXPECT_EQ (wrongRate.addTrack (file.path ()), WAV_ERR_UNSUPPORTED);
+  EXPECT_EQ (wrongChannels.addTrack (file.path ()), WAV_ERR_UNSUPPORTED);
+  EXPECT_EQ (wrongRate.numTracks (), 0);
+}
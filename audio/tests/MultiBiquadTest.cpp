@@ -0,0 +1,128 @@
+// =================================================================================================
+// MultiBiquadTest.cpp
+//
+// Every version of the MultiBiquad kernels, at every width, gives exactly the output of
+// Biquad::tick on each channel.
+// =================================================================================================
+
+#include "gtest/gtest.h"
+#include "TestUtils.h"
+#include "../MultiBiquad.h"
+#include "../SimdIsa.h"
+
+static const float SAMPLE_RATE = 48000;
+
+// A different filter for each channel
+static Biquad
+channelFilter (int ch)
+{
+  Biquad b (SAMPLE_RATE);
+  switch (ch % 3)
+    {
+    case 0:
+      b.initLPF (500 + 300 * ch, 0.8);
+      break;
+    case 1:
+      b.initHPF (50 + 40 * ch);
+      break;
+    default:
+      b.initBPF (1000 + 200 * ch, 1.5, 2);
+    }
+  return b;
+}
+
+template < int N > static void
+checkAgainstTicks ()
+{
+  SimdIsa best = simdIsa ();
+  int numFrames = 3001;
+
+  for (int isa = SIMD_ISA_SCALAR; isa <= best; isa++)
+    for (int numCh : {1, N - 1, N})
+      {
+	setSimdIsa ((SimdIsa) isa);
+	SCOPED_TRACE (string (simdIsaName ((SimdIsa) isa)) + ", N = " +
+		      to_string (N) + ", " + to_string (numCh) + " ch");
+
+	// The expected output, a channel at a time
+	vector < vector < float >>x (numCh), expected (numCh);
+	for (int ch = 0; ch < numCh; ch++)
+	  {
+	    x[ch] = testNoise (numFrames, ch + 1);
+	    Biquad b = channelFilter (ch);
+	    for (int i = 0; i < numFrames; i++)
+	      expected[ch].push_back (b.tick (x[ch][i]));
+	  }
+
+	// Non-interleaved, in blocks that split the tiles
+	MultiBiquad < N > split (SAMPLE_RATE);
+	for (int ch = 0; ch < numCh; ch++)
+	  split.setCoefficients (ch, channelFilter (ch));
+	vector < vector < float >>y (numCh, vector < float >(numFrames));
+	for (int i = 0; i < numFrames; i += 45)
+	  {
+	    int n = std::min (45, numFrames - i);
+	    vector < const float *>in (numCh);
+	    vector < float *>out (numCh);
+	    for (int ch = 0; ch < numCh; ch++)
+	      {
+		in[ch] = x[ch].data () + i;
+		out[ch] = y[ch].data () + i;
+	      }
+	    split.process (in.data (), out.data (), numCh, n);
+	  }
+	EXPECT_EQ (y, expected);
+
+	// Interleaved, N channels with silence in the spare ones
+	if (numCh == N)
+	  {
+	    MultiBiquad < N > lanes (SAMPLE_RATE);
+	    for (int ch = 0; ch < N; ch++)
+	      lanes.setCoefficients (ch, channelFilter (ch));
+	    vector < float >frames (N * numFrames), out (N * numFrames);
+	    for (int i = 0; i < numFrames; i++)
+	      for (int ch = 0; ch < N; ch++)
+		frames[i * N + ch] = x[ch][i];
+	    for (int i = 0; i < numFrames; i += 100)
+	      lanes.processInterleaved (frames.data () + i * N, out.data () + i * N,
+					std::min (100, numFrames - i));
+	    for (int ch = 0; ch < N; ch++)
+	      for (int i = 0; i < numFrames; i++)
+		ASSERT_EQ (out[i * N + ch], expected[ch][i]) << "channel " << ch;
+	  }
+      }
+  setSimdIsa (best);
+}
+
+TEST (MultiBiquad, MatchesTicks4)
+{
+  checkAgainstTicks < 4 > ();
+}
+
+TEST (MultiBiquad, MatchesTicks8)
+{
+  checkAgainstTicks < 8 > ();
+}
+
+TEST (MultiBiquad, MatchesTicks16)
+{
+  checkAgainstTicks < 16 > ();
+}
+
+// The same filter on every channel by default, and pass-through before any is set
+TEST (MultiBiquad, Defaults)
+{
+  vector < float >x = testNoise (4 * 500);
+  vector < float >y (x.size ());
+  MultiBiquad < 4 > pass (SAMPLE_RATE);
+  pass.processInterleaved (x.data (), y.data (), 500);
+  EXPECT_EQ (y, x);
+
+  MultiBiquad < 4 > lpf (SAMPLE_RATE);
+  lpf.initLPF (1000);
+  lpf.processInterleaved (x.data (), y.data (), 500);
+  Biquad b (SAMPLE_RATE);
+  b.initLPF (1000);
+  for (int i = 0; i < 500; i++)
+    ASSERT_EQ (y[i * 4 + 2], b.tick (x[i * 4 + 2]));
+}
@@ -0,0 +1,106 @@
+// =================================================================================================
+// OscillatorBankTest.cpp
+//
+// OscillatorBank's partials against a long double reference, and its phase wrapping.
+// =================================================================================================
+
+#include "gtest/gtest.h"
+#include "TestUtils.h"
+#include "../OscillatorBank.h"
+
+static const double SAMPLE_RATE = 48000;
+
+// Worst difference between a bank with one partial and sin, over n samples from sample
+// skip on, rendered in blocks of odd sizes
+static double
+maxSineError (OscillatorMode mode, double freq, double phase, int64_t skip, int n)
+{
+  OscillatorBank bank (SAMPLE_RATE, mode);
+  bank.addPartial (freq, 1, phase);
+
+  vector < float >x (1000);
+  for (int64_t done = 0; done < skip; done += x.size ())
+    bank.render (x.data (), (int) min < int64_t > (x.size (), skip - done));
+
+  // The bank steps a 64-bit fraction of a cycle, so the reference does too
+  uint64_t step = (uint64_t) (freq / SAMPLE_RATE * 18446744073709551616.0);
+  uint64_t start = (uint64_t) (phase * 18446744073709551616.0);
+  double worst = 0;
+  int64_t i = skip;
+  for (int block = 1; i < skip + n; block = block * 3 % 997)
+    {
+      int len = (int) min < int64_t > (block, skip + n - i);
+      bank.render (x.data (), len);
+      for (int j = 0; j < len; j++, i++)
+	{
+	  long double cycles = (long double) (start + step * (uint64_t) i) /
+	    18446744073709551616.0L;
+	  worst = max (worst, (double) fabsl (x[j] - sinl (2 * M_PIl * cycles)));
+	}
+    }
+  return worst;
+}
+
+// Float output can't be closer than 6e-8; the float rotation adds up to about 30 times that
+TEST (OscillatorBank, PhasorAccuracy)
+{
+  for (double freq = 0.1; freq < SAMPLE_RATE / 2; freq *= 1.7)
+    for (double phase = 0; phase < 1; phase += 0.3)
+      {
+	SCOPED_TRACE (testing::Message () << freq << " Hz, phase " << phase);
+	EXPECT_LT (maxSineError (OSC_PHASOR, freq, phase, 0, 24000), 2e-6);
+      }
+}
+
+// The phase doesn't drift: an hour in, the error is what it was at the start
+TEST (OscillatorBank, PhasorAccuracyAfterAnHour)
+{
+  EXPECT_LT (maxSineError (OSC_PHASOR, 997.3, 0.1, 3600 * 48000LL, 4800), 2e-6);
+}
+
+// A 2048-sample table read with linear interpolation
+TEST (OscillatorBank, WavetableAccuracy)
+{
+  EXPECT_LT (maxSineError (OSC_WAVETABLE, 440, 0, 0, 48000), 2e-6);
+  EXPECT_LT (maxSineError (OSC_WAVETABLE, 15000, 0.7, 0, 48000), 2e-6);
+}
+
+// Phases and frequencies that wrap to just below a whole cycle
+TEST (OscillatorBank, WrapsToWholeCycle)
+{
+  for (int mode = OSC_PHASOR; mode <= OSC_WAVETABLE; mode++)
+    {
+      SCOPED_TRACE (mode);
+      // -1e-20 wraps to 1 - 1e-20, which rounds to 1: the same as 0
+      EXPECT_LT (maxSineError ((OscillatorMode) mode, 440, -1e-20, 0, 1000), 2e-6);
+      EXPECT_LT (maxSineError ((OscillatorMode) mode, 440, nextafter (1.0, 0.0), 0,
+			      1000), 2e-6);
+
+      // A frequency just below 0 (or the sample rate) is a whole cycle per sample
+      OscillatorBank bank (SAMPLE_RATE, (OscillatorMode) mode);
+      bank.addPartial (-1e-13, 1);
+      bank.addPartial (SAMPLE_RATE, 1);
+      bank.addPartial (-SAMPLE_RATE * 3, 1);
+      vector < float >x (1000, 1);
+      bank.render (x.data (), x.size ());
+      for (size_t i = 0; i < x.size (); i++)
+	ASSERT_NEAR (x[i], 0, 1e-6);
+    }
+}
+
+// setFrequency keeps the phase
+TEST (OscillatorBank, FrequencyChangeIsContinuous)
+{
+  OscillatorBank bank (SAMPLE_RATE);
+  int p = bank.addPartial (1000, 1);
+  vector < float >x (2000);
+  bank.render (x.data (), 1000);
+  bank.setFrequency (p, 2000);
+  bank.render (x.data () + 1000, 1000);
+
+  // 1000 samples at 1 kHz is 20.833 cycles
+  double phase = 1000 * 1000 / SAMPLE_RATE;
+  for (int i = 1000; i < 2000; i++)
+    ASSERT_NEAR (x[i], sin (2 * M_PI * (phase + (i - 1000) * 2000 / SAMPLE_RATE)),
+		 1e-6);
+}
@@ -0,0 +1,129 @@
+// =================================================================================================
+// PannerTest.cpp
+//
+// Panner's laws, and its interleaved, planar and mono kernels against plain scaling.
+// =================================================================================================
+
+#include "gtest/gtest.h"
+#include "TestUtils.h"
+#include "../Panner.h"
+
+TEST (Panner, Laws)
+{
+  for (float pan = -1; pan <= 1; pan += 0.125f)
+    {
+      SCOPED_TRACE (pan);
+      float l, r;
+      Panner::gains (PAN_CONSTANT_POWER, pan, l, r);
+      EXPECT_NEAR (l * l + r * r, 1, 1e-6);
+      Panner::gains (PAN_LINEAR, pan, l, r);
+      EXPECT_NEAR (l + r, 1, 1e-6);
+      Panner::gains (PAN_BALANCE, pan, l, r);
+      EXPECT_EQ (max (l, r), 1);
+      EXPECT_NEAR (l - r, -pan, 1e-6);
+    }
+
+  float l, r;
+  Panner::gains (PAN_CONSTANT_POWER, 0, l, r);
+  EXPECT_NEAR (20 * log10 (l), -3.01, 0.01);
+  EXPECT_FLOAT_EQ (l, r);
+  Panner::gains (PAN_CONSTANT_POWER, -1, l, r);
+  EXPECT_FLOAT_EQ (l, 1);
+  EXPECT_NEAR (r, 0, 1e-7);
+  Panner::gains (PAN_BALANCE, 2, l, r);	// Clamped
+  EXPECT_EQ (l, 0);
+  EXPECT_EQ (r, 1);
+}
+
+// At a fixed position, every kernel gives exactly gain * sample, at any length and
+// alignment, in place or not
+TEST (Panner, KernelsMatchScaling)
+{
+  const PanLaw laws[] = { PAN_CONSTANT_POWER, PAN_LINEAR, PAN_BALANCE };
+  for (int law = 0; law < 3; law++)
+    for (int n = 0; n < 40; n += 3)
+      for (int offset = 0; offset < 2; offset++)
+	{
+	  SCOPED_TRACE (testing::Message () << "law " << law << ", " << n << " frames, offset "
+			<< offset);
+	  Panner panner (laws[law], 0.3f);
+	  float gL, gR;
+	  Panner::gains (laws[law], 0.3f, gL, gR);
+
+	  vector < float >x = testNoise (2 * n + 2), y (2 * n + 2);
+	  panner.processMono (x.data () + offset, y.data () + offset, n);
+	  for (int i = 0; i < n; i++)
+	    {
+	      ASSERT_EQ (y[offset + 2 * i], gL * x[offset + i]);
+	      ASSERT_EQ (y[offset + 2 * i + 1], gR * x[offset + i]);
+	    }
+
+	  y = x;
+	  panner.processStereo (y.data () + offset, y.data () + offset, n);
+	  for (int i = 0; i < n; i++)
+	    {
+	      ASSERT_EQ (y[offset + 2 * i], gL * x[offset + 2 * i]);
+	      ASSERT_EQ (y[offset + 2 * i + 1], gR * x[offset + 2 * i + 1]);
+	    }
+
+	  vector < float >left = testNoise (n + 1, 2), right = testNoise (n + 1, 3);
+	  const float *in[2] = { left.data () + offset, right.data () + offset };
+	  vector < float >outL (n + 1), outR (n + 1);
+	  float *out[2] = { outL.data () + offset, outR.data () + offset };
+	  panner.processStereo (in, out, n);
+	  for (int i = 0; i < n; i++)
+	    {
+	      ASSERT_EQ (out[0][i], gL * in[0][i]);
+	      ASSERT_EQ (out[1][i], gR * in[1][i]);
+	    }
+	}
+}
+
+// A glide moves steadily to the new gains over the ramp, however it's split into blocks,
+// and the interleaved and planar kernels glide alike
+TEST (Panner, Glide)
+{
+  const int RAMP = 1000, N = 1500;
+  vector < float >ones (2 * N, 1.0f);
+  vector < float >whole (2 * N), chunked (2 * N), left (N), right (N);
+
+  Panner a (PAN_CONSTANT_POWER, -1), b (PAN_CONSTANT_POWER, -1), c (PAN_CONSTANT_POWER, -1);
+  a.setRampLength (RAMP);
+  b.setRampLength (RAMP);
+  c.setRampLength (RAMP);
+  a.setPan (1);
+  b.setPan (1);
+  c.setPan (1);
+
+  a.processStereo (ones.data (), whole.data (), N);
+  for (int i = 0, len = 1; i < N; i += len, len = len * 3 % 101)
+    {
+      len = min (len, N - i);
+      b.processStereo (ones.data () + 2 * i, chunked.data () + 2 * i, len);
+    }
+  const float *in[2] = { ones.data (), ones.data () + N };
+  float *out[2] = { left.data (), right.data () };
+  c.processStereo (in, out, N);
+
+  float gL, gR;
+  Panner::gains (PAN_CONSTANT_POWER, 1, gL, gR);
+  for (int i = 0; i < N; i++)
+    {
+      SCOPED_TRACE (i);
+      ASSERT_NEAR (chunked[2 * i], whole[2 * i], 1e-6);
+      ASSERT_NEAR (chunked[2 * i + 1], whole[2 * i + 1], 1e-6);
+      ASSERT_NEAR (left[i], whole[2 * i], 1e-6);
+      ASSERT_NEAR (right[i], whole[2 * i + 1], 1e-6);
+      if (i > 0 && i < RAMP)
+	{
+	  // Linear, from (1, 0) to (0, 1)
+	  ASSERT_NEAR (whole[2 * i] - whole[2 * i - 2], -1.0 / RAMP, 1e-6);
+	  ASSERT_NEAR (whole[2 * i + 1] - whole[2 * i - 1], 1.0 / RAMP, 1e-6);
+	}
+      if (i >= RAMP)
+	{
+	  ASSERT_EQ (whole[2 * i], gL);
+	  ASSERT_EQ (whole[2 * i + 1], gR);
+	}
+    }
+}
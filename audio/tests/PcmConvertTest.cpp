@@ -0,0 +1,153 @@
+// =================================================================================================
+// PcmConvertTest.cpp
+//
+// The PCM conversion kernels: every instruction set the processor supports gives exactly
+// the scalar kernels' output, including the tails and unaligned buffers the vector loops
+// don't cover.
+// =================================================================================================
+
+#include "gtest/gtest.h"
+#include "../PcmConvert.h"
+#include "../SimdIsa.h"
+#include <climits>
+#include <cstring>
+#include <random>
+#include <vector>
+
+using namespace std;
+
+// Odd, so every vector loop leaves a tail
+static const int NUM_SAMPLES = 4099;
+
+class PcmConvertTest:public::testing::Test
+{
+protected:
+  virtual void SetUp ()
+  {
+    best = simdIsa ();
+
+    mt19937 rng (1);
+    raw.resize (4 * NUM_SAMPLES + 1);
+    for (size_t i = 0; i < raw.size (); i++)
+      raw[i] = rng ();
+
+    // Extremes of each width, so the scaling and sign extension are checked at the ends
+    const uint8_t extremes[][4] = {
+      {0x00, 0x00, 0x00, 0x80}, {0xFF, 0xFF, 0xFF, 0x7F},
+      {0xFF, 0xFF, 0xFF, 0xFF}, {0x00, 0x00, 0x00, 0x00}
+    };
+    memcpy (raw.data () + 1, extremes, sizeof (extremes));
+
+    // Includes values beyond full scale, which are clipped
+    uniform_real_distribution < float >dist (-1.2f, 1.2f);
+    flt.resize (NUM_SAMPLES);
+    for (int i = 0; i < NUM_SAMPLES; i++)
+      flt[i] = dist (rng);
+    flt[0] = 1;
+    flt[1] = -1;
+    flt[2] = 1.0001f;
+    flt[3] = -1.0001f;
+  }
+
+  virtual void TearDown ()
+  {
+    setSimdIsa (best);
+  }
+
+  // Output of one conversion at the given instruction set, from raw + offset
+  template < class Convert > vector < float >toFloat (SimdIsa isa, Convert convert,
+						      int offset)
+  {
+    setSimdIsa (isa);
+    vector < float >y (NUM_SAMPLES);
+    convert (raw.data () + offset, y.data (), NUM_SAMPLES);
+    return y;
+  }
+
+  SimdIsa best;
+  vector < uint8_t > raw;
+  vector < float >flt;
+};
+
+TEST_F (PcmConvertTest, ToFloatMatchesScalar)
+{
+  auto pcm8 =[](const uint8_t * s, float *d, size_t n)
+  {
+    pcm8ToFloat (s, d, n);
+  };
+  auto pcm16 =[](const uint8_t * s, float *d, size_t n)
+  {
+    pcm16ToFloat ((const int16_t *) s, d, n);
+  };
+  auto pcm24 =[](const uint8_t * s, float *d, size_t n)
+  {
+    pcm24ToFloat (s, d, n);
+  };
+  auto pcm32 =[](const uint8_t * s, float *d, size_t n)
+  {
+    pcm32ToFloat ((const int32_t *) s, d, n);
+  };
+
+  // Aligned, and one byte off
+  for (int offset = 0; offset <= 1; offset++)
+    for (int isa = SIMD_ISA_SSE2; isa <= best; isa++)
+      {
+	SCOPED_TRACE (simdIsaName ((SimdIsa) isa));
+	EXPECT_EQ (toFloat ((SimdIsa) isa, pcm8, offset),
+		   toFloat (SIMD_ISA_SCALAR, pcm8, offset));
+	EXPECT_EQ (toFloat ((SimdIsa) isa, pcm16, offset),
+		   toFloat (SIMD_ISA_SCALAR, pcm16, offset));
+	EXPECT_EQ (toFloat ((SimdIsa) isa, pcm24, offset),
+		   toFloat (SIMD_ISA_SCALAR, pcm24, offset));
+	EXPECT_EQ (toFloat ((SimdIsa) isa, pcm32, offset),
+		   toFloat (SIMD_ISA_SCALAR, pcm32, offset));
+      }
+}
+
+TEST_F (PcmConvertTest, ScalarScaling)
+{
+  setSimdIsa (SIMD_ISA_SCALAR);
+  float y[4];
+  int16_t pcm16[] = { SHRT_MIN, SHRT_MAX, -1, 0 };
+  pcm16ToFloat (pcm16, y, 4);
+  EXPECT_EQ (y[0], -1.0f);
+  EXPECT_EQ (y[1], 32767 / 32768.0f);
+  EXPECT_EQ (y[2], -1 / 32768.0f);
+  EXPECT_EQ (y[3], 0.0f);
+
+  uint8_t pcm8[] = { 0, 128, 255 };
+  pcm8ToFloat (pcm8, y, 3);
+  EXPECT_EQ (y[0], -1.0f);
+  EXPECT_EQ (y[1], 0.0f);
+  EXPECT_EQ (y[2], 127 / 128.0f);
+
+  uint8_t pcm24[] = { 0x00, 0x00, 0x80, 0xFF, 0xFF, 0xFF };
+  pcm24ToFloat (pcm24, y, 2);
+  EXPECT_EQ (y[0], -1.0f);
+  EXPECT_EQ (y[1], -1 / 8388608.0f);
+}
+
+TEST_F (PcmConvertTest, ToPcm16MatchesScalarAndClips)
+{
+  setSimdIsa (SIMD_ISA_SCALAR);
+  vector < int16_t > expected (NUM_SAMPLES);
+  floatToPcm16 (flt.data (), expected.data (), NUM_SAMPLES);
+  EXPECT_EQ (expected[0], SHRT_MAX);
+  EXPECT_EQ (expected[1], -SHRT_MAX);
+  EXPECT_EQ (expected[2], SHRT_MAX);
+  EXPECT_EQ (expected[3], -SHRT_MAX);
+
+  for (int isa = SIMD_ISA_SSE2; isa <= best; isa++)
+    {
+      SCOPED_TRACE (simdIsaName ((SimdIsa) isa));
+      setSimdIsa ((SimdIsa) isa);
+
+      vector < int16_t > y (NUM_SAMPLES);
+      floatToPcm16 (flt.data (), y.data (), NUM_SAMPLES);
+      EXPECT_EQ (y, expected);
+
+      // From an unaligned source
+      floatToPcm16 (flt.data () + 1, y.data (), NUM_SAMPLES - 1);
+      EXPECT_TRUE (equal (y.begin (), y.end () - 1, expected.begin () + 1));
+    }
+}
@@ -0,0 +1,135 @@
+// =================================================================================================
+// ResamplerTest.cpp
+//
+// Resampler's passband, stopband and accuracy, and its block handling.
+// =================================================================================================
+
+#include "gtest/gtest.h"
+#include "TestUtils.h"
+#include "../Resampler.h"
+
+// All of x through the resampler in blocks of the given size, then flushed
+static vector < float >
+resample (Resampler & r, const vector < float >&x, int block)
+{
+  vector < float >y (r.maxOutput ((int) x.size ()) + r.maxOutput (r.latency ()));
+  int numOut = 0;
+  for (size_t i = 0; i < x.size (); i += block)
+    numOut += r.process (x.data () + i, min < int >(block, x.size () - i),
+			 y.data () + numOut);
+  numOut += r.flush (y.data () + numOut);
+  y.resize (numOut);
+  return y;
+}
+
+static vector < float >
+sine (double f, double sr, int n)
+{
+  vector < float >x (n);
+  for (int i = 0; i < n; i++)
+    x[i] = (float) sin (2 * M_PI * f * i / sr);
+  return x;
+}
+
+// Gain in dB of a unit sine at f, away from the ends
+static double
+gainDb (Resampler & r, double f, double inRate)
+{
+  vector < float >y = resample (r, sine (f, inRate, 60000), 1000);
+  double outRate = inRate * r.ratio ();
+  int skip = (int) (0.1 * y.size ());
+  return 20 * log10 (toneAmplitude (y.data () + skip, y.size () - 2 * skip, f, outRate));
+}
+
+// Error of a resampled 1 kHz sine against the exact one, in dB
+static double
+sineErrorDb (Resampler & r, double inRate)
+{
+  const double F = 1000;
+  double outRate = inRate * r.ratio ();
+  vector < float >y = resample (r, sine (F, inRate, 40000), 777);
+  double error = 0, signal = 0;
+  for (size_t j = y.size () / 10; j < y.size () * 9 / 10; j++)
+    {
+      double expected = sin (2 * M_PI * F * j / outRate);
+      error += (y[j] - expected) * (y[j] - expected);
+      signal += expected * expected;
+    }
+  return 10 * log10 (error / signal);
+}
+
+struct Conversion
+{
+  int inRate, outRate;
+  double ratio;			// For an arbitrary ratio; 0 to use the rates
+};
+
+static const Conversion CONVERSIONS[] = {
+  {44100, 48000, 0}, {48000, 44100, 0}, {96000, 44100, 0}, {44100, 96000, 0},
+  {48000, 0, 1 / 1.37}, {48000, 0, 1.61803}
+};
+
+static Resampler
+makeResampler (const Conversion & c)
+{
+  return c.ratio ? Resampler (c.ratio) : Resampler (c.inRate, c.outRate);
+}
+
+// Flat to 84% of the lower Nyquist frequency, and more than 80 dB down beyond it
+TEST (Resampler, PassbandAndStopband)
+{
+  for (size_t i = 0; i < sizeof (CONVERSIONS) / sizeof (CONVERSIONS[0]); i++)
+    {
+      const Conversion & c = CONVERSIONS[i];
+      Resampler r = makeResampler (c);
+      SCOPED_TRACE (testing::Message () << c.inRate << " Hz x " << r.ratio ());
+      EXPECT_EQ (r.isPolyphase (), c.ratio == 0);
+      double nyquist = c.inRate * min (1.0, r.ratio ()) / 2;
+
+      for (double f = 100; f < 0.84 * nyquist; f *= 1.5)
+	{
+	  r.reset ();
+	  EXPECT_NEAR (gainDb (r, f, c.inRate), 0, 0.1) << f << " Hz";
+	}
+      r.reset ();
+      EXPECT_NEAR (gainDb (r, 0.84 * nyquist, c.inRate), 0, 0.1);
+
+      // Only downsampling has input above the output's Nyquist frequency
+      if (r.ratio () < 1)
+	for (double f = 1.05 * nyquist; f < c.inRate / 2; f += 0.1 * nyquist)
+	  {
+	    r.reset ();
+	    EXPECT_LT (gainDb (r, f, c.inRate), -80) << f << " Hz";
+	  }
+    }
+}
+
+TEST (Resampler, SineAccuracy)
+{
+  for (size_t i = 0; i < sizeof (CONVERSIONS) / sizeof (CONVERSIONS[0]); i++)
+    {
+      const Conversion & c = CONVERSIONS[i];
+      Resampler r = makeResampler (c);
+      SCOPED_TRACE (testing::Message () << c.inRate << " Hz x " << r.ratio ());
+      EXPECT_LT (sineErrorDb (r, c.inRate), -90);
+    }
+}
+
+// The output doesn't depend on how the input is split, and has ceil(n * ratio) samples
+TEST (Resampler, BlockInvariant)
+{
+  vector < float >x = testNoise (20011);
+  for (size_t i = 0; i < sizeof (CONVERSIONS) / sizeof (CONVERSIONS[0]); i++)
+    {
+      Resampler r = makeResampler (CONVERSIONS[i]);
+      SCOPED_TRACE (r.ratio ());
+      vector < float >whole = resample (r, x, x.size ());
+      EXPECT_EQ (whole.size (), (size_t) ceil (x.size () * r.ratio () - 1e-9));
+      const int blocks[] = { 1, 7, 64, 1000 };
+      for (int b = 0; b < 4; b++)
+	{
+	  r.reset ();
+	  EXPECT_EQ (resample (r, x, blocks[b]), whole) << blocks[b];
+	}
+    }
+}
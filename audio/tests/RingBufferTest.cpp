@@ -0,0 +1,325 @@
+// =================================================================================================
+// RingBufferTest.cpp
+//
+// DS/RingBuffer.h's queues, which AlsaEngine passes its periods through: single-threaded
+// behaviour, item lifetimes, in-place access through spans, and threaded stress runs.
+// =================================================================================================
+
+#include "gtest/gtest.h"
+#include "../../DS/RingBuffer.h"
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+using namespace std;
+
+TEST (RingBuffer, FullAndEmpty)
+{
+  RingBuffer < int >q (5);
+  EXPECT_EQ (q.capacity (), 8u);	// A power of two
+  EXPECT_TRUE (q.empty ());
+  int value;
+  EXPECT_FALSE (q.pop (value));
+
+  for (int i = 0; i < 8; i++)
+    EXPECT_TRUE (q.push (i));
+  EXPECT_FALSE (q.push (8));
+  EXPECT_EQ (q.size (), 8u);
+
+  // Round and round, so the positions wrap the storage many times
+  for (int i = 8; i < 100; i++)
+    {
+      ASSERT_TRUE (q.pop (value));
+      EXPECT_EQ (value, i - 8);
+      ASSERT_TRUE (q.push (i));
+    }
+}
+
+TEST (RingBuffer, Bulk)
+{
+  RingBuffer < int >q (16);
+  vector < int >in (40), out (40);
+  for (int i = 0; i < 40; i++)
+    in[i] = i;
+
+  EXPECT_EQ (q.pushBulk (in.data (), 10), 10u);
+  EXPECT_EQ (q.pushBulk (in.data () + 10, 10), 6u);	// As many as fit
+  EXPECT_EQ (q.popBulk (out.data (), 4), 4u);
+  EXPECT_EQ (q.pushBulk (in.data () + 16, 10), 4u);	// Across the end of the storage
+  EXPECT_EQ (q.popBulk (out.data () + 4, 100), 16u);	// As many as there are
+  EXPECT_EQ (q.popBulk (out.data (), 1), 0u);
+  for (int i = 0; i < 20; i++)
+    EXPECT_EQ (out[i], i);
+}
+
+// Counts the live copies of itself
+struct Counted
+{
+  static int live;
+  int value;
+  Counted (int v = 0):value (v)
+  {
+    live++;
+  }
+  Counted (const Counted & other):value (other.value)
+  {
+    live++;
+  }
+  Counted & operator= (const Counted & other)
+  {
+    value = other.value;
+    return *this;
+  }
+  ~Counted ()
+  {
+    live--;
+  }
+};
+int Counted::live = 0;
+
+// Items are destroyed when they're popped, and those left when the queue goes
+TEST (RingBuffer, Lifetimes)
+{
+  {
+    RingBuffer < Counted > q (8);
+    MpmcRingBuffer < Counted > m (8);
+    EXPECT_EQ (Counted::live, 0);
+    for (int i = 0; i < 5; i++)
+      {
+	q.push (Counted (i));
+	m.push (Counted (i));
+      }
+    EXPECT_EQ (Counted::live, 10);
+
+    Counted c;
+    q.pop (c);
+    m.pop (c);
+    EXPECT_EQ (Counted::live, 9);
+    Counted out[2];
+    q.popBulk (out, 2);
+    m.popBulk (out, 2);
+    EXPECT_EQ (Counted::live, 2 + 2 + 1 + 2);	// Queues, c and out
+  }
+  EXPECT_EQ (Counted::live, 0);
+
+  // Move-only items
+  RingBuffer < unique_ptr < int > >q (4);
+  EXPECT_TRUE (q.push (unique_ptr < int >(new int (7))));
+  unique_ptr < int >p;
+  EXPECT_TRUE (q.pop (p));
+  EXPECT_EQ (*p, 7);
+}
+
+// One thread pushes a count in runs of random length, another pops it in runs of other
+// lengths; every number comes out once, in order
+TEST (RingBuffer, SpscStress)
+{
+  const int N = 2000000;
+  RingBuffer < int >q (64);
+
+  thread producer ([&] ()
+    {
+      mt19937 rng (1);
+      vector < int >block (100);
+      for (int next = 0; next < N;)
+	{
+	  int n = min < int >(rng () % 100 + 1, N - next);
+	  for (int i = 0; i < n; i++)
+	    block[i] = next + i;
+	  int pushed = q.pushBulk (block.data (), n);
+	  next += pushed;
+	  if (pushed == 0)
+	    this_thread::yield ();
+	}
+    });
+
+  mt19937 rng (2);
+  vector < int >block (100);
+  int expected = 0, errors = 0;
+  while (expected < N)
+    {
+      int n = q.popBulk (block.data (), rng () % 100 + 1);
+      for (int i = 0; i < n; i++)
+	errors += block[i] != expected++;
+      if (n == 0)
+	this_thread::yield ();
+    }
+  producer.join ();
+  EXPECT_EQ (errors, 0);
+  EXPECT_TRUE (q.empty ());
+}
+
+// Four producers and four consumers, single and bulk; every item comes out exactly once
+TEST (RingBuffer, MpmcStress)
+{
+  const int THREADS = 4, PER_THREAD = 200000;
+  MpmcRingBuffer < int >q (256);
+  vector < atomic < int > >seen (THREADS * PER_THREAD);
+  for (size_t i = 0; i < seen.size (); i++)
+    seen[i] = 0;
+
+  vector < thread > threads;
+  for (int t = 0; t < THREADS; t++)
+    threads.push_back (thread ([&, t] ()
+      {
+	int next = t * PER_THREAD, end = next + PER_THREAD;
+	vector < int >block (16);
+	while (next < end)
+	  {
+	    int n = min (t % 2 ? 16 : 1, end - next);
+	    for (int i = 0; i < n; i++)
+	      block[i] = next + i;
+	    int pushed = (int) q.pushBulk (block.data (), n);
+	    next += pushed;
+	    if (pushed == 0)
+	      this_thread::yield ();
+	  }
+      }));
+  for (int t = 0; t < THREADS; t++)
+    threads.push_back (thread ([&, t] ()
+      {
+	vector < int >block (16);
+	for (int taken = 0; taken < PER_THREAD;)
+	  {
+	    int n = (int) q.popBulk (block.data (), min (t % 2 ? 16 : 1, PER_THREAD - taken));
+	    for (int i = 0; i < n; i++)
+	      seen[block[i]]++;
+	    taken += n;
+	    if (n == 0)
+	      this_thread::yield ();
+	  }
+      }));
+  for (size_t t = 0; t < threads.size (); t++)
+    threads[t].join ();
+
+  int wrong = 0;
+  for (size_t i = 0; i < seen.size (); i++)
+    wrong += seen[i] != 1;
+  EXPECT_EQ (wrong, 0);
+  EXPECT_TRUE (q.empty ());
+}
+
+// Fills a reservation with consecutive numbers from next
+static void
+fillSpans (RingBuffer < int >::Spans s, int next)
+{
+  for (size_t i = 0; i < s.firstSize; i++)
+    s.first[i] = next++;
+  for (size_t i = 0; i < s.secondSize; i++)
+    s.second[i] = next++;
+}
+
+// The i'th item of a peek
+static int
+spanItem (const RingBuffer < int >::Spans & s, size_t i)
+{
+  return i < s.firstSize ? s.first[i] : s.second[i - s.firstSize];
+}
+
+TEST (RingBuffer, Spans)
+{
+  RingBuffer < int >q (8);
+
+  // Move the positions to 6, so the next run of slots crosses the end
+  for (int i = 0; i < 6; i++)
+    q.push (i);
+  int value;
+  for (int i = 0; i < 6; i++)
+    q.pop (value);
+
+  RingBuffer < int >::Spans s = q.reserve (5);
+  EXPECT_EQ (s.firstSize, 2u);
+  EXPECT_EQ (s.secondSize, 3u);
+  fillSpans (s, 100);
+
+  // Reserving again before committing hands out the same slots
+  RingBuffer < int >::Spans again = q.reserve (5);
+  EXPECT_EQ (again.first, s.first);
+  EXPECT_EQ (again.second, s.second);
+
+  // A partial commit publishes only the start of the reservation
+  q.commit (3);
+  EXPECT_EQ (q.size (), 3u);
+  s = q.reserve (100);
+  EXPECT_EQ (s.size (), 5u);	// Only what's free
+  fillSpans (s, 103);
+  q.commit (5);
+  EXPECT_EQ (q.size (), 8u);
+  EXPECT_EQ (q.reserve (1).size (), 0u);
+
+  s = q.peek (100);
+  ASSERT_EQ (s.size (), 8u);
+  EXPECT_EQ (s.firstSize, 2u);
+  for (size_t i = 0; i < s.size (); i++)
+    EXPECT_EQ (spanItem (s, i), 100 + (int) i);
+
+  // Peeking again before releasing hands out the same items, and a partial release
+  // removes only the oldest
+  EXPECT_EQ (q.peek (8).first, s.first);
+  q.release (3);
+  EXPECT_EQ (q.size (), 5u);
+  s = q.peek (2);
+  ASSERT_EQ (s.size (), 2u);
+  EXPECT_EQ (spanItem (s, 0), 103);
+  q.release (2);
+
+  // The in-place and copying calls see the same queue
+  ASSERT_TRUE (q.pop (value));
+  EXPECT_EQ (value, 105);
+  EXPECT_TRUE (q.push (108));
+  s = q.peek (10);
+  ASSERT_EQ (s.size (), 3u);
+  EXPECT_EQ (spanItem (s, 2), 108);
+  q.release (3);
+  EXPECT_TRUE (q.empty ());
+  EXPECT_EQ (q.peek (1).size (), 0u);
+}
+
+// As SpscStress, reserving and peeking in place, with partial commits and releases. The
+// positions start partway round: on one CPU the threads take turns filling and emptying
+// the queue, which from position 0 would keep every run of 48 short of the end.
+TEST (RingBuffer, SpansStress)
+{
+  const int N = 2000000;
+  RingBuffer < int >q (64);
+  int value;
+  for (int i = 0; i < 40; i++)
+    {
+      q.push (i);
+      q.pop (value);
+    }
+
+  thread producer ([&] ()
+    {
+      mt19937 rng (3);
+      for (int next = 0; next < N;)
+	{
+	  RingBuffer < int >::Spans s = q.reserve (min < int >(48, N - next));
+	  fillSpans (s, next);
+	  int n = s.size () ? rng () % s.size () + 1 : 0;
+	  q.commit (n);
+	  next += n;
+	  if (n == 0)
+	    this_thread::yield ();
+	}
+    });
+
+  mt19937 rng (4);
+  int expected = 0, errors = 0, wrapped = 0;
+  while (expected < N)
+    {
+      RingBuffer < int >::Spans s = q.peek (48);
+      int n = s.size () ? rng () % s.size () + 1 : 0;
+      for (int i = 0; i < n; i++)
+	errors += spanItem (s, i) != expected++;
+      wrapped += s.secondSize > 0;
+      q.release (n);
+      if (n == 0)
+	this_thread::yield ();
+    }
+  producer.join ();
+  EXPECT_EQ (errors, 0);
+  EXPECT_GT (wrapped, 0);
+  EXPECT_TRUE (q.empty ());
+}
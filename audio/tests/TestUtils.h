@@ -0,0 +1,102 @@
+// =================================================================================================
+// TestUtils.h
+//
+// Helpers shared by the unit tests: temporary files and test signals.
+//
+// =================================================================================================
+
+#ifndef __TestUtils__
+#define __TestUtils__
+
+#include <cmath>
+#include <cstdlib>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+
+using namespace std;
+
+/// A file name in the temporary directory, removed when it goes out of scope
+class TempFile
+{
+public:
+
+	TempFile()
+	{
+		char path[] = "/tmp/audioTestXXXXXX";
+		int fd = mkstemp(path);
+		if (fd >= 0)
+			close(fd);
+		m_path = path;
+	}
+
+	~TempFile() { unlink(m_path.c_str()); }
+
+	TempFile(const TempFile&) = delete;
+	TempFile& operator=(const TempFile&) = delete;
+
+	const string& path() const { return m_path; }
+
+private:
+
+	string m_path;
+};
+
+/// numFrames of numCh interleaved sines, each channel at a different frequency
+inline vector<float> testSines(int numCh, int numFrames, float sr, float amplitude = 0.5f)
+{
+	vector<float> x(numCh * numFrames);
+	for (int i = 0; i < numFrames; i++)
+		for (int ch = 0; ch < numCh; ch++)
+			x[i * numCh + ch] = amplitude * (float)sin(2 * M_PI * (440.0 + 110 * ch) * i / sr);
+	return x;
+}
+
+/// n samples of uniform noise in [-amplitude, amplitude], the same for the same seed
+inline vector<float> testNoise(int n, unsigned seed = 1, float amplitude = 1)
+{
+	mt19937 rng(seed);
+	uniform_real_distribution<float> dist(-amplitude, amplitude);
+	vector<float> x(n);
+	for (int i = 0; i < n; i++)
+		x[i] = dist(rng);
+	return x;
+}
+
+/// Amplitude and phase of frequency f in x, by correlating with a sine and a cosine
+inline double toneAmplitude(const float *x, int n, double f, double sr)
+{
+	double s = 0, c = 0;
+	for (int i = 0; i < n; i++)
+	{
+		s += x[i] * sin(2 * M_PI * f * i / sr);
+		c += x[i] * cos(2 * M_PI * f * i / sr);
+	}
+	return 2 * sqrt(s * s + c * c) / n;
+}
+
+/// Gain in dB of a mono filter at frequency f, from its response to a unit sine once it
+/// has settled. process(x, y, n) filters a block.
+template <class Process>
+double sineGainDb(Process process, double f, double sr)
+{
+	const int SETTLE = 8192, N = 32768;
+	vector<float> x(SETTLE + N), y(SETTLE + N);
+	for (int i = 0; i < SETTLE + N; i++)
+		x[i] = (float)sin(2 * M_PI * f * i / sr);
+	process(x.data(), y.data(), SETTLE + N);
+	return 20 * log10(toneAmplitude(y.data() + SETTLE, N, f, sr) /
+					  toneAmplitude(x.data() + SETTLE, N, f, sr));
+}
+
+/// Largest absolute difference between two buffers of the same size
+inline double maxAbsDiff(const vector<float>& a, const vector<float>& b)
+{
+	double diff = 0;
+	for (size_t i = 0; i < a.size() && i < b.size(); i++)
+		diff = fmax(diff, fabs((double)a[i] - b[i]));
+	return diff;
+}
+
+#endif
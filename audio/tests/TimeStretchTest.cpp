@@ -0,0 +1,88 @@
+// =================================================================================================
+// TimeStretchTest.cpp
+//
+// TimeStretch's output length and block handling across its whole range.
+// =================================================================================================
+
+#include "gtest/gtest.h"
+#include "TestUtils.h"
+#include "../TimeStretch.h"
+
+static const int SAMPLE_RATE = 44100;
+
+// All of x through the stretcher in blocks of the given size, then flushed
+static vector < float >
+stretch (TimeStretch & ts, const vector < float >&x, int block)
+{
+  vector < float >y, out (max (ts.maxOutput (block), ts.maxOutput (0)));
+  for (size_t i = 0; i < x.size (); i += block)
+    {
+      int k = ts.process (x.data () + i, min < int >(block, x.size () - i), out.data ());
+      y.insert (y.end (), out.begin (), out.begin () + k);
+    }
+  int k = ts.flush (out.data ());
+  y.insert (y.end (), out.begin (), out.begin () + k);
+  return y;
+}
+
+// Every stretch and pitch shift ends, with the input length times the stretch
+TEST (TimeStretch, OutputLengthOverFullRange)
+{
+  const double stretches[] = { 0.25, 0.3, 0.5, 0.7, 1, 1.3, 2, 3, 4 };
+  const double pitches[] = { -24, -12, -7, -1, 0, 5, 12, 24 };
+  vector < float >x = testSines (1, 20000, SAMPLE_RATE);
+  for (int method = STRETCH_WSOLA; method <= STRETCH_PHASE_VOCODER; method++)
+    for (int s = 0; s < 9; s++)
+      for (int p = 0; p < 8; p++)
+	{
+	  SCOPED_TRACE (testing::Message () << "method " << method << ", stretch "
+			<< stretches[s] << ", pitch " << pitches[p]);
+	  TimeStretch ts (SAMPLE_RATE, (StretchMethod) method, stretches[s], pitches[p]);
+	  vector < float >y = stretch (ts, x, 4096);
+	  EXPECT_NEAR ((double) y.size (), x.size () * stretches[s], 1);
+	}
+}
+
+// Flushing straight away makes no output, and doesn't hang
+TEST (TimeStretch, FlushWithoutInput)
+{
+  float y[1];
+  TimeStretch ts (SAMPLE_RATE, STRETCH_PHASE_VOCODER, 0.25, -24);
+  EXPECT_EQ (ts.flush (y), 0);
+}
+
+// The output doesn't depend on how the input is split
+TEST (TimeStretch, BlockInvariant)
+{
+  vector < float >x = testNoise (30011, 1, 0.5f);
+  for (int method = STRETCH_WSOLA; method <= STRETCH_PHASE_VOCODER; method++)
+    {
+      SCOPED_TRACE (method);
+      TimeStretch ts (SAMPLE_RATE, (StretchMethod) method, 1.37, 3);
+      vector < float >whole = stretch (ts, x, x.size ());
+      const int blocks[] = { 1, 100, 4097 };
+      for (int b = 0; b < 3; b++)
+	{
+	  ts.reset ();
+	  EXPECT_EQ (stretch (ts, x, blocks[b]), whole) << blocks[b];
+	}
+    }
+}
+
+// Stretching keeps a steady tone's pitch, and shifting moves it by the interval
+TEST (TimeStretch, KeepsOrShiftsPitch)
+{
+  vector < float >x = testSines (1, 44100, SAMPLE_RATE);	// 440 Hz at 0.5
+  for (int method = STRETCH_WSOLA; method <= STRETCH_PHASE_VOCODER; method++)
+    {
+      SCOPED_TRACE (method);
+      TimeStretch slower (SAMPLE_RATE, (StretchMethod) method, 1.5);
+      vector < float >y = stretch (slower, x, 1024);
+      EXPECT_NEAR (toneAmplitude (y.data () + 10000, 40000, 440, SAMPLE_RATE), 0.5, 0.05);
+
+      TimeStretch fifth (SAMPLE_RATE, (StretchMethod) method, 1, 7);
+      y = stretch (fifth, x, 1024);
+      double f = 440 * pow (2, 7 / 12.0);
+      EXPECT_NEAR (toneAmplitude (y.data () + 5000, 30000, f, SAMPLE_RATE), 0.5, 0.05);
+    }
+}
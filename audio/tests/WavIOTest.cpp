@@ -0,0 +1,482 @@
+// =================================================================================================
+// WavIOTest.cpp
+//
+// WavReader, WavWriter, and audioRead/audioWrite built on them.
+// =================================================================================================
+
+#include "gtest/gtest.h"
+#include "TestUtils.h"
+#include "../WavUtils.h"
+#include <cstring>
+#include <fstream>
+#include <iterator>
+
+static const int SAMPLE_RATE = 44100;
+
+// 16-bit audio goes through a round trip to within two quantization steps: the writer
+// truncates x * 32767, and the reader divides by 32768
+TEST (WavIO, AudioWriteReadRoundTrip)
+{
+  TempFile file;
+  vector < float >x = testSines (2, 10000, SAMPLE_RATE);
+  ASSERT_EQ (audioWrite (file.path (), x, SAMPLE_RATE, 2), WAV_OK);
+
+  vector < float >y;
+  int sr = 0, numCh = 0;
+  ASSERT_EQ (audioRead (file.path (), y, sr, numCh), WAV_OK);
+  EXPECT_EQ (sr, SAMPLE_RATE);
+  EXPECT_EQ (numCh, 2);
+  ASSERT_EQ (y.size (), x.size ());
+  EXPECT_LE (maxAbsDiff (x, y), 2.0 / 32768);
+}
+
+// The split versions read and write the same files as the interleaved ones
+TEST (WavIO, SplitMatchesInterleaved)
+{
+  TempFile interleavedFile, splitFile;
+  int numFrames = 5000;
+  vector < float >x = testSines (3, numFrames, SAMPLE_RATE);
+  vector < vector < float >>split (3, vector < float >(numFrames));
+  for (int i = 0; i < numFrames; i++)
+    for (int ch = 0; ch < 3; ch++)
+      split[ch][i] = x[i * 3 + ch];
+
+  ASSERT_EQ (audioWrite (interleavedFile.path (), x, SAMPLE_RATE, 3), WAV_OK);
+  ASSERT_EQ (audioWrite (splitFile.path (), split, SAMPLE_RATE), WAV_OK);
+
+  vector < float >a, b;
+  int sr, numCh;
+  ASSERT_EQ (audioRead (interleavedFile.path (), a, sr, numCh), WAV_OK);
+  ASSERT_EQ (audioRead (splitFile.path (), b, sr, numCh), WAV_OK);
+  EXPECT_EQ (a, b);
+
+  vector < vector < float >>c;
+  ASSERT_EQ (audioRead (splitFile.path (), c, sr), WAV_OK);
+  ASSERT_EQ (c.size (), 3u);
+  for (int i = 0; i < numFrames; i++)
+    for (int ch = 0; ch < 3; ch++)
+      ASSERT_EQ (c[ch][i], a[i * 3 + ch]);
+}
+
+// Streaming in odd-sized blocks gives the same audio as reading the whole file
+TEST (WavIO, StreamingMatchesWholeFile)
+{
+  TempFile file;
+  int numFrames = 20000;
+  vector < float >x = testSines (2, numFrames, SAMPLE_RATE);
+
+  WavWriter writer;
+  ASSERT_EQ (writer.open (file.path (), SAMPLE_RATE, 2), WAV_OK);
+  for (int i = 0; i < numFrames; i += 777)
+    writer.write (x.data () + 2 * i, std::min (777, numFrames - i));
+  EXPECT_EQ (writer.numFrames (), numFrames);
+  ASSERT_EQ (writer.close (), WAV_OK);
+
+  vector < float >whole;
+  int sr, numCh;
+  ASSERT_EQ (audioRead (file.path (), whole, sr, numCh), WAV_OK);
+
+  WavReader reader;
+  ASSERT_EQ (reader.open (file.path ()), WAV_OK);
+  EXPECT_EQ (reader.numFrames (), numFrames);
+  vector < float >streamed (2 * numFrames);
+  int pos = 0, n;
+  while ((n = reader.read (streamed.data () + 2 * pos, 333)) > 0)
+    pos += n;
+  EXPECT_EQ (pos, numFrames);
+  EXPECT_EQ (reader.position (), numFrames);
+  EXPECT_EQ (streamed, whole);
+}
+
+// Every format the writer supports reads back as written, to within its quantization step
+TEST (WavIO, SampleFormats)
+{
+  struct
+  {
+    int bits;
+    WavSampleFormat format;
+    double tolerance;
+  } formats[] =
+  {
+    {8, WAV_FORMAT_PCM, 2.0 / 128},
+    {16, WAV_FORMAT_PCM, 2.0 / 32768},
+    {24, WAV_FORMAT_PCM, 2.0 / 8388608},
+    {32, WAV_FORMAT_PCM, 1e-7},
+    {32, WAV_FORMAT_FLOAT, 0},
+    {64, WAV_FORMAT_FLOAT, 0}
+  };
+  int numFrames = 3000;
+
+  for (auto & f:formats)
+    for (int numCh : {1, 2, 6})
+      {
+	SCOPED_TRACE (to_string (f.bits) + " bits, format " +
+		      to_string (f.format) + ", " + to_string (numCh) + " ch");
+	TempFile file;
+	vector < float >x = testSines (numCh, numFrames, SAMPLE_RATE, 0.9f);
+	WavWriter writer;
+	ASSERT_EQ (writer.open (file.path (), SAMPLE_RATE, numCh, f.bits, f.format),
+		   WAV_OK);
+	writer.write (x.data (), numFrames);
+	ASSERT_EQ (writer.close (), WAV_OK);
+
+	WavReader reader;
+	ASSERT_EQ (reader.open (file.path ()), WAV_OK);
+	EXPECT_EQ (reader.numChannels (), numCh);
+	EXPECT_EQ (reader.bitsPerSample (), f.bits);
+	EXPECT_EQ (reader.sampleFormat (), f.format);
+	ASSERT_EQ (reader.numFrames (), numFrames);
+	vector < float >y (x.size ());
+	EXPECT_EQ (reader.read (y.data (), numFrames), numFrames);
+	EXPECT_LE (maxAbsDiff (x, y), f.tolerance);
+      }
+}
+
+// Floats, more than two channels or more than 16 bits get an extensible fmt chunk
+TEST (WavIO, ExtensibleHeader)
+{
+  struct
+  {
+    int numCh, bits;
+    WavSampleFormat format;
+    bool extensible;
+  } cases[] =
+  {
+    {2, 16, WAV_FORMAT_PCM, false},
+    {1, 8, WAV_FORMAT_PCM, false},
+    {3, 16, WAV_FORMAT_PCM, true},
+    {2, 24, WAV_FORMAT_PCM, true},
+    {1, 32, WAV_FORMAT_FLOAT, true}
+  };
+
+  for (auto & c:cases)
+    {
+      TempFile file;
+      WavWriter writer;
+      ASSERT_EQ (writer.open (file.path (), SAMPLE_RATE, c.numCh, c.bits, c.format),
+		 WAV_OK);
+      ASSERT_EQ (writer.close (), WAV_OK);
+
+      // The format tag follows "RIFF", its size, "WAVE", the 36-byte JUNK chunk, and
+      // the fmt chunk's ID and size
+      ifstream in (file.path ().c_str (), ios::binary);
+      in.seekg (12 + 36 + 8);
+      uint16_t formatTag = 0;
+      in.read ((char *) &formatTag, 2);
+      EXPECT_EQ (formatTag, c.extensible ? 0xFFFE : (uint16_t) c.format);
+    }
+}
+
+// The writer reports formats it can't write
+TEST (WavIO, WriterRejectsUnsupportedFormats)
+{
+  TempFile file;
+  WavWriter writer;
+  EXPECT_EQ (writer.open (file.path (), SAMPLE_RATE, 2, 12), WAV_ERR_UNSUPPORTED);
+  EXPECT_EQ (writer.open (file.path (), SAMPLE_RATE, 2, 16, WAV_FORMAT_FLOAT),
+	     WAV_ERR_UNSUPPORTED);
+  EXPECT_EQ (writer.open (file.path (), SAMPLE_RATE, 0), WAV_ERR_UNSUPPORTED);
+}
+
+// The header's BlockAlign is a short and its ByteRate an int. Formats right at those
+// limits round-trip, and one channel more is refused rather than written with a wrapped
+// header that the reader would reject.
+TEST (WavIO, HeaderFieldLimits)
+{
+  struct
+  {
+    int sr, numCh, bits;
+    WavSampleFormat format;
+  } limits[] =
+  {
+    {SAMPLE_RATE, 8191, 32, WAV_FORMAT_FLOAT},	// 32764 bytes a frame
+    {96000, 7456, 24, WAV_FORMAT_PCM}	// 2147328000 bytes a second
+  };
+
+  for (auto & l:limits)
+    {
+      SCOPED_TRACE (to_string (l.numCh) + " ch, " + to_string (l.bits) + " bits");
+      TempFile file;
+      int numFrames = 10;
+      vector < float >x = testNoise (l.numCh * numFrames, 1, 0.9f);
+      WavWriter writer;
+      ASSERT_EQ (writer.open (file.path (), l.sr, l.numCh, l.bits, l.format), WAV_OK);
+      writer.write (x.data (), numFrames);
+      ASSERT_EQ (writer.close (), WAV_OK);
+
+      WavReader reader;
+      ASSERT_EQ (reader.open (file.path ()), WAV_OK);
+      EXPECT_EQ (reader.sampleRate (), l.sr);
+      EXPECT_EQ (reader.numChannels (), l.numCh);
+      ASSERT_EQ (reader.numFrames (), numFrames);
+      vector < float >y (x.size ());
+      EXPECT_EQ (reader.read (y.data (), numFrames), numFrames);
+      EXPECT_LE (maxAbsDiff (x, y), 2.0 / 8388608);
+
+      EXPECT_EQ (writer.open (file.path (), l.sr, l.numCh + 1, l.bits, l.format),
+		 WAV_ERR_UNSUPPORTED);
+    }
+
+  // The case that used to wrap both fields
+  TempFile file;
+  WavWriter writer;
+  EXPECT_EQ (writer.open (file.path (), SAMPLE_RATE, 9000, 32, WAV_FORMAT_FLOAT),
+	     WAV_ERR_UNSUPPORTED);
+}
+
+// Interleaving undoes deinterleaving, for channel counts that span several tiles
+TEST (WavIO, InterleaveRoundTrip)
+{
+  for (int numCh : {1, 2, 17, 37})
+    {
+      int numFrames = 1000;
+      vector < float >x (numCh * numFrames);
+      for (size_t i = 0; i < x.size (); i++)
+	x[i] = (float) i;
+
+      vector < vector < float >>split (numCh, vector < float >(numFrames));
+      vector < float *>splitPtrs (numCh);
+      for (int ch = 0; ch < numCh; ch++)
+	splitPtrs[ch] = split[ch].data ();
+      deinterleave (x.data (), splitPtrs.data (), numCh, numFrames);
+      for (int ch = 0; ch < numCh; ch++)
+	ASSERT_EQ (split[ch][123], x[123 * numCh + ch]);
+
+      vector < float >y (x.size ());
+      interleave (splitPtrs.data (), y.data (), numCh, numFrames);
+      EXPECT_EQ (y, x);
+    }
+}
+
+// Appends a little-endian field to a file image
+template < class T > static void
+put (string & bytes, T value)
+{
+  bytes.append ((const char *) &value, sizeof (value));
+}
+
+// A 16-bit mono header with an RF64 signature and a ds64 chunk, whose data size is
+// dataSize (with the 32-bit sizes set to 0xFFFFFFFF), followed by numFrames samples
+static string
+rf64File (uint64_t dataSize, int numFrames, const char *signature = "RF64")
+{
+  string bytes = signature;
+  put < uint32_t > (bytes, 0xFFFFFFFF);
+  bytes += "WAVE";
+
+  bytes += "ds64";
+  put < uint32_t > (bytes, 28);
+  put < uint64_t > (bytes, 4 + 36 + 24 + 8 + dataSize);
+  put < uint64_t > (bytes, dataSize);
+  put < uint64_t > (bytes, dataSize / 2);
+  put < uint32_t > (bytes, 0);
+
+  bytes += "fmt ";
+  put < uint32_t > (bytes, 16);
+  put < int16_t > (bytes, 1);
+  put < int16_t > (bytes, 1);
+  put < int32_t > (bytes, SAMPLE_RATE);
+  put < int32_t > (bytes, 2 * SAMPLE_RATE);
+  put < int16_t > (bytes, 2);
+  put < int16_t > (bytes, 16);
+
+  bytes += "data";
+  put < uint32_t > (bytes, 0xFFFFFFFF);
+  for (int i = 0; i < numFrames; i++)
+    put < int16_t > (bytes, (int16_t) (i * 16));
+  return bytes;
+}
+
+static void
+writeBytes (const string & path, const string & bytes)
+{
+  ofstream out (path.c_str (), ios::binary);
+  out.write (bytes.data (), bytes.size ());
+}
+
+// The data size of an RF64 or BW64 file comes from its ds64 chunk
+TEST (WavIO, ReadsRf64)
+{
+  for (const char *signature : {"RF64", "BW64"})
+    {
+      TempFile file;
+      writeBytes (file.path (), rf64File (2 * 1000, 1000, signature));
+
+      WavReader reader;
+      ASSERT_EQ (reader.open (file.path ()), WAV_OK);
+      EXPECT_EQ (reader.numFrames (), 1000);
+      EXPECT_FALSE (reader.truncated ());
+      vector < float >x (1000);
+      EXPECT_EQ (reader.read (x.data (), 1000), 1000);
+      EXPECT_EQ (x[999], 999 * 16 / 32768.0f);
+
+      MappedWav wav;
+      ASSERT_EQ (wav.open (file.path ()), WAV_OK);
+      EXPECT_EQ (wav.numFrames (), 1000);
+    }
+}
+
+// A ds64 size beyond 4 GB is taken as 64 bits, then limited to what the file holds
+TEST (WavIO, Rf64SizeBeyond32Bits)
+{
+  TempFile file;
+  writeBytes (file.path (), rf64File (6000000000ull, 1000));
+
+  int sr;
+  int64_t numSamples;
+  short numCh, bits, format;
+  ifstream in (file.path ().c_str (), ios::binary);
+  ASSERT_EQ (readWavHeader (in, sr, numSamples, numCh, bits, format), WAV_OK);
+  EXPECT_EQ (numSamples, 3000000000ll);
+
+  WavReader reader;
+  ASSERT_EQ (reader.open (file.path ()), WAV_OK);
+  EXPECT_EQ (reader.numFrames (), 1000);
+}
+
+// An RF64 file needs its ds64 chunk
+TEST (WavIO, Rf64WithoutDs64)
+{
+  string bytes = rf64File (2 * 10, 10);
+  bytes.replace (12, 4, "JUNK");
+  TempFile file;
+  writeBytes (file.path (), bytes);
+
+  WavReader reader;
+  EXPECT_EQ (reader.open (file.path ()), WAV_ERR_BAD_FORMAT);
+}
+
+// Files start with the JUNK chunk that becomes ds64 if the data outgrows 4 GB
+TEST (WavIO, WriterReservesDs64)
+{
+  TempFile file;
+  vector < float >x = testSines (1, 100, SAMPLE_RATE);
+  ASSERT_EQ (audioWrite (file.path (), x, SAMPLE_RATE), WAV_OK);
+
+  ifstream in (file.path ().c_str (), ios::binary);
+  char header[20];
+  in.read (header, sizeof (header));
+  EXPECT_EQ (string (header, 4), "RIFF");
+  EXPECT_EQ (string (header + 12, 4), "JUNK");
+  uint32_t junkSize;
+  memcpy (&junkSize, header + 16, 4);
+  EXPECT_EQ (junkSize, 28u);
+}
+
+// Odd-sized chunks before the data are followed by a pad byte, which findChunk skips
+TEST (WavIO, SkipsPaddedChunk)
+{
+  string bytes = rf64File (2 * 10, 10);
+  string riff = "RIFF";
+  put < uint32_t > (riff, 0);
+  riff += "WAVE";
+  riff += "LIST";
+  put < uint32_t > (riff, 3);
+  riff += "abc";
+  riff += '\0';
+  riff += bytes.substr (12 + 36);		// fmt and data chunks
+  riff.replace (riff.size () - 2 * 10 - 4, 4, string ("\x14\0\0\0", 4));
+  TempFile file;
+  writeBytes (file.path (), riff);
+
+  WavReader reader;
+  ASSERT_EQ (reader.open (file.path ()), WAV_OK);
+  EXPECT_EQ (reader.numFrames (), 10);
+}
+
+// The bytes of a 16-bit mono file of numFrames samples, as audioWrite writes it: RIFF
+// header, 36-byte JUNK chunk, fmt chunk at byte 48 and data chunk at byte 72
+static string
+wavFileBytes (int numFrames)
+{
+  TempFile file;
+  vector < float >x = testSines (1, numFrames, SAMPLE_RATE);
+  audioWrite (file.path (), x, SAMPLE_RATE);
+  ifstream in (file.path ().c_str (), ios::binary);
+  return string (istreambuf_iterator < char >(in), istreambuf_iterator < char >());
+}
+
+static WavStatus
+openBytes (const string & bytes)
+{
+  TempFile file;
+  writeBytes (file.path (), bytes);
+  WavReader reader;
+  return reader.open (file.path ());
+}
+
+// Malformed headers are reported with what's wrong with them
+TEST (WavStatus, MalformedHeaders)
+{
+  string good = wavFileBytes (100);
+  ASSERT_EQ (good.size (), 80u + 2 * 100);
+  EXPECT_EQ (openBytes (good), WAV_OK);
+
+  EXPECT_EQ (openBytes (""), WAV_ERR_NOT_WAVE);
+  EXPECT_EQ (openBytes ("RIFF\x10\0\0\0AVI LIST"), WAV_ERR_NOT_WAVE);
+
+  string noFmt = good;
+  noFmt.replace (48, 4, "fmx ");
+  EXPECT_EQ (openBytes (noFmt), WAV_ERR_NO_FMT);
+
+  string badAlign = good;
+  badAlign[68] = 4;
+  EXPECT_EQ (openBytes (badAlign), WAV_ERR_BAD_FORMAT);
+
+  string compressed = good;
+  compressed[56] = 2;		// ADPCM
+  EXPECT_EQ (openBytes (compressed), WAV_ERR_UNSUPPORTED);
+
+  string lowRate = good;
+  int32_t rate = 4000, byteRate = 8000;
+  memcpy (&lowRate[60], &rate, 4);
+  memcpy (&lowRate[64], &byteRate, 4);
+  EXPECT_EQ (openBytes (lowRate), WAV_ERR_UNSUPPORTED);
+
+  string noData = good;
+  noData.replace (72, 4, "date");
+  EXPECT_EQ (openBytes (noData), WAV_ERR_NO_DATA);
+
+  EXPECT_EQ (openBytes (good.substr (0, 62)), WAV_ERR_TRUNCATED);
+}
+
+// A file cut short inside its data is reported, with the audio that is there
+TEST (WavStatus, TruncatedData)
+{
+  int numFrames = 1000;
+  string bytes = wavFileBytes (numFrames);
+  TempFile whole, cut;
+  writeBytes (whole.path (), bytes);
+  writeBytes (cut.path (), bytes.substr (0, 1000));
+  int framesThere = (1000 - 80) / 2;
+
+  vector < float >expected, x;
+  int sr, numCh;
+  ASSERT_EQ (audioRead (whole.path (), expected, sr, numCh), WAV_OK);
+  EXPECT_EQ (audioRead (cut.path (), x, sr, numCh), WAV_ERR_DATA_TRUNCATED);
+  ASSERT_EQ ((int) x.size (), framesThere);
+  EXPECT_TRUE (equal (x.begin (), x.end (), expected.begin ()));
+
+  vector < vector < float >>split;
+  EXPECT_EQ (audioRead (cut.path (), split, sr), WAV_ERR_DATA_TRUNCATED);
+  ASSERT_EQ (split.size (), 1u);
+  EXPECT_EQ (split[0], x);
+
+  WavReader reader;
+  ASSERT_EQ (reader.open (cut.path ()), WAV_OK);
+  EXPECT_TRUE (reader.truncated ());
+  EXPECT_EQ (reader.numFrames (), framesThere);
+
+  ASSERT_EQ (reader.open (whole.path ()), WAV_OK);
+  EXPECT_FALSE (reader.truncated ());
+}
+
+TEST (WavStatus, MissingFile)
+{
+  vector < float >x;
+  int sr, numCh;
+  EXPECT_EQ (audioRead ("/nonexistent/file.wav", x, sr, numCh), WAV_ERR_OPEN);
+  EXPECT_TRUE (x.empty ());
+  EXPECT_STREQ (wavStatusString (WAV_ERR_DATA_TRUNCATED),
+		"file ends before the end of its data");
+}
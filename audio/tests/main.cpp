@@ -0,0 +1,14 @@
+// =================================================================================================
+// main.cpp
+//
+// Runs the audio unit tests (make test). Each tests/*Test.cpp covers one module.
+// =================================================================================================
+
+#include "gtest/gtest.h"
+
+int
+main (int argc, char **argv)
+{
+  ::testing::InitGoogleTest (&argc, argv);
+  return RUN_ALL_TESTS ();
+}